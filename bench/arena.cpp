@@ -0,0 +1,100 @@
+#include <bench.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+
+#include <font.h>
+#include <arena.h>
+
+namespace {
+	// What renderOccluders ranks
+	struct Score {
+		float score;
+		uint32_t index;
+	};
+}
+
+void Bench::arena() {
+	// A frame's worth of small transient arrays, heap vectors against the arena.
+	// A million of them would hold half a gigabyte at once, so the sweep stops short.
+	constexpr size_t elements = 64;
+	volatile size_t sink = 0;
+
+	for (size_t count : sweep) {
+		if (count > 100000) break;
+
+		const double heap = time(5, count, [&] {
+			for (size_t iter = 0; iter < count; iter++) {
+				std::vector<Score> scores(elements);
+				sink = sink + scores.size();
+			}
+		});
+
+		Arena::Frames frames;
+		const double arena = time(5, count, [&] {
+			frames.next();
+			for (size_t iter = 0; iter < count; iter++) {
+				auto scores = frames.current().array<Score>(elements);
+				sink = sink + scores.size();
+			}
+		});
+
+		report("frame scratch heap", count, heap);
+		report("frame scratch arena", count, arena);
+	}
+
+	// Strings copied into the arena every frame, like a snapshot does
+	const std::vector<std::string> texts = { "CHOP A WOOD", "MEW", "A STRING LONGER THAN THE SMALL STRING BUFFER" };
+	for (size_t count : sweep) {
+		std::vector<Font::String> strings(count);
+		for (size_t iter = 0; iter < count; iter++) strings[iter] = { texts[iter % texts.size()], { 0, 0 }, 16 };
+
+		std::vector<std::string> heapCopies(count);
+		const double heap = time(5, count, [&] {
+			for (size_t iter = 0; iter < count; iter++) heapCopies[iter] = std::string(strings[iter].data) + "!";
+		});
+
+		Arena::Linear text;
+		std::vector<Font::String> copies(count);
+		const double arena = time(5, count, [&] {
+			text.reset();
+			for (size_t iter = 0; iter < count; iter++) copies[iter] = { text.string(strings[iter].data), { 0, 0 }, 16 };
+		});
+
+		report("frame strings heap", count, heap);
+		report("frame strings arena", count, arena);
+	}
+
+	// Overflow grows the block once, after that a frame stays in it
+	Arena::Frames frames;
+	const size_t frameBytes = Arena::Linear::defaultCapacity * 3;
+	bool steady = true;
+	for (int frame = 0; frame < 8; frame++) {
+		frames.next();
+		for (size_t used = 0; used < frameBytes; used += 1000) frames.current().allocate(1000, 8);
+		steady = steady && (frame < 2 || frames.current()._overflow.empty());
+	}
+	frames.next();
+
+	const size_t expected = (frameBytes + 999) / 1000 * 1000;
+	std::cout << "  peak bytes/frame " << frames.peak() << " of " << expected << ": " << check(frames.peak() == expected)
+		<< ", no overflow once grown: " << check(steady) << std::endl;
+
+	// Mixed alignments: 9 bytes of data take 16 with padding, so the data alone
+	// stays under the 64 KiB block while the padded frame needs twice that
+	Arena::Frames padded;
+	bool paddedSteady = true;
+	for (int frame = 0; frame < 8; frame++) {
+		padded.next();
+		for (int pair = 0; pair < 7000; pair++) {
+			padded.current().allocate(1, 1);
+			padded.current().allocate(8, 8);
+		}
+		paddedSteady = paddedSteady && (frame < 2 || padded.current()._overflow.empty());
+	}
+
+	std::cout << "  padded peak " << padded.peak() << " bytes/frame, no overflow once grown: " << check(paddedSteady) << std::endl;
+}
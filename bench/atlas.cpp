@@ -0,0 +1,110 @@
+#include <bench.h>
+
+#include <vector>
+#include <string>
+#include <random>
+#include <iostream>
+
+#include <atlas.h>
+
+namespace {
+	struct ImageSet {
+		const char* name;
+		size_t count;
+		uint32_t minSize, maxSize;
+	};
+
+	struct Size {
+		uint32_t width, height;
+	};
+
+	// Placements on one page must not share a texel
+	size_t overlaps(const std::vector<std::pair<uint32_t, Atlas::Rect>>& placed, uint32_t pageSize) {
+		std::vector<std::vector<bool>> used;
+		size_t count = 0;
+
+		for (auto& [page, rect] : placed) {
+			if (page >= used.size()) used.resize(page + 1, std::vector<bool>(size_t(pageSize) * pageSize, false));
+
+			for (uint32_t y = rect.y; y < rect.y + rect.height; y++) {
+				for (uint32_t x = rect.x; x < rect.x + rect.width; x++) {
+					auto texel = used[page][size_t(y) * pageSize + x];
+					count += texel ? 1 : 0;
+					texel = true;
+				}
+			}
+		}
+
+		return count;
+	}
+}
+
+void Bench::atlas() {
+	constexpr std::array sets = {
+		ImageSet{ "icons", 5000, 16, 32 },
+		ImageSet{ "sprites", 1000, 8, 128 },
+		ImageSet{ "mixed", 200, 16, 512 },
+	};
+	constexpr std::array methods = {
+		std::pair{ Atlas::Method::MaxRects, "maxrects" },
+		std::pair{ Atlas::Method::Skyline, "skyline" },
+	};
+
+	for (auto& set : sets) {
+		std::mt19937 rng(13);
+		std::uniform_int_distribution<uint32_t> side(set.minSize, set.maxSize);
+
+		std::vector<Size> sizes;
+		uint64_t texels = 0;
+		for (size_t iter = 0; iter < set.count; iter++) {
+			sizes.push_back({ side(rng), side(rng) });
+			texels += uint64_t(sizes.back().width) * sizes.back().height;
+		}
+
+		for (auto& [method, methodName] : methods) {
+			Atlas::Packer packer({}, method);
+			std::vector<std::pair<uint32_t, Atlas::Rect>> placed;
+
+			const double ms = time(3, [&] {
+				packer.clear();
+				placed.clear();
+
+				for (auto& size : sizes) {
+					uint32_t page = 0;
+					if (auto rect = packer.insert(size.width, size.height, page))
+						placed.push_back({ page, *rect });
+				}
+			});
+
+			report(std::string("atlas ") + methodName + " " + set.name, set.count, ms);
+			const size_t overlapping = overlaps(placed, packer._settings.pageSize);
+			std::cout << "  pages " << packer._pages.size() << ", occupancy "
+				<< packer.occupancy(texels) * 100.0 << "%, placed " << placed.size()
+				<< ", overlapping texels " << overlapping << " (" << check(overlapping == 0) << ")\n";
+		}
+	}
+
+	// Full build with texels, gutters and the mip-safe chain
+	std::mt19937 rng(17);
+	std::uniform_int_distribution<uint32_t> side(8, 128);
+	std::vector<std::vector<uint32_t>> images;
+	std::vector<Size> sizes;
+	for (size_t iter = 0; iter < 1000; iter++) {
+		sizes.push_back({ side(rng), side(rng) });
+		images.emplace_back(size_t(sizes.back().width) * sizes.back().height, static_cast<uint32_t>(iter) | 0xff000000);
+	}
+
+	Atlas::Builder builder;
+	size_t levels = 0;
+	report("atlas build + mips", images.size(), time(3, [&] {
+		builder = Atlas::Builder();
+		for (size_t iter = 0; iter < images.size(); iter++)
+			builder.add(sizes[iter].width, sizes[iter].height, images[iter]);
+
+		for (uint32_t page = 0; page < builder.pages.size(); page++)
+			levels += builder.mipChain(page).size();
+	}));
+
+	std::cout << "  pages " << builder.pages.size() << ", mip levels " << builder.mipLevels()
+		<< ", occupancy " << builder.packer.occupancy(builder.usedTexels) * 100.0 << "%, checksum " << levels << "\n";
+}
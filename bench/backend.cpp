@@ -0,0 +1,103 @@
+#include <bench.h>
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <backend.h>
+#include <renderqueue.h>
+
+namespace {
+	// Handles are only compared, made-up addresses stand in for device objects
+	template<typename T> T* fake(uintptr_t id) {
+		return reinterpret_cast<T*>((id + 1) * 64);
+	}
+
+	struct State {
+		int shader, texture;
+	};
+
+	// Shaped like D3DRenderer's draws: every shader has its own layout and
+	// vertex buffer, every texture its own view
+	Backend::Pipeline pipeline(const State& state) {
+		return {
+			.layout = fake<Backend::InputLayout>(state.shader),
+			.vertexBufferCount = 2,
+			.vertexBuffers = { fake<Backend::Buffer>(state.shader), fake<Backend::Buffer>(1000) },
+			.strides = { 16, 64 },
+			.vs = fake<Backend::VertexShader>(state.shader),
+			.vsConstants = fake<Backend::Buffer>(1001),
+			.viewport = { .width = 1280.0f, .height = 720.0f },
+			.ps = fake<Backend::PixelShader>(state.shader),
+			.resourceCount = 1,
+			.resources = { fake<Backend::ShaderResource>(state.texture) },
+			.sampler = fake<Backend::Sampler>(0),
+			.target = fake<Backend::RenderTarget>(0),
+		};
+	}
+
+	// Slots every bind() above sets, and which of them follow the shader
+	constexpr size_t slotsPerDraw = 11, shaderSlots = 4;
+}
+
+void Bench::backend() {
+	std::mt19937 rng(23);
+	std::uniform_int_distribution<int> layer(0, 2), pass(0, 1), shader(0, 15), texture(0, 255);
+	std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+
+	for (size_t count : counts) {
+		Render::Queue queue;
+		std::vector<State> states;
+		for (size_t iter = 0; iter < count; iter++) {
+			const State state = { shader(rng), texture(rng) };
+			queue.submit(Render::makeKey(static_cast<Render::Layer>(layer(rng)), static_cast<Render::Pass>(pass(rng)),
+				static_cast<uint16_t>(state.shader), static_cast<uint16_t>(state.texture), depth(rng)), static_cast<uint32_t>(iter));
+			states.push_back(state);
+		}
+
+		std::vector<uint32_t> submitted(count), sorted;
+		for (size_t iter = 0; iter < count; iter++) submitted[iter] = static_cast<uint32_t>(iter);
+		for (const auto& item : queue.sort()) sorted.push_back(item.draw);
+
+		// What the null context does for a frame of D3DRenderer::flush, plus the instance upload
+		Backend::NullContext ctx;
+		auto replay = [&](const std::vector<uint32_t>& order) {
+			ctx.beginFrame();
+
+			Backend::Buffer* ring = fake<Backend::Buffer>(1000);
+			std::memset(ctx.map(ring, Backend::MapType::WriteDiscard, count * 64), 0, count * 64);
+			ctx.unmap(ring);
+
+			for (uint32_t draw : order) {
+				ctx.bind(pipeline(states[draw]));
+				ctx.drawInstanced(6, 1, 0, draw);
+			}
+		};
+
+		// Binds the cache has to issue, a slot only changes with its state
+		auto expectedBinds = [&](const std::vector<uint32_t>& order) {
+			size_t binds = slotsPerDraw;
+			for (size_t iter = 1; iter < order.size(); iter++) {
+				const State& now = states[order[iter]];
+				const State& last = states[order[iter - 1]];
+				binds += (now.shader != last.shader) ? shaderSlots : 0;
+				binds += (now.texture != last.texture) ? 1 : 0;
+			}
+			return binds;
+		};
+
+		for (const auto& [name, order] : { std::pair{ "submitted", &submitted }, std::pair{ "sorted", &sorted } }) {
+			report(std::string("null backend replay, ") + name, count, time(3, [&] { replay(*order); }));
+
+			const Backend::FrameStats& stats = ctx.stats;
+			const bool counted = stats.drawCalls() == count && stats.triangles == 2 * count
+				&& stats.binds + stats.bindsSkipped == slotsPerDraw * count && stats.bytesUploaded == 64 * count;
+
+			std::cout << "  binds " << stats.binds << ", skipped " << stats.bindsSkipped << ", matches the state changes: "
+				<< check(stats.binds == expectedBinds(*order)) << ", draws and bytes counted: " << check(counted) << std::endl;
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace Bench {
+
+	inline constexpr std::array counts = { size_t(1000), size_t(10000), size_t(100000), size_t(1000000) };
+
+	// Per-object hot paths, every decade from a single object up
+	inline constexpr std::array sweep = { size_t(1), size_t(10), size_t(100), size_t(1000), size_t(10000), size_t(100000), size_t(1000000) };
+
+	// Best wall time in ms out of `reps` runs of fn
+	template<typename Fn> double time(int reps, Fn&& fn) {
+		double best = 1e30;
+		for (int rep = 0; rep < reps; rep++) {
+			auto begin = std::chrono::high_resolution_clock::now();
+			fn();
+			auto end = std::chrono::high_resolution_clock::now();
+
+			const double ms = std::chrono::duration<double, std::milli>(end - begin).count();
+			best = (ms < best) ? ms : best;
+		}
+		return best;
+	}
+
+	// Same, but fn runs often enough per sample that a few objects still
+	// take measurable time. Returns ms per call.
+	template<typename Fn> double time(int reps, size_t count, Fn&& fn) {
+		const size_t calls = std::max<size_t>(1, size_t(100000) / std::max<size_t>(count, 1));
+		return time(reps, [&] { for (size_t call = 0; call < calls; call++) fn(); }) / static_cast<double>(calls);
+	}
+
+	struct Result {
+		std::string name;
+		size_t count;
+		double ms;
+	};
+
+	// Every report so far, for --json
+	std::vector<Result>& results();
+
+	void report(const std::string& name, size_t count, double ms);
+
+	// "yes" or "NO" for the line that prints it. Every NO is counted,
+	// DXbench exits with 1 after any.
+	const char* check(bool ok);
+	size_t failures();
+
+	void transforms();
+	void text();
+	void shaders();
+	void textures();
+	void streaming();
+	void atlas();
+	void queue();
+	void backend();
+	void recording();
+	void jobs();
+	void culling();
+	void occlusion();
+	void raster();
+	void profiler();
+	void snapshot();
+	void arena();
+	void mesh();
+	void hierarchy();
+	void entity();
+
+}
@@ -0,0 +1,99 @@
+#include <bench.h>
+
+#include <DirectXMath.h>
+
+#include <cmath>
+#include <vector>
+#include <string>
+#include <random>
+#include <iostream>
+
+#include <sprite.h>
+#include <cube.h>
+#include <culling.h>
+
+namespace {
+	// One object at a time, what the SIMD kernels have to agree with
+	std::vector<uint32_t> cullScalar(const Cull::Frustum& frustum, std::span<Cube::Data> cubes) {
+		using namespace DirectX;
+
+		std::vector<uint32_t> visible;
+		for (size_t idx = 0; idx < cubes.size(); idx++) {
+			XMVECTOR pos = cubes[idx].getPosition();
+			const float radius = XMVectorGetX(XMVector3Length(cubes[idx].getScale()));
+
+			bool inside = true;
+			for (auto& plane : frustum.planes)
+				inside &= XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&plane), pos)) >= -radius;
+
+			if (inside) visible.push_back(static_cast<uint32_t>(idx));
+		}
+		return visible;
+	}
+
+	std::vector<uint32_t> cullScalar(const Cull::Rect& view, float halfSize, std::span<Sprite::Data> sprites) {
+		using namespace DirectX;
+
+		std::vector<uint32_t> visible;
+		for (size_t idx = 0; idx < sprites.size(); idx++) {
+			XMFLOAT2 pos, scale;
+			XMStoreFloat2(&pos, sprites[idx].getPosition());
+			XMStoreFloat2(&scale, sprites[idx].getScale());
+			const float radius = halfSize * std::sqrt(scale.x * scale.x + scale.y * scale.y);
+
+			if (pos.x + radius >= view.left && pos.x - radius <= view.right &&
+				pos.y + radius >= view.bottom && pos.y - radius <= view.top)
+				visible.push_back(static_cast<uint32_t>(idx));
+		}
+		return visible;
+	}
+}
+
+void Bench::culling() {
+	using namespace DirectX;
+
+	constexpr float width = 1280.0f, height = 720.0f;
+	const Cull::Frustum frustum = Cull::Frustum::fromProjection(XMMatrixPerspectiveFovLH(XM_PIDIV4, width / height, 0.01f, 100.0f));
+	const Cull::Rect view = { 0.0f, 0.0f, width, height };
+
+	// About half of either lands on screen
+	std::mt19937 rng(31);
+	std::uniform_real_distribution<float> spread(-60.0f, 60.0f), depth(-20.0f, 140.0f), rot(-XM_2PI, XM_2PI), scl(0.1f, 2.0f);
+	std::uniform_real_distribution<float> spriteX(-width, 2.0f * width), spriteY(-height, 2.0f * height), spriteScl(0.005f, 0.05f);
+
+	for (size_t count : counts) {
+		std::vector<Cube::Data> cubes;
+		std::vector<Sprite::Data> sprites;
+		for (size_t iter = 0; iter < count; iter++) {
+			cubes.push_back({ { spread(rng), spread(rng), depth(rng) }, { rot(rng), rot(rng), rot(rng) }, { scl(rng), scl(rng), scl(rng) } });
+			sprites.push_back({ { spriteX(rng), spriteY(rng) }, rot(rng), { spriteScl(rng), spriteScl(rng) } });
+		}
+
+		// The kernels walk the same objects split into columns
+		const Cube::Arrays cubeColumns(cubes);
+		const Sprite::Arrays spriteColumns(sprites);
+
+		const int reps = (count >= 100000) ? 5 : 50;
+		std::vector<uint32_t> visible, expected;
+
+		report("cull cubes scalar", count, time(reps, [&] { expected = cullScalar(frustum, cubes); }));
+		report("cull cubes 4-wide", count, time(reps, [&] { Cube::cull(frustum, cubeColumns, visible); }));
+		std::cout << "  visible " << visible.size() << ", matches scalar: " << check(visible == expected) << std::endl;
+
+		report("cull sprites scalar", count, time(reps, [&] { expected = cullScalar(view, height / 2.0f, sprites); }));
+		report("cull sprites 4-wide", count, time(reps, [&] { Sprite::cull(view, height / 2.0f, spriteColumns, visible); }));
+		std::cout << "  visible " << visible.size() << ", matches scalar: " << check(visible == expected) << std::endl;
+
+		// What culling saves on the transforms that follow it
+		std::vector<Cube::Instance> out(count);
+		report("cube transforms, all", count, time(reps, [&] { Cube::getWorldMatrices(cubeColumns, out); }));
+		report("cube cull + transforms, visible", count, time(reps, [&] {
+			const size_t survivors = Cube::cull(frustum, cubeColumns, visible);
+			Cube::getWorldMatrices(cubeColumns, visible, std::span(out).first(survivors));
+		}));
+		report("cube cull + cached matrices, visible", count, time(reps, [&] {
+			const size_t survivors = Cube::cull(frustum, cubeColumns, visible);
+			Cube::gatherWorldMatrices(cubeColumns, visible, std::span(out).first(survivors));
+		}));
+	}
+}
@@ -0,0 +1,205 @@
+#include <bench.h>
+
+#include <DirectXMath.h>
+
+#include <cmath>
+#include <span>
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+#include <entity.h>
+#include <snapshot.h>
+#include <cube.h>
+
+namespace {
+
+	struct Spin {
+		DirectX::XMFLOAT3 rate;
+	};
+
+	// Which entity a row belongs to, for the churn check
+	struct Tag {
+		uint32_t id;
+	};
+
+	// Only on some entities, splits them over two archetypes
+	struct Selected {
+		float weight;
+	};
+
+	Cube::Data cubeAt(size_t iter) {
+		return Cube::Data({ static_cast<float>(iter % 100), static_cast<float>(iter / 100 % 100), 6.0f }, { 0.0f, 0.0f, 0.0f }, { 0.5f, 0.5f, 0.5f });
+	}
+
+	// The same cube as state creates it, a component per field and its world matrix
+	template<typename... Ts> Entity::Handle createCube(Entity::World& world, size_t iter, const Ts&... more) {
+		const Cube::Position position = { { static_cast<float>(iter % 100), static_cast<float>(iter / 100 % 100), 6.0f } };
+		const Cube::Instance matrix = { cubeAt(iter).getWorldMatrix() };
+		return world.create(position, Cube::Rotation{}, Cube::Scale{ { 0.5f, 0.5f, 0.5f } }, matrix, more...);
+	}
+
+	// What state::update does to the cubes that spin
+	void spinCubes(Entity::World& world, float delta) {
+		world.each<const Cube::Position, Cube::Rotation, const Cube::Scale, const Spin, Cube::Instance>(
+			[&](std::span<const Cube::Position> positions, std::span<Cube::Rotation> rotations, std::span<const Cube::Scale> scales,
+					std::span<const Spin> spins, std::span<Cube::Instance> matrices) {
+				for (size_t iter = 0; iter < rotations.size(); iter++) {
+					const DirectX::XMFLOAT3& rate = spins[iter].rate;
+					rotations[iter] = { { rate.x * delta, rate.y * delta, rate.z * delta } };
+				}
+				Cube::getWorldMatrices({ positions, rotations, scales }, matrices);
+			});
+	}
+
+	Spin spinAt(size_t iter) {
+		return { { (iter % 2 != 0) ? 0.0f : DirectX::XM_PIDIV4, DirectX::XM_PIDIV4, 0.0f } };
+	}
+
+}
+
+void Bench::entity() {
+	using namespace DirectX;
+
+	const float delta = 0.5f;
+
+	for (size_t count : sweep) {
+		const int reps = (count >= 100000) ? 5 : 10;
+
+		// What state kept before, one vector per kind and the spin worked out from the index
+		std::vector<Cube::Data> cubes;
+		for (size_t iter = 0; iter < count; iter++) cubes.push_back(cubeAt(iter));
+
+		report("state vectors update", count, time(reps, count, [&] {
+			for (size_t iter = 0; iter < cubes.size(); iter++) {
+				const bool flag = (iter % 2) != 0;
+				cubes[iter].setRotation(XMVECTOR{ XM_PIDIV4 * delta * (flag ? 0.0f : 1.0f), XM_PIDIV4 * delta, 0 });
+			}
+		}));
+
+		// What the renderer did with them every frame, every matrix rebuilt
+		const Cube::Arrays columns(cubes);
+		std::vector<Cube::Instance> rebuilt(count);
+		report("state vectors all matrices", count, time(reps, count, [&] { Cube::getWorldMatrices(columns, rebuilt); }));
+
+		// A quarter stands still without a Spin, the update never visits them
+		Entity::World world;
+		for (size_t iter = 0; iter < count; iter++) {
+			if (iter % 4 == 0)
+				createCube(world, iter, spinAt(iter), Selected{ 1.0f });
+			else if (iter % 4 == 3)
+				createCube(world, iter);
+			else
+				createCube(world, iter, spinAt(iter));
+		}
+
+		report("entity each update", count, time(reps, count, [&] {
+			world.each<Cube::Rotation, const Spin>([&](std::span<Cube::Rotation> rotations, std::span<const Spin> spins) {
+				for (size_t iter = 0; iter < rotations.size(); iter++) {
+					const XMFLOAT3& rate = spins[iter].rate;
+					rotations[iter] = { { rate.x * delta, rate.y * delta, rate.z * delta } };
+				}
+			});
+		}));
+
+		report("entity update + cached matrices", count, time(reps, count, [&] { spinCubes(world, delta); }));
+
+		// Only the quarter with the extra component, one archetype skipped whole
+		size_t selected = 0;
+		report("entity each selected", count, time(reps, count, [&] {
+			selected = 0;
+			world.each<const Selected>([&](std::span<const Selected> weights) { selected += weights.size(); });
+		}));
+
+		std::vector<Cube::Data> vectorScene;
+		Snapshot::Scene entityScene;
+		report("state vectors publish", count, time(reps, count, [&] { vectorScene.assign(cubes.begin(), cubes.end()); }));
+		report("entity publish", count, time(reps, count, [&] {
+			entityScene.clear();
+			world.each<const Cube::Position, const Cube::Rotation, const Cube::Scale, const Cube::Instance>(
+				[&](std::span<const Cube::Position> position, std::span<const Cube::Rotation> rotation,
+						std::span<const Cube::Scale> scale, std::span<const Cube::Instance> matrices) {
+					entityScene.add(Cube::Columns{ position, rotation, scale, matrices });
+				});
+		}));
+
+		// Cached matrices, moved or not, have to be what a full rebuild gives
+		const Cube::Arrays& published = entityScene.cubes;
+		rebuilt.resize(published.size());
+		Cube::getWorldMatrices(Cube::Columns{ published.position, published.rotation, published.scale }, rebuilt);
+		float err = 0.0f;
+		for (size_t iter = 0; iter < rebuilt.size(); iter++)
+			for (size_t elem = 0; elem < 16; elem++)
+				err = std::max(err, std::abs((&rebuilt[iter].model._11)[elem] - (&published.world[iter].model._11)[elem]));
+
+		std::cout << "  " << world._archetypes.size() << " archetypes, " << world._archetypes[0].capacity << " cubes per chunk, "
+			<< selected << " selected of " << world.count<Cube::Position>() << ", " << world.count<Cube::Position, Spin>()
+			<< " spinning, cached matrices match a rebuild: " << check(err < 1e-5f) << std::endl;
+	}
+
+	// Churn: every frame a tenth of the entities go and as many new ones come.
+	// Live handles have to keep finding their own data, dead ones nothing.
+	std::mt19937 rng(42);
+	for (size_t count : sweep) {
+		if (count < 10) continue;
+
+		Entity::World world;
+		std::vector<Entity::Handle> live, dead;
+		std::vector<uint32_t> ids;
+		uint32_t nextId = 0;
+		for (size_t iter = 0; iter < count; iter++) {
+			live.push_back(createCube(world, iter, Tag{ nextId }));
+			ids.push_back(nextId++);
+		}
+
+		const size_t churn = count / 10;
+		size_t chunksBefore = 0;
+		for (auto& arch : world._archetypes) chunksBefore += arch.chunks.size();
+
+		report("entity churn", churn * 2, time(5, churn * 2, [&] {
+			for (size_t iter = 0; iter < churn; iter++) {
+				const size_t victim = std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng);
+				world.destroy(live[victim]);
+				dead.push_back(live[victim]);
+
+				live[victim] = createCube(world, iter, Tag{ nextId });
+				ids[victim] = nextId++;
+			}
+		}));
+
+		bool found = true;
+		for (size_t iter = 0; iter < live.size(); iter++) {
+			const Tag* tag = world.get<Tag>(live[iter]);
+			found = found && tag != nullptr && tag->id == ids[iter];
+		}
+
+		bool gone = true;
+		for (Entity::Handle handle : dead) gone = gone && !world.alive(handle) && world.get<Tag>(handle) == nullptr;
+
+		size_t chunksAfter = 0;
+		for (auto& arch : world._archetypes) chunksAfter += arch.chunks.size();
+
+		std::cout << "  " << dead.size() << " destroyed and recreated, live handles find their data: " << check(found)
+			<< ", stale handles find nothing: " << check(gone) << ", chunks " << chunksBefore << " -> " << chunksAfter << std::endl;
+	}
+
+	// Destroys and creates inside a query wait for it, so every entity is
+	// visited exactly once whatever the query does to the world
+	Entity::World world;
+	for (size_t iter = 0; iter < 10000; iter++) createCube(world, iter, Tag{ static_cast<uint32_t>(iter) });
+
+	std::vector<uint8_t> visits(10000, 0);
+	world.each<const Tag>([&](std::span<const Entity::Handle> handles, std::span<const Tag> tags) {
+		for (size_t iter = 0; iter < tags.size(); iter++) {
+			visits[tags[iter].id]++;
+			if (tags[iter].id % 2 == 0) world.destroy(handles[iter]);
+			if (tags[iter].id % 5 == 0) createCube(world, iter, Tag{ 20000 });
+		}
+	});
+
+	const bool once = std::all_of(visits.begin(), visits.end(), [](uint8_t visit) { return visit == 1; });
+	std::cout << "  changes inside a query: every entity visited once: " << check(once)
+		<< ", " << world.count<Tag>() << " left of 10000 - 5000 + 2000" << std::endl;
+}
@@ -0,0 +1,131 @@
+#include <bench.h>
+
+#include <DirectXMath.h>
+
+#include <cmath>
+#include <vector>
+#include <random>
+#include <string>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+#include <hierarchy.h>
+#include <cube.h>
+
+namespace {
+
+	// Groups of a root, 8 children and 64 grandchildren, added depth first
+	constexpr size_t groupSize = 1 + 8 + 64;
+
+	struct Forest {
+		Hierarchy::Tree tree;
+		std::vector<Hierarchy::Node> roots, leaves;
+	};
+
+	Forest forest(size_t groups, std::mt19937& rng) {
+		std::uniform_real_distribution<float> pos(-10.0f, 10.0f), rot(-DirectX::XM_PI, DirectX::XM_PI);
+		auto random = [&] { return Hierarchy::Transform{ { pos(rng), pos(rng), pos(rng) }, { rot(rng), rot(rng), rot(rng) }, { 1.0f, 1.0f, 1.0f } }; };
+
+		Forest built;
+		for (size_t group = 0; group < groups; group++) {
+			const Hierarchy::Node root = built.tree.add(Hierarchy::none, random());
+			built.roots.push_back(root);
+
+			for (int child = 0; child < 8; child++) {
+				const Hierarchy::Node mid = built.tree.add(root, random());
+				for (int leaf = 0; leaf < 8; leaf++) built.leaves.push_back(built.tree.add(mid, random()));
+			}
+		}
+
+		built.tree.update();
+		return built;
+	}
+
+	float maxError(const Hierarchy::Tree& a, const Hierarchy::Tree& b) {
+		float err = 0.0f;
+		for (size_t pos = 0; pos < a.size(); pos++) {
+			const float* x = &a._world[pos]._11;
+			const float* y = &b._world[pos]._11;
+			for (int elem = 0; elem < 16; elem++) err = std::max(err, std::abs(x[elem] - y[elem]));
+		}
+		return err;
+	}
+
+}
+
+void Bench::hierarchy() {
+	std::mt19937 rng(42);
+
+	for (size_t count : sweep) {
+		if (count < groupSize) continue;
+
+		Forest scene = forest(count / groupSize, rng);
+		const size_t nodes = scene.tree.size();
+		const int reps = (nodes >= 100000) ? 5 : 10;
+
+		// What every frame costs today, each object rebuilt whether it moved or not
+		const Cube::Arrays flat(std::vector<Cube::Data>(nodes, Cube::Data({ 1.0f, 2.0f, 3.0f }, { 0.1f, 0.2f, 0.3f }, { 1.0f, 1.0f, 1.0f })));
+		std::vector<Cube::Instance> instances(nodes);
+		report("flat getWorldMatrices", nodes, time(reps, count, [&] { Cube::getWorldMatrices(flat, instances); }));
+
+		report("hierarchy updateAll", nodes, time(reps, count, [&] { scene.tree.updateAll(); }));
+		report("hierarchy update, nothing changed", nodes, time(reps, count, [&] { scene.tree.update(); }));
+
+		// A fixed number of changes has to cost the same whatever the tree size,
+		// reported per changed node
+		std::uniform_int_distribution<size_t> pickLeaf(0, scene.leaves.size() - 1), pickRoot(0, scene.roots.size() - 1);
+		for (size_t changed : { std::min<size_t>(100, nodes), nodes / 10 }) {
+			std::vector<Hierarchy::Node> leaves(changed);
+			for (auto& node : leaves) node = scene.leaves[pickLeaf(rng)];
+
+			size_t recomputed = 0;
+			report("hierarchy update " + std::to_string(changed) + " leaves of " + std::to_string(nodes), changed, time(reps, changed, [&] {
+				for (Hierarchy::Node node : leaves) scene.tree.setLocal(node, scene.tree.local(node));
+				recomputed = scene.tree.update();
+			}));
+			std::cout << "  recomputed " << recomputed << " world matrices\n";
+		}
+
+		// A moved root drags its 72 descendants along
+		std::vector<Hierarchy::Node> roots(std::min<size_t>(100, scene.roots.size()));
+		for (auto& node : roots) node = scene.roots[pickRoot(rng)];
+
+		size_t recomputed = 0;
+		report("hierarchy update " + std::to_string(roots.size()) + " roots of " + std::to_string(nodes), roots.size(), time(reps, roots.size(), [&] {
+			for (Hierarchy::Node node : roots) scene.tree.setLocal(node, scene.tree.local(node));
+			recomputed = scene.tree.update();
+		}));
+		std::cout << "  recomputed " << recomputed << " world matrices\n";
+	}
+
+	// Partial updates have to land on what a full rebuild gives, also after
+	// nodes were inserted into the middle of the arrays
+	Forest scene = forest(20, rng);
+	std::uniform_real_distribution<float> pos(-10.0f, 10.0f);
+	std::uniform_int_distribution<size_t> pick(0, scene.leaves.size() - 1);
+	for (int frame = 0; frame < 50; frame++) {
+		for (int change = 0; change < 10; change++) {
+			const Hierarchy::Node node = (change % 3 == 0) ? scene.roots[change % scene.roots.size()] : scene.leaves[pick(rng)];
+			Hierarchy::Transform local = scene.tree.local(node);
+			local.position.x = pos(rng);
+			scene.tree.setLocal(node, local);
+		}
+
+		if (frame % 10 == 0) scene.tree.add(scene.roots[frame % scene.roots.size()], { { pos(rng), 0.0f, 0.0f } });
+		scene.tree.update();
+	}
+
+	Hierarchy::Tree reference = scene.tree;
+	reference.updateAll();
+
+	bool ordered = true;
+	for (size_t at = 0; at < scene.tree.size(); at++) {
+		const uint32_t parent = scene.tree._parent[at];
+		ordered = ordered && (parent == Hierarchy::none || (parent < at && at < parent + scene.tree._size[parent]));
+	}
+
+	const float err = maxError(scene.tree, reference);
+	std::cout << std::defaultfloat << "  partial against full update, max error " << err << " (" << check(err < 1e-5f) << ")"
+		<< ", parents before children: " << check(ordered) << std::fixed << std::endl;
+}
@@ -0,0 +1,96 @@
+#include <bench.h>
+
+#include <DirectXMath.h>
+
+#include <array>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include <sprite.h>
+#include <jobs.h>
+
+namespace {
+	constexpr size_t grain = 16384;
+
+	// What a frame does to every sprite, update then build its instance
+	void update(std::span<Sprite::Rotation> rotations, float angle) {
+		for (auto& rotation : rotations) rotation.radians = angle;
+	}
+}
+
+void Bench::jobs() {
+	using namespace DirectX;
+
+	constexpr std::array objectCounts = { size_t(100000), size_t(1000000), size_t(10000000) };
+
+	std::mt19937 rng(29);
+	std::uniform_real_distribution<float> pos(-500.0f, 500.0f), rot(-XM_2PI, XM_2PI), scl(0.1f, 4.0f);
+
+	// 1, 2, 4 ... threads, and every core
+	std::vector<size_t> threadCounts;
+	const size_t cores = Jobs::Scheduler::defaultWorkers() + 1;
+	for (size_t threads = 1; threads < cores; threads *= 2) threadCounts.push_back(threads);
+	threadCounts.push_back(cores);
+
+	for (size_t count : objectCounts) {
+		Sprite::Arrays sprites;
+		for (size_t iter = 0; iter < count; iter++)
+			sprites.add(Sprite::Data({ pos(rng), pos(rng) }, rot(rng), { scl(rng), scl(rng) }));
+
+		std::vector<Sprite::Instance> expected(count), out(count);
+		update(sprites.rotation, 1.0f);
+		Sprite::getWorldMatrices(sprites, expected);
+
+		const int reps = (count >= 1000000) ? 3 : 10;
+		double single = 0.0;
+
+		for (size_t threads : threadCounts) {
+			Jobs::Scheduler scheduler(threads - 1);
+			const size_t chunks = (count + grain - 1) / grain;
+
+			// Each chunk's transforms wait for every update, through a counter
+			const double ms = time(reps, [&] {
+				Jobs::Counter updated, built;
+
+				for (size_t chunk = 0; chunk < chunks; chunk++) {
+					const size_t first = chunk * grain;
+					auto span = std::span(sprites.rotation).subspan(first, std::min(grain, count - first));
+
+					scheduler.spawn([span] { update(span, 1.0f); }, &updated);
+				}
+
+				for (size_t chunk = 0; chunk < chunks; chunk++) {
+					const size_t first = chunk * grain;
+					const size_t size = std::min(grain, count - first);
+
+					scheduler.spawn([&, first, size] {
+						Sprite::getWorldMatrices(Sprite::Columns(sprites).subspan(first, size), std::span(out).subspan(first, size));
+					}, updated, &built);
+				}
+
+				scheduler.wait(built);
+			});
+
+			single = (threads == 1) ? ms : single;
+			report("jobs update + transforms " + std::to_string(threads) + " threads", count, ms);
+
+			const bool same = std::memcmp(out.data(), expected.data(), count * sizeof(Sprite::Instance)) == 0;
+			std::cout << "  speedup " << single / ms << ", matches serial: " << check(same) << std::endl;
+		}
+
+		// Same work through parallelFor, the grain decides how much there is to steal
+		Jobs::Scheduler scheduler;
+		for (size_t tune : { size_t(1024), grain, size_t(262144) }) {
+			report("jobs parallelFor grain " + std::to_string(tune), count, time(reps, [&] {
+				scheduler.parallelFor(count, tune, [&](size_t first, size_t size) {
+					update(std::span(sprites.rotation).subspan(first, size), 1.0f);
+					Sprite::getWorldMatrices(Sprite::Columns(sprites).subspan(first, size), std::span(out).subspan(first, size));
+				});
+			}));
+		}
+	}
+}
@@ -0,0 +1,107 @@
+#include <bench.h>
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+
+std::vector<Bench::Result>& Bench::results() {
+	static std::vector<Result> all;
+	return all;
+}
+
+void Bench::report(const std::string& name, size_t count, double ms) {
+	results().push_back({ name, count, ms });
+
+	std::cout << std::left << std::setw(40) << name
+		<< std::right << std::setw(10) << count
+		<< std::setw(12) << std::fixed << std::setprecision(3) << ms << " ms"
+		<< std::setw(12) << std::setprecision(2) << ms * 1e6 / static_cast<double>(count) << " ns/item"
+		<< std::endl;
+}
+
+namespace {
+	size_t failed = 0;
+}
+
+const char* Bench::check(bool ok) {
+	failed += ok ? 0 : 1;
+	return ok ? "yes" : "NO";
+}
+
+size_t Bench::failures() {
+	return failed;
+}
+
+namespace {
+	// One object per report, names are plain ASCII
+	bool writeJson(const std::string& path) {
+		std::ofstream file(path);
+		if (!file) return false;
+
+		file << "[";
+		const auto& all = Bench::results();
+		for (size_t idx = 0; idx < all.size(); idx++) {
+			const auto& result = all[idx];
+			file << (idx == 0 ? "\n" : ",\n") << std::defaultfloat << std::setprecision(9)
+				<< "  {\"name\": \"" << result.name << "\", \"count\": " << result.count
+				<< ", \"ms\": " << result.ms << ", \"nsPerItem\": " << result.ms * 1e6 / static_cast<double>(result.count) << "}";
+		}
+		file << "\n]\n";
+
+		return static_cast<bool>(file);
+	}
+}
+
+// DXbench [--only suite] [--json results.json]
+int main(int argc, char* argv[]) {
+	const std::vector<std::pair<std::string, std::function<void()>>> suites = {
+		{ "transforms", Bench::transforms },
+		{ "text", Bench::text },
+		{ "shaders", Bench::shaders },
+		{ "textures", Bench::textures },
+		{ "streaming", Bench::streaming },
+		{ "atlas", Bench::atlas },
+		{ "queue", Bench::queue },
+		{ "backend", Bench::backend },
+		{ "recording", Bench::recording },
+		{ "jobs", Bench::jobs },
+		{ "culling", Bench::culling },
+		{ "occlusion", Bench::occlusion },
+		{ "raster", Bench::raster },
+		{ "profiler", Bench::profiler },
+		{ "snapshot", Bench::snapshot },
+		{ "arena", Bench::arena },
+		{ "mesh", Bench::mesh },
+		{ "hierarchy", Bench::hierarchy },
+		{ "entity", Bench::entity },
+	};
+
+	std::string only, json;
+	for (int arg = 1; arg + 1 < argc; arg += 2) {
+		const std::string option = argv[arg];
+
+		if (option == "--only")
+			only = argv[arg + 1];
+		else if (option == "--json")
+			json = argv[arg + 1];
+	}
+
+	for (auto& [name, suite] : suites)
+		if (only.empty() || only == name) suite();
+
+	if (!json.empty() && !writeJson(json)) {
+		std::cerr << "Could not write " << json << std::endl;
+		return 1;
+	}
+
+	if (Bench::failures() > 0) {
+		std::cerr << Bench::failures() << " checks failed" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
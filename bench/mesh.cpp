@@ -0,0 +1,260 @@
+#include <bench.h>
+
+#include <span>
+#include <cmath>
+#include <array>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include <DirectXMath.h>
+
+#include <mesh.h>
+#include <cube.h>
+
+namespace {
+
+	// A torus has plenty of self occlusion from the side, so draw order shows up as overdraw
+	Mesh::Source torus(uint32_t rings, uint32_t sides) {
+		using namespace DirectX;
+
+		Mesh::Source mesh;
+		for (uint32_t ring = 0; ring <= rings; ring++) {
+			for (uint32_t side = 0; side <= sides; side++) {
+				const float u = static_cast<float>(ring) / rings, v = static_cast<float>(side) / sides;
+				const float ringAngle = u * XM_2PI, sideAngle = v * XM_2PI;
+				const float radius = 1.0f + 0.4f * std::cos(sideAngle);
+
+				mesh.positions.push_back({ radius * std::cos(ringAngle), 0.4f * std::sin(sideAngle), radius * std::sin(ringAngle) });
+				mesh.uvs.push_back({ u, v });
+			}
+		}
+
+		for (uint32_t ring = 0; ring < rings; ring++) {
+			for (uint32_t side = 0; side < sides; side++) {
+				const uint32_t a = ring * (sides + 1) + side, b = a + sides + 1;
+				mesh.indices.insert(mesh.indices.end(), { a, a + 1, b, b, a + 1, b + 1 });
+			}
+		}
+
+		return mesh;
+	}
+
+	// Triangles in random order, what an exporter that does not care produces
+	void shuffle(std::vector<uint32_t>& indices, std::mt19937& rng) {
+		std::vector<std::array<uint32_t, 3>> triangles(indices.size() / 3);
+		std::memcpy(triangles.data(), indices.data(), indices.size() * sizeof(uint32_t));
+		std::shuffle(triangles.begin(), triangles.end(), rng);
+		std::memcpy(indices.data(), triangles.data(), indices.size() * sizeof(uint32_t));
+	}
+
+	// Corners of every triangle, rotated so the order does not matter but the winding does
+	std::vector<std::string> triangleSet(const Mesh::Source& mesh) {
+		std::vector<std::string> set;
+		for (size_t tri = 0; tri < mesh.indices.size(); tri += 3) {
+			std::array<std::string, 3> corners;
+			for (int corner = 0; corner < 3; corner++) {
+				const uint32_t idx = mesh.indices[tri + corner];
+				std::ostringstream text;
+				text << std::lround(mesh.positions[idx].x) << "," << std::lround(mesh.positions[idx].y) << "," << std::lround(mesh.positions[idx].z)
+					<< "/" << std::lround(mesh.uvs[idx].x) << "," << std::lround(mesh.uvs[idx].y) << " ";
+				corners[corner] = text.str();
+			}
+
+			std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+			set.push_back(corners[0] + corners[1] + corners[2]);
+		}
+
+		std::sort(set.begin(), set.end());
+		return set;
+	}
+
+	std::string objText(const Mesh::Source& mesh) {
+		std::ostringstream text;
+		for (auto& pos : mesh.positions) text << "v " << pos.x << " " << pos.y << " " << -pos.z << "\n";
+		for (auto& uv : mesh.uvs) text << "vt " << uv.x << " " << uv.y << "\n";
+		for (size_t idx = 0; idx < mesh.indices.size(); idx += 3)
+			text << "f " << mesh.indices[idx] + 1 << "/" << mesh.indices[idx] + 1 << " " << mesh.indices[idx + 1] + 1 << "/" << mesh.indices[idx + 1] + 1
+				<< " " << mesh.indices[idx + 2] + 1 << "/" << mesh.indices[idx + 2] + 1 << "\n";
+		return text.str();
+	}
+
+	// Distance based selection over a field of tori, from right in front of the camera to far away
+	void lodSelection() {
+		Mesh::Source shape = torus(100, 100);
+		Mesh::buildLods(shape);
+
+		// What recordCubes computes: the largest extent in pixels under the 45 degree, 720 pixel projection
+		const float focal = 720.0f / std::tan(DirectX::XM_PIDIV4 / 2.0f);
+		const float extent = 2.8f;
+
+		for (float depth : { 5.0f, 20.0f, 80.0f, 320.0f }) {
+			const uint32_t level = Mesh::selectLod(shape.lods, extent * focal * 0.5f / depth, 0);
+			std::cout << "  at z " << depth << ": lod " << level << ", " << shape.lods[level].indexCount / 3 << " of " << shape.lods[0].indexCount / 3 << " triangles\n";
+		}
+
+		// Jittering a few percent around the depth where level 2 becomes good enough
+		// must not switch every frame
+		const float boundary = extent * focal * 0.5f * shape.lods[std::min<size_t>(2, shape.lods.size() - 1)].error;
+		uint32_t current = 0, switches = 0, plainSwitches = 0, plain = 0;
+		for (int frame = 0; frame < 1000; frame++) {
+			const float depth = boundary * (1.0f + 0.05f * std::sin(frame * 0.7f));
+			const float size = extent * focal * 0.5f / depth;
+
+			const uint32_t next = Mesh::selectLod(shape.lods, size, current);
+			const uint32_t nextPlain = Mesh::selectLod(shape.lods, size, plain, 1.0f, 0.0f);
+			switches += next != current;
+			plainSwitches += nextPlain != plain;
+			current = next;
+			plain = nextPlain;
+		}
+		std::cout << "  lod switches over 1000 jittering frames: " << switches << " with hysteresis, " << plainSwitches << " without\n";
+	}
+
+	void printCache(const char* name, const Mesh::Source& mesh) {
+		const auto fifo16 = Mesh::analyzeVertexCache(mesh.indices, mesh.positions.size(), 16);
+		const auto fifo32 = Mesh::analyzeVertexCache(mesh.indices, mesh.positions.size(), 32);
+		std::cout << "  " << name << ": ACMR " << fifo16.acmr << " / " << fifo32.acmr << ", ATVR " << fifo16.atvr << " / " << fifo32.atvr
+			<< " (FIFO 16 / 32), overdraw " << Mesh::analyzeOverdraw(mesh.indices, mesh.positions, 128) << "\n";
+	}
+
+}
+
+void Bench::mesh() {
+	// The shipped cube has to import to exactly the built-in one
+	Mesh::Source cube;
+	const bool imported = Mesh::importObj(std::string(DXBENCH_RES) + "/cube.obj", cube);
+	Mesh::optimize(cube);
+
+	Mesh::View cubeView;
+	const auto cubeData = Mesh::encode(cube, Mesh::Optimized);
+	Mesh::Source decoded;
+	if (Mesh::parse(cubeData, cubeView) == Mesh::Result::Ok) Mesh::decode(cubeView, decoded);
+
+	Mesh::Source builtin;
+	for (auto& vert : Cube::vertices) {
+		builtin.positions.push_back(vert.pos);
+		builtin.uvs.push_back(vert.tex);
+	}
+	builtin.indices.assign(Cube::indices.begin(), Cube::indices.end());
+
+	std::cout << "  cube.obj: imported " << check(imported) << ", " << decoded.positions.size() << " vertices, "
+		<< decoded.indices.size() << " indices, " << cubeData.size() << " bytes, same triangles as Cube: "
+		<< check(triangleSet(decoded) == triangleSet(builtin))
+		<< ", overdraw " << Mesh::analyzeOverdraw(decoded.indices, decoded.positions) << "\n";
+
+	std::mt19937 rng(42);
+	for (size_t count : sweep) {
+		if (count < 1000) continue;
+
+		const uint32_t side = static_cast<uint32_t>(std::sqrt(count / 2.0));
+		const Mesh::Source grid = torus(side, side);
+		const size_t triangles = grid.indices.size() / 3;
+		const int reps = (triangles >= 100000) ? 1 : 5;
+
+		Mesh::Source shuffled = grid;
+		shuffle(shuffled.indices, rng);
+
+		Mesh::Source cached = shuffled;
+		report("mesh optimizeVertexCache", triangles, time(reps, [&] {
+			cached.indices = shuffled.indices;
+			Mesh::optimizeVertexCache(cached.indices, cached.positions.size());
+		}));
+
+		Mesh::Source ordered = cached;
+		report("mesh optimizeOverdraw", triangles, time(reps, [&] {
+			ordered.indices = cached.indices;
+			Mesh::optimizeOverdraw(ordered.indices, ordered.positions);
+		}));
+
+		Mesh::Source fetched = ordered;
+		Mesh::optimizeVertexFetch(fetched);
+
+		std::cout << "  torus " << triangles << " triangles, " << grid.positions.size() << " vertices\n";
+		printCache("generated", grid);
+		printCache("shuffled", shuffled);
+		printCache("vertex cache", cached);
+		printCache("+ overdraw", ordered);
+
+		// Simplification is offline work, past 100k triangles the run is only slower
+		if (triangles <= 100000) {
+			Mesh::Source lods = grid;
+			report("mesh buildLods", triangles, time(1, [&] {
+				lods.lods.clear();
+				lods.indices = grid.indices;
+				Mesh::buildLods(lods);
+			}));
+
+			std::cout << "  lods:";
+			for (const Mesh::Lod& lod : lods.lods) std::cout << " " << lod.indexCount / 3 << " (error " << std::defaultfloat << lod.error << std::fixed << ")";
+			std::cout << "\n";
+		}
+
+		// Load paths: text import, the mapped binary as the importer writes it,
+		// and the same binary without the offline reorder
+		const std::string objPath = "mesh_bench.obj", meshPath = "mesh_bench.mesh", rawPath = "mesh_bench_raw.mesh";
+		std::ofstream(objPath) << objText(shuffled);
+		Mesh::write(meshPath, Mesh::encode(fetched, Mesh::Optimized));
+		Mesh::write(rawPath, Mesh::encode(shuffled, 0));
+
+		Mesh::Source reimported;
+		report("mesh import obj", triangles, time(reps, [&] { Mesh::importObj(objPath, reimported); }));
+
+		Mesh::File file;
+		Mesh::Result opened = Mesh::Result::Ok;
+		report("mesh mmap + parse", triangles, time(reps, [&] { opened = file.open(meshPath); }));
+		report("mesh mmap + parse + reorder", triangles, time(reps, [&] { file.open(rawPath); }));
+
+		// Reordered on load has to match the offline vertex cache pass
+		std::vector<uint32_t> reordered(file.view.header.indexCount);
+		for (size_t idx = 0; idx < reordered.size(); idx++) reordered[idx] = file.view.index(idx);
+		const auto loaded = Mesh::analyzeVertexCache(reordered, file.view.vertices.size());
+
+		file.open(meshPath);
+		Mesh::Source roundTrip;
+		Mesh::decode(file.view, roundTrip);
+
+		float posErr = 0.0f;
+		for (size_t vert = 0; vert < roundTrip.positions.size(); vert++) {
+			posErr = std::max({ posErr, std::abs(roundTrip.positions[vert].x - fetched.positions[vert].x),
+				std::abs(roundTrip.positions[vert].y - fetched.positions[vert].y), std::abs(roundTrip.positions[vert].z - fetched.positions[vert].z) });
+		}
+
+		const size_t fileBytes = file._file.bytes().size();
+		const size_t floatBytes = fetched.positions.size() * sizeof(Cube::Vertex) + fetched.indices.size() * sizeof(uint32_t);
+		std::cout << "  load " << Mesh::describe(opened) << " (" << check(opened == Mesh::Result::Ok) << "), " << fileBytes << " bytes instead of " << floatBytes
+			<< ", max position error " << std::defaultfloat << posErr << std::fixed << ", reimported " << reimported.indices.size() / 3 << " triangles"
+			<< ", reordered on load ACMR " << loaded.acmr << "\n";
+
+		file.close();
+		std::remove(objPath.c_str());
+		std::remove(meshPath.c_str());
+		std::remove(rawPath.c_str());
+	}
+
+	lodSelection();
+
+	// Damaged copies have to be rejected before anything reads past the end
+	Mesh::View damaged;
+	auto rejected = [&](const char* name, std::vector<std::byte> copy) {
+		const auto result = Mesh::parse(copy, damaged);
+		std::cout << "  " << name << ": " << Mesh::describe(result) << ", rejected: " << check(result != Mesh::Result::Ok) << "\n";
+	};
+
+	rejected("truncated", { cubeData.begin(), cubeData.end() - 1 });
+	rejected("header only", { cubeData.begin(), cubeData.begin() + sizeof(Mesh::Header) });
+
+	auto badMagic = cubeData;
+	badMagic[0] ^= std::byte(1);
+	rejected("bad magic", badMagic);
+
+	auto badIndex = cubeData;
+	badIndex[badIndex.size() - 1] = std::byte(0xff);
+	rejected("bad index", badIndex);
+}
@@ -0,0 +1,153 @@
+#include <bench.h>
+
+#include <DirectXMath.h>
+
+#include <cmath>
+#include <vector>
+#include <string>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include <cube.h>
+#include <culling.h>
+#include <occlusion.h>
+
+namespace {
+	constexpr uint32_t bufferWidth = 320, bufferHeight = 180;
+
+	// The screen the quarter resolution buffer stands in for
+	constexpr uint32_t screenWidth = bufferWidth * 4, screenHeight = bufferHeight * 4;
+
+	DirectX::XMMATRIX world(Cube::Data& cube) {
+		DirectX::XMFLOAT4X4 model = cube.getWorldMatrix();
+		return DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&model));
+	}
+
+	float radius(Cube::Data& cube) {
+		return DirectX::XMVectorGetX(DirectX::XMVector3Length(cube.getScale()));
+	}
+
+	// A wall of big cubes close by, the crowd behind it is what gets tested.
+	// Tilted about z the wall's edges cross the pixels diagonally.
+	void buildScene(size_t count, float tilt, std::vector<Cube::Data>& occluders, std::vector<Cube::Data>& cubes) {
+		std::mt19937 rng(37);
+		std::uniform_real_distribution<float> spread(-30.0f, 30.0f), depth(15.0f, 90.0f), rot(-DirectX::XM_2PI, DirectX::XM_2PI), scl(0.2f, 1.0f);
+
+		// About a third of the screen
+		occluders.clear();
+		for (int y = -1; y <= 1; y++)
+			for (int x = -2; x <= 2; x++)
+				occluders.push_back({ { x * 2.0f, y * 2.0f, 12.0f }, { 0.0f, 0.0f, tilt }, { 1.0f, 1.0f, 1.0f } });
+
+		cubes.clear();
+		for (size_t iter = 0; iter < count; iter++)
+			cubes.push_back({ { spread(rng), spread(rng), depth(rng) }, { rot(rng), rot(rng), rot(rng) }, { scl(rng), scl(rng), scl(rng) } });
+	}
+
+	// Occluded cubes whose bounds still see a texel of `reference`, the same
+	// occluders rasterized at full resolution, at least as far as them. Each of
+	// those is a cube the quarter resolution buffer hid but the screen would show.
+	size_t falseCulls(const Occlusion::Buffer& reference, std::vector<Cube::Data>& cubes, const std::vector<uint32_t>& before, const std::vector<uint32_t>& after) {
+		const auto& level = reference._levels[0];
+		size_t wrong = 0;
+
+		for (uint32_t idx : before) {
+			if (std::binary_search(after.begin(), after.end(), idx)) continue;
+
+			DirectX::XMFLOAT3 center;
+			DirectX::XMStoreFloat3(&center, cubes[idx].getPosition());
+
+			Occlusion::Rect bounds;
+			float nearest;
+			if (!reference.project(center, radius(cubes[idx]), bounds, nearest)) {
+				wrong++;
+				continue;
+			}
+
+			const int minX = std::max(0, static_cast<int>(std::floor(bounds.left)));
+			const int maxX = std::min(static_cast<int>(level.width) - 1, static_cast<int>(std::floor(bounds.right)));
+			const int minY = std::max(0, static_cast<int>(std::floor(bounds.top)));
+			const int maxY = std::min(static_cast<int>(level.height) - 1, static_cast<int>(std::floor(bounds.bottom)));
+
+			bool seen = false;
+			for (int y = minY; y <= maxY && !seen; y++)
+				for (int x = minX; x <= maxX && !seen; x++)
+					seen = level.depth[size_t(y) * level.pitch + x] >= nearest;
+
+			wrong += seen;
+		}
+		return wrong;
+	}
+}
+
+void Bench::occlusion() {
+	using namespace DirectX;
+
+	const XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.01f, 100.0f);
+	const Cull::Frustum frustum = Cull::Frustum::fromProjection(proj);
+
+	Occlusion::Buffer buffer, reference;
+	buffer.resize(bufferWidth, bufferHeight, proj);
+	reference.resize(screenWidth, screenHeight, proj);
+
+	// Known answers first: behind the wall, beside it, in front of it
+	{
+		std::vector<Cube::Data> occluders, cubes;
+		buildScene(0, 0.0f, occluders, cubes);
+
+		buffer.clear();
+		for (auto& occluder : occluders) buffer.renderBox(world(occluder));
+		buffer.buildHiZ();
+
+		cubes = {
+			{ { 0.0f, 0.0f, 30.0f }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } },
+			{ { 40.0f, 0.0f, 60.0f }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } },
+			{ { 0.0f, 0.0f, 5.0f }, { 0.0f, 0.0f, 0.0f }, { 0.5f, 0.5f, 0.5f } },
+			{ { 0.0f, 0.0f, 12.0f }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } },
+		};
+		std::vector<uint32_t> visible = { 0, 1, 2, 3 };
+		Cube::occlude(buffer, Cube::Arrays(cubes), visible);
+
+		const bool ok = visible == std::vector<uint32_t>{ 1, 2, 3 };
+		std::cout << "occlusion behind/beside/in front/occluder itself: " << check(ok) << std::endl;
+	}
+
+	for (size_t count : counts) {
+		std::vector<Cube::Data> occluders, cubes;
+		buildScene(count, 0.5f, occluders, cubes);
+		const Cube::Arrays columns(cubes);
+
+		const int reps = (count >= 100000) ? 5 : 50;
+		std::vector<uint32_t> inFrustum, visible;
+		Cube::cull(frustum, columns, inFrustum);
+
+		report("occluder raster + HiZ", occluders.size(), time(reps, [&] {
+			buffer.clear();
+			for (auto& occluder : occluders) buffer.renderBox(world(occluder));
+			buffer.buildHiZ();
+		}));
+
+		report("occlusion test 4-wide", inFrustum.size(), time(reps, [&] {
+			visible = inFrustum;
+			Cube::occlude(buffer, columns, visible);
+		}));
+
+		// What the hidden cubes would have cost in transforms alone
+		std::vector<Cube::Instance> out(count);
+		report("cube transforms, frustum survivors", inFrustum.size(), time(reps, [&] {
+			Cube::getWorldMatrices(columns, inFrustum, out);
+		}));
+		report("cube transforms, occlusion survivors", visible.size(), time(reps, [&] {
+			Cube::getWorldMatrices(columns, visible, out);
+		}));
+
+		reference.clear();
+		for (auto& occluder : occluders) reference.renderBox(world(occluder));
+
+		const size_t culled = inFrustum.size() - visible.size();
+		const size_t wrong = falseCulls(reference, cubes, inFrustum, visible);
+		std::cout << "  in frustum " << inFrustum.size() << ", not occluded " << visible.size()
+			<< ", wrongly culled " << wrong << " of " << culled << " against full resolution: " << check(wrong == 0) << std::endl;
+	}
+}
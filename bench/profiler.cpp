@@ -0,0 +1,75 @@
+#include <bench.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include <jobs.h>
+#include <profiler.h>
+
+namespace {
+	size_t count(const std::string& text, const std::string& what) {
+		size_t ret = 0;
+		for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + what.size())) ret++;
+		return ret;
+	}
+}
+
+void Bench::profiler() {
+	Profile::Profiler& profiler = Profile::profiler();
+	volatile size_t sink = 0;
+
+	// What a zone costs on the hot path, frames end often enough for the ring
+	constexpr size_t zones = 1000000, perFrame = 10000;
+	const double bare = time(5, [&] { for (size_t iter = 0; iter < zones; iter++) sink = sink + 1; });
+	const double zoned = time(5, [&] {
+		for (size_t frame = 0; frame < zones / perFrame; frame++) {
+			for (size_t iter = 0; iter < perFrame; iter++) {
+				PROFILE_ZONE("bench zone");
+				sink = sink + 1;
+			}
+			profiler.endFrame();
+		}
+	});
+
+	report("profiler no zone", zones, bare);
+	report("profiler zone + collect", zones, zoned);
+
+	// Zones from every worker end up in the frame, each thread on its own track
+	Jobs::Scheduler scheduler;
+	constexpr size_t tasks = 4096;
+	for (size_t frame = 0; frame < Profile::Profiler::traceFrames; frame++) {
+		{
+			PROFILE_ZONE("bench frame");
+			scheduler.parallelFor(tasks, 64, [&](size_t first, size_t size) {
+				for (size_t task = first; task < first + size; task++) {
+					PROFILE_ZONE("bench task");
+					sink = sink + 1;
+				}
+			});
+		}
+		profiler.endFrame();
+	}
+
+	const auto summary = profiler.summary();
+	auto task = std::find_if(summary.begin(), summary.end(), [](const Profile::Summary& zone) { return zone.name == "bench task"; });
+	auto frame = std::find_if(summary.begin(), summary.end(), [](const Profile::Summary& zone) { return zone.name == "bench frame"; });
+	const bool counted = task != summary.end() && frame != summary.end() && task->frames == Profile::Profiler::traceFrames
+		&& task->minMs <= task->avgMs && task->avgMs <= task->p99Ms;
+
+	std::cout << "  " << scheduler.threads() << " threads, task zones summarized every frame: " << check(counted) << std::endl;
+
+	// The trace keeps exactly the last frames, all of them are the parallel ones
+	const std::string path = "profiler_bench_trace.json";
+	std::stringstream text;
+	if (profiler.writeTrace(path)) text << std::ifstream(path).rdbuf();
+	std::remove(path.c_str());
+
+	const size_t events = count(text.str(), "\"ph\":\"X\"");
+	const size_t expected = Profile::Profiler::traceFrames * (tasks + 1);
+	std::cout << "  trace events " << events << " of " << expected << ": " << check(events == expected) << std::endl;
+}
@@ -0,0 +1,54 @@
+#include <bench.h>
+
+#include <vector>
+#include <string>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include <renderqueue.h>
+
+void Bench::queue() {
+	std::mt19937 rng(19);
+	std::uniform_int_distribution<int> layer(0, 2), pass(0, 1), shader(0, 15), texture(0, 255);
+	std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+
+	for (size_t count : counts) {
+		std::vector<Render::Queue::Item> items;
+		std::vector<int> states;     // shader and texture of every draw
+		items.reserve(count);
+		for (size_t iter = 0; iter < count; iter++) {
+			const int program = shader(rng), view = texture(rng);
+			const uint64_t key = Render::makeKey(static_cast<Render::Layer>(layer(rng)), static_cast<Render::Pass>(pass(rng)),
+				static_cast<uint16_t>(program), static_cast<uint16_t>(view), depth(rng));
+
+			items.push_back({ key, static_cast<uint32_t>(iter) });
+			states.push_back(program * 256 + view);
+		}
+
+		auto byKey = [](const Render::Queue::Item& a, const Render::Queue::Item& b) { return a.key < b.key; };
+
+		std::vector<Render::Queue::Item> reference;
+		report("queue std::stable_sort", count, time(3, [&] {
+			reference = items;
+			std::stable_sort(reference.begin(), reference.end(), byKey);
+		}));
+
+		Render::Queue queue;
+		report("queue radix sort", count, time(3, [&] {
+			queue._items = items;
+			queue.sort();
+		}));
+
+		// Same order, ties included, and how often shader or texture change in submission and sorted order
+		size_t mismatches = 0, submitted = 0, sorted = 0;
+		for (size_t iter = 0; iter < count; iter++) {
+			mismatches += (queue._items[iter].draw != reference[iter].draw) ? 1 : 0;
+			submitted += (iter == 0 || states[iter] != states[iter - 1]) ? 1 : 0;
+			sorted += (iter == 0 || states[queue._items[iter].draw] != states[queue._items[iter - 1].draw]) ? 1 : 0;
+		}
+
+		std::cout << "  mismatches " << mismatches << " (" << check(mismatches == 0) << "), state changes " << submitted
+			<< " submitted, " << sorted << " sorted" << std::endl;
+	}
+}
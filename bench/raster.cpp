@@ -0,0 +1,261 @@
+#include <bench.h>
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include <array>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+#include <iostream>
+
+#include <cube.h>
+#include <sprite.h>
+#include <font.h>
+#include <jobs.h>
+#include <raster.h>
+
+namespace {
+	constexpr uint32_t width = 1280, height = 720;
+	constexpr std::array<float, 4> clearColor = { 0.0f, 0.0f, 0.25f, 1.0f };
+
+	Raster::Texture solid(uint32_t size, uint32_t layers, uint32_t texel) {
+		return { size, size, layers, std::vector<uint32_t>(size_t(size) * size * layers, texel) };
+	}
+
+	// Two tone checker, so the filtering has something to blend
+	Raster::Texture checker(uint32_t size, uint32_t a, uint32_t b) {
+		Raster::Texture tex = { size, size, 1, std::vector<uint32_t>(size_t(size) * size) };
+		for (uint32_t y = 0; y < size; y++)
+			for (uint32_t x = 0; x < size; x++)
+				tex.texels[y * size + x] = (((x / 8) ^ (y / 8)) & 1) ? a : b;
+		return tex;
+	}
+
+	// Same quad populateVRAM builds
+	std::array<Sprite::Vertex, 6> spriteQuad() {
+		const float half = static_cast<float>(height) / 2.0f;
+		return { {
+			{ { half,  half }, { 1.0f, 1.0f } }, { { half, -half }, { 1.0f, 0.0f } }, { { -half, -half }, { 0.0f, 0.0f } },
+			{ { -half, -half }, { 0.0f, 0.0f } }, { { -half,  half }, { 0.0f, 1.0f } }, { { half,  half }, { 1.0f, 1.0f } },
+		} };
+	}
+
+	void setProjection(Raster::Device& device) {
+		using namespace DirectX;
+		device.setProjection(
+			XMMatrixPerspectiveFovLH(XM_PIDIV4, static_cast<float>(width) / static_cast<float>(height), 0.01f, 1000.0f),
+			XMMatrixOrthographicOffCenterLH(0.0f, static_cast<float>(width), 0.0f, static_cast<float>(height), 0.1f, 100.0f));
+	}
+
+	uint64_t hash(const std::vector<uint32_t>& pixels) {
+		uint64_t h = 14695981039346656037ull;
+		for (uint32_t pixel : pixels) h = (h ^ pixel) * 1099511628211ull;
+		return h;
+	}
+
+	uint32_t pixel(const Raster::Device& device, uint32_t x, uint32_t y) {
+		return device._target.color[size_t(y) * device._target.width + x];
+	}
+
+	// Draw order of a frame: sprites behind, cubes, text over both
+	struct Scene {
+		std::vector<Cube::Instance> cubes;
+		std::vector<Sprite::Instance> sprites;
+		std::vector<Font::Glyph> glyphs;
+		std::array<Sprite::Vertex, 6> quad = spriteQuad();
+		Raster::Texture wood, heart, atlas, font;
+
+		void draw(Raster::Device& device) const {
+			device.clear(clearColor);
+			device.clearDepth();
+
+			device.submit({ .program = Raster::Program::Sprite, .vertices = quad.data(), .count = 6,
+				.instances = sprites.data(), .instanceCount = static_cast<uint32_t>(sprites.size()), .textures = { &atlas } });
+			device.submit({ .program = Raster::Program::Cube, .vertices = Cube::vertices.data(), .indices = Cube::indices.data(), .count = 36,
+				.instances = cubes.data(), .instanceCount = static_cast<uint32_t>(cubes.size()), .textures = { &wood, &heart } });
+			device.submit({ .program = Raster::Program::Font, .count = 6,
+				.instances = glyphs.data(), .instanceCount = static_cast<uint32_t>(glyphs.size()), .textures = { &font } });
+
+			device.flush();
+		}
+	};
+
+	Scene buildScene(size_t cubeCount, size_t spriteCount, size_t glyphCount) {
+		using namespace DirectX;
+
+		std::mt19937 rng(41);
+		std::uniform_real_distribution<float> x(0.0f, static_cast<float>(width)), y(0.0f, static_cast<float>(height));
+		std::uniform_real_distribution<float> rot(-XM_2PI, XM_2PI), scl(0.01f, 0.06f);
+
+		Scene scene;
+		scene.wood = checker(64, 0xff204080, 0xff3060a0);
+		scene.heart = checker(32, 0x802020e0, 0x00000000);
+		scene.atlas = { 128, 128, 2, {} };
+		for (uint32_t texel : { 0xff30c030u, 0xffc03030u })
+			scene.atlas.texels.insert(scene.atlas.texels.end(), size_t(128) * 128, texel);
+		scene.font = checker(256, 0xffffffff, 0x40ffffff);
+
+		// Grid in front of the camera like --cubes builds
+		std::vector<Cube::Data> data;
+		const size_t side = 32;
+		for (size_t iter = 0; iter < cubeCount; iter++) {
+			const float cx = static_cast<float>(iter % side) - side / 2.0f;
+			const float cy = static_cast<float>((iter / side) % side) - side / 2.0f;
+			const float cz = static_cast<float>(iter / (side * side));
+			data.push_back({ { cx * 3.0f, cy * 3.0f, 40.0f + cz * 3.0f }, { rot(rng), rot(rng), 0.0f }, { 1.0f, 1.0f, 1.0f } });
+		}
+		scene.cubes.resize(cubeCount);
+		Cube::getWorldMatrices(Cube::Arrays(data), scene.cubes);
+
+		std::vector<Sprite::Data> sprites;
+		for (size_t iter = 0; iter < spriteCount; iter++) {
+			sprites.push_back({ { x(rng), y(rng) }, rot(rng), { scl(rng), scl(rng) } });
+			sprites.back().setUV({ 0.0f, 0.0f, 1.0f, 1.0f }, static_cast<uint32_t>(iter % 2));
+		}
+		scene.sprites.resize(spriteCount);
+		Sprite::getWorldMatrices(Sprite::Arrays(sprites), scene.sprites);
+
+		for (size_t iter = 0; iter < glyphCount; iter++) {
+			const float u = static_cast<float>(iter % 64) / 64.0f;
+			scene.glyphs.push_back({ { x(rng), y(rng) }, PackedVector::XMHALF2(12.0f, 24.0f), PackedVector::XMUSHORTN2(u, u + 1.0f / 64.0f) });
+		}
+
+		return scene;
+	}
+
+	// One cube and one sprite on solid textures, every pixel that matters is known
+	bool knownPixels() {
+		using namespace DirectX;
+
+		Jobs::Scheduler scheduler(0);
+		Raster::Device device(scheduler);
+		device.resize(width, height);
+		setProjection(device);
+
+		Scene scene;
+		scene.wood = solid(4, 1, 0xff2040c0);
+		scene.heart = solid(4, 1, 0x00000000);     // transparent, combiPS leaves the wood alone
+		scene.atlas = solid(4, 1, 0xff00ff00);
+		scene.font = solid(4, 1, 0xffffffff);
+
+		std::vector<Cube::Data> cube = { { { 0.0f, 0.0f, 6.0f }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } } };
+		scene.cubes.resize(1);
+		Cube::getWorldMatrices(Cube::Arrays(cube), scene.cubes);
+
+		std::vector<Sprite::Data> sprite = { { { 100.0f, 100.0f }, 0.0f, { 0.1f, 0.1f } } };
+		scene.sprites.resize(1);
+		Sprite::getWorldMatrices(Sprite::Arrays(sprite), scene.sprites);
+
+		// Opaque white glyph, blending writes zero alpha
+		scene.glyphs.push_back({ { 1000.0f, 600.0f }, PackedVector::XMHALF2(20.0f, 20.0f), PackedVector::XMUSHORTN2(0.0f, 1.0f) });
+
+		scene.draw(device);
+
+		// Screen y grows down, the sprite and glyph positions are from the bottom
+		return pixel(device, 0, 0) == 0xff400000
+			&& pixel(device, width / 2, height / 2) == 0xff2040c0
+			&& pixel(device, 100, height - 100) == 0xff00ff00
+			&& pixel(device, 1010, height - 610) == 0x00ffffff;
+	}
+
+	// Pixels that differ between sprites drawn from full and compact
+	// instances, half precision only moves a few edges
+	size_t compactDifference(size_t spriteCount, size_t& covered) {
+		using namespace DirectX;
+
+		std::mt19937 rng(43);
+		std::uniform_real_distribution<float> x(0.0f, static_cast<float>(width)), y(0.0f, static_cast<float>(height));
+		std::uniform_real_distribution<float> rot(-XM_2PI, XM_2PI), scl(0.01f, 0.06f);
+
+		// Two regions, each a page of the atlas
+		std::vector<Sprite::Region> regions(Sprite::maxRegions, { { 0.0f, 0.0f, 1.0f, 1.0f }, 0, {} });
+		regions[1].page = 1;
+
+		std::vector<Sprite::Data> sprites;
+		for (size_t iter = 0; iter < spriteCount; iter++) {
+			sprites.push_back({ { x(rng), y(rng) }, rot(rng), { scl(rng), scl(rng) } });
+			sprites.back().setUV({ 0.0f, 0.0f, 1.0f, 1.0f }, static_cast<uint32_t>(iter % 2)).setRegion(static_cast<uint16_t>(iter % 2));
+		}
+
+		std::vector<Sprite::Instance> full(spriteCount);
+		std::vector<Sprite::CompactInstance> compact(spriteCount);
+		Sprite::getWorldMatrices(Sprite::Arrays(sprites), full);
+		Sprite::getCompactInstances(Sprite::Arrays(sprites), compact);
+
+		Raster::Texture atlas = { 128, 128, 2, {} };
+		for (uint32_t texel : { 0xff30c030u, 0xffc03030u })
+			atlas.texels.insert(atlas.texels.end(), size_t(128) * 128, texel);
+		const auto quad = spriteQuad();
+
+		Jobs::Scheduler scheduler;
+		std::array<std::vector<uint32_t>, 2> images;
+		for (size_t pass = 0; pass < 2; pass++) {
+			Raster::Device device(scheduler);
+			device.resize(width, height);
+			setProjection(device);
+			device.clear(clearColor);
+			device.clearDepth();
+
+			device.submit({ .program = (pass == 0) ? Raster::Program::Sprite : Raster::Program::SpriteCompact,
+				.vertices = quad.data(), .count = 6,
+				.instances = (pass == 0) ? static_cast<const void*>(full.data()) : static_cast<const void*>(compact.data()),
+				.instanceCount = static_cast<uint32_t>(spriteCount), .textures = { &atlas }, .regions = regions.data() });
+			device.flush();
+
+			images[pass] = device._target.color;
+		}
+
+		const uint32_t background = images[0][0];
+		size_t differ = 0;
+		covered = 0;
+		for (size_t idx = 0; idx < images[0].size(); idx++) {
+			differ += (images[0][idx] != images[1][idx]) ? 1 : 0;
+			covered += (images[0][idx] != background) ? 1 : 0;
+		}
+		return differ;
+	}
+}
+
+void Bench::raster() {
+	std::cout << "raster known pixels: " << check(knownPixels()) << std::endl;
+
+	size_t covered = 0;
+	const size_t differ = compactDifference(2000, covered);
+	std::cout << "compact sprites, pixels differing " << differ << " of " << covered << " covered: "
+		<< check(differ * 100 < covered) << std::endl;
+
+	// 1, 2, 4 ... threads, and every core
+	std::vector<size_t> threadCounts;
+	const size_t cores = Jobs::Scheduler::defaultWorkers() + 1;
+	for (size_t threads = 1; threads < cores; threads *= 2) threadCounts.push_back(threads);
+	threadCounts.push_back(cores);
+
+	for (size_t cubeCount : { size_t(1000), size_t(10000) }) {
+		const Scene scene = buildScene(cubeCount, 2000, 2000);
+		uint64_t expected = 0;
+		double single = 0.0;
+
+		for (size_t threads : threadCounts) {
+			Jobs::Scheduler scheduler(threads - 1);
+			Raster::Device device(scheduler);
+			device.resize(width, height);
+			setProjection(device);
+
+			const double ms = time(5, [&] { scene.draw(device); });
+			const size_t pixels = device._stats.pixels;
+
+			report("raster " + std::to_string(cubeCount) + " cubes " + std::to_string(threads) + " threads", pixels, ms);
+
+			// Tiles keep submission order, so the image may not depend on the threads
+			const uint64_t image = hash(device._target.color);
+			expected = (threads == 1) ? image : expected;
+			single = (threads == 1) ? ms : single;
+
+			std::cout << "  " << static_cast<double>(pixels) / (ms * 1000.0) << " Mpixels/s, "
+				<< device._stats.triangles << " triangles, speedup " << single / ms
+				<< ", same image: " << check(image == expected) << std::endl;
+		}
+	}
+}
@@ -0,0 +1,112 @@
+#include <bench.h>
+
+#include <DirectXMath.h>
+
+#include <array>
+#include <vector>
+#include <string>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include <sprite.h>
+#include <cube.h>
+#include <jobs.h>
+#include <commandlist.h>
+#include <renderqueue.h>
+
+namespace {
+	constexpr size_t grain = 16384;
+
+	// About the size of D3DRenderer::Draw, the pipeline being mostly pointers
+	struct Packet {
+		std::array<const void*, 20> pipeline;
+		uint32_t instances;
+		uint32_t firstInstance;
+	};
+
+	struct Scene {
+		Sprite::Arrays sprites;
+		Cube::Arrays cubes;
+		std::vector<Sprite::Instance> spriteOut;
+		std::vector<Cube::Instance> cubeOut;
+	};
+
+	// One chunk's transforms plus its draw, what a renderScene task does
+	void recordTask(Scene& scene, size_t task, Command::List& list) {
+		const size_t spriteTasks = (scene.sprites.size() + grain - 1) / grain;
+		Packet packet = {};
+
+		if (task < spriteTasks) {
+			const size_t first = task * grain;
+			const size_t count = std::min(grain, scene.sprites.size() - first);
+
+			Sprite::getWorldMatrices(Sprite::Columns(scene.sprites).subspan(first, count), std::span(scene.spriteOut).subspan(first, count));
+			packet.instances = static_cast<uint32_t>(count);
+			packet.firstInstance = static_cast<uint32_t>(first);
+			list.record(Render::makeKey(Render::Layer::Background, Render::Pass::Opaque, 1, 0, 0.0f), 0, packet);
+			return;
+		}
+
+		const size_t first = (task - spriteTasks) * grain;
+		const size_t count = std::min(grain, scene.cubes.size() - first);
+
+		Cube::getWorldMatrices(Cube::Columns(scene.cubes).subspan(first, count), std::span(scene.cubeOut).subspan(first, count));
+		packet.instances = static_cast<uint32_t>(count);
+		packet.firstInstance = static_cast<uint32_t>(first);
+		list.record(Render::makeKey(Render::Layer::World, Render::Pass::Opaque, 0, 0, 1.0f - static_cast<float>(first) / static_cast<float>(scene.cubes.size())), 0, packet);
+	}
+
+	// Order the draws come out in, to compare runs
+	std::vector<uint32_t> replayOrder(Command::Stream& stream) {
+		std::vector<uint32_t> order;
+		stream.replay([&](const Command::List::Header& header, std::span<const std::byte> bytes) {
+			order.push_back(static_cast<uint32_t>(header.key >> 56) << 28 | Command::packet<Packet>(bytes).firstInstance);
+		});
+		return order;
+	}
+}
+
+void Bench::recording() {
+	using namespace DirectX;
+
+	std::mt19937 rng(23);
+	std::uniform_real_distribution<float> pos(-500.0f, 500.0f), rot(-XM_2PI, XM_2PI), scl(0.1f, 4.0f);
+
+	Jobs::Scheduler pool;
+
+	for (size_t count : counts) {
+		Scene scene;
+		for (size_t iter = 0; iter < count; iter++) {
+			scene.sprites.add(Sprite::Data({ pos(rng), pos(rng) }, rot(rng), { scl(rng), scl(rng) }));
+			scene.cubes.add(Cube::Data({ pos(rng), pos(rng), pos(rng) }, { rot(rng), rot(rng), rot(rng) }, { scl(rng), scl(rng), scl(rng) }));
+		}
+		scene.spriteOut.resize(count);
+		scene.cubeOut.resize(count);
+
+		const size_t tasks = 2 * ((count + grain - 1) / grain);
+		const int reps = (count >= 100000) ? 5 : 20;
+
+		// Same chunks on one thread, into one list
+		Command::Stream serial;
+		report("record + replay 1 thread", 2 * count, time(reps, [&] {
+			serial.clear();
+			for (size_t task = 0; task < tasks; task++) recordTask(scene, task, serial.list(0));
+			replayOrder(serial);
+		}));
+		const auto expected = replayOrder(serial);
+
+		Command::Stream parallel;
+		parallel.reserve(tasks);
+		report("record + replay " + std::to_string(pool.threads()) + " threads", 2 * count, time(reps, [&] {
+			parallel.clear();
+			pool.parallelFor(tasks, 1, [&](size_t first, size_t count) {
+				for (size_t task = first; task < first + count; task++) recordTask(scene, task, parallel._lists[task]);
+			});
+			replayOrder(parallel);
+		}));
+
+		std::cout << "  commands " << parallel.size() << ", replay matches 1 thread: "
+			<< check(replayOrder(parallel) == expected) << std::endl;
+	}
+}
@@ -0,0 +1,85 @@
+#include <bench.h>
+
+#include <span>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <shaderpack.h>
+
+void Bench::shaders() {
+	constexpr std::array variantCounts = { size_t(16), size_t(256), size_t(4096) };
+	constexpr size_t lookups = 1000000;
+	const std::string path = "bench_shaders.pack";
+
+	std::mt19937 rng(11);
+	std::uniform_int_distribution<int> byte(0, 255), length(64, 2048);
+
+	for (size_t count : variantCounts) {
+		// Stub bytecode for every permutation of one entry point
+		std::vector<Shader::Key> keys;
+		std::vector<std::vector<std::byte>> codes;
+		for (size_t iter = 0; iter < count; iter++) {
+			keys.push_back({ "spriteVS", "vs_4_0", {
+				{ "VARIANT", std::to_string(iter) },
+				{ "INSTANCED", (iter & 1) ? "1" : "0" },
+			} });
+
+			std::vector<std::byte> code(length(rng));
+			for (auto& chr : code) chr = static_cast<std::byte>(byte(rng));
+			codes.push_back(std::move(code));
+		}
+
+		std::vector<uint64_t> hashes;
+		for (auto& key : keys) hashes.push_back(key.hash());
+
+		std::vector<std::byte> built;
+		report("shader pack build", count, time(5, [&] {
+			std::vector<Shader::Pack::Blob> blobs;
+			for (size_t iter = 0; iter < count; iter++)
+				blobs.push_back({ hashes[iter], codes[iter] });
+
+			built = Shader::Pack::build(42, std::move(blobs));
+		}));
+
+		Shader::Pack::write(path, built);
+
+		Shader::Pack pack;
+		report("shader pack open", count, time(5, [&] { pack.open(path); }));
+
+		size_t found = 0, mismatched = 0;
+		for (size_t iter = 0; iter < count; iter++) {
+			auto code = pack.find(hashes[iter]);
+			found += code.empty() ? 0 : 1;
+			mismatched += (code.size() == codes[iter].size()
+				&& std::memcmp(code.data(), codes[iter].data(), code.size()) == 0) ? 0 : 1;
+		}
+
+		size_t bytes = 0;
+		report("shader pack find", lookups, time(5, [&] {
+			for (size_t iter = 0; iter < lookups; iter++)
+				bytes += pack.find(hashes[iter % count]).size();
+		}));
+
+		// Define order must not change the key, a flipped byte must fail the load
+		Shader::Key swapped = keys[0];
+		std::swap(swapped.defines[0], swapped.defines[1]);
+
+		std::vector<std::byte> corrupt = built;
+		corrupt[0] ^= std::byte(1);
+		Shader::Pack rejected;
+
+		std::cout << "  found " << found << "/" << count << ", mismatched " << mismatched
+			<< " (" << check(found == count && mismatched == 0) << "), source hash " << pack._sourceHash
+			<< ", define order ignored: " << check(swapped.hash() == hashes[0])
+			<< ", corrupt rejected: " << check(!rejected.load(corrupt))
+			<< ", checksum " << bytes << "\n";
+
+		pack.close();
+	}
+
+	std::remove(path.c_str());
+}
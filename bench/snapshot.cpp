@@ -0,0 +1,89 @@
+#include <bench.h>
+
+#include <DirectXMath.h>
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <iostream>
+
+#include <sprite.h>
+#include <cube.h>
+#include <font.h>
+#include <profiler.h>
+#include <snapshot.h>
+
+namespace {
+	// Every sprite of snapshot n sits at x = n, and there are n % 7 + 1 of them
+	void fill(Snapshot::Scene& scene, uint64_t sequence) {
+		const float x = static_cast<float>(sequence);
+		scene.sprites.clear();
+		for (uint64_t iter = 0; iter < sequence % 7 + 1; iter++) scene.sprites.add(Sprite::Data{ { x, 0.0f }, 0.0f, { 1.0f, 1.0f } });
+	}
+
+	bool intact(Snapshot::Scene& scene) {
+		if (scene.sprites.size() != scene.sequence % 7 + 1) return false;
+
+		for (auto& position : scene.sprites.position)
+			if (position.x != static_cast<float>(scene.sequence)) return false;
+		return true;
+	}
+}
+
+void Bench::snapshot() {
+	// What the update thread pays per publish, every column copied
+	for (size_t count : sweep) {
+		const Sprite::Arrays sprites(std::vector<Sprite::Data>(count, Sprite::Data{ { 1.0f, 2.0f }, 0.5f, { 1.0f, 1.0f } }));
+		const Cube::Arrays cubes(std::vector<Cube::Data>(count, Cube::Data{ { 0.0f, 0.0f, 6.0f }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } }));
+		const std::vector<Font::String> strings = { { "CHOP A WOOD", { 25, 250 }, 128 } };
+
+		Snapshot::TripleBuffer snapshots;
+		const double ms = time(5, count, [&] {
+			snapshots.back().assign(sprites, cubes, strings);
+			snapshots.publish();
+		});
+
+		report("snapshot publish " + std::to_string(count) + "+" + std::to_string(count), count, ms);
+	}
+
+	// A writer and a reader flat out, the reader may never see a torn snapshot
+	// or go back in time, and every snapshot is either taken or dropped
+	constexpr uint64_t publishes = 200000;
+	Snapshot::TripleBuffer snapshots;
+	Snapshot::Stats stats;
+	std::atomic<bool> written = false;
+	size_t torn = 0, backwards = 0;
+	uint64_t last = 0;
+
+	std::thread writer([&] {
+		for (uint64_t sequence = 1; sequence <= publishes; sequence++) {
+			fill(snapshots.back(), sequence);
+			snapshots.publish();
+		}
+		written = true;
+	});
+
+	while (last < publishes) {
+		// The flag is read before the acquire, so the last snapshot still comes
+		const bool finished = written.load();
+		const bool acquired = snapshots.acquire();
+		Snapshot::Scene& scene = snapshots.front();
+
+		if (acquired) {
+			torn += intact(scene) ? 0 : 1;
+			backwards += (scene.sequence <= last) ? 1 : 0;
+			last = scene.sequence;
+		}
+		stats.frame(scene, acquired, Profile::now());
+
+		if (finished && !acquired) break;
+	}
+	writer.join();
+
+	std::cout << "  " << publishes << " publishes, " << stats.fresh() << " taken, " << stats.dropped << " dropped, "
+		<< stats.duplicated << " duplicated, latency avg " << stats.avgLatencyMs() * 1e3 << " us, max " << stats.maxLatencyMs * 1e3 << " us\n"
+		<< "  no torn or stale snapshots: " << check(torn == 0 && backwards == 0)
+		<< ", taken + dropped = published: " << check(last == publishes && stats.fresh() + stats.dropped == publishes) << std::endl;
+}
@@ -0,0 +1,104 @@
+#include <bench.h>
+
+#include <vector>
+#include <string>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+#include <texturestream.h>
+
+namespace {
+	// Square RGBA8 texture with a full mip chain
+	Texture::Desc fakeTexture(uint32_t size) {
+		Texture::Desc desc = { size, size, {} };
+		for (uint32_t edge = size; edge > 0; edge /= 2)
+			desc.mipBytes.push_back(size_t(edge) * edge * 4);
+
+		return desc;
+	}
+
+	// Camera walks along a row of textures, the close ones want full detail
+	void request(Texture::Residency& residency, size_t count, int frame, std::mt19937& rng) {
+		std::uniform_real_distribution<float> jitter(0.5f, 1.5f);
+		const size_t visible = std::max<size_t>(1, count / 8);
+		const size_t first = (static_cast<size_t>(frame) * visible / 16) % count;
+
+		for (size_t iter = 0; iter < visible; iter++) {
+			const float distance = 1.0f + static_cast<float>(iter);
+			residency.request(static_cast<Texture::Handle>((first + iter) % count), 2048.0f / distance * jitter(rng));
+		}
+	}
+
+	size_t recount(const Texture::Residency& residency) {
+		size_t total = 0;
+		for (auto& entry : residency._entries) total += residency.footprint(entry);
+		return total;
+	}
+}
+
+void Bench::streaming() {
+	constexpr std::array textureCounts = { size_t(64), size_t(512), size_t(4096) };
+	constexpr int frames = 600;
+
+	for (size_t count : textureCounts) {
+		std::mt19937 rng(3);
+		std::uniform_int_distribution<int> sizeLog(9, 12);
+
+		// Same budget for every count, the larger sets have to evict
+		Texture::Streamer streamer;
+		streamer.residency._budget = size_t(256) << 20;
+		for (size_t iter = 0; iter < count; iter++)
+			streamer.residency.add(fakeTexture(1u << sizeLog(rng)));
+
+		const size_t tails = streamer.residency._committed;
+		size_t overBudget = 0, mismatched = 0, peak = 0;
+
+		report("streaming schedule x" + std::to_string(frames), count, time(1, [&] {
+			for (int frame = 0; frame < frames; frame++) {
+				request(streamer.residency, count, frame, rng);
+				streamer.update();
+
+				const size_t committed = streamer.residency._committed;
+				peak = std::max(peak, committed);
+				overBudget += (committed > std::max(streamer.residency._budget, tails)) ? 1 : 0;
+				mismatched += (committed != recount(streamer.residency)) ? 1 : 0;
+			}
+		}));
+
+		auto& stats = streamer.residency._stats;
+		std::cout << "  budget " << (streamer.residency._budget >> 20) << " MB, peak " << (peak >> 20)
+			<< " MB, loads " << stats.loads << ", evictions " << stats.evictions
+			<< ", deferred " << stats.deferred << ", over budget " << overBudget
+			<< ", accounting errors " << mismatched << " (" << check(overBudget == 0 && mismatched == 0) << ")\n";
+	}
+
+	// Same walk with a real worker thread and a slow fake loader
+	Texture::Streamer streamer;
+	std::mt19937 rng(5);
+	size_t total = 0;
+	for (size_t iter = 0; iter < 256; iter++) {
+		auto desc = fakeTexture(2048);
+		for (size_t bytes : desc.mipBytes) total += bytes;
+		streamer.residency.add(std::move(desc));
+	}
+	streamer.residency._budget = total / 4;
+
+	size_t loaded = 0, finished = 0;
+	streamer.start([&](const Texture::Job&) {
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+		loaded++;
+	});
+
+	for (int frame = 0; frame < frames; frame++) {
+		request(streamer.residency, 256, frame, rng);
+		finished += streamer.update().size();
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+	streamer.stop();
+
+	std::cout << "  threaded: loaded " << loaded << ", finished " << finished
+		<< ", in flight " << streamer.residency._inFlight << "\n";
+}
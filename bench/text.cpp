@@ -0,0 +1,84 @@
+#include <bench.h>
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include <font.h>
+#include <fontcache.h>
+
+void Bench::text() {
+	// Glyph quads for `count` letters, what renderString lays out before any caching
+	const std::string text(16, 'W');
+	for (size_t count : sweep) {
+		std::vector<Font::String> strings;
+		for (size_t left = count; left > 0; left -= std::min<size_t>(left, 16))
+			strings.push_back({ std::string_view(text).substr(0, std::min<size_t>(left, 16)), { 10, 10 }, 16 });
+
+		std::vector<Font::Glyph> glyphs(count);
+		report("text glyph quads", count, time((count >= 100000) ? 5 : 10, count, [&] {
+			size_t head = 0;
+			for (auto& str : strings) head += Font::layout(str, glyphs.data() + head);
+		}));
+	}
+
+	constexpr std::array stringCounts = { size_t(1000), size_t(5000), size_t(20000) };
+	constexpr int frames = 60;
+	constexpr size_t changedPerHundred = 5;
+
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<int> letter('A', 'Z'), length(4, 24), px(0, 800);
+
+	for (size_t count : stringCounts) {
+		// Strings only point at their text, it changes in place
+		std::vector<std::string> texts(count);
+		std::vector<Font::String> strings;
+		strings.reserve(count);
+		for (size_t iter = 0; iter < count; iter++) {
+			texts[iter].resize(length(rng));
+			for (auto& chr : texts[iter]) chr = static_cast<char>(letter(rng));
+
+			strings.push_back({ texts[iter], { px(rng), px(rng) }, 16 });
+		}
+
+		// A few strings change every frame, e.g. counters and timers
+		auto mutate = [&](int frame) {
+			for (size_t iter = frame % 100; iter < count; iter += 100 / changedPerHundred)
+				texts[iter][0] = static_cast<char>(letter(rng));
+		};
+
+		std::vector<Font::Glyph> glyphs;
+		report("text full layout x" + std::to_string(frames), count, time(3, [&] {
+			for (int frame = 0; frame < frames; frame++) {
+				mutate(frame);
+
+				size_t glyphCount = 0;
+				for (auto& str : strings) glyphCount += Font::glyphCount(str);
+				glyphs.resize(glyphCount);
+
+				size_t head = 0;
+				for (auto& str : strings) head += Font::layout(str, glyphs.data() + head);
+			}
+		}));
+
+		Font::LayoutCache cache;
+		size_t hits = 0, misses = 0, uploaded = 0;
+		report("text layout cache x" + std::to_string(frames), count, time(3, [&] {
+			for (int frame = 0; frame < frames; frame++) {
+				mutate(frame);
+				cache.update(strings);
+
+				hits += cache._stats.hits;
+				misses += cache._stats.misses;
+				uploaded += cache._dirtyEnd - cache._dirtyBegin;
+				cache.clearDirty();
+			}
+		}));
+
+		std::cout << "cache hits " << hits << ", misses " << misses
+			<< ", uploaded glyphs " << uploaded << std::endl;
+	}
+}
@@ -0,0 +1,107 @@
+#include <bench.h>
+
+#include <span>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <dds.h>
+#include <mappedfile.h>
+
+void Bench::textures() {
+	const std::string path = std::string(DXBENCH_RES) + "/font/Hack.dds";
+	constexpr int loads = 100;
+
+	DDS::File probe;
+	const DDS::Result opened = probe.open(path);
+	if (opened != DDS::Result::Ok) {
+		std::cout << "dds: " << path << ": " << DDS::describe(opened) << "\n";
+		return;
+	}
+
+	// What CreateDDSTextureFromFile does, read everything into the heap first
+	size_t checksum = 0;
+	report("dds read into heap + parse x" + std::to_string(loads), loads, time(5, [&] {
+		for (int load = 0; load < loads; load++) {
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			std::vector<std::byte> data(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+			DDS::Image image;
+			DDS::parse(data, image);
+			checksum += image.subresources.size();
+		}
+	}));
+
+	report("dds mmap + parse x" + std::to_string(loads), loads, time(5, [&] {
+		for (int load = 0; load < loads; load++) {
+			DDS::File file;
+			file.open(path);
+			checksum += file.image.subresources.size();
+		}
+	}));
+
+	const DDS::Image& image = probe.image;
+	std::cout << "  " << image.width << "x" << image.height << ", format " << image.format
+		<< ", mips " << image.mipLevels << ", pitch " << image.subresources[0].rowPitch
+		<< ", checksum " << checksum << "\n";
+
+	// Damaged copies of the same file have to be rejected, not read past the end
+	std::vector<std::byte> data(probe._file.bytes().begin(), probe._file.bytes().end());
+	DDS::Image damaged;
+
+	auto rejected = [&](const char* name, std::vector<std::byte> copy) {
+		const auto result = DDS::parse(copy, damaged);
+		std::cout << "  " << name << ": " << DDS::describe(result) << ", rejected: " << check(result != DDS::Result::Ok) << "\n";
+	};
+
+	rejected("truncated", { data.begin(), data.end() - 1 });
+	rejected("header only", { data.begin(), data.begin() + 128 });
+
+	auto badMagic = data;
+	badMagic[0] = std::byte('X');
+	rejected("bad magic", badMagic);
+
+	// Pitch lives at byte 20, after the magic and four header fields
+	auto badPitch = data;
+	const uint32_t pitch = 1234;
+	std::memcpy(badPitch.data() + 20, &pitch, sizeof(pitch));
+	rejected("bad pitch", badPitch);
+
+	// Sprites may be block compressed, the atlas gets them decoded. A 5x5 BC1
+	// image is four blocks, the right and bottom ones mostly outside.
+	std::vector<unsigned char> bc1(4 * 8);
+	const uint16_t red = 0xf800, blue = 0x001f;
+	for (size_t block = 0; block < 4; block++) {
+		const bool opaque = (block != 3);
+		const uint16_t ends[2] = { opaque ? red : blue, opaque ? blue : red };
+		const uint32_t bits = opaque ? 0xaaaaaaaa : 0xffffffff;  // index 2 everywhere, or 3
+		std::memcpy(bc1.data() + block * 8, ends, 4);
+		std::memcpy(bc1.data() + block * 8 + 4, &bits, 4);
+	}
+
+	DDS::Image bc1Image = { 71, 5, 5, 1, 1, { { bc1.data(), 16, 32 } } };
+	std::vector<uint32_t> texels;
+	const bool bc1Read = DDS::readRGBA8(bc1Image, texels);
+	// Two thirds red, one third blue; the last block is 3 color mode, index 3 is transparent
+	const bool bc1Ok = bc1Read && texels.size() == 25 && texels[0] == 0xff5500aa && texels[24] == 0;
+
+	// BC3: alpha endpoints 255 and 0, index 2 is 6/7 of the way to the first
+	std::vector<unsigned char> bc3(16, 0);
+	bc3[0] = 255;
+	uint64_t alphaBits = 0;
+	for (uint32_t texel = 0; texel < 16; texel++) alphaBits |= uint64_t(2) << (texel * 3);
+	std::memcpy(bc3.data() + 2, &alphaBits, 6);
+	std::memcpy(bc3.data() + 8, &red, 2);
+	std::memcpy(bc3.data() + 10, &blue, 2);
+
+	DDS::Image bc3Image = { 77, 4, 4, 1, 1, { { bc3.data(), 16, 16 } } };
+	const bool bc3Read = DDS::readRGBA8(bc3Image, texels);
+	const bool bc3Ok = bc3Read && (texels[0] >> 24) == 255 * 6 / 7 && (texels[15] & 0xff) == 255;
+
+	std::cout << "  BC1 and BC3 decode for the sprite atlas: " << check(bc1Ok && bc3Ok) << "\n";
+}
@@ -0,0 +1,118 @@
+#include <bench.h>
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include <cmath>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include <sprite.h>
+#include <cube.h>
+
+namespace {
+
+	float maxError(const float* a, const float* b, size_t n) {
+		float err = 0.0f;
+		for (size_t i = 0; i < n; i++)
+			err = std::max(err, std::abs(a[i] - b[i]));
+		return err;
+	}
+
+	// The matrix spriteCompactVS builds, relative to the CPU one
+	float compactError(const Sprite::CompactInstance& compact, const Sprite::Instance& full) {
+		using namespace DirectX::PackedVector;
+
+		const float sclX = XMConvertHalfToFloat(compact.scale.x), sclY = XMConvertHalfToFloat(compact.scale.y);
+		const float rot = XMConvertHalfToFloat(compact.rotation);
+		const float sinRot = std::sin(rot), cosRot = std::cos(rot);
+
+		const float decoded[6] = { sclX * cosRot, -sclY * sinRot, compact.position.x, sclX * sinRot, sclY * cosRot, compact.position.y };
+		const float* expected[6] = { &full.model._11, &full.model._12, &full.model._13, &full.model._21, &full.model._22, &full.model._23 };
+
+		float err = 0.0f;
+		for (size_t i = 0; i < 6; i++)
+			err = std::max(err, std::abs(decoded[i] - *expected[i]) / std::max(1.0f, std::abs(*expected[i])));
+		return err;
+	}
+
+}
+
+void Bench::transforms() {
+	using namespace DirectX;
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos(-500.0f, 500.0f), rot(-XM_2PI, XM_2PI), scl(0.1f, 4.0f);
+
+	for (size_t count : sweep) {
+		std::vector<Sprite::Data> sprites;
+		std::vector<Cube::Data> cubes;
+		sprites.reserve(count);
+		cubes.reserve(count);
+
+		for (size_t iter = 0; iter < count; iter++) {
+			sprites.push_back({ { pos(rng), pos(rng) }, rot(rng), { scl(rng), scl(rng) } });
+			cubes.push_back({ { pos(rng), pos(rng), pos(rng) }, { rot(rng), rot(rng), rot(rng) }, { scl(rng), scl(rng), scl(rng) } });
+		}
+
+		// The kernels walk the same objects split into columns
+		const Sprite::Arrays spriteColumns(sprites);
+		const Cube::Arrays cubeColumns(cubes);
+
+		const int reps = (count >= 100000) ? 5 : 10;
+
+		std::vector<Sprite::Instance> spriteRef(count), spriteOut(count);
+		report("sprite getWorldMatrix", count, time(reps, count, [&] {
+			for (size_t iter = 0; iter < count; iter++)
+				spriteRef[iter].model = sprites[iter].getWorldMatrix();
+		}));
+		report("sprite getWorldMatrices", count, time(reps, count, [&] {
+			Sprite::getWorldMatrices(spriteColumns, spriteOut);
+		}));
+
+		std::vector<Cube::Instance> cubeRef(count), cubeOut(count);
+		report("cube getWorldMatrix", count, time(reps, count, [&] {
+			for (size_t iter = 0; iter < count; iter++)
+				cubeRef[iter].model = cubes[iter].getWorldMatrix();
+		}));
+		report("cube getWorldMatrices", count, time(reps, count, [&] {
+			Cube::getWorldMatrices(cubeColumns, cubeOut);
+		}));
+
+		// What recordSprites does: survivors of the cull packed back to back
+		// into mapped ring memory, here every other sprite
+		std::vector<uint32_t> visible;
+		for (uint32_t iter = 0; iter < count; iter += 2) visible.push_back(iter);
+		std::vector<std::byte> ring(count * sizeof(Sprite::Instance));
+		report("sprite pack into ring", count, time(reps, count, [&] {
+			Sprite::getWorldMatrices(spriteColumns, visible, { reinterpret_cast<Sprite::Instance*>(ring.data()), visible.size() });
+		}));
+
+		// Same survivors as 16 byte instances, the shader builds the matrices
+		std::vector<Sprite::CompactInstance> compact(count);
+		report("sprite compact pack into ring", count, time(reps, count, [&] {
+			Sprite::getCompactInstances(spriteColumns, visible, { compact.data(), visible.size() });
+		}));
+
+		Sprite::getCompactInstances(spriteColumns, compact);
+		float compactErr = 0.0f;
+		for (size_t iter = 0; iter < count; iter++)
+			compactErr = std::max(compactErr, compactError(compact[iter], spriteOut[iter]));
+
+		std::cout << "bytes/sprite " << sizeof(Sprite::CompactInstance) << " instead of " << sizeof(Sprite::Instance)
+			<< ", max relative error " << std::defaultfloat << compactErr << ", within half precision: " << check(compactErr < 1e-2f) << std::endl;
+
+		// Batched results have to match the per-object path. Sprite instances
+		// carry the atlas rect after the matrix, so only the 3x3 is compared.
+		float spriteErr = 0.0f;
+		for (size_t iter = 0; iter < count; iter++)
+			spriteErr = std::max(spriteErr, maxError(&spriteRef[iter].model._11, &spriteOut[iter].model._11, 9));
+		const float cubeErr = maxError(&cubeRef[0].model._11, &cubeOut[0].model._11, count * 16);
+		std::cout << std::defaultfloat << "max error: sprite " << spriteErr << ", cube " << cubeErr
+			<< ", matches per-object: " << check(spriteErr < 1e-4f && cubeErr < 1e-4f) << std::endl;
+	}
+}
@@ -1,27 +1,51 @@
 // #pragma pack_matrix(row_major)
 
+struct AtlasRegion {
+	float4 uvRect; // Atlas u, v, width, height
+	uint4 page; // Page in x
+};
+
 cbuffer projBuffer : register(b0) {
 	matrix pers;
 	matrix ortho;
-};
-
-cbuffer cubeModelBuffer : register(b1) {
-	matrix model;
+	float4 meshMin; // Cube mesh bounds, 0 and 1 for unquantized vertices
+	float4 meshScale;
+	AtlasRegion regions[1024]; // Sprite::maxRegions, for compact sprites
 };
 
 Texture2D woodTexView : register(t0);
 Texture2D heartTexView : register(t1);
+Texture2DArray atlasTexView : register(t0); // Sprite atlas pages
 SamplerState texSampler : register(s0);
 
 struct CVSInput {
 	float3 pos : POSITION0;
 	float2 tex : TEXCOORD0;
+	float4x4 model : MODEL0; // Cube-specific
 };
 
 struct VSInput {
 	float2 pos : POSITION0;
 	float2 tex : TEXCOORD0;
 	float3x3 model : MODEL0; // Sprite-specific
+	float4 uvRect : ATLASRECT0; // Atlas u, v, width, height
+	uint page : ATLASPAGE0;
+};
+
+struct CompactVSInput {
+	float2 pos : POSITION0;
+	float2 tex : TEXCOORD0;
+	float2 position : INSTPOS0; // Sprite::CompactInstance
+	float2 scale : INSTSCALE0;
+	float rotation : INSTROTATION0;
+	uint region : INSTREGION0;
+};
+
+struct GlyphInput {
+	float2 pos : GLYPHPOS0;
+	float2 size : GLYPHSIZE0;
+	float2 uv : GLYPHUV0; // Atlas u start and end
+	uint id : SV_VertexID;
 };
 
 struct PSInput {
@@ -29,38 +53,70 @@ struct PSInput {
 	float2 tex : TEXCOORD0;
 };
 
+struct AtlasPSInput {
+	float4 pos : SV_POSITION;
+	float3 tex : TEXCOORD0; // Page in z
+};
+
 // Cube vertex shader entry point
 PSInput cubeVS(CVSInput vert) {
 	float2 UV = vert.tex;
 	UV.y = 1.0 - UV.y;
 
 	PSInput ret = {
-		mul(mul(float4(vert.pos.xyz, 1.0), model), pers),
+		mul(mul(float4(meshMin.xyz + vert.pos * meshScale.xyz, 1.0), vert.model), pers),
 		UV
 	};
 
 	return ret;
 }
 
-// Font vertex shader entry point
-PSInput fontVS(VSInput vert) {
+// Font vertex shader entry point, one glyph instance per quad
+PSInput fontVS(GlyphInput glyph) {
+	// Same corner order the CPU-built quads used
+	const float2 corners[6] = {
+		float2(1.0, 1.0), float2(1.0, 0.0), float2(0.0, 0.0),
+		float2(0.0, 0.0), float2(0.0, 1.0), float2(1.0, 1.0)
+	};
+	float2 corner = corners[glyph.id];
+
 	PSInput ret = {
-		mul(float4(vert.pos.xy, 1.0, 1.0), ortho),
-		vert.tex
+		mul(float4(glyph.pos + corner * glyph.size, 1.0, 1.0), ortho),
+		float2(lerp(glyph.uv.x, glyph.uv.y, corner.x), 1.0 - corner.y)
 	};
 
 	return ret;
 }
 
 // Sprite vertex shader entry point
-PSInput spriteVS(VSInput vert) {
+AtlasPSInput spriteVS(VSInput vert) {
 	float2 UV = vert.tex;
 	UV.y = 1.0 - UV.y;
 
-	PSInput ret = {
+	AtlasPSInput ret = {
 		mul(float4(mul(float3(vert.pos.xy, 1.0), vert.model), 1.0), ortho),
 		// mul(float4(vert.pos, 1.0, 1.0), proj),
-		UV
+		float3(vert.uvRect.xy + UV * vert.uvRect.zw, vert.page)
+	};
+
+	return ret;
+}
+
+// Compact sprite vertex shader entry point, same result as spriteVS
+AtlasPSInput spriteCompactVS(CompactVSInput vert) {
+	float2 UV = vert.tex;
+	UV.y = 1.0 - UV.y;
+
+	float sinRot, cosRot;
+	sincos(vert.rotation, sinRot, cosRot);
+
+	float2 scaled = vert.pos * vert.scale;
+	float2 world = float2(scaled.x * cosRot - scaled.y * sinRot, scaled.x * sinRot + scaled.y * cosRot) + vert.position;
+	AtlasRegion region = regions[vert.region];
+
+	AtlasPSInput ret = {
+		mul(float4(world, 1.0, 1.0), ortho),
+		float3(region.uvRect.xy + UV * region.uvRect.zw, region.page.x)
 	};
 
 	return ret;
@@ -71,6 +127,11 @@ float4 spritePS(PSInput frag) : SV_TARGET {
 	return woodTexView.Sample(texSampler, frag.tex);
 }
 
+// Sprite atlas pixel shader entry point
+float4 atlasPS(AtlasPSInput frag) : SV_TARGET {
+	return atlasTexView.Sample(texSampler, frag.tex);
+}
+
 // Combined pixel shader entrypoint
 float4 combiPS(PSInput frag) : SV_TARGET {
 	float4 wood = woodTexView.Sample(texSampler, frag.tex);
@@ -0,0 +1,59 @@
+#include <arena.h>
+
+#include <bit>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+
+Arena::Linear::Linear(size_t capacity)
+	: _block(std::make_unique<std::byte[]>(capacity)), _capacity(capacity) {}
+
+void* Arena::Linear::allocate(size_t bytes, size_t align) {
+	const size_t first = (_head + align - 1) & ~(align - 1);
+
+	// Where the allocation would end in a block that held the whole frame,
+	// padding included, so the block that reset grows holds the same frame again
+	_used = ((_used + align - 1) & ~(align - 1)) + bytes;
+
+	if (first + bytes <= _capacity) {
+		_head = first + bytes;
+		return _block.get() + first;
+	}
+
+	// new[] is aligned for any fundamental type
+	return _overflow.emplace_back(std::make_unique<std::byte[]>(bytes)).get();
+}
+
+std::string_view Arena::Linear::string(std::string_view text) {
+	if (text.empty()) return {};
+
+	char* data = static_cast<char*>(allocate(text.size(), 1));
+	std::memcpy(data, text.data(), text.size());
+	return { data, text.size() };
+}
+
+void Arena::Linear::reset() {
+	_peak = std::max(_peak, _used);
+
+	if (!_overflow.empty()) {
+		_overflow.clear();
+		_capacity = std::bit_ceil(_peak);
+		_block = std::make_unique<std::byte[]>(_capacity);
+	}
+#ifdef _DEBUG
+	else {
+		std::memset(_block.get(), 0xcd, _head);
+	}
+#endif
+
+	_head = 0;
+	_used = 0;
+}
+
+void Arena::Frames::next() {
+	_current ^= 1;
+	_arenas[_current].reset();
+}
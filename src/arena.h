@@ -0,0 +1,67 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+
+namespace Arena {
+
+	// Bump allocator for data that dies all at once. Allocations that do not
+	// fit get their own heap block until the next reset, which then grows
+	// the main block to the peak, so a steady state never touches the heap.
+	// Debug builds overwrite everything reset drops with 0xcd.
+	struct Linear {
+		static constexpr size_t defaultCapacity = size_t(64) << 10;
+
+		std::unique_ptr<std::byte[]> _block;
+		size_t _capacity = 0;
+		size_t _head = 0;
+		std::vector<std::unique_ptr<std::byte[]>> _overflow;
+
+		size_t _used = 0;       // bytes since the last reset, overflow and alignment padding included
+		size_t _peak = 0;       // most bytes any one reset dropped
+
+		explicit Linear(size_t capacity = defaultCapacity);
+
+		Linear(const Linear&) = delete;
+		Linear& operator=(const Linear&) = delete;
+
+		// `align` at most alignof(std::max_align_t)
+		void* allocate(size_t bytes, size_t align);
+
+		// Uninitialized, for types that need no construction or destruction
+		template<typename T> std::span<T> array(size_t count) {
+			static_assert(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>);
+			if (count == 0) return {};
+
+			return { static_cast<T*>(allocate(count * sizeof(T), alignof(T))), count };
+		}
+
+		// Copy of `text`, valid until the reset
+		std::string_view string(std::string_view text);
+
+		// O(1) unless something overflowed since the last one
+		void reset();
+	};
+
+	// Two arenas taking turns, so what a frame allocated still lives
+	// through the next one
+	struct Frames {
+		std::array<Linear, 2> _arenas;
+		size_t _current = 0;
+
+		Linear& current() { return _arenas[_current]; }
+
+		// Drops what the frame before last allocated and makes its arena current
+		void next();
+
+		// Most bytes a frame allocated so far, this one excluded
+		size_t peak() const { return std::max(_arenas[0]._peak, _arenas[1]._peak); }
+	};
+
+}
@@ -0,0 +1,271 @@
+#include <atlas.h>
+
+#include <span>
+#include <array>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+
+namespace {
+	bool overlaps(const Atlas::Rect& a, const Atlas::Rect& b) {
+		return a.x < b.x + b.width && b.x < a.x + a.width
+			&& a.y < b.y + b.height && b.y < a.y + a.height;
+	}
+
+	bool contains(const Atlas::Rect& outer, const Atlas::Rect& inner) {
+		return inner.x >= outer.x && inner.y >= outer.y
+			&& inner.x + inner.width <= outer.x + outer.width
+			&& inner.y + inner.height <= outer.y + outer.height;
+	}
+
+	uint32_t average(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+		uint32_t ret = 0;
+		for (uint32_t shift = 0; shift < 32; shift += 8) {
+			const uint32_t sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff)
+				+ ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+			ret |= ((sum + 2) / 4) << shift;
+		}
+		return ret;
+	}
+}
+
+// Packer
+
+std::optional<Atlas::Rect> Atlas::Packer::insert(uint32_t width, uint32_t height, uint32_t& page) {
+	const uint32_t pageCells = _settings.pageSize / _settings.alignment;
+	const uint32_t w = cells(width + 2 * _settings.padding);
+	const uint32_t h = cells(height + 2 * _settings.padding);
+
+	if (width == 0 || height == 0 || w > pageCells || h > pageCells) return std::nullopt;
+
+	// First page with room, a new one otherwise
+	Rect placed = {};
+	for (page = 0; page <= _pages.size(); page++) {
+		if (page == _pages.size()) addPage();
+
+		Page& target = _pages[page];
+		const bool fits = (_method == Method::MaxRects)
+			? insertMaxRects(target, w, h, placed)
+			: insertSkyline(target, w, h, placed);
+
+		if (fits) {
+			target.usedCells += static_cast<uint64_t>(w) * h;
+			break;
+		}
+	}
+
+	const uint32_t align = _settings.alignment;
+	return Rect{ placed.x * align, placed.y * align, placed.width * align, placed.height * align };
+}
+
+double Atlas::Packer::occupancy(uint64_t usedTexels) const {
+	if (_pages.empty()) return 0.0;
+
+	const double pageTexels = static_cast<double>(_settings.pageSize) * _settings.pageSize;
+	return static_cast<double>(usedTexels) / (pageTexels * static_cast<double>(_pages.size()));
+}
+
+uint32_t Atlas::Packer::cells(uint32_t texels) const {
+	return (texels + _settings.alignment - 1) / _settings.alignment;
+}
+
+void Atlas::Packer::addPage() {
+	const uint32_t pageCells = _settings.pageSize / _settings.alignment;
+
+	Page page;
+	page.free.push_back({ 0, 0, pageCells, pageCells });
+	page.skyline.push_back({ 0, 0, pageCells });
+	_pages.push_back(std::move(page));
+}
+
+bool Atlas::Packer::insertMaxRects(Page& page, uint32_t width, uint32_t height, Rect& placed) {
+	// Best short side fit, the long side breaks ties
+	uint32_t bestShort = std::numeric_limits<uint32_t>::max();
+	uint32_t bestLong = std::numeric_limits<uint32_t>::max();
+
+	for (auto& free : page.free) {
+		if (free.width < width || free.height < height) continue;
+
+		const uint32_t shortSide = std::min(free.width - width, free.height - height);
+		const uint32_t longSide = std::max(free.width - width, free.height - height);
+
+		if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong)) {
+			placed = { free.x, free.y, width, height };
+			bestShort = shortSide;
+			bestLong = longSide;
+		}
+	}
+
+	if (bestShort == std::numeric_limits<uint32_t>::max()) return false;
+
+	// Every free rect the placement cuts splits into its up to four leftovers
+	std::vector<Rect> kept, split;
+	kept.reserve(page.free.size());
+
+	for (auto& free : page.free) {
+		if (!overlaps(free, placed)) {
+			kept.push_back(free);
+			continue;
+		}
+
+		const uint32_t freeRight = free.x + free.width, freeBottom = free.y + free.height;
+		const uint32_t placedRight = placed.x + placed.width, placedBottom = placed.y + placed.height;
+
+		if (placed.x > free.x) split.push_back({ free.x, free.y, placed.x - free.x, free.height });
+		if (placedRight < freeRight) split.push_back({ placedRight, free.y, freeRight - placedRight, free.height });
+		if (placed.y > free.y) split.push_back({ free.x, free.y, free.width, placed.y - free.y });
+		if (placedBottom < freeBottom) split.push_back({ free.x, placedBottom, free.width, freeBottom - placedBottom });
+	}
+
+	// Only maximal rects stay. Untouched rects already were, so only the
+	// leftovers need checking, against each other and the untouched ones
+	std::vector<bool> removed(split.size(), false);
+	for (size_t idx = 0; idx < split.size(); idx++) {
+		for (size_t other = 0; other < split.size() && !removed[idx]; other++) {
+			if (other != idx && !removed[other] && contains(split[other], split[idx]))
+				removed[idx] = true;
+		}
+
+		for (size_t other = 0; other < kept.size() && !removed[idx]; other++) {
+			if (contains(kept[other], split[idx]))
+				removed[idx] = true;
+		}
+	}
+
+	page.free = std::move(kept);
+	for (size_t idx = 0; idx < split.size(); idx++) {
+		if (!removed[idx]) page.free.push_back(split[idx]);
+	}
+
+	return true;
+}
+
+bool Atlas::Packer::insertSkyline(Page& page, uint32_t width, uint32_t height, Rect& placed) {
+	const uint32_t pageCells = _settings.pageSize / _settings.alignment;
+	auto& skyline = page.skyline;
+
+	// Bottom-left, the lowest top edge wins and the narrower segment breaks ties
+	size_t best = skyline.size();
+	uint32_t bestTop = std::numeric_limits<uint32_t>::max(), bestWidth = 0, bestY = 0;
+
+	for (size_t idx = 0; idx < skyline.size(); idx++) {
+		if (skyline[idx].x + width > pageCells) break;
+
+		uint32_t y = 0, remaining = width;
+		for (size_t seg = idx; remaining > 0; seg++) {
+			y = std::max(y, skyline[seg].y);
+			remaining -= std::min(remaining, skyline[seg].width);
+		}
+
+		if (y + height > pageCells) continue;
+
+		if (y + height < bestTop || (y + height == bestTop && skyline[idx].width < bestWidth)) {
+			best = idx;
+			bestTop = y + height;
+			bestWidth = skyline[idx].width;
+			bestY = y;
+		}
+	}
+
+	if (best == skyline.size()) return false;
+
+	placed = { skyline[best].x, bestY, width, height };
+
+	// The new segment covers whatever it rests on
+	skyline.insert(skyline.begin() + best, { placed.x, bestTop, width });
+
+	const uint32_t right = placed.x + width;
+	for (size_t idx = best + 1; idx < skyline.size() && skyline[idx].x < right;) {
+		const uint32_t covered = right - skyline[idx].x;
+
+		if (skyline[idx].width <= covered) {
+			skyline.erase(skyline.begin() + idx);
+			continue;
+		}
+
+		skyline[idx].x += covered;
+		skyline[idx].width -= covered;
+		break;
+	}
+
+	for (size_t idx = 1; idx < skyline.size();) {
+		if (skyline[idx - 1].y == skyline[idx].y) {
+			skyline[idx - 1].width += skyline[idx].width;
+			skyline.erase(skyline.begin() + idx);
+		}
+		else idx++;
+	}
+
+	return true;
+}
+
+// Builder
+
+std::optional<Atlas::Region> Atlas::Builder::add(uint32_t width, uint32_t height, std::span<const uint32_t> texels) {
+	if (texels.size() < static_cast<size_t>(width) * height) return std::nullopt;
+
+	uint32_t page = 0;
+	auto rect = packer.insert(width, height, page);
+	if (!rect) return std::nullopt;
+
+	const uint32_t size = packer._settings.pageSize;
+	const uint32_t pad = packer._settings.padding;
+
+	if (page >= pages.size())
+		pages.resize(page + 1, std::vector<uint32_t>(static_cast<size_t>(size) * size, 0));
+
+	// Image plus its gutter, the gutter repeats the nearest edge texel
+	auto& dst = pages[page];
+	for (uint32_t y = 0; y < height + 2 * pad; y++) {
+		const uint32_t srcY = std::min(height - 1, (y > pad) ? y - pad : 0);
+		uint32_t* row = dst.data() + static_cast<size_t>(rect->y + y) * size + rect->x;
+
+		for (uint32_t x = 0; x < width + 2 * pad; x++) {
+			const uint32_t srcX = std::min(width - 1, (x > pad) ? x - pad : 0);
+			row[x] = texels[static_cast<size_t>(srcY) * width + srcX];
+		}
+	}
+
+	usedTexels += static_cast<uint64_t>(width) * height;
+
+	const float inv = 1.0f / static_cast<float>(size);
+	return Region{
+		{
+			static_cast<float>(rect->x + pad) * inv, static_cast<float>(rect->y + pad) * inv,
+			static_cast<float>(width) * inv, static_cast<float>(height) * inv,
+		},
+		page,
+	};
+}
+
+uint32_t Atlas::Builder::mipLevels() const {
+	uint32_t levels = 1;
+	for (uint32_t align = packer._settings.alignment; align > 1 && (packer._settings.pageSize >> levels) > 0; align /= 2)
+		levels++;
+
+	return levels;
+}
+
+std::vector<std::vector<uint32_t>> Atlas::Builder::mipChain(uint32_t page) const {
+	std::vector<std::vector<uint32_t>> chain = { pages[page] };
+
+	for (uint32_t level = 1; level < mipLevels(); level++) {
+		const uint32_t size = packer._settings.pageSize >> level;
+		const auto& src = chain.back();
+
+		std::vector<uint32_t> mip(static_cast<size_t>(size) * size);
+		for (uint32_t y = 0; y < size; y++) {
+			const uint32_t* top = src.data() + static_cast<size_t>(y * 2) * size * 2;
+			const uint32_t* bottom = top + size * 2;
+
+			for (uint32_t x = 0; x < size; x++)
+				mip[static_cast<size_t>(y) * size + x] = average(top[x * 2], top[x * 2 + 1], bottom[x * 2], bottom[x * 2 + 1]);
+		}
+
+		chain.push_back(std::move(mip));
+	}
+
+	return chain;
+}
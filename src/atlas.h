@@ -0,0 +1,83 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <optional>
+
+namespace Atlas {
+
+	struct Rect {
+		uint32_t x, y;
+		uint32_t width, height;
+	};
+
+	struct Settings {
+		uint32_t pageSize = 2048;
+		uint32_t padding = 2;       // gutter texels around every image, filled with its edge
+		uint32_t alignment = 4;     // placement grid, a 2^n grid keeps n mips from mixing images
+	};
+
+	enum class Method { MaxRects, Skyline };
+
+	// Places rectangles on as many pages as it takes. Works in cells of
+	// `alignment` texels, so every placement lands on the mip-safe grid.
+	struct Packer {
+		struct Segment {
+			uint32_t x, y, width;
+		};
+
+		struct Page {
+			std::vector<Rect> free;         // MaxRects, maximal free rectangles
+			std::vector<Segment> skyline;   // Skyline, top edge from left to right
+			uint64_t usedCells = 0;
+		};
+
+		Settings _settings;
+		Method _method = Method::MaxRects;
+		std::vector<Page> _pages;
+
+		Packer(Settings settings = {}, Method method = Method::MaxRects)
+			: _settings(settings), _method(method) {}
+
+		// Rect is in texels and includes the padding, nullopt when larger than a page
+		std::optional<Rect> insert(uint32_t width, uint32_t height, uint32_t& page);
+
+		// Used share of the page area, padding and grid rounding count as waste
+		double occupancy(uint64_t usedTexels) const;
+
+		void clear() { _pages.clear(); }
+
+	private:
+		uint32_t cells(uint32_t texels) const;
+		void addPage();
+
+		bool insertMaxRects(Page& page, uint32_t width, uint32_t height, Rect& placed);
+		bool insertSkyline(Page& page, uint32_t width, uint32_t height, Rect& placed);
+	};
+
+	// Where one image ended up, uvRect is u, v, width, height in page space
+	struct Region {
+		std::array<float, 4> uvRect;
+		uint32_t page;
+	};
+
+	// Packs RGBA8 images into pages and builds their mip chains
+	struct Builder {
+		Packer packer;
+		std::vector<std::vector<uint32_t>> pages;   // mip 0 texels per page
+		uint64_t usedTexels = 0;
+
+		Builder(Settings settings = {}, Method method = Method::MaxRects) : packer(settings, method) {}
+
+		std::optional<Region> add(uint32_t width, uint32_t height, std::span<const uint32_t> texels);
+
+		// Mips that stay inside each image's cells, log2(alignment) + 1
+		uint32_t mipLevels() const;
+
+		// Box-filtered mips of one page, index 0 is the page itself
+		std::vector<std::vector<uint32_t>> mipChain(uint32_t page) const;
+	};
+
+}
@@ -0,0 +1,405 @@
+#include <backend.h>
+
+#ifdef _WIN32
+#include <d3d11.h>
+#include <dxgi.h>
+#include <DX.h>
+#endif
+
+#include <array>
+#include <vector>
+#include <algorithm>
+
+#define HR(fn) DX::ThrowIfFailed(fn, __FILE__, __LINE__, __func__)
+
+Backend::FrameStats& Backend::FrameStats::operator+=(const FrameStats& other) {
+	maps += other.maps;
+	unmaps += other.unmaps;
+	discards += other.discards;
+	updates += other.updates;
+	bytesUploaded += other.bytesUploaded;
+	binds += other.binds;
+	bindsSkipped += other.bindsSkipped;
+	clears += other.clears;
+	draws += other.draws;
+	drawIndexed += other.drawIndexed;
+	drawInstanced += other.drawInstanced;
+	drawIndexedInstanced += other.drawIndexedInstanced;
+	instances += other.instances;
+	triangles += other.triangles;
+	return *this;
+}
+
+// Context
+
+void Backend::Context::beginFrame() {
+	stats = {};
+	_known = 0;
+}
+
+void* Backend::Context::map(Buffer* buf, MapType type, size_t bytes, size_t offset) {
+	stats.maps++;
+	stats.discards += (type == MapType::WriteDiscard) ? 1 : 0;
+	stats.bytesUploaded += bytes;
+	return doMap(buf, type, offset + bytes);
+}
+
+void Backend::Context::unmap(Buffer* buf) {
+	stats.unmaps++;
+	doUnmap(buf);
+}
+
+void Backend::Context::update(Buffer* buf, size_t offset, size_t bytes, const void* data) {
+	stats.updates++;
+	stats.bytesUploaded += bytes;
+	doUpdate(buf, offset, bytes, data);
+}
+
+bool Backend::Context::redundant(Slot slot, bool same) {
+	if ((_known & slot) && same) {
+		stats.bindsSkipped++;
+		return true;
+	}
+
+	stats.binds++;
+	_known |= slot;
+	return false;
+}
+
+void Backend::Context::setInputLayout(InputLayout* layout) {
+	if (redundant(InputLayoutSlot, _bound.layout == layout)) return;
+
+	_bound.layout = layout;
+	doSetInputLayout(layout);
+}
+
+void Backend::Context::setVertexBuffers(unsigned int count, Buffer* const* bufs,
+		const unsigned int* strides, const unsigned int* offsets) {
+	bool same = (count == _bound.vertexBufferCount);
+	for (unsigned int idx = 0; same && idx < count; idx++) {
+		same = _bound.vertexBuffers[idx] == bufs[idx]
+			&& _bound.strides[idx] == strides[idx] && _bound.offsets[idx] == offsets[idx];
+	}
+
+	if (redundant(VertexBufferSlot, same)) return;
+
+	// More buffers than the cache holds are bound blind
+	if (count > _bound.vertexBuffers.size()) {
+		_known &= ~VertexBufferSlot;
+	}
+	else {
+		_bound.vertexBufferCount = count;
+		std::copy_n(bufs, count, _bound.vertexBuffers.begin());
+		std::copy_n(strides, count, _bound.strides.begin());
+		std::copy_n(offsets, count, _bound.offsets.begin());
+	}
+
+	doSetVertexBuffers(count, bufs, strides, offsets);
+}
+
+void Backend::Context::setIndexBuffer(Buffer* buf, IndexFormat format) {
+	if (redundant(IndexBufferSlot, _bound.indexBuffer == buf && _bound.indexFormat == format)) return;
+
+	_bound.indexBuffer = buf;
+	_bound.indexFormat = format;
+	doSetIndexBuffer(buf, format);
+}
+
+void Backend::Context::setTopology(Topology topology) {
+	if (redundant(TopologySlot, _bound.topology == topology)) return;
+
+	_bound.topology = topology;
+	doSetTopology(topology);
+}
+
+void Backend::Context::setVS(VertexShader* shader) {
+	if (redundant(VSSlot, _bound.vs == shader)) return;
+
+	_bound.vs = shader;
+	doSetVS(shader);
+}
+
+void Backend::Context::setVSConstantBuffers(unsigned int count, Buffer* const* bufs) {
+	if (redundant(VSConstantSlot, count == 1 && _bound.vsConstants == bufs[0])) return;
+
+	// Only slot 0 is cached
+	_bound.vsConstants = bufs[0];
+	if (count != 1) _known &= ~VSConstantSlot;
+
+	doSetVSConstantBuffers(count, bufs);
+}
+
+void Backend::Context::setViewport(const Viewport& viewport) {
+	if (redundant(ViewportSlot, _bound.viewport == viewport)) return;
+
+	_bound.viewport = viewport;
+	doSetViewport(viewport);
+}
+
+void Backend::Context::setPS(PixelShader* shader) {
+	if (redundant(PSSlot, _bound.ps == shader)) return;
+
+	_bound.ps = shader;
+	doSetPS(shader);
+}
+
+void Backend::Context::setPSResources(unsigned int count, ShaderResource* const* views) {
+	bool same = (count == _bound.resourceCount);
+	for (unsigned int idx = 0; same && idx < count; idx++)
+		same = _bound.resources[idx] == views[idx];
+
+	if (redundant(PSResourceSlot, same)) return;
+
+	if (count > _bound.resources.size()) {
+		_known &= ~PSResourceSlot;
+	}
+	else {
+		_bound.resourceCount = count;
+		std::copy_n(views, count, _bound.resources.begin());
+	}
+
+	doSetPSResources(count, views);
+}
+
+void Backend::Context::setPSSampler(Sampler* sampler) {
+	if (redundant(PSSamplerSlot, _bound.sampler == sampler)) return;
+
+	_bound.sampler = sampler;
+	doSetPSSampler(sampler);
+}
+
+void Backend::Context::setRenderTarget(RenderTarget* target, DepthTarget* depth) {
+	if (redundant(RenderTargetSlot, _bound.target == target && _bound.depth == depth)) return;
+
+	_bound.target = target;
+	_bound.depth = depth;
+	doSetRenderTarget(target, depth);
+}
+
+void Backend::Context::setBlendState(BlendState* state) {
+	if (redundant(BlendSlot, _bound.blend == state)) return;
+
+	_bound.blend = state;
+	doSetBlendState(state);
+}
+
+void Backend::Context::bind(const Pipeline& pipeline) {
+	setInputLayout(pipeline.layout);
+	if (pipeline.vertexBufferCount > 0)
+		setVertexBuffers(pipeline.vertexBufferCount, pipeline.vertexBuffers.data(),
+			pipeline.strides.data(), pipeline.offsets.data());
+	if (pipeline.indexBuffer != nullptr)
+		setIndexBuffer(pipeline.indexBuffer, pipeline.indexFormat);
+	setTopology(pipeline.topology);
+
+	setVS(pipeline.vs);
+	setVSConstantBuffers(1, &pipeline.vsConstants);
+	setViewport(pipeline.viewport);
+
+	setPS(pipeline.ps);
+	if (pipeline.resourceCount > 0)
+		setPSResources(pipeline.resourceCount, pipeline.resources.data());
+	setPSSampler(pipeline.sampler);
+
+	setRenderTarget(pipeline.target, pipeline.depth);
+	setBlendState(pipeline.blend);
+}
+
+void Backend::Context::clear(RenderTarget* target, const std::array<float, 4>& color) {
+	stats.clears++;
+	doClear(target, color);
+}
+
+void Backend::Context::clearDepth(DepthTarget* depth) {
+	stats.clears++;
+	doClearDepth(depth);
+}
+
+void Backend::Context::draw(unsigned int vertices, unsigned int first) {
+	stats.draws++;
+	stats.triangles += vertices / 3;
+	doDraw(vertices, first);
+}
+
+void Backend::Context::drawIndexed(unsigned int indices, unsigned int first, int base) {
+	stats.drawIndexed++;
+	stats.triangles += indices / 3;
+	doDrawIndexed(indices, first, base);
+}
+
+void Backend::Context::drawInstanced(unsigned int vertices, unsigned int instances,
+		unsigned int first, unsigned int firstInstance) {
+	stats.drawInstanced++;
+	stats.instances += instances;
+	stats.triangles += size_t(vertices / 3) * instances;
+	doDrawInstanced(vertices, instances, first, firstInstance);
+}
+
+void Backend::Context::drawIndexedInstanced(unsigned int indices, unsigned int instances,
+		unsigned int first, int base, unsigned int firstInstance) {
+	stats.drawIndexedInstanced++;
+	stats.instances += instances;
+	stats.triangles += size_t(indices / 3) * instances;
+	doDrawIndexedInstanced(indices, instances, first, base, firstInstance);
+}
+
+void Backend::Context::present() {
+	doPresent();
+}
+
+// D3D11Context
+
+#ifdef _WIN32
+namespace {
+	// Handles come from Backend::handle, these undo its casts
+	ID3D11Buffer* d3d(Backend::Buffer* obj) { return reinterpret_cast<ID3D11Buffer*>(obj); }
+	ID3D11Buffer* const* d3d(Backend::Buffer* const* objs) { return reinterpret_cast<ID3D11Buffer* const*>(objs); }
+	ID3D11InputLayout* d3d(Backend::InputLayout* obj) { return reinterpret_cast<ID3D11InputLayout*>(obj); }
+	ID3D11VertexShader* d3d(Backend::VertexShader* obj) { return reinterpret_cast<ID3D11VertexShader*>(obj); }
+	ID3D11PixelShader* d3d(Backend::PixelShader* obj) { return reinterpret_cast<ID3D11PixelShader*>(obj); }
+	ID3D11ShaderResourceView* const* d3d(Backend::ShaderResource* const* objs) { return reinterpret_cast<ID3D11ShaderResourceView* const*>(objs); }
+	ID3D11SamplerState* d3d(Backend::Sampler* obj) { return reinterpret_cast<ID3D11SamplerState*>(obj); }
+	ID3D11RenderTargetView* d3d(Backend::RenderTarget* obj) { return reinterpret_cast<ID3D11RenderTargetView*>(obj); }
+	ID3D11DepthStencilView* d3d(Backend::DepthTarget* obj) { return reinterpret_cast<ID3D11DepthStencilView*>(obj); }
+	ID3D11BlendState* d3d(Backend::BlendState* obj) { return reinterpret_cast<ID3D11BlendState*>(obj); }
+
+	D3D11_MAP d3d(Backend::MapType type) {
+		return (type == Backend::MapType::WriteDiscard) ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	}
+
+	DXGI_FORMAT d3d(Backend::IndexFormat format) {
+		switch (format) {
+		case Backend::IndexFormat::UInt16: return DXGI_FORMAT_R16_UINT;
+		case Backend::IndexFormat::UInt32: return DXGI_FORMAT_R32_UINT;
+		default: return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
+	D3D11_PRIMITIVE_TOPOLOGY d3d(Backend::Topology) {
+		return D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	}
+}
+
+void* Backend::D3D11Context::doMap(Buffer* buf, MapType type, size_t) {
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	HR(_context->Map(d3d(buf), 0, d3d(type), 0, &mapped));
+	return mapped.pData;
+}
+
+void Backend::D3D11Context::doUnmap(Buffer* buf) {
+	_context->Unmap(d3d(buf), 0);
+}
+
+void Backend::D3D11Context::doUpdate(Buffer* buf, size_t offset, size_t bytes, const void* data) {
+	D3D11_BOX box = {
+		.left = static_cast<unsigned int>(offset),
+		.top = 0,
+		.front = 0,
+		.right = static_cast<unsigned int>(offset + bytes),
+		.bottom = 1,
+		.back = 1,
+	};
+
+	_context->UpdateSubresource(d3d(buf), 0, &box, data, 0, 0);
+}
+
+void Backend::D3D11Context::doSetInputLayout(InputLayout* layout) {
+	_context->IASetInputLayout(d3d(layout));
+}
+
+void Backend::D3D11Context::doSetVertexBuffers(unsigned int count, Buffer* const* bufs,
+		const unsigned int* strides, const unsigned int* offsets) {
+	_context->IASetVertexBuffers(0, count, d3d(bufs), strides, offsets);
+}
+
+void Backend::D3D11Context::doSetIndexBuffer(Buffer* buf, IndexFormat format) {
+	_context->IASetIndexBuffer(d3d(buf), d3d(format), 0);
+}
+
+void Backend::D3D11Context::doSetTopology(Topology topology) {
+	_context->IASetPrimitiveTopology(d3d(topology));
+}
+
+void Backend::D3D11Context::doSetVS(VertexShader* shader) {
+	_context->VSSetShader(d3d(shader), 0, 0);
+}
+
+void Backend::D3D11Context::doSetVSConstantBuffers(unsigned int count, Buffer* const* bufs) {
+	_context->VSSetConstantBuffers(0, count, d3d(bufs));
+}
+
+void Backend::D3D11Context::doSetViewport(const Viewport& viewport) {
+	const D3D11_VIEWPORT d3dViewport = {
+		.TopLeftX = viewport.x,
+		.TopLeftY = viewport.y,
+		.Width = viewport.width,
+		.Height = viewport.height,
+		.MinDepth = viewport.minDepth,
+		.MaxDepth = viewport.maxDepth,
+	};
+
+	_context->RSSetViewports(1, &d3dViewport);
+}
+
+void Backend::D3D11Context::doSetPS(PixelShader* shader) {
+	_context->PSSetShader(d3d(shader), 0, 0);
+}
+
+void Backend::D3D11Context::doSetPSResources(unsigned int count, ShaderResource* const* views) {
+	_context->PSSetShaderResources(0, count, d3d(views));
+}
+
+void Backend::D3D11Context::doSetPSSampler(Sampler* sampler) {
+	ID3D11SamplerState* state = d3d(sampler);
+	_context->PSSetSamplers(0, 1, &state);
+}
+
+void Backend::D3D11Context::doSetRenderTarget(RenderTarget* target, DepthTarget* depth) {
+	ID3D11RenderTargetView* view = d3d(target);
+	_context->OMSetRenderTargets(1, &view, d3d(depth));
+}
+
+void Backend::D3D11Context::doSetBlendState(BlendState* state) {
+	_context->OMSetBlendState(d3d(state), nullptr, 0xFFFFFFFF);
+}
+
+void Backend::D3D11Context::doClear(RenderTarget* target, const std::array<float, 4>& color) {
+	_context->ClearRenderTargetView(d3d(target), color.data());
+}
+
+void Backend::D3D11Context::doClearDepth(DepthTarget* depth) {
+	_context->ClearDepthStencilView(d3d(depth), D3D11_CLEAR_DEPTH, 1.0f, 0);
+}
+
+void Backend::D3D11Context::doDraw(unsigned int vertices, unsigned int first) {
+	_context->Draw(vertices, first);
+}
+
+void Backend::D3D11Context::doDrawIndexed(unsigned int indices, unsigned int first, int base) {
+	_context->DrawIndexed(indices, first, base);
+}
+
+void Backend::D3D11Context::doDrawInstanced(unsigned int vertices, unsigned int instances,
+		unsigned int first, unsigned int firstInstance) {
+	_context->DrawInstanced(vertices, instances, first, firstInstance);
+}
+
+void Backend::D3D11Context::doDrawIndexedInstanced(unsigned int indices, unsigned int instances,
+		unsigned int first, int base, unsigned int firstInstance) {
+	_context->DrawIndexedInstanced(indices, instances, first, base, firstInstance);
+}
+
+void Backend::D3D11Context::doPresent() {
+	_swapChain->Present(1, 0);
+}
+#endif
+
+// NullContext
+
+void* Backend::NullContext::doMap(Buffer* buf, MapType, size_t end) {
+	auto& mem = _scratch[buf];
+	if (mem.size() < end)
+		mem.resize(end);
+
+	return mem.data();
+}
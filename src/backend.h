@@ -0,0 +1,261 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+// D3D11Context is the only part that knows these, and only as pointers
+struct ID3D11DeviceContext;
+struct IDXGISwapChain;
+struct ID3D11Buffer;
+struct ID3D11InputLayout;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+struct ID3D11BlendState;
+
+namespace Backend {
+
+	// Opaque handles to objects the renderer created on its device. Only
+	// compared and passed through, the D3D11 context casts them back.
+	struct Buffer;
+	struct InputLayout;
+	struct VertexShader;
+	struct PixelShader;
+	struct ShaderResource;
+	struct Sampler;
+	struct RenderTarget;
+	struct DepthTarget;
+	struct BlendState;
+
+	enum class MapType : uint8_t { WriteDiscard, WriteNoOverwrite };
+	enum class IndexFormat : uint8_t { Unknown, UInt16, UInt32 };
+	enum class Topology : uint8_t { TriangleList };
+
+	struct Viewport {
+		float x = 0.0f, y = 0.0f;
+		float width = 0.0f, height = 0.0f;
+		float minDepth = 0.0f, maxDepth = 1.0f;
+
+		bool operator==(const Viewport&) const = default;
+	};
+
+	struct FrameStats {
+		size_t maps = 0;
+		size_t unmaps = 0;
+		size_t discards = 0;
+		size_t updates = 0;
+		size_t bytesUploaded = 0;
+		size_t binds = 0;
+		size_t bindsSkipped = 0;    // matched what was already bound
+		size_t clears = 0;
+		size_t draws = 0;
+		size_t drawIndexed = 0;
+		size_t drawInstanced = 0;
+		size_t drawIndexedInstanced = 0;
+		size_t instances = 0;
+		size_t triangles = 0;       // every draw is a triangle list
+
+		size_t drawCalls() const {
+			return draws + drawIndexed + drawInstanced + drawIndexedInstanced;
+		}
+
+		FrameStats& operator+=(const FrameStats& other);
+	};
+
+	// Everything a draw binds, empty buffer and resource slots are left alone
+	struct Pipeline {
+		InputLayout* layout = nullptr;
+		unsigned int vertexBufferCount = 0;
+		std::array<Buffer*, 2> vertexBuffers = {};
+		std::array<unsigned int, 2> strides = {};
+		std::array<unsigned int, 2> offsets = {};
+		Buffer* indexBuffer = nullptr;
+		IndexFormat indexFormat = IndexFormat::Unknown;
+		Topology topology = Topology::TriangleList;
+
+		VertexShader* vs = nullptr;
+		Buffer* vsConstants = nullptr;
+		Viewport viewport = {};
+		PixelShader* ps = nullptr;
+		unsigned int resourceCount = 0;
+		std::array<ShaderResource*, 2> resources = {};
+		Sampler* sampler = nullptr;
+
+		RenderTarget* target = nullptr;
+		DepthTarget* depth = nullptr;
+		BlendState* blend = nullptr;
+	};
+
+	// Thin layer over a device context used by every render* call.
+	// Public calls record into `stats`, the virtual do* calls do the work.
+	// Binds that match the cached state are dropped before reaching do*.
+	struct Context {
+		FrameStats stats;
+
+		virtual ~Context() = default;
+
+		// Also forgets the cached state, views may be replaced between frames
+		void beginFrame();
+
+		// Returns the start of the buffer, the caller writes `bytes` at `offset`
+		void* map(Buffer* buf, MapType type, size_t bytes, size_t offset = 0);
+		void unmap(Buffer* buf);
+		void update(Buffer* buf, size_t offset, size_t bytes, const void* data);
+
+		void setInputLayout(InputLayout* layout);
+		void setVertexBuffers(unsigned int count, Buffer* const* bufs,
+			const unsigned int* strides, const unsigned int* offsets);
+		void setIndexBuffer(Buffer* buf, IndexFormat format);
+		void setTopology(Topology topology);
+
+		void setVS(VertexShader* shader);
+		void setVSConstantBuffers(unsigned int count, Buffer* const* bufs);
+		void setViewport(const Viewport& viewport);
+		void setPS(PixelShader* shader);
+		void setPSResources(unsigned int count, ShaderResource* const* views);
+		void setPSSampler(Sampler* sampler);
+
+		void setRenderTarget(RenderTarget* target, DepthTarget* depth);
+		void setBlendState(BlendState* state);
+
+		// Every set* call the pipeline needs, redundant ones are skipped
+		void bind(const Pipeline& pipeline);
+
+		void clear(RenderTarget* target, const std::array<float, 4>& color);
+		void clearDepth(DepthTarget* depth);
+
+		void draw(unsigned int vertices, unsigned int first);
+		void drawIndexed(unsigned int indices, unsigned int first, int base);
+		void drawInstanced(unsigned int vertices, unsigned int instances,
+			unsigned int first, unsigned int firstInstance);
+		void drawIndexedInstanced(unsigned int indices, unsigned int instances,
+			unsigned int first, int base, unsigned int firstInstance);
+
+		void present();
+
+	protected:
+		enum Slot : uint32_t {
+			InputLayoutSlot = 1 << 0,
+			VertexBufferSlot = 1 << 1,
+			IndexBufferSlot = 1 << 2,
+			TopologySlot = 1 << 3,
+			VSSlot = 1 << 4,
+			VSConstantSlot = 1 << 5,
+			ViewportSlot = 1 << 6,
+			PSSlot = 1 << 7,
+			PSResourceSlot = 1 << 8,
+			PSSamplerSlot = 1 << 9,
+			RenderTargetSlot = 1 << 10,
+			BlendSlot = 1 << 11,
+		};
+
+		// Last state handed to do*, only the slots in _known are trustworthy
+		Pipeline _bound;
+		uint32_t _known = 0;
+
+		// Counts the bind, true when `slot` already holds the same state
+		bool redundant(Slot slot, bool same);
+
+		virtual void* doMap(Buffer*, MapType, size_t) = 0;
+		virtual void doUnmap(Buffer*) = 0;
+		virtual void doUpdate(Buffer*, size_t, size_t, const void*) {}
+
+		virtual void doSetInputLayout(InputLayout*) {}
+		virtual void doSetVertexBuffers(unsigned int, Buffer* const*,
+			const unsigned int*, const unsigned int*) {}
+		virtual void doSetIndexBuffer(Buffer*, IndexFormat) {}
+		virtual void doSetTopology(Topology) {}
+
+		virtual void doSetVS(VertexShader*) {}
+		virtual void doSetVSConstantBuffers(unsigned int, Buffer* const*) {}
+		virtual void doSetViewport(const Viewport&) {}
+		virtual void doSetPS(PixelShader*) {}
+		virtual void doSetPSResources(unsigned int, ShaderResource* const*) {}
+		virtual void doSetPSSampler(Sampler*) {}
+
+		virtual void doSetRenderTarget(RenderTarget*, DepthTarget*) {}
+		virtual void doSetBlendState(BlendState*) {}
+
+		virtual void doClear(RenderTarget*, const std::array<float, 4>&) {}
+		virtual void doClearDepth(DepthTarget*) {}
+
+		virtual void doDraw(unsigned int, unsigned int) {}
+		virtual void doDrawIndexed(unsigned int, unsigned int, int) {}
+		virtual void doDrawInstanced(unsigned int, unsigned int, unsigned int, unsigned int) {}
+		virtual void doDrawIndexedInstanced(unsigned int, unsigned int,
+			unsigned int, int, unsigned int) {}
+
+		virtual void doPresent() {}
+	};
+
+	// Forwards everything to a live device context and swap chain.
+	// Does not own either of them, D3DRenderer retires both. Only built
+	// on Windows, the rest of Backend builds anywhere.
+	struct D3D11Context : Context {
+		ID3D11DeviceContext* _context = nullptr;
+		IDXGISwapChain* _swapChain = nullptr;
+
+		D3D11Context(ID3D11DeviceContext* _ctx, IDXGISwapChain* _swap)
+			: _context(_ctx), _swapChain(_swap) {}
+
+	protected:
+		void* doMap(Buffer*, MapType, size_t) override;
+		void doUnmap(Buffer*) override;
+		void doUpdate(Buffer*, size_t, size_t, const void*) override;
+
+		void doSetInputLayout(InputLayout*) override;
+		void doSetVertexBuffers(unsigned int, Buffer* const*,
+			const unsigned int*, const unsigned int*) override;
+		void doSetIndexBuffer(Buffer*, IndexFormat) override;
+		void doSetTopology(Topology) override;
+
+		void doSetVS(VertexShader*) override;
+		void doSetVSConstantBuffers(unsigned int, Buffer* const*) override;
+		void doSetViewport(const Viewport&) override;
+		void doSetPS(PixelShader*) override;
+		void doSetPSResources(unsigned int, ShaderResource* const*) override;
+		void doSetPSSampler(Sampler*) override;
+
+		void doSetRenderTarget(RenderTarget*, DepthTarget*) override;
+		void doSetBlendState(BlendState*) override;
+
+		void doClear(RenderTarget*, const std::array<float, 4>&) override;
+		void doClearDepth(DepthTarget*) override;
+
+		void doDraw(unsigned int, unsigned int) override;
+		void doDrawIndexed(unsigned int, unsigned int, int) override;
+		void doDrawInstanced(unsigned int, unsigned int, unsigned int, unsigned int) override;
+		void doDrawIndexedInstanced(unsigned int, unsigned int,
+			unsigned int, int, unsigned int) override;
+
+		void doPresent() override;
+	};
+
+	// D3D11 objects as handles, the casts D3D11Context undoes
+	inline Buffer* handle(ID3D11Buffer* obj) { return reinterpret_cast<Buffer*>(obj); }
+	inline InputLayout* handle(ID3D11InputLayout* obj) { return reinterpret_cast<InputLayout*>(obj); }
+	inline VertexShader* handle(ID3D11VertexShader* obj) { return reinterpret_cast<VertexShader*>(obj); }
+	inline PixelShader* handle(ID3D11PixelShader* obj) { return reinterpret_cast<PixelShader*>(obj); }
+	inline ShaderResource* handle(ID3D11ShaderResourceView* obj) { return reinterpret_cast<ShaderResource*>(obj); }
+	inline Sampler* handle(ID3D11SamplerState* obj) { return reinterpret_cast<Sampler*>(obj); }
+	inline RenderTarget* handle(ID3D11RenderTargetView* obj) { return reinterpret_cast<RenderTarget*>(obj); }
+	inline DepthTarget* handle(ID3D11DepthStencilView* obj) { return reinterpret_cast<DepthTarget*>(obj); }
+	inline BlendState* handle(ID3D11BlendState* obj) { return reinterpret_cast<BlendState*>(obj); }
+
+	// Headless context, no device required. Maps hand out CPU scratch
+	// memory per buffer so the upload path still writes real bytes.
+	struct NullContext : Context {
+		std::unordered_map<Buffer*, std::vector<unsigned char>> _scratch;
+
+	protected:
+		void* doMap(Buffer*, MapType, size_t) override;
+		void doUnmap(Buffer*) override {}
+	};
+
+}
@@ -0,0 +1,39 @@
+#include <commandlist.h>
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+size_t Command::Stream::size() const {
+	size_t count = 0;
+	for (auto& list : _lists) count += list._count;
+
+	return count;
+}
+
+void Command::Stream::clear() {
+	for (auto& list : _lists) list.clear();
+
+	_commands.clear();
+	_queue.clear();
+}
+
+void Command::Stream::merge() {
+	_commands.clear();
+	_queue.clear();
+
+	for (auto& list : _lists) {
+		const std::byte* at = list._data.data();
+		const std::byte* end = at + list._data.size();
+
+		while (at < end) {
+			Header header;
+			std::memcpy(&header, at, sizeof(Header));
+
+			_queue.submit(header.key, static_cast<uint32_t>(_commands.size()));
+			_commands.push_back(at);
+			at += List::padded(sizeof(Header)) + List::padded(header.size);
+		}
+	}
+}
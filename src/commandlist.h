@@ -0,0 +1,96 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <renderqueue.h>
+
+namespace Command {
+
+	// Commands one thread recorded. Packets are any trivially copyable type,
+	// stored back to back behind their header, so a warm list never allocates.
+	// Nothing here knows about D3D, the replay callback decides what an op means.
+	struct List {
+		struct Header {
+			uint64_t key;
+			uint32_t op;
+			uint32_t size;      // packet bytes, padding excluded
+		};
+
+		static constexpr size_t align = alignof(std::max_align_t);
+
+		std::vector<std::byte> _data;
+		size_t _count = 0;
+
+		template<typename T> void record(uint64_t key, uint32_t op, const T& packet) {
+			static_assert(std::is_trivially_copyable_v<T>, "packets are copied as bytes");
+
+			const Header header = { key, op, static_cast<uint32_t>(sizeof(T)) };
+			const size_t at = _data.size();
+			_data.resize(at + padded(sizeof(Header)) + padded(sizeof(T)));
+
+			std::memcpy(_data.data() + at, &header, sizeof(Header));
+			std::memcpy(_data.data() + at + padded(sizeof(Header)), &packet, sizeof(T));
+			_count++;
+		}
+
+		void clear() {
+			_data.clear();
+			_count = 0;
+		}
+
+		static constexpr size_t padded(size_t bytes) { return (bytes + align - 1) / align * align; }
+	};
+
+	// Reads a packet back, `bytes` is what replay hands the callback
+	template<typename T> T packet(std::span<const std::byte> bytes) {
+		T ret;
+		std::memcpy(&ret, bytes.data(), sizeof(T));
+		return ret;
+	}
+
+	// Per-thread lists merged into one frame. Lists are walked in index order
+	// and the merge is sorted stably by key, so the replay order only depends
+	// on what went into which list, never on how the recording threads ran.
+	struct Stream {
+		std::vector<List> _lists;
+		std::vector<const std::byte*> _commands;
+		Render::Queue _queue;
+
+		// Makes sure lists [0, count) exist, recording threads each take their own
+		void reserve(size_t count) {
+			if (_lists.size() < count) _lists.resize(count);
+		}
+
+		List& list(size_t idx) {
+			reserve(idx + 1);
+			return _lists[idx];
+		}
+
+		size_t size() const;
+		void clear();
+
+		// Calls fn(header, packet bytes) for every command, in key order
+		template<typename Fn> void replay(Fn&& fn) {
+			merge();
+
+			for (auto& item : _queue.sort()) {
+				Header header;
+				const std::byte* at = _commands[item.draw];
+				std::memcpy(&header, at, sizeof(Header));
+
+				fn(header, std::span<const std::byte>(at + List::padded(sizeof(Header)), header.size));
+			}
+		}
+
+	private:
+		using Header = List::Header;
+
+		void merge();
+	};
+
+}
@@ -2,7 +2,54 @@
 
 #include <DirectXMath.h>
 
-DirectX::XMFLOAT4X4 Cube::Data::getWorldMatrix() {
+#include <span>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+const std::array<Cube::Vertex, 24> Cube::vertices = {
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, 1.0f, -1.0f), DirectX::XMFLOAT2(0.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, 1.0f, -1.0f), DirectX::XMFLOAT2(1.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f), DirectX::XMFLOAT2(1.0f, 1.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, 1.0f, 1.0f), DirectX::XMFLOAT2(0.0f, 1.0f) },
+
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, -1.0f, -1.0f), DirectX::XMFLOAT2(0.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, -1.0f, -1.0f), DirectX::XMFLOAT2(1.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, -1.0f, 1.0f), DirectX::XMFLOAT2(1.0f, 1.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, -1.0f, 1.0f), DirectX::XMFLOAT2(0.0f, 1.0f) },
+
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, -1.0f, 1.0f), DirectX::XMFLOAT2(0.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, -1.0f, -1.0f), DirectX::XMFLOAT2(1.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, 1.0f, -1.0f), DirectX::XMFLOAT2(1.0f, 1.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, 1.0f, 1.0f), DirectX::XMFLOAT2(0.0f, 1.0f) },
+
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, -1.0f, 1.0f), DirectX::XMFLOAT2(0.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, -1.0f, -1.0f), DirectX::XMFLOAT2(1.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, 1.0f, -1.0f), DirectX::XMFLOAT2(1.0f, 1.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f), DirectX::XMFLOAT2(0.0f, 1.0f) },
+
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, -1.0f, -1.0f), DirectX::XMFLOAT2(0.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, -1.0f, -1.0f), DirectX::XMFLOAT2(1.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, 1.0f, -1.0f), DirectX::XMFLOAT2(1.0f, 1.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, 1.0f, -1.0f), DirectX::XMFLOAT2(0.0f, 1.0f) },
+
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, -1.0f, 1.0f), DirectX::XMFLOAT2(0.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, -1.0f, 1.0f), DirectX::XMFLOAT2(1.0f, 0.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f), DirectX::XMFLOAT2(1.0f, 1.0f) },
+	Cube::Vertex { DirectX::XMFLOAT3(-1.0f, 1.0f, 1.0f), DirectX::XMFLOAT2(0.0f, 1.0f) },
+};
+
+const std::array<uint16_t, 36> Cube::indices = {
+	3, 1, 0, 2, 1, 3,
+	6, 4, 5, 7, 4, 6,
+	11, 9, 8, 10, 9, 11,
+	14, 12, 13, 15, 12, 14,
+	19, 17, 16, 18, 17, 19,
+	22, 20, 21, 23, 20, 22
+};
+
+DirectX::XMFLOAT4X4 Cube::Data::getWorldMatrix() const {
 	DirectX::XMVECTOR translateVec = DirectX::XMLoadFloat3(&_position);
 	DirectX::XMMATRIX translate = DirectX::XMMatrixTranslationFromVector(translateVec);
 
@@ -22,6 +69,253 @@ DirectX::XMFLOAT4X4 Cube::Data::getWorldMatrix() {
 	return ret;
 }
 
+namespace {
+
+	// Kernel behind both getWorldMatrices, `indices` may be null
+	void buildInstances(Cube::Columns cubes, const uint32_t* indices, size_t count, Cube::Instance* out) {
+		using namespace DirectX;
+
+		if (count == 0) return;
+
+		// Short batches repeat their last cube in the unused lanes
+		auto lane = [&](size_t idx) -> size_t {
+			idx = std::min(idx, count - 1);
+			return (indices != nullptr) ? indices[idx] : idx;
+		};
+
+		const Cube::Rotation* rot = cubes.rotation.data();
+		const Cube::Scale* scl = cubes.scale.data();
+
+		for (size_t first = 0; first < count; first += 4) {
+			const size_t c0 = lane(first), c1 = lane(first + 1), c2 = lane(first + 2), c3 = lane(first + 3);
+
+			// Roll, pitch, yaw sines and cosines for all four lanes at once
+			XMVECTOR sp, cp, sy, cy, sr, cr;
+			XMVectorSinCos(&sp, &cp, XMVectorSet(rot[c0].x, rot[c1].x, rot[c2].x, rot[c3].x));
+			XMVectorSinCos(&sy, &cy, XMVectorSet(rot[c0].y, rot[c1].y, rot[c2].y, rot[c3].y));
+			XMVectorSinCos(&sr, &cr, XMVectorSet(rot[c0].z, rot[c1].z, rot[c2].z, rot[c3].z));
+
+			XMVECTOR sclX = XMVectorSet(scl[c0].x, scl[c1].x, scl[c2].x, scl[c3].x);
+			XMVECTOR sclY = XMVectorSet(scl[c0].y, scl[c1].y, scl[c2].y, scl[c3].y);
+			XMVECTOR sclZ = XMVectorSet(scl[c0].z, scl[c1].z, scl[c2].z, scl[c3].z);
+
+			// Rows of XMMatrixRotationRollPitchYaw
+			XMVECTOR spsy = XMVectorMultiply(sp, sy);
+			XMVECTOR spcy = XMVectorMultiply(sp, cy);
+
+			XMVECTOR r00 = XMVectorMultiplyAdd(sr, spsy, XMVectorMultiply(cr, cy));
+			XMVECTOR r01 = XMVectorMultiply(sr, cp);
+			XMVECTOR r02 = XMVectorSubtract(XMVectorMultiply(sr, spcy), XMVectorMultiply(cr, sy));
+
+			XMVECTOR r10 = XMVectorSubtract(XMVectorMultiply(cr, spsy), XMVectorMultiply(sr, cy));
+			XMVECTOR r11 = XMVectorMultiply(cr, cp);
+			XMVECTOR r12 = XMVectorMultiplyAdd(cr, spcy, XMVectorMultiply(sr, sy));
+
+			XMVECTOR r20 = XMVectorMultiply(cp, sy);
+			XMVECTOR r21 = XMVectorNegate(sp);
+			XMVECTOR r22 = XMVectorMultiply(cp, cy);
+
+			// Scale rows, stored transposed like getWorldMatrix
+			alignas(16) float m[9][4];
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m[0]), XMVectorMultiply(sclX, r00));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m[1]), XMVectorMultiply(sclY, r10));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m[2]), XMVectorMultiply(sclZ, r20));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m[3]), XMVectorMultiply(sclX, r01));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m[4]), XMVectorMultiply(sclY, r11));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m[5]), XMVectorMultiply(sclZ, r21));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m[6]), XMVectorMultiply(sclX, r02));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m[7]), XMVectorMultiply(sclY, r12));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m[8]), XMVectorMultiply(sclZ, r22));
+
+			const size_t lanes = std::min<size_t>(4, count - first);
+			for (size_t idx = 0; idx < lanes; idx++) {
+				const Cube::Position& pos = cubes.position[lane(first + idx)];
+
+				out[first + idx].model = XMFLOAT4X4(
+					m[0][idx], m[1][idx], m[2][idx], pos.x,
+					m[3][idx], m[4][idx], m[5][idx], pos.y,
+					m[6][idx], m[7][idx], m[8][idx], pos.z,
+					0.0f, 0.0f, 0.0f, 1.0f
+				);
+			}
+		}
+	}
+
+}
+
+void Cube::getWorldMatrices(Columns cubes, std::span<Instance> out) {
+	buildInstances(cubes, nullptr, std::min(cubes.size(), out.size()), out.data());
+}
+
+void Cube::getWorldMatrices(Columns cubes, std::span<const uint32_t> indices, std::span<Instance> out) {
+	buildInstances(cubes, indices.data(), std::min(indices.size(), out.size()), out.data());
+}
+
+void Cube::gatherWorldMatrices(Columns cubes, std::span<const uint32_t> indices, std::span<Instance> out) {
+	if (cubes.world.empty()) {
+		getWorldMatrices(cubes, indices, out);
+		return;
+	}
+
+	const size_t count = std::min(indices.size(), out.size());
+	for (size_t idx = 0; idx < count; idx++) out[idx] = cubes.world[indices[idx]];
+}
+
+size_t Cube::cull(const Cull::Frustum& frustum, Columns cubes, std::vector<uint32_t>& visible) {
+	using namespace DirectX;
+
+	const size_t count = cubes.size();
+	visible.resize(count);
+	if (count == 0) return 0;
+
+	auto lane = [&](size_t idx) -> size_t { return std::min(idx, count - 1); };
+	const Position* pos = cubes.position.data();
+	const Scale* scl = cubes.scale.data();
+
+	// Every plane component splatted once, the loop only multiplies
+	std::array<std::array<XMVECTOR, 4>, 6> planes;
+	for (size_t plane = 0; plane < planes.size(); plane++) {
+		const XMVECTOR p = XMLoadFloat4(&frustum.planes[plane]);
+		planes[plane] = { XMVectorSplatX(p), XMVectorSplatY(p), XMVectorSplatZ(p), XMVectorSplatW(p) };
+	}
+
+	size_t survivors = 0;
+	for (size_t first = 0; first < count; first += 4) {
+		const size_t c0 = lane(first), c1 = lane(first + 1), c2 = lane(first + 2), c3 = lane(first + 3);
+
+		XMVECTOR x = XMVectorSet(pos[c0].x, pos[c1].x, pos[c2].x, pos[c3].x);
+		XMVECTOR y = XMVectorSet(pos[c0].y, pos[c1].y, pos[c2].y, pos[c3].y);
+		XMVECTOR z = XMVectorSet(pos[c0].z, pos[c1].z, pos[c2].z, pos[c3].z);
+		XMVECTOR sclX = XMVectorSet(scl[c0].x, scl[c1].x, scl[c2].x, scl[c3].x);
+		XMVECTOR sclY = XMVectorSet(scl[c0].y, scl[c1].y, scl[c2].y, scl[c3].y);
+		XMVECTOR sclZ = XMVectorSet(scl[c0].z, scl[c1].z, scl[c2].z, scl[c3].z);
+
+		// The unit cube spans [-1, 1], its sphere reaches the scaled corner
+		XMVECTOR radius = XMVectorSqrt(XMVectorMultiplyAdd(sclX, sclX,
+			XMVectorMultiplyAdd(sclY, sclY, XMVectorMultiply(sclZ, sclZ))));
+		XMVECTOR negRadius = XMVectorNegate(radius);
+
+		XMVECTOR inside = XMVectorTrueInt();
+		for (auto& plane : planes) {
+			XMVECTOR dist = XMVectorMultiplyAdd(x, plane[0],
+				XMVectorMultiplyAdd(y, plane[1], XMVectorMultiplyAdd(z, plane[2], plane[3])));
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(dist, negRadius));
+		}
+
+		alignas(16) uint32_t mask[4];
+		XMStoreInt4A(mask, inside);
+
+		// Always written, only kept when visible
+		const size_t lanes = std::min<size_t>(4, count - first);
+		for (size_t idx = 0; idx < lanes; idx++) {
+			visible[survivors] = static_cast<uint32_t>(first + idx);
+			survivors += mask[idx] & 1;
+		}
+	}
+
+	visible.resize(survivors);
+	return survivors;
+}
+
+size_t Cube::occlude(const Occlusion::Buffer& buffer, Columns cubes, std::vector<uint32_t>& visible) {
+	using namespace DirectX;
+
+	const size_t count = visible.size();
+	if (count == 0) return 0;
+
+	auto lane = [&](size_t idx) -> size_t { return visible[std::min(idx, count - 1)]; };
+	const Position* pos = cubes.position.data();
+	const Scale* scl = cubes.scale.data();
+
+	// Same bounds as Occlusion::Buffer::project, four spheres at once
+	const XMVECTOR projX = XMVectorReplicate(buffer._proj._11 * 0.5f * static_cast<float>(buffer._width));
+	const XMVECTOR projY = XMVectorReplicate(buffer._proj._22 * 0.5f * static_cast<float>(buffer._height));
+	const XMVECTOR centerX = XMVectorReplicate(0.5f * static_cast<float>(buffer._width));
+	const XMVECTOR centerY = XMVectorReplicate(0.5f * static_cast<float>(buffer._height));
+	const XMVECTOR depthScale = XMVectorReplicate(buffer._proj._33), depthBias = XMVectorReplicate(buffer._proj._43);
+	const XMVECTOR nearPlane = XMVectorReplicate(buffer._near);
+
+	size_t survivors = 0;
+	for (size_t first = 0; first < count; first += 4) {
+		const size_t c0 = lane(first), c1 = lane(first + 1), c2 = lane(first + 2), c3 = lane(first + 3);
+
+		XMVECTOR x = XMVectorSet(pos[c0].x, pos[c1].x, pos[c2].x, pos[c3].x);
+		XMVECTOR y = XMVectorSet(pos[c0].y, pos[c1].y, pos[c2].y, pos[c3].y);
+		XMVECTOR z = XMVectorSet(pos[c0].z, pos[c1].z, pos[c2].z, pos[c3].z);
+		XMVECTOR sclX = XMVectorSet(scl[c0].x, scl[c1].x, scl[c2].x, scl[c3].x);
+		XMVECTOR sclY = XMVectorSet(scl[c0].y, scl[c1].y, scl[c2].y, scl[c3].y);
+		XMVECTOR sclZ = XMVectorSet(scl[c0].z, scl[c1].z, scl[c2].z, scl[c3].z);
+
+		XMVECTOR radius = XMVectorSqrt(XMVectorMultiplyAdd(sclX, sclX,
+			XMVectorMultiplyAdd(sclY, sclY, XMVectorMultiply(sclZ, sclZ))));
+
+		// Spheres reaching past the near plane stay, the buffer cannot tell
+		XMVECTOR zNear = XMVectorSubtract(z, radius);
+		XMVECTOR zFar = XMVectorAdd(z, radius);
+		XMVECTOR crossing = XMVectorLessOrEqual(zNear, nearPlane);
+		zNear = XMVectorSelect(zNear, zFar, crossing);
+
+		XMVECTOR invNear = XMVectorReciprocal(zNear), invFar = XMVectorReciprocal(zFar);
+		XMVECTOR minX = XMVectorSubtract(x, radius), maxX = XMVectorAdd(x, radius);
+		XMVECTOR minY = XMVectorSubtract(y, radius), maxY = XMVectorAdd(y, radius);
+
+		alignas(16) float left[4], top[4], right[4], bottom[4], nearest[4];
+		alignas(16) uint32_t skip[4];
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(left), XMVectorMultiplyAdd(projX,
+			XMVectorMin(XMVectorMultiply(minX, invNear), XMVectorMultiply(minX, invFar)), centerX));
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(right), XMVectorMultiplyAdd(projX,
+			XMVectorMax(XMVectorMultiply(maxX, invNear), XMVectorMultiply(maxX, invFar)), centerX));
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(top), XMVectorNegativeMultiplySubtract(projY,
+			XMVectorMax(XMVectorMultiply(maxY, invNear), XMVectorMultiply(maxY, invFar)), centerY));
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(bottom), XMVectorNegativeMultiplySubtract(projY,
+			XMVectorMin(XMVectorMultiply(minY, invNear), XMVectorMultiply(minY, invFar)), centerY));
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(nearest), XMVectorMultiplyAdd(depthBias, invNear, depthScale));
+		XMStoreInt4A(skip, crossing);
+
+		const size_t lanes = std::min<size_t>(4, count - first);
+		for (size_t idx = 0; idx < lanes; idx++) {
+			const bool keep = (skip[idx] != 0) || buffer.visible({ left[idx], top[idx], right[idx], bottom[idx] }, nearest[idx]);
+
+			visible[survivors] = visible[first + idx];
+			survivors += keep;
+		}
+	}
+
+	visible.resize(survivors);
+	return survivors;
+}
+
+Cube::Arrays::Arrays(std::span<const Data> cubes) {
+	for (const Data& cube : cubes) add(cube);
+}
+
+void Cube::Arrays::clear() {
+	position.clear();
+	rotation.clear();
+	scale.clear();
+	world.clear();
+}
+
+void Cube::Arrays::add(Columns more) {
+	position.insert(position.end(), more.position.begin(), more.position.end());
+	rotation.insert(rotation.end(), more.rotation.begin(), more.rotation.end());
+	scale.insert(scale.end(), more.scale.begin(), more.scale.end());
+
+	if (more.world.size() == more.size()) {
+		world.insert(world.end(), more.world.begin(), more.world.end());
+	} else {
+		world.resize(position.size());
+		getWorldMatrices(more, std::span(world).last(more.size()));
+	}
+}
+
+void Cube::Arrays::add(const Data& cube) {
+	position.push_back({ cube._position });
+	rotation.push_back({ cube._rotation });
+	scale.push_back({ cube._scale });
+	world.push_back({ cube.getWorldMatrix() });
+}
+
 DirectX::XMVECTOR Cube::Data::getPosition() {
 	return DirectX::XMLoadFloat3(&_position);
 }
@@ -2,22 +2,102 @@
 
 #include <DirectXMath.h>
 
+#include <span>
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include <culling.h>
+#include <occlusion.h>
+
 namespace Cube {
 	struct Vertex {
 		DirectX::XMFLOAT3 pos;
 		DirectX::XMFLOAT2 tex;
 	};
 
+	struct Instance {
+		DirectX::XMFLOAT4X4 model;
+	};
+
+	// Cube from -1 to 1, four corners per face so each gets its own texture coordinates
+	extern const std::array<Vertex, 24> vertices;
+	extern const std::array<uint16_t, 36> indices;
+
+	// A cube's fields, each its own component in the entity store so a query
+	// only streams over the columns it touches
+	struct Position : DirectX::XMFLOAT3 {};
+	struct Rotation : DirectX::XMFLOAT3 {};    // pitch, yaw, roll in radians
+	struct Scale : DirectX::XMFLOAT3 {};
+
+	class Data;
+
+	// Cubes as parallel columns, element i of each belongs to cube i
+	struct Columns {
+		std::span<const Position> position;
+		std::span<const Rotation> rotation;
+		std::span<const Scale> scale;
+		std::span<const Instance> world;    // cached world matrices, empty when there are none
+
+		size_t size() const { return position.size(); }
+		bool empty() const { return position.empty(); }
+
+		Columns subspan(size_t first, size_t count) const {
+			return { position.subspan(first, count), rotation.subspan(first, count), scale.subspan(first, count),
+				world.empty() ? world : world.subspan(first, count) };
+		}
+	};
+
+	// Owning columns, keep their capacity through clear. World matrices are
+	// always there, built on add for columns that come without them.
+	struct Arrays {
+		std::vector<Position> position;
+		std::vector<Rotation> rotation;
+		std::vector<Scale> scale;
+		std::vector<Instance> world;
+
+		Arrays() = default;
+		explicit Arrays(std::span<const Data> cubes);
+
+		size_t size() const { return position.size(); }
+		operator Columns() const { return { position, rotation, scale, world }; }
+
+		void clear();
+		void add(Columns more);
+		void add(const Data& cube);
+	};
+
+	// Same result as Data::getWorldMatrix, four cubes per SIMD iteration
+	void getWorldMatrices(Columns cubes, std::span<Instance> out);
+
+	// Same, for the cubes at `indices` only, written back to back
+	void getWorldMatrices(Columns cubes, std::span<const uint32_t> indices, std::span<Instance> out);
+
+	// Copies the cached matrices of the cubes at `indices`, back to back.
+	// Builds them like getWorldMatrices when the columns have none.
+	void gatherWorldMatrices(Columns cubes, std::span<const uint32_t> indices, std::span<Instance> out);
+
+	// Indices of the cubes whose bounding sphere is not fully outside the
+	// frustum, four per SIMD iteration. Reads positions and scales only.
+	size_t cull(const Cull::Frustum& frustum, Columns cubes, std::vector<uint32_t>& visible);
+
+	// Drops the cubes at `visible` whose bounding sphere is hidden in the
+	// occlusion buffer, bounds of four computed per SIMD iteration
+	size_t occlude(const Occlusion::Buffer& buffer, Columns cubes, std::vector<uint32_t>& visible);
+
+	// One cube on its own, the per-object reference for the kernels
 	class Data {
 		DirectX::XMFLOAT3 _position = { 0.0f, 0.0f, 0.0f };
 		DirectX::XMFLOAT3 _rotation = { 0.0f, 0.0f, 0.0f };
 		DirectX::XMFLOAT3 _scale = { 0.0f, 0.0f, 0.0f };
 
+		friend struct Arrays;
+
 	public:
 		Data(const DirectX::XMFLOAT3& _pos, const DirectX::XMFLOAT3& _rot, const DirectX::XMFLOAT3& _scl)
 			: _position(_pos), _rotation(_rot), _scale(_scl) {}
 
-		DirectX::XMFLOAT4X4 getWorldMatrix();
+		DirectX::XMFLOAT4X4 getWorldMatrix() const;
 
 		DirectX::XMVECTOR getPosition();
 		Data& setPosition(DirectX::XMFLOAT3 other);
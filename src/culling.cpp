@@ -0,0 +1,33 @@
+#include <culling.h>
+
+#include <DirectXMath.h>
+
+#include <array>
+
+Cull::Frustum Cull::Frustum::fromProjection(DirectX::FXMMATRIX proj) {
+	using namespace DirectX;
+
+	// Row vectors times proj, so the clip space components are proj's columns
+	const XMMATRIX cols = XMMatrixTranspose(proj);
+	const std::array<XMVECTOR, 6> planes = {
+		XMVectorAdd(cols.r[3], cols.r[0]),
+		XMVectorSubtract(cols.r[3], cols.r[0]),
+		XMVectorAdd(cols.r[3], cols.r[1]),
+		XMVectorSubtract(cols.r[3], cols.r[1]),
+		cols.r[2],
+		XMVectorSubtract(cols.r[3], cols.r[2]),
+	};
+
+	Frustum ret;
+	for (size_t idx = 0; idx < planes.size(); idx++)
+		XMStoreFloat4(&ret.planes[idx], XMPlaneNormalize(planes[idx]));
+
+	return ret;
+}
+
+Cull::Stats& Cull::Stats::operator+=(const Stats& other) {
+	tested += other.tested;
+	visible += other.visible;
+	ms += other.ms;
+	return *this;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <array>
+#include <cstddef>
+
+namespace Cull {
+
+	// Planes point inwards and are normalized, so a sphere is outside once
+	// its center is more than its radius behind any of them
+	struct Frustum {
+		std::array<DirectX::XMFLOAT4, 6> planes;
+
+		// Left, right, bottom, top, near, far of a D3D projection, z in [0, w]
+		static Frustum fromProjection(DirectX::FXMMATRIX proj);
+	};
+
+	// Visible area of the ortho projection, in pixels
+	struct Rect {
+		float left, bottom, right, top;
+	};
+
+	struct Stats {
+		size_t tested = 0;
+		size_t visible = 0;
+		double ms = 0.0;        // summed over every thread that culled
+
+		size_t culled() const { return tested - visible; }
+
+		Stats& operator+=(const Stats& other);
+	};
+
+}
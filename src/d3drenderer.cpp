@@ -4,17 +4,40 @@
 #include <dxgi.h>
 #include <d3dcompiler.h>
 #include <directxmath.h>
-#include <DDSTextureLoader.h>
 #include <DX.h>
+#include <backend.h>
+#include <uploadring.h>
+#include <renderqueue.h>
+#include <commandlist.h>
+#include <jobs.h>
+#include <culling.h>
+#include <occlusion.h>
+#include <raster.h>
+#include <profiler.h>
+#include <mappedfile.h>
+#include <shaderpack.h>
+#include <dds.h>
+#include <mesh.h>
 
 #include <span>
 #include <array>
 #include <vector>
 #include <chrono>
 #include <string>
+#include <cstring>
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <utility>
+#include <cmath>
+#include <numeric>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
 
 #include <cube.h>
 #include <font.h>
+#include <fontcache.h>
 #include <sprite.h>
 #include <window.h>
 
@@ -23,6 +46,49 @@
 void D3DRenderer::init() {
 	deviceSetup();
 	shaderSetup();
+
+	_backend = std::make_unique<Backend::D3D11Context>(_context, _swapChain);
+}
+
+void D3DRenderer::initHeadless() {
+	_viewport = {
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = _viewWidth,
+		.height = _viewHeight,
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f,
+	};
+
+	_backend = std::make_unique<Backend::NullContext>();
+}
+
+void D3DRenderer::initSoftware() {
+	initHeadless();
+
+	_raster = std::make_unique<Raster::Device>(_jobs);
+	_raster->resize(static_cast<uint32_t>(_viewWidth), static_cast<uint32_t>(_viewHeight));
+}
+
+bool D3DRenderer::saveFrame(const std::string& path) const {
+	if (_raster == nullptr) return false;
+
+	const Raster::Target& target = _raster->_target;
+	std::ofstream file(path, std::ios::binary);
+	if (!file) return false;
+
+	// Binary PPM, alpha is dropped
+	file << "P6\n" << target.width << " " << target.height << "\n255\n";
+	std::vector<unsigned char> rgb;
+	rgb.reserve(target.color.size() * 3);
+	for (uint32_t texel : target.color) {
+		rgb.push_back(static_cast<unsigned char>(texel & 0xff));
+		rgb.push_back(static_cast<unsigned char>((texel >> 8) & 0xff));
+		rgb.push_back(static_cast<unsigned char>((texel >> 16) & 0xff));
+	}
+	file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+
+	return static_cast<bool>(file);
 }
 
 void D3DRenderer::deviceSetup() {
@@ -132,12 +198,12 @@ void D3DRenderer::deviceSetup() {
 	HR(_device->CreateDepthStencilView(_depthTex, &depthViewDesc, &_depthTexView));
 
 	_viewport = {
-		.TopLeftX = 0.0f,
-		.TopLeftY = 0.0f,
-		.Width = _viewWidth,
-		.Height = _viewHeight,
-		.MinDepth = 0.0f,
-		.MaxDepth = 1.0f,
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = _viewWidth,
+		.height = _viewHeight,
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f,
 	};
 
 	D3D11_SAMPLER_DESC texSamplerDesc = {
@@ -152,25 +218,68 @@ void D3DRenderer::deviceSetup() {
 	HR(_device->CreateSamplerState(&texSamplerDesc, &_texSampler));
 }
 
-ID3DBlob* D3DRenderer::compileShader(const wchar_t* filename, 
-		const char* entry, const char* version) {
+namespace {
+	const char* shaderSource = "sampleShader.hlsl";
+	const wchar_t* shaderSourceW = L"sampleShader.hlsl";
+	const char* shaderPackPath = "shaders.pack";
+	const char* cubeMeshPath = "res/cube.mesh";
+
+	// Every shader variant the renderer creates. A new permutation is a new
+	// key here, listed in shaderKeys, plus the create* call that uses it.
+	const Shader::Key spriteVSKey = { "spriteVS", "vs_4_0" };
+	const Shader::Key spriteCompactVSKey = { "spriteCompactVS", "vs_4_0" };
+	const Shader::Key fontVSKey = { "fontVS", "vs_4_0" };
+	const Shader::Key cubeVSKey = { "cubeVS", "vs_4_0" };
+	const Shader::Key spritePSKey = { "spritePS", "ps_4_0" };
+	const Shader::Key combiPSKey = { "combiPS", "ps_4_0" };
+	const Shader::Key atlasPSKey = { "atlasPS", "ps_4_0" };
+
+	const std::array shaderKeys = { &spriteVSKey, &spriteCompactVSKey, &fontVSKey, &cubeVSKey, &spritePSKey, &combiPSKey, &atlasPSKey };
+
+	// Shader ids in the sort key, one per VS and PS pair
+	enum Program : uint16_t { CubeProgram, SpriteProgram, FontProgram };
+	enum Op : uint32_t { DrawOp };
+	constexpr uint16_t atlasTextureId = 0xffff;
+
+	// Far plane of the perspective projection
+	constexpr float farPlane = 100.0f;
+
+	unsigned int shaderFlags() {
+		unsigned int flags = D3DCOMPILE_ENABLE_STRICTNESS;
+#if defined( DEBUG ) || defined( _DEBUG )
+		flags |= D3DCOMPILE_DEBUG;
+#endif
+		return flags;
+	}
+
+	// Source and compile flags, 0 when the source is not shipped
+	uint64_t shaderSourceHash() {
+		MappedFile source;
+		if (!source.open(shaderSource)) return 0;
+
+		const unsigned int flags = shaderFlags();
+		return Shader::hash(source.bytes(), Shader::hash(std::as_bytes(std::span(&flags, 1))));
+	}
+}
+
+ID3DBlob* D3DRenderer::compileShader(const wchar_t* filename, const Shader::Key& key) {
 	ID3DBlob* sBuffer = nullptr;
 	ID3DBlob* errorBuffer = nullptr;
 
-	unsigned int shaderFlags = D3DCOMPILE_ENABLE_STRICTNESS;
-#if defined( DEBUG ) || defined( _DEBUG )
-	shaderFlags |= D3DCOMPILE_DEBUG;
-#endif
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (auto& define : key.defines)
+		macros.push_back({ define.name.c_str(), define.value.c_str() });
+	macros.push_back({ nullptr, nullptr });
 
 	try {
 		HR(
 			D3DCompileFromFile(
 				filename,
+				macros.data(),
 				0,
-				0,
-				entry,
-				version,
-				shaderFlags,
+				key.entry.c_str(),
+				key.profile.c_str(),
+				shaderFlags(),
 				0,
 				&sBuffer,
 				&errorBuffer
@@ -193,25 +302,66 @@ ID3DBlob* D3DRenderer::compileShader(const wchar_t* filename,
 	return sBuffer;
 }
 
-void D3DRenderer::shaderSetup() {
-	ID3DBlob* sBuffer = nullptr;
-	sBuffer = compileShader(L"sampleShader.hlsl", "spriteVS", "vs_4_0");
+void D3DRenderer::openShaderPack() {
+	// A pack built from another version of the source is ignored
+	const uint64_t source = shaderSourceHash();
+	if (_shaderPack.open(shaderPackPath) && source != 0 && _shaderPack._sourceHash != source)
+		_shaderPack.close();
+}
 
-	try {
-		HR(
-			_device->CreateVertexShader(
-				sBuffer->GetBufferPointer(),
-				sBuffer->GetBufferSize(),
-				0,
-				&_spriteVS
-			)
-		);
-	}
-	catch (DX::com_exception e) {
+std::span<const std::byte> D3DRenderer::shaderBytecode(const Shader::Key& key) {
+	const uint64_t id = key.hash();
+
+	auto packed = _shaderPack.find(id);
+	if (!packed.empty()) return packed;
+
+	// Missing from the pack, compile once and keep it for the pack rewrite
+	auto& code = _shaderCompiled[id];
+	if (code.empty()) {
+		ID3DBlob* sBuffer = compileShader(shaderSourceW, key);
+
+		auto* begin = static_cast<const std::byte*>(sBuffer->GetBufferPointer());
+		code.assign(begin, begin + sBuffer->GetBufferSize());
 		retire(sBuffer);
-		throw e;
 	}
 
+	return code;
+}
+
+void D3DRenderer::createVS(const Shader::Key& key, ID3D11VertexShader** shader,
+		std::span<const D3D11_INPUT_ELEMENT_DESC> layoutDesc, ID3D11InputLayout** layout) {
+	auto code = shaderBytecode(key);
+
+	HR(_device->CreateVertexShader(code.data(), code.size(), 0, shader));
+
+	if (layout != nullptr)
+		HR(_device->CreateInputLayout(layoutDesc.data(), layoutDesc.size(), code.data(), code.size(), layout));
+}
+
+void D3DRenderer::createPS(const Shader::Key& key, ID3D11PixelShader** shader) {
+	auto code = shaderBytecode(key);
+
+	HR(_device->CreatePixelShader(code.data(), code.size(), 0, shader));
+}
+
+void D3DRenderer::buildShaderPack() {
+	std::vector<Shader::Pack::Blob> blobs;
+	for (const Shader::Key* key : shaderKeys)
+		blobs.push_back({ key->hash(), shaderBytecode(*key) });
+
+	auto pack = Shader::Pack::build(shaderSourceHash(), std::move(blobs));
+
+	// Windows will not replace a file that is still mapped
+	_shaderPack.close();
+	_shaderCompiled.clear();
+
+	if (!Shader::Pack::write(shaderPackPath, pack))
+		_sysWin.shout("Could not write the shader pack", "Shader error");
+}
+
+void D3DRenderer::shaderSetup() {
+	openShaderPack();
+
 	std::array spriteILDesc = {
 		D3D11_INPUT_ELEMENT_DESC { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT,
 			0, offsetof(Sprite::Vertex, pos), D3D11_INPUT_PER_VERTEX_DATA, 0 },
@@ -223,479 +373,953 @@ void D3DRenderer::shaderSetup() {
 			1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
 		D3D11_INPUT_ELEMENT_DESC { "MODEL", 2, DXGI_FORMAT_R32G32B32_FLOAT,
 			1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		D3D11_INPUT_ELEMENT_DESC { "ATLASRECT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT,
+			1, offsetof(Sprite::Instance, uvRect), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		D3D11_INPUT_ELEMENT_DESC { "ATLASPAGE", 0, DXGI_FORMAT_R32_UINT,
+			1, offsetof(Sprite::Instance, page), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
 	};
 
-	try {
-		HR(
-			_device->CreateInputLayout(
-				spriteILDesc.data(),
-				spriteILDesc.size(),
-				sBuffer->GetBufferPointer(),
-				sBuffer->GetBufferSize(),
-				&_spriteIL
-			)
-		);
-	}
-	catch (DX::com_exception e) {
-		retire(sBuffer);
-		throw e;
-	}
-	retire(sBuffer);
-
-	sBuffer = compileShader(L"sampleShader.hlsl", "fontVS", "vs_4_0");
-
-	try {
-		HR(
-			_device->CreateVertexShader(
-				sBuffer->GetBufferPointer(),
-				sBuffer->GetBufferSize(),
-				0,
-				&_fontVS
-			)
-		);
-	}
-	catch (DX::com_exception e) {
-		retire(sBuffer);
-		throw e;
-	}
-	retire(sBuffer);
-
-	sBuffer = compileShader(L"sampleShader.hlsl", "cubeVS", "vs_4_0");
+	std::array spriteCompactILDesc = {
+		D3D11_INPUT_ELEMENT_DESC { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT,
+			0, offsetof(Sprite::Vertex, pos), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		D3D11_INPUT_ELEMENT_DESC { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,
+			0, offsetof(Sprite::Vertex, tex), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		D3D11_INPUT_ELEMENT_DESC { "INSTPOS", 0, DXGI_FORMAT_R32G32_FLOAT,
+			1, offsetof(Sprite::CompactInstance, position), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		D3D11_INPUT_ELEMENT_DESC { "INSTSCALE", 0, DXGI_FORMAT_R16G16_FLOAT,
+			1, offsetof(Sprite::CompactInstance, scale), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		D3D11_INPUT_ELEMENT_DESC { "INSTROTATION", 0, DXGI_FORMAT_R16_FLOAT,
+			1, offsetof(Sprite::CompactInstance, rotation), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		D3D11_INPUT_ELEMENT_DESC { "INSTREGION", 0, DXGI_FORMAT_R16_UINT,
+			1, offsetof(Sprite::CompactInstance, region), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	};
 
-	try {
-		HR(
-			_device->CreateVertexShader(
-				sBuffer->GetBufferPointer(),
-				sBuffer->GetBufferSize(),
-				0,
-				&_cubeVS
-			)
-		);
-	}
-	catch (DX::com_exception e) {
-		retire(sBuffer);
-		throw e;
-	}
+	std::array fontILDesc = {
+		D3D11_INPUT_ELEMENT_DESC { "GLYPHPOS", 0, DXGI_FORMAT_R32G32_FLOAT,
+			0, offsetof(Font::Glyph, pos), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		D3D11_INPUT_ELEMENT_DESC { "GLYPHSIZE", 0, DXGI_FORMAT_R16G16_FLOAT,
+			0, offsetof(Font::Glyph, size), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		D3D11_INPUT_ELEMENT_DESC { "GLYPHUV", 0, DXGI_FORMAT_R16G16_UNORM,
+			0, offsetof(Font::Glyph, uv), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	};
 
 	std::array cubeILDesc = {
 		D3D11_INPUT_ELEMENT_DESC { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,
 			0, offsetof(Cube::Vertex, pos), D3D11_INPUT_PER_VERTEX_DATA, 0 },
 		D3D11_INPUT_ELEMENT_DESC { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,
 			0, offsetof(Cube::Vertex, tex), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		D3D11_INPUT_ELEMENT_DESC { "MODEL", 0, DXGI_FORMAT_R32G32B32A32_FLOAT,
+			1, offsetof(Cube::Instance, model), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		D3D11_INPUT_ELEMENT_DESC { "MODEL", 1, DXGI_FORMAT_R32G32B32A32_FLOAT,
+			1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		D3D11_INPUT_ELEMENT_DESC { "MODEL", 2, DXGI_FORMAT_R32G32B32A32_FLOAT,
+			1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		D3D11_INPUT_ELEMENT_DESC { "MODEL", 3, DXGI_FORMAT_R32G32B32A32_FLOAT,
+			1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
 	};
 
-	try {
-		HR(
-			_device->CreateInputLayout(
-				cubeILDesc.data(),
-				cubeILDesc.size(),
-				sBuffer->GetBufferPointer(),
-				sBuffer->GetBufferSize(),
-				&_cubeIL
-			)
-		);
+	createVS(spriteVSKey, &_spriteVS, spriteILDesc, &_spriteIL);
+	createVS(spriteCompactVSKey, &_spriteCompactVS, spriteCompactILDesc, &_spriteCompactIL);
+	createVS(fontVSKey, &_fontVS, fontILDesc, &_fontIL);
+	createVS(cubeVSKey, &_cubeVS, cubeILDesc, &_cubeIL);
+
+	// Same shader for the quantized mesh, the UNORM formats hand it [0, 1]
+	std::array cubeMeshILDesc = cubeILDesc;
+	cubeMeshILDesc[0] = { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, offsetof(Mesh::Vertex, pos), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	cubeMeshILDesc[1] = { "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM, 0, offsetof(Mesh::Vertex, tex), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+
+	auto cubeCode = shaderBytecode(cubeVSKey);
+	HR(_device->CreateInputLayout(cubeMeshILDesc.data(), cubeMeshILDesc.size(), cubeCode.data(), cubeCode.size(), &_cubeMeshIL));
+
+	createPS(spritePSKey, &_PS);
+	createPS(combiPSKey, &_combiPS);
+	createPS(atlasPSKey, &_atlasPS);
+
+	// Anything compiled at runtime goes into the pack for the next launch
+	if (!_shaderCompiled.empty())
+		buildShaderPack();
+
+	_shaderPack.close();
+}
+
+Texture::Handle D3DRenderer::loadTexture(const char* path) {
+	auto& tex = _streamed.emplace_back();
+
+	const DDS::Result result = tex.file.open(path);
+	if (result != DDS::Result::Ok) {
+		_sysWin.shout((std::string(path) + ": " + DDS::describe(result)).c_str(), "Texture error");
+		throw DX::com_exception(E_FAIL, __FILE__, __LINE__, __func__);
 	}
-	catch (DX::com_exception e) {
-		retire(sBuffer);
-		throw e;
+
+	const DDS::Image& image = tex.file.image;
+
+	Texture::Desc desc = { image.width, image.height, std::vector<size_t>(image.mipLevels) };
+	for (uint32_t slice = 0; slice < image.arraySize; slice++) {
+		for (uint32_t mip = 0; mip < image.mipLevels; mip++)
+			desc.mipBytes[mip] += image.subresources[slice * image.mipLevels + mip].slicePitch;
 	}
-	retire(sBuffer);
 
-	sBuffer = compileShader(L"sampleShader.hlsl", "spritePS", "ps_4_0");
+	// Starts out with the smallest mips only, the rest streams in on demand
+	const Texture::Handle handle = _textures.residency.add(std::move(desc));
+	createTextureView(image, _textures.residency._entries[handle].residentMip, &tex.view);
 
-	try {
-		HR(
-			_device->CreatePixelShader(
-				sBuffer->GetBufferPointer(),
-				sBuffer->GetBufferSize(),
-				0,
-				&_PS
-			)
-		);
+	return handle;
+}
+
+Texture::Handle D3DRenderer::loadRasterTexture(const char* path) {
+	auto& tex = _rasterTextures.emplace_back();
+
+	// Block compressed files are not decoded, they stay empty and sample as zero
+	DDS::File file;
+	if (file.open(path) == DDS::Result::Ok && DDS::readRGBA8(file.image, tex.texels)) {
+		tex.width = file.image.width;
+		tex.height = file.image.height;
 	}
-	catch (DX::com_exception e) {
-		retire(sBuffer);
-		throw e;
+
+	return static_cast<Texture::Handle>(_rasterTextures.size() - 1);
+}
+
+void D3DRenderer::createTextureView(const DDS::Image& image, uint32_t firstMip, ID3D11ShaderResourceView** view) {
+	// Mips are uploaded straight out of the mapping, nothing is copied first
+	std::vector<D3D11_SUBRESOURCE_DATA> initData;
+	for (uint32_t slice = 0; slice < image.arraySize; slice++) {
+		for (uint32_t mip = firstMip; mip < image.mipLevels; mip++) {
+			auto& sub = image.subresources[slice * image.mipLevels + mip];
+			initData.push_back({ .pSysMem = sub.data, .SysMemPitch = sub.rowPitch, .SysMemSlicePitch = sub.slicePitch, });
+		}
 	}
-	retire(sBuffer);
 
-	sBuffer = compileShader(L"sampleShader.hlsl", "combiPS", "ps_4_0");
+	D3D11_TEXTURE2D_DESC texDesc = {
+		.Width = std::max(1u, image.width >> firstMip),
+		.Height = std::max(1u, image.height >> firstMip),
+		.MipLevels = image.mipLevels - firstMip,
+		.ArraySize = image.arraySize,
+		.Format = static_cast<DXGI_FORMAT>(image.format),
+		.SampleDesc = {.Count = 1, .Quality = 0, },
+		.Usage = D3D11_USAGE_IMMUTABLE,
+		.BindFlags = D3D11_BIND_SHADER_RESOURCE,
+	};
+
+	ID3D11Texture2D* tex = nullptr;
+	HR(_device->CreateTexture2D(&texDesc, initData.data(), &tex));
 
 	try {
-		HR(
-			_device->CreatePixelShader(
-				sBuffer->GetBufferPointer(),
-				sBuffer->GetBufferSize(),
-				0,
-				&_combiPS
-			)
-		);
+		HR(_device->CreateShaderResourceView(tex, nullptr, view));
 	}
 	catch (DX::com_exception e) {
-		retire(sBuffer);
+		retire(tex);
 		throw e;
 	}
-	retire(sBuffer);
+
+	retire(tex);
 }
 
-void D3DRenderer::populateVRAM(unsigned int reserve_sprites, unsigned int reserve_letters) {
-	using namespace DirectX;
+void D3DRenderer::requestTexture(Texture::Handle texture, float pixels) {
+	if (texture >= _streamed.size()) return;
 
-	// Vertex Sprite buffer
-	{
-		std::array spriteVert = {
-			Sprite::Vertex { XMFLOAT2(_viewHeight / 2,  _viewHeight / 2), XMFLOAT2(1.0, 1.0) },
-			Sprite::Vertex { XMFLOAT2(_viewHeight / 2, -_viewHeight / 2), XMFLOAT2(1.0, 0.0) },
-			Sprite::Vertex { XMFLOAT2(-_viewHeight / 2, -_viewHeight / 2), XMFLOAT2(0.0, 0.0) },
-
-			Sprite::Vertex { XMFLOAT2(-_viewHeight / 2, -_viewHeight / 2), XMFLOAT2(0.0, 0.0) },
-			Sprite::Vertex { XMFLOAT2(-_viewHeight / 2,  _viewHeight / 2), XMFLOAT2(0.0, 1.0) },
-			Sprite::Vertex { XMFLOAT2(_viewHeight / 2,  _viewHeight / 2), XMFLOAT2(1.0, 1.0) },
-		};
+	_textures.residency.request(texture, pixels);
+}
 
-		D3D11_BUFFER_DESC spriteVertDesc = {
-			.ByteWidth = sizeof(spriteVert),
-			.Usage = D3D11_USAGE_DEFAULT,
-			.BindFlags = D3D11_BIND_VERTEX_BUFFER,
-		};
+ID3D11ShaderResourceView* D3DRenderer::textureView(Texture::Handle texture) {
+	return (texture < _streamed.size()) ? _streamed[texture].view : nullptr;
+}
 
-		D3D11_SUBRESOURCE_DATA spriteVertResData = {
-			.pSysMem = spriteVert.data(),
-		};
+std::vector<Atlas::Region> D3DRenderer::loadSpriteAtlas(std::span<const char* const> paths) {
+	Atlas::Builder builder;
+	std::vector<Atlas::Region> regions;
 
-		HR(_device->CreateBuffer(&spriteVertDesc, &spriteVertResData, &_spriteVertBuf));
-	}
+	for (const char* path : paths) {
+		DDS::File file;
+		std::vector<uint32_t> texels;
 
-	// Instance Sprite buffer
-	{
-		D3D11_BUFFER_DESC instBufDesc = {
-			.ByteWidth = reserve_sprites * sizeof(Sprite::Instance),
-			.Usage = D3D11_USAGE_DYNAMIC,
-			.BindFlags = D3D11_BIND_VERTEX_BUFFER,
-			.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE,
-		};
+		const DDS::Result result = file.open(path);
+		if (result != DDS::Result::Ok || !DDS::readRGBA8(file.image, texels)) {
+			const char* reason = (result != DDS::Result::Ok) ? DDS::describe(result) : "sprites need 8-bit RGBA, BGRA or BC1-3";
+			_sysWin.shout((std::string(path) + ": " + reason).c_str(), "Texture error");
+			throw DX::com_exception(E_FAIL, __FILE__, __LINE__, __func__);
+		}
+
+		auto region = builder.add(file.image.width, file.image.height, texels);
+		if (!region) {
+			_sysWin.shout((std::string(path) + ": larger than an atlas page").c_str(), "Texture error");
+			throw DX::com_exception(E_FAIL, __FILE__, __LINE__, __func__);
+		}
+
+		regions.push_back(*region);
 
-		HR(_device->CreateBuffer(&instBufDesc, nullptr, &_spriteInstBuf));
+		// Only the first maxRegions can be drawn by compact sprites
+		if (regions.size() <= _spriteRegions.size())
+			_spriteRegions[regions.size() - 1] = { DirectX::XMFLOAT4(region->uvRect.data()), region->page, {} };
 	}
 
-	// Vertex Font buffer
-	{
-		D3D11_BUFFER_DESC instFontBufDesc = {
-			.ByteWidth = reserve_letters * 6 * sizeof(Sprite::Vertex),
-			.Usage = D3D11_USAGE_DYNAMIC,
-			.BindFlags = D3D11_BIND_VERTEX_BUFFER,
-			.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE,
-		};
+	if (_projBuf != nullptr) createProjBuffer();
 
-		HR(_device->CreateBuffer(&instFontBufDesc, nullptr, &_fontVertBuf));
+	if (builder.pages.empty()) return regions;
+
+	// Pages become the slices of one array texture, so all sprites share a bind
+	const uint32_t pageSize = builder.packer._settings.pageSize;
+	const uint32_t mipLevels = builder.mipLevels();
+
+	// The software rasterizer only samples the top mip of each page
+	if (_raster != nullptr) {
+		_rasterAtlas = { pageSize, pageSize, static_cast<uint32_t>(builder.pages.size()), {} };
+		for (uint32_t page = 0; page < builder.pages.size(); page++) {
+			const auto chain = builder.mipChain(page);
+			_rasterAtlas.texels.insert(_rasterAtlas.texels.end(), chain[0].begin(), chain[0].end());
+		}
 	}
 
-	// Projection buffer
-	{
-		XMMATRIX ortho = XMMatrixTranspose(XMMatrixOrthographicOffCenterLH(
-			0.0f, static_cast<float>(_viewWidth), 0.0f, static_cast<float>(_viewHeight), 0.1f, 100.0f
-		));
+	if (_device == nullptr) return regions;
 
-		XMMATRIX pers = XMMatrixTranspose(XMMatrixPerspectiveFovLH(XM_PIDIV4, 
-			static_cast<float>(_viewWidth) / static_cast<float>(_viewHeight), 0.01f, 100.0f
-		));
+	std::vector<std::vector<std::vector<uint32_t>>> chains;
+	std::vector<D3D11_SUBRESOURCE_DATA> initData;
+	for (uint32_t page = 0; page < builder.pages.size(); page++) {
+		auto& chain = chains.emplace_back(builder.mipChain(page));
 
-		std::array<XMFLOAT4X4, 2> vpMatrix;
-		XMStoreFloat4x4(&vpMatrix[0], pers);
-		XMStoreFloat4x4(&vpMatrix[1], ortho);
+		for (uint32_t mip = 0; mip < mipLevels; mip++) {
+			const unsigned int pitch = (pageSize >> mip) * sizeof(uint32_t);
+			initData.push_back({ .pSysMem = chain[mip].data(), .SysMemPitch = pitch, .SysMemSlicePitch = 0, });
+		}
+	}
 
-		D3D11_BUFFER_DESC projBufDesc = {
-			.ByteWidth = sizeof(vpMatrix),
-			.Usage = D3D11_USAGE_DEFAULT,
-			.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
-		};
+	D3D11_TEXTURE2D_DESC atlasDesc = {
+		.Width = pageSize,
+		.Height = pageSize,
+		.MipLevels = mipLevels,
+		.ArraySize = static_cast<unsigned int>(builder.pages.size()),
+		.Format = DXGI_FORMAT_R8G8B8A8_UNORM,
+		.SampleDesc = {.Count = 1, .Quality = 0, },
+		.Usage = D3D11_USAGE_IMMUTABLE,
+		.BindFlags = D3D11_BIND_SHADER_RESOURCE,
+	};
 
-		D3D11_SUBRESOURCE_DATA projResData = {
-			.pSysMem = &vpMatrix,
-		};
+	ID3D11Texture2D* atlasTex = nullptr;
+	HR(_device->CreateTexture2D(&atlasDesc, initData.data(), &atlasTex));
 
-		HR(_device->CreateBuffer(&projBufDesc, &projResData, &_projBuf));
+	retire(_spriteAtlasView);
+	try {
+		HR(_device->CreateShaderResourceView(atlasTex, nullptr, &_spriteAtlasView));
+	}
+	catch (DX::com_exception e) {
+		retire(atlasTex);
+		throw e;
 	}
 
-	HR(CreateDDSTextureFromFile(
-			_device,
-			L"res/wood/Wood066_1K_Color.dds",
-			nullptr,
-			&_woodTexView));
+	retire(atlasTex);
+	return regions;
+}
 
-	HR(CreateDDSTextureFromFile(
-			_device,
-			L"res/font/Hack.dds",
-			nullptr,
-			&_fontTexView));
+size_t D3DRenderer::spriteStride() const {
+	return _compactSprites ? sizeof(Sprite::CompactInstance) : sizeof(Sprite::Instance);
+}
 
-	HR(CreateDDSTextureFromFile(
-			_device,
-			L"res/heart/heart.dds",
-			nullptr,
-			&_heartTexView));
+void D3DRenderer::createProjBuffer() {
+	if (_device == nullptr) return;
 
-	// Cube section
+	// Matrices, cube bounds, then the region table, like in projBuffer
+	const size_t head = sizeof(_viewProj) + sizeof(_cubeBounds);
+	std::vector<std::byte> data(head + _spriteRegions.size() * sizeof(Sprite::Region));
+	std::memcpy(data.data(), _viewProj.data(), sizeof(_viewProj));
+	std::memcpy(data.data() + sizeof(_viewProj), _cubeBounds.data(), sizeof(_cubeBounds));
+	std::memcpy(data.data() + head, _spriteRegions.data(), _spriteRegions.size() * sizeof(Sprite::Region));
 
-	// Cube model matrix
-	{
-		D3D11_BUFFER_DESC cubeModelBufDesc = {
-			.ByteWidth = sizeof(XMFLOAT4X4),
-			.Usage = D3D11_USAGE_DYNAMIC,
-			.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
-			.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE,
-		};
+	D3D11_BUFFER_DESC projBufDesc = {
+		.ByteWidth = static_cast<unsigned int>(data.size()),
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
+	};
+
+	D3D11_SUBRESOURCE_DATA projResData = {
+		.pSysMem = data.data(),
+	};
 
-		HR(_device->CreateBuffer(&cubeModelBufDesc, nullptr, &_cubeModelBuf));
+	retire(_projBuf);
+	HR(_device->CreateBuffer(&projBufDesc, &projResData, &_projBuf));
+}
+
+void D3DRenderer::loadCubeMesh() {
+	using namespace DirectX;
+
+	// The built-in floats, unless the imported mesh loads
+	std::span<const std::byte> vertices = std::as_bytes(std::span(Cube::vertices));
+	std::span<const std::byte> indices = std::as_bytes(std::span(Cube::indices));
+
+	Mesh::File mesh;
+	const Mesh::Result result = mesh.open(cubeMeshPath);
+	if (result == Mesh::Result::Ok) {
+		const Mesh::View& view = mesh.view;
+		vertices = std::as_bytes(view.vertices);
+		indices = view.indices;
+
+		_cubeQuantized = true;
+		_cubeVertexStride = sizeof(Mesh::Vertex);
+		_cubeLods.assign(view.lods.begin(), view.lods.end());
+		_cubeIndexFormat = (view.indexSize() == 4) ? Backend::IndexFormat::UInt32 : Backend::IndexFormat::UInt16;
+
+		const XMFLOAT3& lo = view.header.boundsMin;
+		const XMFLOAT3& scale = view.header.boundsScale;
+		_cubeBounds = { XMFLOAT4(lo.x, lo.y, lo.z, 0.0f), XMFLOAT4(scale.x, scale.y, scale.z, 0.0f) };
+		_cubeExtent = std::max({ scale.x, scale.y, scale.z });
+
+		// The software rasterizer reads floats and 16-bit indices, a bigger mesh leaves it the built-in cube
+		if (_raster != nullptr && view.indexSize() == 2) {
+			Mesh::Source decoded;
+			Mesh::decode(view, decoded);
+
+			for (size_t vert = 0; vert < decoded.positions.size(); vert++)
+				_rasterCubeVertices.push_back({ decoded.positions[vert], decoded.uvs[vert] });
+			_rasterCubeIndices.assign(decoded.indices.begin(), decoded.indices.end());
+		}
+	}
+	else if (result != Mesh::Result::Missing) {
+		_sysWin.shout((std::string(cubeMeshPath) + ": " + Mesh::describe(result)).c_str(), "Mesh error");
 	}
 
-	// Cube vertices
-	{
-		std::array<Cube::Vertex, 24> cubeVert = {
-			Cube::Vertex { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT2(0.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT2(1.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT2(1.0f, 1.0f) },
-			Cube::Vertex { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT2(0.0f, 1.0f) },
-
-			Cube::Vertex { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT2(0.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT2(1.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT2(1.0f, 1.0f) },
-			Cube::Vertex { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT2(0.0f, 1.0f) },
-
-			Cube::Vertex { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT2(0.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT2(1.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT2(1.0f, 1.0f) },
-			Cube::Vertex { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT2(0.0f, 1.0f) },
-
-			Cube::Vertex { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT2(0.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT2(1.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT2(1.0f, 1.0f) },
-			Cube::Vertex { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT2(0.0f, 1.0f) },
-
-			Cube::Vertex { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT2(0.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT2(1.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT2(1.0f, 1.0f) },
-			Cube::Vertex { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT2(0.0f, 1.0f) },
-
-			Cube::Vertex { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT2(0.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT2(1.0f, 0.0f) },
-			Cube::Vertex { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT2(1.0f, 1.0f) },
-			Cube::Vertex { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT2(0.0f, 1.0f) },
-		};
+	if (_device == nullptr) return;
 
+	// CreateBuffer copies, so the mapping can go once both exist
+	{
 		D3D11_BUFFER_DESC cubeVertDesc = {
-			.ByteWidth = sizeof(cubeVert),
+			.ByteWidth = static_cast<unsigned int>(vertices.size()),
 			.Usage = D3D11_USAGE_DEFAULT,
 			.BindFlags = D3D11_BIND_VERTEX_BUFFER,
 		};
 
 		D3D11_SUBRESOURCE_DATA cubeVertResData = {
-			.pSysMem = cubeVert.data(),
+			.pSysMem = vertices.data(),
 		};
 
 		HR(_device->CreateBuffer(&cubeVertDesc, &cubeVertResData, &_cubeVertBuf));
 	}
 
-	// Cube indices
 	{
-		std::array<unsigned short, 36> cubeIdx = {
-			3, 1, 0, 2, 1, 3,
-			6, 4, 5, 7, 4, 6,
-			11, 9, 8, 10, 9, 11,
-			14, 12, 13, 15, 12, 14,
-			19, 17, 16, 18, 17, 19,
-			22, 20, 21, 23, 20, 22
-		};
-
 		D3D11_BUFFER_DESC cubeIdxDesc = {
-			.ByteWidth = sizeof(cubeIdx),
+			.ByteWidth = static_cast<unsigned int>(indices.size()),
 			.Usage = D3D11_USAGE_DEFAULT,
 			.BindFlags = D3D11_BIND_INDEX_BUFFER,
 		};
 
 		D3D11_SUBRESOURCE_DATA cubeIdxResData = {
-			.pSysMem = cubeIdx.data(),
+			.pSysMem = indices.data(),
 		};
 
 		HR(_device->CreateBuffer(&cubeIdxDesc, &cubeIdxResData, &_cubeIdxBuf));
 	}
 }
 
+void D3DRenderer::populateVRAM(unsigned int reserve_sprites, unsigned int reserve_letters, unsigned int reserve_cubes) {
+	using namespace DirectX;
+
+	// Culling tests against the same projections the shaders get
+	const XMMATRIX pers = XMMatrixPerspectiveFovLH(XM_PIDIV4, _viewWidth / _viewHeight, 0.01f, farPlane);
+	_frustum = Cull::Frustum::fromProjection(pers);
+	_spriteView = { 0.0f, 0.0f, _viewWidth, _viewHeight };
+	_occlusion.resize(static_cast<uint32_t>(_viewWidth) / 4, static_cast<uint32_t>(_viewHeight) / 4, pers);
+
+	// Sprite and cube instances go through rings, text through the retained layout cache
+	_spriteRing.create(_device, reserve_sprites * spriteStride());
+	_cubeRing.create(_device, std::max(reserve_cubes, 1u) * sizeof(Cube::Instance));
+	_fontCache.reserve(reserve_letters);
+	loadCubeMesh();
+
+	// The sprite quad is _viewHeight pixels wide at scale 1
+	_spriteQuad = {
+		Sprite::Vertex { XMFLOAT2(_viewHeight / 2,  _viewHeight / 2), XMFLOAT2(1.0, 1.0) },
+		Sprite::Vertex { XMFLOAT2(_viewHeight / 2, -_viewHeight / 2), XMFLOAT2(1.0, 0.0) },
+		Sprite::Vertex { XMFLOAT2(-_viewHeight / 2, -_viewHeight / 2), XMFLOAT2(0.0, 0.0) },
+
+		Sprite::Vertex { XMFLOAT2(-_viewHeight / 2, -_viewHeight / 2), XMFLOAT2(0.0, 0.0) },
+		Sprite::Vertex { XMFLOAT2(-_viewHeight / 2,  _viewHeight / 2), XMFLOAT2(0.0, 1.0) },
+		Sprite::Vertex { XMFLOAT2(_viewHeight / 2,  _viewHeight / 2), XMFLOAT2(1.0, 1.0) },
+	};
+
+	const XMMATRIX ortho = XMMatrixOrthographicOffCenterLH(
+		0.0f, static_cast<float>(_viewWidth), 0.0f, static_cast<float>(_viewHeight), 0.1f, 100.0f
+	);
+
+	// Software frames take the textures straight from the files
+	if (_raster != nullptr) {
+		_raster->setProjection(pers, ortho);
+
+		_woodTex = loadRasterTexture("res/wood/Wood066_1K_Color.dds");
+		_fontTex = loadRasterTexture("res/font/Hack.dds");
+		_heartTex = loadRasterTexture("res/heart/heart.dds");
+	}
+
+	// Headless runs have nothing else to upload
+	if(_device == nullptr) return;
+
+	// Vertex Sprite buffer
+	{
+		D3D11_BUFFER_DESC spriteVertDesc = {
+			.ByteWidth = sizeof(_spriteQuad),
+			.Usage = D3D11_USAGE_DEFAULT,
+			.BindFlags = D3D11_BIND_VERTEX_BUFFER,
+		};
+
+		D3D11_SUBRESOURCE_DATA spriteVertResData = {
+			.pSysMem = _spriteQuad.data(),
+		};
+
+		HR(_device->CreateBuffer(&spriteVertDesc, &spriteVertResData, &_spriteVertBuf));
+	}
+
+	// Projection buffer, HLSL reads the matrices transposed
+	XMStoreFloat4x4(&_viewProj[0], XMMatrixTranspose(pers));
+	XMStoreFloat4x4(&_viewProj[1], XMMatrixTranspose(ortho));
+	createProjBuffer();
+
+	_textures.residency._budget = _textureBudget;
+	_woodTex = loadTexture("res/wood/Wood066_1K_Color.dds");
+	_fontTex = loadTexture("res/font/Hack.dds");
+	_heartTex = loadTexture("res/heart/heart.dds");
+
+	// The device is free-threaded, so higher mips are created off the render thread
+	_textures.start([this](const Texture::Job& job) {
+		auto& tex = _streamed[job.texture];
+
+		try {
+			createTextureView(tex.file.image, job.firstMip, &tex.next);
+		}
+		catch (DX::com_exception) {
+			tex.next = nullptr;
+		}
+	});
+}
+
+void D3DRenderer::beginFrame() {
+	if(_backend == nullptr) return;
+	PROFILE_ZONE("beginFrame");
+
+	_backend->beginFrame();
+	_frameArena.next();
+	_spriteCull = {};
+	_cubeCull = {};
+	_cubeOcclusion = {};
+	_cubeLodInstances = {};
+
+	// Swap in the textures the streaming thread finished, a failed one keeps its old mips
+	for (auto& job : _textures.update()) {
+		auto& tex = _streamed[job.texture];
+		if (tex.next == nullptr) continue;
+
+		retire(tex.view);
+		tex.view = tex.next;
+		tex.next = nullptr;
+	}
+}
+
 void D3DRenderer::clrScr(const std::array<float, 4>& color) {
-	_context->ClearRenderTargetView(_bBufferTarget, color.data());
-	_context->ClearDepthStencilView(_depthTexView, D3D11_CLEAR_DEPTH, 1.0f, 0);
+	if(_backend == nullptr) return;
+
+	_backend->clear(Backend::handle(_bBufferTarget), color);
+	_backend->clearDepth(Backend::handle(_depthTexView));
+
+	if (_raster != nullptr) {
+		_raster->clear(color);
+		_raster->clearDepth();
+	}
 }
 
-void D3DRenderer::renderCube(const std::span<Cube::Data> cubes) {
-	if(_context == nullptr) return;
+void D3DRenderer::renderCube(Cube::Columns cubes) {
+	if(_backend == nullptr || cubes.empty()) return;
+	PROFILE_ZONE("renderCube");
+
+	// World matrices go straight into the ring, one allocation holds the whole batch
+	_scratch.resize(std::max<size_t>(_scratch.size(), 1));
+	_cubeLodState.resize(cubes.size(), 0);
+	renderOccluders(cubes);
+
+	auto inst = _cubeRing.map(*_backend, _device, cubes.size() * sizeof(Cube::Instance), sizeof(Cube::Instance));
+	recordCubes(cubes, static_cast<Cube::Instance*>(inst.data), inst.offset, 0, _commands.list(0), _scratch[0]);
+	_cubeRing.unmap(*_backend);
+
+	_cubeCull += std::exchange(_scratch[0].cubeCull, {});
+	_cubeOcclusion += std::exchange(_scratch[0].cubeOcclusion, {});
+	addLodInstances(_scratch[0]);
+	const float largest = std::exchange(_scratch[0].largest, 0.0f);
+	requestTexture(_woodTex, largest);
+	requestTexture(_heartTex, largest);
+}
+
+void D3DRenderer::renderSprites(Sprite::Columns sprites) {
+	if(_backend == nullptr || sprites.empty()) return;
+	PROFILE_ZONE("renderSprites");
+	
+	// Update instances, written straight into the ring
+	_scratch.resize(std::max<size_t>(_scratch.size(), 1));
+	auto inst = _spriteRing.map(*_backend, _device, sprites.size() * spriteStride(), spriteStride());
+	recordSprites(sprites, static_cast<std::byte*>(inst.data), inst.offset, 0, _commands.list(0), _scratch[0]);
+	_spriteRing.unmap(*_backend);
+
+	_spriteCull += std::exchange(_scratch[0].spriteCull, {});
+}
+
+void D3DRenderer::renderScene(Sprite::Columns sprites, Cube::Columns cubes, std::span<Font::String> strings) {
+	if(_backend == nullptr) return;
+	PROFILE_ZONE("renderScene");
+
+	// Ring space is mapped up front for every object, the tasks only write their survivors
+	UploadRing::Allocation spriteInst, cubeInst;
+	if (!sprites.empty())
+		spriteInst = _spriteRing.map(*_backend, _device, sprites.size() * spriteStride(), spriteStride());
+	if (!cubes.empty())
+		cubeInst = _cubeRing.map(*_backend, _device, cubes.size() * sizeof(Cube::Instance), sizeof(Cube::Instance));
+
+	const size_t spriteTasks = (sprites.size() + recordGrain - 1) / recordGrain;
+	const size_t cubeTasks = (cubes.size() + recordGrain - 1) / recordGrain;
+	const std::vector<Font::LayoutCache::Range>* textDraws = nullptr;
+
+	// Task 0 lays out text, then come the sprite and cube chunks. Every task
+	// records into the list and scratch after its number, 0 is the calling thread's
+	_commands.reserve(2 + spriteTasks + cubeTasks);
+	_scratch.resize(std::max(_scratch.size(), 2 + spriteTasks + cubeTasks));
+
+	// Occluders have to be in the buffer before any cube task tests against it
+	_cubeLodState.resize(cubes.size(), 0);
+	renderOccluders(cubes);
+
+	auto record = [&](size_t task) {
+		Command::List& list = _commands._lists[task + 1];
+		TaskScratch& scratch = _scratch[task + 1];
+
+		if (task == 0) {
+			PROFILE_ZONE("layout text");
+			textDraws = &_fontCache.update(strings);
+			return;
+		}
+
+		if (--task < spriteTasks) {
+			const size_t first = task * recordGrain;
+			const size_t count = std::min(recordGrain, sprites.size() - first);
+
+			recordSprites(sprites.subspan(first, count), static_cast<std::byte*>(spriteInst.data) + first * spriteStride(),
+				spriteInst.offset, first, list, scratch);
+			return;
+		}
+
+		task -= spriteTasks;
+		const size_t first = task * recordGrain;
+		const size_t count = std::min(recordGrain, cubes.size() - first);
 
-	unsigned int stride = sizeof(Cube::Vertex);
-	unsigned int offset = 0;
+		recordCubes(cubes.subspan(first, count), static_cast<Cube::Instance*>(cubeInst.data) + first,
+			cubeInst.offset, first, list, scratch);
+	};
 
-	_context->IASetInputLayout(_cubeIL);
-	_context->IASetVertexBuffers(0, 1, &_cubeVertBuf, &stride, &offset);
-	_context->IASetIndexBuffer(_cubeIdxBuf, DXGI_FORMAT_R16_UINT, 0);
-	_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	_jobs.parallelFor(1 + spriteTasks + cubeTasks, 1, [&](size_t first, size_t count) {
+		for (size_t task = first; task < first + count; task++) record(task);
+	});
+
+	float largest = 0.0f;
+	for (auto& scratch : _scratch) {
+		_spriteCull += std::exchange(scratch.spriteCull, {});
+		_cubeCull += std::exchange(scratch.cubeCull, {});
+		_cubeOcclusion += std::exchange(scratch.cubeOcclusion, {});
+		addLodInstances(scratch);
+		largest = std::max(largest, std::exchange(scratch.largest, 0.0f));
+	}
 
-	std::array cbuffers = { _projBuf, _cubeModelBuf, };
+	if (!sprites.empty()) _spriteRing.unmap(*_backend);
 
-	_context->VSSetShader(_cubeVS, 0, 0);
-	_context->VSSetConstantBuffers(0, cbuffers.size(), cbuffers.data());
+	if (!cubes.empty()) {
+		_cubeRing.unmap(*_backend);
+
+		requestTexture(_woodTex, largest);
+		requestTexture(_heartTex, largest);
+	}
 
-	_context->RSSetViewports(1, &_viewport);
+	// Text may have to recreate its buffer, so its draws are recorded here
+	submitText(strings, *textDraws);
+}
 
-	std::array textures = {
-		_woodTexView, _heartTexView
+void D3DRenderer::recordSprites(Sprite::Columns sprites, std::byte* out,
+		unsigned int ringOffset, size_t first, Command::List& list, TaskScratch& scratch) {
+	PROFILE_ZONE("recordSprites");
+
+	// The sprite quad is _viewHeight pixels wide at scale 1
+	auto begin = std::chrono::high_resolution_clock::now();
+	const size_t visible = Sprite::cull(_spriteView, _viewHeight / 2.0f, sprites, scratch.visible);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	scratch.spriteCull += { sprites.size(), visible, std::chrono::duration<double, std::milli>(end - begin).count() };
+	if (visible == 0) return;
+
+	// Only survivors reach the ring, packed from the chunk's start
+	if (_compactSprites)
+		Sprite::getCompactInstances(sprites, scratch.visible, { reinterpret_cast<Sprite::CompactInstance*>(out), visible });
+	else
+		Sprite::getWorldMatrices(sprites, scratch.visible, { reinterpret_cast<Sprite::Instance*>(out), visible });
+
+	// Every sprite samples its own region of the atlas pages
+	Draw draw = {
+		.pipeline = {
+			.layout = Backend::handle(_compactSprites ? _spriteCompactIL : _spriteIL),
+			.vertexBufferCount = 2,
+			.vertexBuffers = { Backend::handle(_spriteVertBuf), Backend::handle(_spriteRing._buffer) },
+			.strides = { sizeof(Sprite::Vertex), static_cast<unsigned int>(spriteStride()) },
+			.offsets = { 0, ringOffset },
+			.vs = Backend::handle(_compactSprites ? _spriteCompactVS : _spriteVS),
+			.vsConstants = Backend::handle(_projBuf),
+			.viewport = _viewport,
+			.ps = Backend::handle(_atlasPS),
+			.resourceCount = 1,
+			.resources = { Backend::handle(_spriteAtlasView) },
+			.sampler = Backend::handle(_texSampler),
+			.target = Backend::handle(_bBufferTarget),
+		},
+		.count = 6,
+		.instances = static_cast<unsigned int>(visible),
+		.firstInstance = static_cast<unsigned int>(first),
+		.program = _compactSprites ? Raster::Program::SpriteCompact : Raster::Program::Sprite,
+		.shadow = _spriteRing._shadow.data(),
 	};
 
-	_context->PSSetShader(_combiPS, 0, 0);
-	_context->PSSetShaderResources(0, textures.size(), textures.data());
-	_context->PSSetSamplers(0, 1, &_texSampler);
+	list.record(Render::makeKey(Render::Layer::Background, Render::Pass::Opaque, SpriteProgram, atlasTextureId, 0.0f), DrawOp, draw);
+}
+
+void D3DRenderer::recordCubes(Cube::Columns cubes, Cube::Instance* out,
+		unsigned int ringOffset, size_t first, Command::List& list, TaskScratch& scratch) {
+	PROFILE_ZONE("recordCubes");
 
-	_context->OMSetRenderTargets(1, &_bBufferTarget, _depthTexView);
-	_context->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+	auto begin = std::chrono::high_resolution_clock::now();
+	size_t visible = Cube::cull(_frustum, cubes, scratch.visible);
+	auto end = std::chrono::high_resolution_clock::now();
 
-	DirectX::XMFLOAT4X4 model;
-	for (size_t iter = 0; iter < cubes.size(); iter++) {
-		model = cubes[iter].getWorldMatrix();
+	scratch.cubeCull += { cubes.size(), visible, std::chrono::duration<double, std::milli>(end - begin).count() };
 
-		D3D11_MAPPED_SUBRESOURCE mappedModelBuf = {};
-		_context->Map(_cubeModelBuf, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedModelBuf);
-		memcpy(mappedModelBuf.pData, &model, sizeof(model));
-		_context->Unmap(_cubeModelBuf, 0);
+	if (_occlusionCulling && visible > 0) {
+		begin = std::chrono::high_resolution_clock::now();
+		const size_t frustumVisible = visible;
+		visible = Cube::occlude(_occlusion, cubes, scratch.visible);
+		end = std::chrono::high_resolution_clock::now();
 
-		_context->DrawIndexed(36, 0, 0);
+		scratch.cubeOcclusion += { frustumVisible, visible, std::chrono::duration<double, std::milli>(end - begin).count() };
+	}
+
+	if (visible == 0) return;
+
+	// Closest visible cube decides the mips, a unit cube at depth z spans about focal / z pixels.
+	// Every cube also picks the coarsest level that stays within a pixel of the full mesh.
+	const float focal = _viewHeight / std::tan(DirectX::XM_PIDIV4 / 2.0f);
+	float nearest = farPlane;
+	std::array<uint32_t, Mesh::maxLods + 1> lodStart = {};
+	for (uint32_t idx : scratch.visible) {
+		const Cube::Position& pos = cubes.position[idx];
+		const Cube::Scale& scale = cubes.scale[idx];
+
+		uint8_t& lod = _cubeLodState[first + idx];
+		if (pos.z <= 0.01f) {
+			lod = 0;
+			lodStart[1]++;
+			continue;
+		}
+
+		const float size = std::max({ scale.x, scale.y, scale.z }) * focal / pos.z;
+		lod = static_cast<uint8_t>(Mesh::selectLod(_cubeLods, size * _cubeExtent * 0.5f, lod));
+		lodStart[lod + 1]++;
+
+		scratch.largest = std::max(scratch.largest, size);
+		nearest = std::min(nearest, pos.z);
+	}
+
+	// Instances of one level sit back to back, so each level is a single draw
+	std::partial_sum(lodStart.begin(), lodStart.end(), lodStart.begin());
+	std::span<const uint32_t> ordered = scratch.visible;
+	if (_cubeLods.size() > 1) {
+		scratch.byLod.resize(visible);
+		std::array<uint32_t, Mesh::maxLods> fill;
+		std::copy_n(lodStart.begin(), fill.size(), fill.begin());
+		for (uint32_t idx : scratch.visible) scratch.byLod[fill[_cubeLodState[first + idx]]++] = idx;
+		ordered = scratch.byLod;
+	}
+
+	// Matrices come cached from the update, only the visible ones are copied
+	Cube::gatherWorldMatrices(cubes, ordered, { out, visible });
+
+	Draw draw = {
+		.pipeline = {
+			.layout = Backend::handle(_cubeQuantized ? _cubeMeshIL : _cubeIL),
+			.vertexBufferCount = 2,
+			.vertexBuffers = { Backend::handle(_cubeVertBuf), Backend::handle(_cubeRing._buffer) },
+			.strides = { _cubeVertexStride, sizeof(Cube::Instance) },
+			.offsets = { 0, ringOffset },
+			.indexBuffer = Backend::handle(_cubeIdxBuf),
+			.indexFormat = _cubeIndexFormat,
+			.vs = Backend::handle(_cubeVS),
+			.vsConstants = Backend::handle(_projBuf),
+			.viewport = _viewport,
+			.ps = Backend::handle(_combiPS),
+			.resourceCount = 2,
+			.resources = { Backend::handle(textureView(_woodTex)), Backend::handle(textureView(_heartTex)) },
+			.sampler = Backend::handle(_texSampler),
+			.target = Backend::handle(_bBufferTarget),
+			.depth = Backend::handle(_depthTexView),
+		},
+		.indexed = true,
+		.program = Raster::Program::Cube,
+		.shadow = _cubeRing._shadow.data(),
+	};
+
+	// Chunks of one batch sort front to back by their closest cube
+	const uint64_t key = Render::makeKey(Render::Layer::World, Render::Pass::Opaque, CubeProgram,
+		static_cast<uint16_t>(_woodTex), nearest / farPlane);
+
+	for (size_t level = 0; level < _cubeLods.size(); level++) {
+		const uint32_t count = lodStart[level + 1] - lodStart[level];
+		if (count == 0) continue;
+
+		draw.count = _cubeLods[level].indexCount;
+		draw.firstIndex = _cubeLods[level].firstIndex;
+		draw.instances = count;
+		draw.firstInstance = static_cast<unsigned int>(first) + lodStart[level];
+		scratch.lodInstances[level] += count;
+		list.record(key, DrawOp, draw);
 	}
 }
 
-void D3DRenderer::renderSprites(const std::span<Sprite::Data> sprites) {
-	if(_context == nullptr) return;
-	
-	// Update instances
-	_spriteInstMem.reserve(sprites.size());
-	_spriteInstMem.clear();
-	for (size_t iter = 0; iter < sprites.size(); iter++)
-		_spriteInstMem.push_back({ sprites[iter].getWorldMatrix() });
+void D3DRenderer::addLodInstances(TaskScratch& scratch) {
+	for (size_t level = 0; level < _cubeLodInstances.size(); level++) _cubeLodInstances[level] += std::exchange(scratch.lodInstances[level], 0);
+}
 
-	D3D11_MAPPED_SUBRESOURCE mappedInstBuf = {};
-	_context->Map(_spriteInstBuf, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedInstBuf);
-	memcpy(mappedInstBuf.pData, _spriteInstMem.data(), _spriteInstMem.size() * sizeof(Sprite::Instance));
-	_context->Unmap(_spriteInstBuf, 0);
+void D3DRenderer::renderOccluders(Cube::Columns cubes) {
+	if (!_occlusionCulling || cubes.empty()) return;
+	PROFILE_ZONE("renderOccluders");
 
-	// Start drawing
-	unsigned int stride[] = { sizeof(Sprite::Vertex), sizeof(Sprite::Instance) };
-	unsigned int offset[] = { 0, 0 };
-	ID3D11Buffer* vertBufs[] = { _spriteVertBuf, _spriteInstBuf };
+	auto begin = std::chrono::high_resolution_clock::now();
 
-	_context->IASetInputLayout(_spriteIL);
-	_context->IASetVertexBuffers(0, 2, vertBufs, stride, offset);
-	_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	// Cubes on screen ranked by their smallest half extent over depth, about how much they hide
+	Cube::cull(_frustum, cubes, _occluders);
+	auto scores = _frameArena.current().array<OccluderScore>(_occluders.size());
+	size_t scored = 0;
+	for (uint32_t idx : _occluders) {
+		const Cube::Position& pos = cubes.position[idx];
+		const Cube::Scale& scale = cubes.scale[idx];
+		if (pos.z <= 0.01f) continue;
 
-	_context->VSSetShader(_spriteVS, 0, 0);
-	_context->VSSetConstantBuffers(0, 1, &_projBuf);
+		scores[scored++] = { std::min({ scale.x, scale.y, scale.z }) / pos.z, idx };
+	}
 
-	_context->RSSetViewports(1, &_viewport);
+	const size_t count = std::min(maxOccluders, scored);
+	std::partial_sort(scores.begin(), scores.begin() + count, scores.begin() + scored,
+		[](const OccluderScore& a, const OccluderScore& b) { return a.score > b.score; });
 
-	_context->PSSetShader(_PS, 0, 0);
-	_context->PSSetShaderResources(0, 1, &_woodTexView);
-	_context->PSSetSamplers(0, 1, &_texSampler);
+	auto ranked = _frameArena.current().array<uint32_t>(count);
+	auto models = _frameArena.current().array<Cube::Instance>(count);
+	for (size_t idx = 0; idx < count; idx++) ranked[idx] = scores[idx].index;
+	Cube::gatherWorldMatrices(cubes, ranked, models);
 
-	_context->OMSetRenderTargets(1, &_bBufferTarget, nullptr);
-	_context->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+	_occlusion.clear();
+	for (const Cube::Instance& model : models)
+		_occlusion.renderBox(DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&model.model)));
+	_occlusion.buildHiZ();
 
-	_context->DrawInstanced(6, sprites.size(), 0, 0);
+	auto end = std::chrono::high_resolution_clock::now();
+	_cubeOcclusion.ms += std::chrono::duration<double, std::milli>(end - begin).count();
 }
 
 void D3DRenderer::renderString(const std::span<Font::String> strings) {
-	using namespace DirectX;
+	if(_backend == nullptr) return;
+	PROFILE_ZONE("renderString");
 
-	if(_context == nullptr) return;
+	// Only strings that are new since the last frames get laid out
+	submitText(strings, _fontCache.update(strings));
+}
 
-	// Generated vertices for string
-	size_t overall_size = 0;
-	for (auto& str : strings) overall_size += str.data.size();
+void D3DRenderer::submitText(std::span<Font::String> strings, const std::vector<Font::LayoutCache::Range>& draws) {
+	// Text queued earlier in the frame still reads the glyphs from before a
+	// compaction, their buffer waits for present and a new one takes over
+	if (_raster != nullptr && !_fontCache._previous.empty())
+		_retiredGlyphs.push_back(std::move(_fontCache._previous));
 
-	_fontVertMem.reserve(overall_size * 6);
-	_fontVertMem.clear();
+	if ((_fontCache._resized || _fontCache._stats.compactions > 0) && _device != nullptr) {
+		_retiredBuffers.push_back(std::exchange(_fontGlyphBuf, nullptr));
 
-	const float lWidth = 2002.0f / 26.0f, lHeight = 150.0f;
-	const float lAspect = lWidth / lHeight;
+		D3D11_BUFFER_DESC fontGlyphDesc = {
+			.ByteWidth = static_cast<unsigned int>(_fontCache._glyphs.size() * sizeof(Font::Glyph)),
+			.Usage = D3D11_USAGE_DEFAULT,
+			.BindFlags = D3D11_BIND_VERTEX_BUFFER,
+		};
 
-	for (auto& str : strings) {
-		const float offX = static_cast<float>(str.pxOffset[0]);
-		const float offY = static_cast<float>(str.pxOffset[1]);
+		HR(_device->CreateBuffer(&fontGlyphDesc, nullptr, &_fontGlyphBuf));
+	}
 
-		const float lVWidth = str.fontSize * lAspect;
-		const float lVHeight = str.fontSize;
+	// And only their range is uploaded
+	if (_fontCache._dirtyEnd > _fontCache._dirtyBegin) {
+		PROFILE_ZONE("upload text");
+		const size_t first = _fontCache._dirtyBegin;
+		const size_t count = _fontCache._dirtyEnd - first;
 
-		for (size_t i = 0; i < str.data.size(); i++) {
-			const int idx = str.data[i] - 'A';
-			if (idx < 0 || idx > 25) continue;
+		_backend->update(Backend::handle(_fontGlyphBuf), first * sizeof(Font::Glyph), count * sizeof(Font::Glyph),
+			_fontCache._glyphs.data() + first);
+	}
+	_fontCache.clearDirty();
 
-			const float tStartX = static_cast<float>(idx) * 1.0f / 26.0f;
-			const float tEndX = static_cast<float>(idx + 1) * 1.0f / 26.0f;
-			const float iOffX = offX + lVWidth * static_cast<float>(i);
+	if (draws.empty()) return;
 
-			_fontVertMem.push_back(Sprite::Vertex{ XMFLOAT2(iOffX + lVWidth, offY + lVHeight), XMFLOAT2(tEndX, 0.0f) });
-			_fontVertMem.push_back(Sprite::Vertex{ XMFLOAT2(iOffX + lVWidth, offY			  ), XMFLOAT2(tEndX, 1.0f) });
-			_fontVertMem.push_back(Sprite::Vertex{ XMFLOAT2(iOffX			 , offY			  ), XMFLOAT2(tStartX, 1.0f) });
-			_fontVertMem.push_back(Sprite::Vertex{ XMFLOAT2(iOffX			 , offY			  ), XMFLOAT2(tStartX, 1.0f) });
-			_fontVertMem.push_back(Sprite::Vertex{ XMFLOAT2(iOffX			 , offY + lVHeight), XMFLOAT2(tStartX, 0.0f) });
-			_fontVertMem.push_back(Sprite::Vertex{ XMFLOAT2(iOffX + lVWidth, offY + lVHeight), XMFLOAT2(tEndX, 0.0f) });
-		}
+	// Glyphs are fontSize pixels tall, the atlas is one row of them
+	if (_fontTex < _streamed.size()) {
+		const DDS::Image& atlas = _streamed[_fontTex].file.image;
+
+		int largest = 0;
+		for (auto& str : strings) largest = std::max(largest, str.fontSize);
+		requestTexture(_fontTex, static_cast<float>(largest * atlas.width) / static_cast<float>(atlas.height));
 	}
 
-	D3D11_MAPPED_SUBRESOURCE mappedVertBuf = {};
-	_context->Map(_fontVertBuf, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedVertBuf);
-	memcpy(mappedVertBuf.pData, _fontVertMem.data(), _fontVertMem.size() * sizeof(Sprite::Vertex));
-	_context->Unmap(_fontVertBuf, 0);
+	// Draw string, fontVS expands every glyph instance into a quad
+	Draw draw = {
+		.pipeline = {
+			.layout = Backend::handle(_fontIL),
+			.vertexBufferCount = 1,
+			.vertexBuffers = { Backend::handle(_fontGlyphBuf) },
+			.strides = { sizeof(Font::Glyph) },
+			.offsets = { 0 },
+			.vs = Backend::handle(_fontVS),
+			.vsConstants = Backend::handle(_projBuf),
+			.viewport = _viewport,
+			.ps = Backend::handle(_PS),
+			.resourceCount = 1,
+			.resources = { Backend::handle(textureView(_fontTex)) },
+			.sampler = Backend::handle(_texSampler),
+			.target = Backend::handle(_bBufferTarget),
+			.blend = Backend::handle(_blendState),
+		},
+		.count = 6,
+		.program = Raster::Program::Font,
+		.shadow = _fontCache._glyphs.data(),
+	};
 
-	// Draw string
-	unsigned int stride[] = { sizeof(Sprite::Vertex) };
-	unsigned int offset[] = { 0 };
-	ID3D11Buffer* vertBufs[] = { _fontVertBuf };
+	// Ranges share the pipeline, so only the first one binds anything
+	const uint64_t key = Render::makeKey(Render::Layer::Overlay, Render::Pass::Transparent,
+		FontProgram, static_cast<uint16_t>(_fontTex), 0.0f);
 
-	_context->IASetInputLayout(_spriteIL);
-	_context->IASetVertexBuffers(0, 1, vertBufs, stride, offset);
-	_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	for (auto& range : draws) {
+		draw.instances = static_cast<unsigned int>(range.count);
+		draw.firstInstance = static_cast<unsigned int>(range.first);
+		submit(key, draw);
+	}
+}
 
-	_context->VSSetShader(_fontVS, 0, 0);
-	_context->VSSetConstantBuffers(0, 1, &_projBuf);
+void D3DRenderer::present() {
+	if(_backend == nullptr) return;
 
-	_context->RSSetViewports(1, &_viewport);
+	PROFILE_ZONE("present");
 
-	_context->PSSetShader(_PS, 0, 0);
-	_context->PSSetShaderResources(0, 1, &_fontTexView);
-	_context->PSSetSamplers(0, 1, &_texSampler);
+	flush();
+	if (_raster != nullptr) {
+		PROFILE_ZONE("rasterize");
+		_raster->flush();
+	}
 
-	_context->OMSetRenderTargets(1, &_bBufferTarget, nullptr);
-	_context->OMSetBlendState(_blendState, nullptr, 0xFFFFFFFF);
+	// Nothing queued reads the old contents any more
+	_spriteRing.recycle();
+	_cubeRing.recycle();
+	for (auto& buffer : _retiredBuffers) retire(buffer);
+	_retiredBuffers.clear();
+	_retiredGlyphs.clear();
 
-	_context->Draw(_fontVertMem.size(), 0);
+	_backend->present();
 }
 
-void D3DRenderer::present() {
-	_swapChain->Present(1, 0);
+void D3DRenderer::submit(uint64_t key, const Draw& draw) {
+	_commands.list(0).record(key, DrawOp, draw);
+}
+
+void D3DRenderer::flush() {
+	PROFILE_ZONE("flush");
+
+	// The backend drops every bind the previous draw already made
+	_commands.replay([this](const Command::List::Header& header, std::span<const std::byte> bytes) {
+		if (header.op != DrawOp) return;
+
+		const auto draw = Command::packet<Draw>(bytes);
+		_backend->bind(draw.pipeline);
+
+		if (draw.indexed)
+			_backend->drawIndexedInstanced(draw.count, draw.instances, draw.firstIndex, 0, draw.firstInstance);
+		else
+			_backend->drawInstanced(draw.count, draw.instances, 0, draw.firstInstance);
+
+		if (_raster != nullptr) rasterDraw(draw);
+	});
+
+	_commands.clear();
+}
+
+void D3DRenderer::rasterDraw(const Draw& draw) {
+	// Instances are read where the backend would have fetched them, the
+	// headless rings and the glyphs the draw was recorded against
+	Raster::Draw soft = {
+		.program = draw.program,
+		.count = draw.count,
+		.instanceCount = draw.instances,
+	};
+
+	auto texture = [&](Texture::Handle handle) {
+		return (handle < _rasterTextures.size()) ? &_rasterTextures[handle] : nullptr;
+	};
+
+	switch (draw.program) {
+	case Raster::Program::Cube:
+		soft.vertices = _rasterCubeIndices.empty() ? Cube::vertices.data() : _rasterCubeVertices.data();
+		soft.indices = _rasterCubeIndices.empty() ? Cube::indices.data() : _rasterCubeIndices.data() + draw.firstIndex;
+		soft.count = _rasterCubeIndices.empty() ? static_cast<uint32_t>(Cube::indices.size()) : draw.count;
+		soft.instances = static_cast<const std::byte*>(draw.shadow) + draw.pipeline.offsets[1] + draw.firstInstance * sizeof(Cube::Instance);
+		soft.textures = { texture(_woodTex), texture(_heartTex) };
+		break;
+
+	case Raster::Program::Sprite:
+		soft.vertices = _spriteQuad.data();
+		soft.instances = static_cast<const std::byte*>(draw.shadow) + draw.pipeline.offsets[1] + draw.firstInstance * sizeof(Sprite::Instance);
+		soft.textures = { &_rasterAtlas };
+		break;
+
+	case Raster::Program::SpriteCompact:
+		soft.vertices = _spriteQuad.data();
+		soft.instances = static_cast<const std::byte*>(draw.shadow) + draw.pipeline.offsets[1] + draw.firstInstance * sizeof(Sprite::CompactInstance);
+		soft.textures = { &_rasterAtlas };
+		soft.regions = _spriteRegions.data();
+		break;
+
+	case Raster::Program::Font:
+		soft.instances = static_cast<const Font::Glyph*>(draw.shadow) + draw.firstInstance;
+		soft.textures = { texture(_fontTex) };
+		break;
+	}
+
+	_raster->submit(soft);
 }
 
 void D3DRenderer::cleanUp() {
+	_backend.reset();
+
 	retire(_texSampler);
-	retire(_fontTexView);
-	retire(_woodTexView);
-	retire(_heartTexView);
+	retire(_spriteAtlasView);
+	_textures.stop();
+	for (auto& tex : _streamed) {
+		retire(tex.view);
+		retire(tex.next);
+	}
+	_streamed.clear();
 	retire(_blendState);
 	retire(_projBuf);
-	retire(_spriteInstBuf);
+	_spriteRing.release();
+	_cubeRing.release();
+	retire(_fontGlyphBuf);
+	for (auto& buffer : _retiredBuffers) retire(buffer);
+	_retiredBuffers.clear();
 	retire(_spriteVertBuf);
-	retire(_fontVertBuf);
-	retire(_cubeModelBuf);
 	retire(_cubeIdxBuf);
 	retire(_cubeVertBuf);
 	retire(_spriteIL);
+	retire(_spriteCompactIL);
+	retire(_fontIL);
 	retire(_cubeIL);
+	retire(_cubeMeshIL);
 	retire(_cubeVS);
 	retire(_fontVS);
 	retire(_spriteVS);
+	retire(_spriteCompactVS);
+	retire(_atlasPS);
 	retire(_combiPS);
 	retire(_PS);
 	retire(_depthTexView);
@@ -6,10 +6,32 @@
 #include <directxmath.h>
 
 #include <span>
+#include <deque>
 #include <vector>
 #include <string>
+#include <memory>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <unordered_map>
 
+#include <backend.h>
+#include <uploadring.h>
+#include <renderqueue.h>
+#include <commandlist.h>
+#include <jobs.h>
+#include <culling.h>
+#include <occlusion.h>
+#include <raster.h>
+#include <arena.h>
+#include <shaderpack.h>
+#include <dds.h>
+#include <mesh.h>
+#include <atlas.h>
+#include <texturestream.h>
 #include <font.h>
+#include <fontcache.h>
 #include <sprite.h>
 #include <cube.h>
 #include <window.h>
@@ -24,38 +46,139 @@ struct D3DRenderer {
 
 	ID3D11DeviceContext* _context = nullptr;
 	IDXGISwapChain* _swapChain = nullptr;
+	std::unique_ptr<Backend::Context> _backend;
 
-	D3D11_VIEWPORT _viewport = {};
+	Backend::Viewport _viewport = {};
 	ID3D11RenderTargetView* _bBufferTarget = nullptr;
 	ID3D11BlendState* _blendState = nullptr;
 	ID3D11Texture2D* _depthTex = nullptr;
 	ID3D11DepthStencilView* _depthTexView = nullptr;
 
-	std::vector<Sprite::Instance> _spriteInstMem;
-	std::vector<Sprite::Vertex> _fontVertMem;
-
 	ID3D11Buffer* _cubeVertBuf = nullptr;
 	ID3D11Buffer* _cubeIdxBuf = nullptr;
-	ID3D11Buffer* _cubeModelBuf = nullptr;
+	UploadRing _cubeRing;
+
+	// Cube geometry, res/cube.mesh as mapped or the built-in floats without it
+	bool _cubeQuantized = false;
+	unsigned int _cubeVertexStride = sizeof(Cube::Vertex);
+	Backend::IndexFormat _cubeIndexFormat = Backend::IndexFormat::UInt16;
+	std::vector<Cube::Vertex> _rasterCubeVertices;     // decoded mesh, empty draws the built-in cube
+	std::vector<uint16_t> _rasterCubeIndices;
+
+	// Levels of detail in the index buffer, picked per cube from its size on screen
+	std::vector<Mesh::Lod> _cubeLods = { { 0, static_cast<uint32_t>(Cube::indices.size()), 0.0f } };
+	float _cubeExtent = 2.0f;                   // largest side of the mesh bounds
+	std::vector<uint8_t> _cubeLodState;         // last level per cube, for the hysteresis
+	std::array<size_t, Mesh::maxLods> _cubeLodInstances = {};  // this frame
 
 	ID3D11Buffer* _spriteVertBuf = nullptr;
-	ID3D11Buffer* _fontVertBuf = nullptr;
-	ID3D11Buffer* _spriteInstBuf = nullptr;
+	ID3D11Buffer* _fontGlyphBuf = nullptr;
+	Font::LayoutCache _fontCache;
+
+	// Replaced mid-frame while queued draws still read them, released at present
+	std::vector<ID3D11Buffer*> _retiredBuffers;
+	std::vector<std::vector<Font::Glyph>> _retiredGlyphs;
+	UploadRing _spriteRing;
 	ID3D11Buffer* _projBuf = nullptr;
 
+	// Sprites upload Sprite::CompactInstance and spriteCompactVS builds the
+	// matrices. Set before populateVRAM.
+	bool _compactSprites = false;
+
+	// Back half of projBuf, loadSpriteAtlas fills it in path order
+	std::array<DirectX::XMFLOAT4X4, 2> _viewProj = {};
+
+	// Between the matrices and the regions, cubeVS dequantizes with min + unorm * scale.
+	// Min 0 and scale 1 pass the built-in float cube through unchanged.
+	std::array<DirectX::XMFLOAT4, 2> _cubeBounds = { DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f), DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 0.0f) };
+	std::vector<Sprite::Region> _spriteRegions = std::vector<Sprite::Region>(Sprite::maxRegions, { { 0.0f, 0.0f, 1.0f, 1.0f }, 0, {} });
+
 	ID3D11VertexShader* _cubeVS = nullptr;
 	ID3D11VertexShader* _spriteVS = nullptr;
+	ID3D11VertexShader* _spriteCompactVS = nullptr;
 	ID3D11VertexShader* _fontVS = nullptr;
 	ID3D11PixelShader* _PS = nullptr;
 	ID3D11PixelShader* _combiPS = nullptr;
+	ID3D11PixelShader* _atlasPS = nullptr;
 	ID3D11InputLayout* _spriteIL = nullptr;
+	ID3D11InputLayout* _spriteCompactIL = nullptr;
+	ID3D11InputLayout* _fontIL = nullptr;
 	ID3D11InputLayout* _cubeIL = nullptr;
+	ID3D11InputLayout* _cubeMeshIL = nullptr;       // cubeVS fed Mesh::Vertex
 
-	ID3D11ShaderResourceView* _heartTexView = nullptr;
-	ID3D11ShaderResourceView* _woodTexView = nullptr;
-	ID3D11ShaderResourceView* _fontTexView = nullptr;
+	// Views only cover the resident mips, which also clamps the sampled LOD
+	struct StreamedTexture {
+		DDS::File file;
+		ID3D11ShaderResourceView* view = nullptr;
+		ID3D11ShaderResourceView* next = nullptr;   // written by the streaming thread
+	};
+
+	Texture::Streamer _textures;
+	std::deque<StreamedTexture> _streamed;
+	Texture::Handle _heartTex = 0, _woodTex = 0, _fontTex = 0;
+	size_t _textureBudget = 64 << 20;
+	ID3D11ShaderResourceView* _spriteAtlasView = nullptr;
 	ID3D11SamplerState* _texSampler = nullptr;
 
+	// Software rendering, replays the same draws on the CPU. Textures are
+	// indexed by the same handles the streamed ones use.
+	std::unique_ptr<Raster::Device> _raster;
+	std::vector<Raster::Texture> _rasterTextures;
+	Raster::Texture _rasterAtlas;
+	std::array<Sprite::Vertex, 6> _spriteQuad = {};
+
+	// Uploads happen at record time, the draws themselves wait for present in key order
+	struct Draw {
+		Backend::Pipeline pipeline;
+		unsigned int count = 0;         // vertices, or indices when indexed
+		unsigned int instances = 0;
+		unsigned int firstInstance = 0;
+		unsigned int firstIndex = 0;
+		bool indexed = false;
+		Raster::Program program = Raster::Program::Cube;  // what the software rasterizer runs instead
+		const void* shadow = nullptr;   // and where it reads the instances, the ring or glyphs recorded against
+	};
+
+	// Instances per recording task when renderScene splits a span
+	static constexpr size_t recordGrain = 16384;
+
+	Command::Stream _commands;
+	Jobs::Scheduler _jobs;
+
+	// Transient data of this and the last frame, beginFrame drops the older
+	Arena::Frames _frameArena;
+
+	// Per recording task, indexed like the command lists
+	struct TaskScratch {
+		std::vector<uint32_t> visible;
+		std::vector<uint32_t> byLod;    // visible, grouped by level of detail
+		Cull::Stats spriteCull, cubeCull, cubeOcclusion;
+		float largest = 0.0f;       // biggest projected cube, decides the mips
+		std::array<size_t, Mesh::maxLods> lodInstances = {};
+	};
+
+	std::vector<TaskScratch> _scratch;
+	Cull::Frustum _frustum = {};
+	Cull::Rect _spriteView = {};
+	Cull::Stats _spriteCull, _cubeCull;     // this frame
+
+	// The biggest cubes on screen are drawn into a quarter resolution depth
+	// buffer first, cubes hidden behind them are dropped before recording
+	static constexpr size_t maxOccluders = 32;
+
+	Occlusion::Buffer _occlusion;
+	bool _occlusionCulling = true;
+	std::vector<uint32_t> _occluders;
+
+	struct OccluderScore {
+		float score;
+		uint32_t index;
+	};
+	Cull::Stats _cubeOcclusion;             // this frame, tested are the frustum survivors
+
+	Shader::Pack _shaderPack;
+	std::unordered_map<uint64_t, std::vector<std::byte>> _shaderCompiled;
+
 	D3DRenderer(Window& _win) : _sysWin(_win) {
 		int _width, _height;
 		SDL_GetWindowSize(_sysWin.SDL, &_width, &_height);
@@ -64,16 +187,56 @@ struct D3DRenderer {
 		this->_viewHeight = static_cast<float>(_height);
 	};
 
+	D3DRenderer(Window& _win, int _width, int _height) : _sysWin(_win) {
+		this->_viewWidth = static_cast<float>(_width);
+		this->_viewHeight = static_cast<float>(_height);
+	};
+
 	void init();
+	void initHeadless();
+
+	// Headless, but every frame is also rasterized on the CPU
+	void initSoftware();
 
-	void populateVRAM(unsigned int reserve_sprites, unsigned int reserve_letters);
+	// Last software frame as a binary PPM, false without one
+	bool saveFrame(const std::string& path) const;
 
+	void populateVRAM(unsigned int reserve_sprites, unsigned int reserve_letters, unsigned int reserve_cubes);
+
+	// Packs sprite images into shared atlas pages, regions come back in path order
+	std::vector<Atlas::Region> loadSpriteAtlas(std::span<const char* const> paths);
+
+	void beginFrame();
 	void clrScr(const std::array<float, 4>&);
-	void renderCube(const std::span<Cube::Data>);
-	void renderSprites(const std::span<Sprite::Data>);
+	void renderCube(Cube::Columns);
+	void renderSprites(Sprite::Columns);
 	void renderString(const std::span<Font::String>);
+
+	// All three at once, recorded in parallel and replayed in the same order every time
+	void renderScene(Sprite::Columns, Cube::Columns, std::span<Font::String>);
 	void present();
 
+	void submit(uint64_t key, const Draw& draw);
+	void flush();
+
+	// Cull the chunk, fill `out` with the survivors and record their draw,
+	// `first` is the chunk's offset into the ring allocation
+	void recordSprites(Sprite::Columns, std::byte* out, unsigned int ringOffset, size_t first, Command::List&, TaskScratch&);
+	void recordCubes(Cube::Columns, Cube::Instance* out, unsigned int ringOffset, size_t first, Command::List&, TaskScratch&);
+	void addLodInstances(TaskScratch&);
+	void submitText(std::span<Font::String>, const std::vector<Font::LayoutCache::Range>&);
+	void renderOccluders(Cube::Columns);
+	void rasterDraw(const Draw&);
+
+	// Bytes per sprite in the ring, depends on _compactSprites
+	size_t spriteStride() const;
+
+	// Recreates projBuf from _viewProj, _cubeBounds and _spriteRegions
+	void createProjBuffer();
+
+	// Cube vertex and index buffers straight from the mapped mesh file
+	void loadCubeMesh();
+
 	template<typename T> void retire(T& COMobj) {
 		if (COMobj == nullptr)
 			return;
@@ -86,6 +249,18 @@ struct D3DRenderer {
 
 	void deviceSetup();
 
-	ID3DBlob* compileShader(const wchar_t*, const char*, const char*);
+	ID3DBlob* compileShader(const wchar_t*, const Shader::Key&);
+	void openShaderPack();
+	std::span<const std::byte> shaderBytecode(const Shader::Key&);
+	void createVS(const Shader::Key&, ID3D11VertexShader**,
+		std::span<const D3D11_INPUT_ELEMENT_DESC> = {}, ID3D11InputLayout** = nullptr);
+	void createPS(const Shader::Key&, ID3D11PixelShader**);
+	void buildShaderPack();
 	void shaderSetup();
+
+	Texture::Handle loadTexture(const char*);
+	Texture::Handle loadRasterTexture(const char*);
+	void createTextureView(const DDS::Image&, uint32_t, ID3D11ShaderResourceView**);
+	void requestTexture(Texture::Handle, float);
+	ID3D11ShaderResourceView* textureView(Texture::Handle);
 };
@@ -0,0 +1,465 @@
+#include <dds.h>
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include <mappedfile.h>
+
+namespace {
+	constexpr uint32_t fourCC(char a, char b, char c, char d) {
+		return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8)
+			| (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+	}
+
+	constexpr uint32_t magic = fourCC('D', 'D', 'S', ' ');
+
+	// Header flags
+	constexpr uint32_t flagPitch = 0x8;
+	constexpr uint32_t flagLinearSize = 0x80000;
+	constexpr uint32_t flagDepth = 0x800000;
+
+	// Pixel format flags
+	constexpr uint32_t pfAlpha = 0x2;
+	constexpr uint32_t pfFourCC = 0x4;
+	constexpr uint32_t pfRGB = 0x40;
+	constexpr uint32_t pfLuminance = 0x20000;
+
+	constexpr uint32_t caps2Cubemap = 0x200;
+	constexpr uint32_t caps2Volume = 0x200000;
+
+	// DX10 extension
+	constexpr uint32_t dimensionTexture2D = 3;
+	constexpr uint32_t miscTextureCube = 0x4;
+
+	constexpr uint32_t maxSize = 16384;
+	constexpr uint32_t maxArraySize = 2048;
+
+	struct PixelFormat {
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t bitCount;
+		uint32_t rMask, gMask, bMask, aMask;
+	};
+
+	struct Header {
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		PixelFormat format;
+		uint32_t caps, caps2, caps3, caps4;
+		uint32_t reserved2;
+	};
+
+	struct HeaderDX10 {
+		uint32_t dxgiFormat;
+		uint32_t resourceDimension;
+		uint32_t miscFlag;
+		uint32_t arraySize;
+		uint32_t miscFlags2;
+	};
+
+	static_assert(sizeof(PixelFormat) == 32);
+	static_assert(sizeof(Header) == 124);
+	static_assert(sizeof(HeaderDX10) == 20);
+
+	// DXGI_FORMAT values, kept here so the parser needs no D3D headers
+	enum Format : uint32_t {
+		R32G32B32A32_FLOAT = 2,
+		R16G16B16A16_FLOAT = 10,
+		R16G16B16A16_UNORM = 11,
+		R32G32_FLOAT = 16,
+		R10G10B10A2_UNORM = 24,
+		R8G8B8A8_UNORM = 28,
+		R16G16_FLOAT = 34,
+		R16G16_UNORM = 35,
+		R32_FLOAT = 41,
+		R8G8_UNORM = 49,
+		R16_FLOAT = 54,
+		R16_UNORM = 56,
+		R8_UNORM = 61,
+		A8_UNORM = 65,
+		BC1_UNORM = 71,
+		BC2_UNORM = 74,
+		BC3_UNORM = 77,
+		BC4_UNORM = 80,
+		BC4_SNORM = 81,
+		BC5_UNORM = 83,
+		BC5_SNORM = 84,
+		B5G6R5_UNORM = 85,
+		B5G5R5A1_UNORM = 86,
+		B8G8R8A8_UNORM = 87,
+		B8G8R8X8_UNORM = 88,
+		B4G4R4A4_UNORM = 115,
+	};
+
+	bool masks(const PixelFormat& pf, uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+		return pf.rMask == r && pf.gMask == g && pf.bMask == b && pf.aMask == a;
+	}
+
+	// Legacy pixel formats written by older tools, e.g. the GIMP exporter
+	uint32_t legacyFormat(const PixelFormat& pf) {
+		if (pf.flags & pfFourCC) {
+			switch (pf.fourCC) {
+				case fourCC('D', 'X', 'T', '1'): return BC1_UNORM;
+				case fourCC('D', 'X', 'T', '2'):
+				case fourCC('D', 'X', 'T', '3'): return BC2_UNORM;
+				case fourCC('D', 'X', 'T', '4'):
+				case fourCC('D', 'X', 'T', '5'): return BC3_UNORM;
+				case fourCC('A', 'T', 'I', '1'):
+				case fourCC('B', 'C', '4', 'U'): return BC4_UNORM;
+				case fourCC('B', 'C', '4', 'S'): return BC4_SNORM;
+				case fourCC('A', 'T', 'I', '2'):
+				case fourCC('B', 'C', '5', 'U'): return BC5_UNORM;
+				case fourCC('B', 'C', '5', 'S'): return BC5_SNORM;
+
+				// D3DFORMAT values stored in place of a fourCC
+				case 36: return R16G16B16A16_UNORM;
+				case 111: return R16_FLOAT;
+				case 112: return R16G16_FLOAT;
+				case 113: return R16G16B16A16_FLOAT;
+				case 114: return R32_FLOAT;
+				case 115: return R32G32_FLOAT;
+				case 116: return R32G32B32A32_FLOAT;
+			}
+			return 0;
+		}
+
+		if (pf.flags & pfRGB) {
+			switch (pf.bitCount) {
+				case 32:
+					if (masks(pf, 0xff, 0xff00, 0xff0000, 0xff000000)) return R8G8B8A8_UNORM;
+					if (masks(pf, 0xff0000, 0xff00, 0xff, 0xff000000)) return B8G8R8A8_UNORM;
+					if (masks(pf, 0xff0000, 0xff00, 0xff, 0)) return B8G8R8X8_UNORM;
+					// Both orders mean the same format, older writers swapped them
+					if (masks(pf, 0x3ff, 0xffc00, 0x3ff00000, 0xc0000000)) return R10G10B10A2_UNORM;
+					if (masks(pf, 0x3ff00000, 0xffc00, 0x3ff, 0xc0000000)) return R10G10B10A2_UNORM;
+					if (masks(pf, 0xffff, 0xffff0000, 0, 0)) return R16G16_UNORM;
+					if (masks(pf, 0xffffffff, 0, 0, 0)) return R32_FLOAT;
+					break;
+				case 16:
+					if (masks(pf, 0x7c00, 0x3e0, 0x1f, 0x8000)) return B5G5R5A1_UNORM;
+					if (masks(pf, 0xf800, 0x7e0, 0x1f, 0)) return B5G6R5_UNORM;
+					if (masks(pf, 0xf00, 0xf0, 0xf, 0xf000)) return B4G4R4A4_UNORM;
+					break;
+			}
+			return 0;
+		}
+
+		if (pf.flags & pfLuminance) {
+			if (pf.bitCount == 8 && masks(pf, 0xff, 0, 0, 0)) return R8_UNORM;
+			if (pf.bitCount == 16 && masks(pf, 0xffff, 0, 0, 0)) return R16_UNORM;
+			if (pf.bitCount == 16 && masks(pf, 0xff, 0, 0, 0xff00)) return R8G8_UNORM;
+			return 0;
+		}
+
+		if ((pf.flags & pfAlpha) && pf.bitCount == 8) return A8_UNORM;
+
+		return 0;
+	}
+}
+
+const char* DDS::describe(Result result) {
+	switch (result) {
+		case Result::Ok: return "ok";
+		case Result::Missing: return "file missing or empty";
+		case Result::TooSmall: return "file smaller than the DDS header";
+		case Result::BadMagic: return "not a DDS file";
+		case Result::BadHeader: return "malformed DDS header";
+		case Result::UnsupportedFormat: return "unsupported pixel format";
+		case Result::UnsupportedDimension: return "only 2D textures and arrays are supported";
+		case Result::BadPitch: return "header pitch does not match the format";
+		case Result::Truncated: return "pixel data is truncated";
+	}
+	return "unknown";
+}
+
+DDS::FormatInfo DDS::formatInfo(uint32_t dxgiFormat) {
+	switch (dxgiFormat) {
+		case 1: case 2: case 3: case 4:                         // R32G32B32A32
+			return { 128, false };
+		case 5: case 6: case 7: case 8:                         // R32G32B32
+			return { 96, false };
+		case 9: case 10: case 11: case 12: case 13: case 14:    // R16G16B16A16
+		case 15: case 16: case 17: case 18:                     // R32G32
+			return { 64, false };
+		case 23: case 24: case 25: case 26:                     // R10G10B10A2, R11G11B10
+		case 27: case 28: case 29: case 30: case 31: case 32:   // R8G8B8A8
+		case 33: case 34: case 35: case 36: case 37: case 38:   // R16G16
+		case 39: case 41: case 42: case 43:                     // R32
+		case 87: case 88: case 90: case 91: case 92: case 93:   // B8G8R8A8, B8G8R8X8
+			return { 32, false };
+		case 48: case 49: case 50: case 51: case 52:            // R8G8
+		case 53: case 54: case 56: case 57: case 58: case 59:   // R16
+		case 85: case 86: case 115:                             // B5G6R5, B5G5R5A1, B4G4R4A4
+			return { 16, false };
+		case 60: case 61: case 62: case 63: case 64: case 65:   // R8, A8
+			return { 8, false };
+		case 70: case 71: case 72:                              // BC1
+		case 79: case 80: case 81:                              // BC4
+			return { 64, true };
+		case 73: case 74: case 75:                              // BC2
+		case 76: case 77: case 78:                              // BC3
+		case 82: case 83: case 84:                              // BC5
+		case 94: case 95: case 96:                              // BC6H
+		case 97: case 98: case 99:                              // BC7
+			return { 128, true };
+	}
+	return { 0, false };
+}
+
+void DDS::mipPitch(uint32_t dxgiFormat, uint32_t width, uint32_t height, uint32_t& rowPitch, uint32_t& rows) {
+	const FormatInfo info = formatInfo(dxgiFormat);
+
+	if (info.compressed) {
+		rowPitch = std::max(1u, (width + 3) / 4) * (info.bitsPerPixel / 8);
+		rows = std::max(1u, (height + 3) / 4);
+	}
+	else {
+		rowPitch = (width * info.bitsPerPixel + 7) / 8;
+		rows = height;
+	}
+}
+
+DDS::Result DDS::parse(std::span<const std::byte> data, Image& image) {
+	image = {};
+
+	if (data.size() < sizeof(uint32_t) + sizeof(Header)) return Result::TooSmall;
+
+	uint32_t fileMagic;
+	std::memcpy(&fileMagic, data.data(), sizeof(uint32_t));
+	if (fileMagic != magic) return Result::BadMagic;
+
+	Header header;
+	std::memcpy(&header, data.data() + sizeof(uint32_t), sizeof(Header));
+	if (header.size != sizeof(Header) || header.format.size != sizeof(PixelFormat)) return Result::BadHeader;
+
+	size_t offset = sizeof(uint32_t) + sizeof(Header);
+	uint32_t format = 0;
+	uint32_t arraySize = 1;
+
+	if ((header.format.flags & pfFourCC) && header.format.fourCC == fourCC('D', 'X', '1', '0')) {
+		if (data.size() < offset + sizeof(HeaderDX10)) return Result::TooSmall;
+
+		HeaderDX10 ext;
+		std::memcpy(&ext, data.data() + offset, sizeof(HeaderDX10));
+		offset += sizeof(HeaderDX10);
+
+		if (ext.resourceDimension != dimensionTexture2D || (ext.miscFlag & miscTextureCube))
+			return Result::UnsupportedDimension;
+
+		format = ext.dxgiFormat;
+		arraySize = ext.arraySize;
+	}
+	else {
+		if ((header.caps2 & (caps2Cubemap | caps2Volume)) || ((header.flags & flagDepth) && header.depth > 1))
+			return Result::UnsupportedDimension;
+
+		format = legacyFormat(header.format);
+	}
+
+	const FormatInfo info = formatInfo(format);
+	if (info.bitsPerPixel == 0) return Result::UnsupportedFormat;
+
+	if (header.width == 0 || header.height == 0 || header.width > maxSize || header.height > maxSize)
+		return Result::BadHeader;
+	if (arraySize == 0 || arraySize > maxArraySize) return Result::BadHeader;
+
+	uint32_t fullChain = 1;
+	while ((std::max(header.width, header.height) >> fullChain) != 0) fullChain++;
+
+	const uint32_t mipLevels = std::max(1u, header.mipMapCount);
+	if (mipLevels > fullChain) return Result::BadHeader;
+
+	// Writers leave the pitch at 0 often enough, only a set value has to match
+	uint32_t rowPitch, rows;
+	mipPitch(format, header.width, header.height, rowPitch, rows);
+
+	if (header.pitchOrLinearSize != 0) {
+		if (!info.compressed && (header.flags & flagPitch) && header.pitchOrLinearSize != rowPitch)
+			return Result::BadPitch;
+		if (info.compressed && (header.flags & flagLinearSize) && header.pitchOrLinearSize != rowPitch * rows)
+			return Result::BadPitch;
+	}
+
+	image.format = format;
+	image.width = header.width;
+	image.height = header.height;
+	image.mipLevels = mipLevels;
+	image.arraySize = arraySize;
+	image.subresources.reserve(static_cast<size_t>(arraySize) * mipLevels);
+
+	for (uint32_t slice = 0; slice < arraySize; slice++) {
+		uint32_t width = header.width, height = header.height;
+
+		for (uint32_t mip = 0; mip < mipLevels; mip++) {
+			mipPitch(format, width, height, rowPitch, rows);
+			const size_t bytes = static_cast<size_t>(rowPitch) * rows;
+
+			if (data.size() - offset < bytes) {
+				image = {};
+				return Result::Truncated;
+			}
+
+			image.subresources.push_back({ data.data() + offset, rowPitch, static_cast<uint32_t>(bytes) });
+			offset += bytes;
+
+			width = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+		}
+	}
+
+	return Result::Ok;
+}
+
+namespace {
+
+	uint32_t rgba(uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+		return r | (g << 8) | (b << 16) | (a << 24);
+	}
+
+	uint32_t expand565(uint16_t color) {
+		const uint32_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+		return rgba((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255);
+	}
+
+	// Channel by channel (a * wa + b * wb) / (wa + wb)
+	uint32_t blend(uint32_t a, uint32_t b, uint32_t wa, uint32_t wb) {
+		uint32_t out = 0;
+		for (uint32_t shift = 0; shift < 32; shift += 8)
+			out |= ((((a >> shift) & 0xff) * wa + ((b >> shift) & 0xff) * wb) / (wa + wb)) << shift;
+		return out;
+	}
+
+	// The 8 byte color half of a BC1-3 block. BC2 and BC3 always use four colors.
+	void decodeColors(const unsigned char* block, bool fourColors, uint32_t out[16]) {
+		uint16_t c0, c1;
+		uint32_t bits;
+		std::memcpy(&c0, block, 2);
+		std::memcpy(&c1, block + 2, 2);
+		std::memcpy(&bits, block + 4, 4);
+
+		uint32_t palette[4] = { expand565(c0), expand565(c1) };
+		if (fourColors || c0 > c1) {
+			palette[2] = blend(palette[0], palette[1], 2, 1);
+			palette[3] = blend(palette[0], palette[1], 1, 2);
+		}
+		else {
+			palette[2] = blend(palette[0], palette[1], 1, 1);
+			palette[3] = 0;
+		}
+
+		for (uint32_t texel = 0; texel < 16; texel++) out[texel] = palette[(bits >> (texel * 2)) & 3];
+	}
+
+	// BC2, 4 bits of alpha per texel
+	void decodeExplicitAlpha(const unsigned char* block, uint32_t out[16]) {
+		for (uint32_t texel = 0; texel < 16; texel++) {
+			const uint32_t alpha = (block[texel / 2] >> ((texel % 2) * 4)) & 15;
+			out[texel] = (out[texel] & 0xffffff) | ((alpha * 17) << 24);
+		}
+	}
+
+	// BC3, two endpoints and a 3 bit index per texel
+	void decodeInterpolatedAlpha(const unsigned char* block, uint32_t out[16]) {
+		const uint32_t a0 = block[0], a1 = block[1];
+		uint32_t palette[8] = { a0, a1 };
+		if (a0 > a1) {
+			for (uint32_t step = 1; step < 7; step++) palette[step + 1] = (a0 * (7 - step) + a1 * step) / 7;
+		}
+		else {
+			for (uint32_t step = 1; step < 5; step++) palette[step + 1] = (a0 * (5 - step) + a1 * step) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		uint64_t bits = 0;
+		std::memcpy(&bits, block + 2, 6);
+		for (uint32_t texel = 0; texel < 16; texel++)
+			out[texel] = (out[texel] & 0xffffff) | (palette[(bits >> (texel * 3)) & 7] << 24);
+	}
+
+	bool readBC(const DDS::Image& image, std::vector<uint32_t>& texels) {
+		const uint32_t blockBytes = (image.format == BC1_UNORM) ? 8 : 16;
+		const DDS::Subresource& top = image.subresources[0];
+		texels.resize(static_cast<size_t>(image.width) * image.height);
+
+		for (uint32_t by = 0; by < (image.height + 3) / 4; by++) {
+			auto* row = static_cast<const unsigned char*>(top.data) + static_cast<size_t>(by) * top.rowPitch;
+
+			for (uint32_t bx = 0; bx < (image.width + 3) / 4; bx++) {
+				const unsigned char* block = row + static_cast<size_t>(bx) * blockBytes;
+				uint32_t decoded[16];
+
+				if (image.format == BC1_UNORM) {
+					decodeColors(block, false, decoded);
+				}
+				else {
+					decodeColors(block + 8, true, decoded);
+					if (image.format == BC2_UNORM)
+						decodeExplicitAlpha(block, decoded);
+					else
+						decodeInterpolatedAlpha(block, decoded);
+				}
+
+				// Edge blocks hang over the image, their outside texels are dropped
+				for (uint32_t y = 0; y < 4 && by * 4 + y < image.height; y++)
+					for (uint32_t x = 0; x < 4 && bx * 4 + x < image.width; x++)
+						texels[static_cast<size_t>(by * 4 + y) * image.width + bx * 4 + x] = decoded[y * 4 + x];
+			}
+		}
+
+		return true;
+	}
+
+}
+
+bool DDS::readRGBA8(const Image& image, std::vector<uint32_t>& texels) {
+	if (image.format == BC1_UNORM || image.format == BC2_UNORM || image.format == BC3_UNORM) return readBC(image, texels);
+
+	const bool bgra = (image.format == B8G8R8A8_UNORM || image.format == B8G8R8X8_UNORM);
+	if (!bgra && image.format != R8G8B8A8_UNORM) return false;
+
+	const Subresource& top = image.subresources[0];
+	texels.resize(static_cast<size_t>(image.width) * image.height);
+
+	for (uint32_t y = 0; y < image.height; y++) {
+		auto* row = static_cast<const unsigned char*>(top.data) + static_cast<size_t>(y) * top.rowPitch;
+		std::memcpy(texels.data() + static_cast<size_t>(y) * image.width, row, image.width * sizeof(uint32_t));
+	}
+
+	// Swap red and blue, X8 formats get an opaque alpha
+	if (bgra) {
+		for (auto& texel : texels) {
+			texel = (texel & 0xff00ff00) | ((texel >> 16) & 0xff) | ((texel & 0xff) << 16);
+			if (image.format == B8G8R8X8_UNORM) texel |= 0xff000000;
+		}
+	}
+
+	return true;
+}
+
+DDS::Result DDS::File::open(const std::string& path) {
+	close();
+
+	if (!_file.open(path)) return Result::Missing;
+
+	const Result result = parse(_file.bytes(), image);
+	if (result != Result::Ok) close();
+
+	return result;
+}
+
+void DDS::File::close() {
+	image = {};
+	_file.close();
+}
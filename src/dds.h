@@ -0,0 +1,74 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include <mappedfile.h>
+
+// DDS container parser. Does not depend on D3D headers so it runs anywhere,
+// formats are DXGI_FORMAT values and subresources match D3D11_SUBRESOURCE_DATA.
+namespace DDS {
+
+	enum class Result {
+		Ok,
+		Missing,
+		TooSmall,
+		BadMagic,
+		BadHeader,
+		UnsupportedFormat,
+		UnsupportedDimension,
+		BadPitch,
+		Truncated,
+	};
+
+	const char* describe(Result result);
+
+	// Same layout as D3D11_SUBRESOURCE_DATA
+	struct Subresource {
+		const void* data;
+		uint32_t rowPitch;
+		uint32_t slicePitch;
+	};
+
+	struct FormatInfo {
+		uint32_t bitsPerPixel;  // bits per texel, or per 4x4 block when compressed
+		bool compressed;
+	};
+
+	// Zeroed info for formats the loader does not handle
+	FormatInfo formatInfo(uint32_t dxgiFormat);
+
+	// Row pitch and row count of one mip level
+	void mipPitch(uint32_t dxgiFormat, uint32_t width, uint32_t height, uint32_t& rowPitch, uint32_t& rows);
+
+	// 2D textures and texture arrays, subresources point into the parsed memory
+	struct Image {
+		uint32_t format = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 0;
+		uint32_t arraySize = 0;
+
+		// arraySize * mipLevels entries, ordered like D3D11 subresource indices
+		std::vector<Subresource> subresources;
+	};
+
+	Result parse(std::span<const std::byte> data, Image& image);
+
+	// Mip 0 of the first slice as RGBA8. Decodes BC1, BC2 and BC3, false for
+	// anything else but 8-bit RGBA and BGRA.
+	bool readRGBA8(const Image& image, std::vector<uint32_t>& texels);
+
+	// Keeps the file mapped for as long as the subresources are in use
+	struct File {
+		MappedFile _file;
+		Image image;
+
+		Result open(const std::string& path);
+		void close();
+	};
+
+}
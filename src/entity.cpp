@@ -0,0 +1,172 @@
+#include <entity.h>
+
+#include <span>
+#include <array>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+	std::array<Entity::ComponentInfo, Entity::maxComponents> registry;
+	std::atomic<uint32_t> registered = 0;
+	std::mutex registryMutex;
+
+	size_t alignUp(size_t offset, size_t align) {
+		return (offset + align - 1) / align * align;
+	}
+
+	// Bytes a chunk of `capacity` rows takes, filling in where each column starts
+	size_t layout(uint32_t capacity, std::span<const size_t> sizes, std::span<const uint32_t> components, std::vector<size_t>& offsets) {
+		size_t offset = capacity * sizeof(Entity::Handle);
+		offsets.clear();
+		for (size_t col = 0; col < components.size(); col++) {
+			offset = alignUp(offset, Entity::componentInfo(components[col]).align);
+			offsets.push_back(offset);
+			offset += capacity * sizes[col];
+		}
+
+		return offset;
+	}
+
+}
+
+uint32_t Entity::registerComponent(size_t size, size_t align) {
+	std::lock_guard lock(registryMutex);
+
+	const uint32_t id = registered.load(std::memory_order_relaxed);
+	if (id >= maxComponents) std::abort();
+
+	registry[id] = { size, align };
+	registered.store(id + 1, std::memory_order_release);
+	return id;
+}
+
+Entity::ComponentInfo Entity::componentInfo(uint32_t id) {
+	return registry[id];
+}
+
+size_t Entity::packedOffset(Mask mask, uint32_t id) {
+	size_t offset = 0;
+	for (uint32_t bit = 0; bit < maxComponents; bit++) {
+		if ((mask & (Mask(1) << bit)) == 0) continue;
+
+		offset = alignUp(offset, registry[bit].align);
+		if (bit == id) return offset;
+		offset += registry[bit].size;
+	}
+
+	return offset;
+}
+
+size_t Entity::packedSize(Mask mask) {
+	return packedOffset(mask, none);
+}
+
+Entity::Archetype::Archetype(Mask mask) : mask(mask) {
+	column.fill(none);
+	for (uint32_t bit = 0; bit < maxComponents; bit++) {
+		if ((mask & (Mask(1) << bit)) == 0) continue;
+
+		column[bit] = static_cast<uint32_t>(components.size());
+		components.push_back(bit);
+		sizes.push_back(componentInfo(bit).size);
+	}
+
+	// As many rows as fit once the columns are aligned, at least one
+	size_t rowBytes = sizeof(Handle);
+	for (size_t size : sizes) rowBytes += size;
+
+	capacity = static_cast<uint32_t>(std::max<size_t>(1, chunkBytes / rowBytes));
+	while (capacity > 1 && layout(capacity, sizes, components, offsets) > chunkBytes) capacity--;
+	chunkSize = layout(capacity, sizes, components, offsets);
+}
+
+size_t Entity::Archetype::push(Handle handle) {
+	const size_t row = count++;
+	if (row / capacity >= chunks.size()) chunks.push_back(std::unique_ptr<std::byte[]>(new std::byte[chunkSize]));
+
+	*handles(row) = handle;
+	return row;
+}
+
+bool Entity::World::destroy(Handle handle) {
+	if (!alive(handle)) return false;
+
+	if (_iterating > 0)
+		_pending.push_back({ handle, 0, {} });
+	else
+		remove(handle);
+	return true;
+}
+
+void Entity::World::flush() {
+	// Nothing in here queries, so nothing queues behind
+	for (Pending& op : _pending) {
+		if (!alive(op.handle)) continue;
+
+		if (op.mask == 0) {
+			remove(op.handle);
+			continue;
+		}
+
+		const uint32_t index = archetype(op.mask);
+		Archetype& arch = _archetypes[index];
+		const size_t row = arch.push(op.handle);
+		for (size_t col = 0; col < arch.components.size(); col++)
+			std::memcpy(arch.at(static_cast<uint32_t>(col), row), op.row.data() + packedOffset(op.mask, arch.components[col]), arch.sizes[col]);
+
+		_locations[op.handle.index].archetype = index;
+		_locations[op.handle.index].row = row;
+	}
+
+	_pending.clear();
+}
+
+Entity::Handle Entity::World::allocate() {
+	uint32_t index;
+	if (!_free.empty()) {
+		index = _free.back();
+		_free.pop_back();
+	}
+	else {
+		index = static_cast<uint32_t>(_locations.size());
+		_locations.push_back({});
+	}
+
+	return { index, _locations[index].generation };
+}
+
+uint32_t Entity::World::archetype(Mask mask) {
+	auto [found, inserted] = _byMask.try_emplace(mask, static_cast<uint32_t>(_archetypes.size()));
+	if (inserted) _archetypes.emplace_back(mask);
+
+	return found->second;
+}
+
+void Entity::World::remove(Handle handle) {
+	Location& loc = _locations[handle.index];
+
+	// A create that never got placed has no row to give back
+	if (loc.archetype != none) {
+		Archetype& arch = _archetypes[loc.archetype];
+		const size_t last = arch.count - 1;
+		if (loc.row != last) {
+			for (size_t col = 0; col < arch.components.size(); col++)
+				std::memcpy(arch.at(static_cast<uint32_t>(col), loc.row), arch.at(static_cast<uint32_t>(col), last), arch.sizes[col]);
+
+			const Handle moved = *arch.handles(last);
+			*arch.handles(loc.row) = moved;
+			_locations[moved.index].row = loc.row;
+		}
+		arch.count--;
+	}
+
+	loc.archetype = none;
+	loc.generation++;
+	_free.push_back(handle.index);
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <unordered_map>
+
+#include <jobs.h>
+
+// Entities grouped by the exact set of components they have (their archetype).
+// Each archetype keeps its entities in fixed size chunks, one contiguous column
+// per component, so a query walks plain arrays. Components are moved with
+// memcpy and never constructed or destroyed in place.
+namespace Entity {
+
+	// Stale once the entity is destroyed, the slot's generation moves on
+	struct Handle {
+		uint32_t index = ~0u;
+		uint32_t generation = 0;
+
+		bool operator==(const Handle&) const = default;
+	};
+
+	using Mask = uint64_t;
+	static constexpr uint32_t maxComponents = 64;
+	static constexpr uint32_t none = ~0u;
+
+	// Bytes per chunk, rows are as many entities as fit
+	static constexpr size_t chunkBytes = size_t(64) << 10;
+
+	struct ComponentInfo {
+		size_t size;
+		size_t align;
+	};
+
+	// Ids in order of first use, more than maxComponents types aborts
+	uint32_t registerComponent(size_t size, size_t align);
+	ComponentInfo componentInfo(uint32_t id);
+
+	// const T is the same component, a query only promises not to write it
+	template<typename T> uint32_t componentId() {
+		if constexpr (!std::is_same_v<T, std::remove_cv_t<T>>) {
+			return componentId<std::remove_cv_t<T>>();
+		}
+		else {
+			static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "components are moved with memcpy");
+			static_assert(alignof(T) <= alignof(std::max_align_t));
+
+			static const uint32_t id = registerComponent(sizeof(T), alignof(T));
+			return id;
+		}
+	}
+
+	template<typename... Ts> Mask maskOf() {
+		return ((Mask(1) << componentId<Ts>()) | ... | Mask(0));
+	}
+
+	// Where each component starts in a row packed in ascending id order, for creates that have to wait
+	size_t packedOffset(Mask mask, uint32_t id);
+	size_t packedSize(Mask mask);
+
+	struct Archetype {
+		Mask mask = 0;
+		uint32_t capacity = 0;                      // rows per chunk
+		size_t chunkSize = 0;                       // bytes, chunkBytes unless a single row is bigger
+		std::array<uint32_t, maxComponents> column; // by component id, none if missing
+		std::vector<uint32_t> components;           // ascending ids
+		std::vector<size_t> offsets;                // column start in a chunk, by column
+		std::vector<size_t> sizes;
+		std::vector<std::unique_ptr<std::byte[]>> chunks;  // kept when emptied, churn does not allocate
+		size_t count = 0;                           // rows in use, every chunk before the last is full
+
+		explicit Archetype(Mask mask);
+
+		// Handles sit in front of the columns in every chunk
+		Handle* handles(size_t row) { return reinterpret_cast<Handle*>(chunks[row / capacity].get()) + row % capacity; }
+		std::byte* at(uint32_t col, size_t row) { return chunks[row / capacity].get() + offsets[col] + (row % capacity) * sizes[col]; }
+
+		size_t push(Handle handle);
+	};
+
+	struct World {
+		struct Location {
+			uint32_t archetype = none;      // none while a create waits
+			uint32_t generation = 1;
+			size_t row = 0;
+		};
+
+		// A create or destroy made while a query ran, applied when it ends
+		struct Pending {
+			Handle handle;
+			Mask mask = 0;                  // 0 destroys
+			std::vector<std::byte> row;     // packed, see packedOffset
+		};
+
+		std::vector<Archetype> _archetypes;
+		std::unordered_map<Mask, uint32_t> _byMask;
+		std::vector<Location> _locations;   // by handle index
+		std::vector<uint32_t> _free;
+		std::vector<Pending> _pending;
+		uint32_t _iterating = 0;
+
+		// Shows up in queries right away, or once the running query is done
+		template<typename... Ts> Handle create(const Ts&... components) {
+			static_assert(sizeof...(Ts) > 0);
+			const Mask mask = maskOf<Ts...>();
+			const Handle handle = allocate();
+
+			if (_iterating > 0) {
+				Pending pending = { handle, mask, std::vector<std::byte>(packedSize(mask)) };
+				(std::memcpy(pending.row.data() + packedOffset(mask, componentId<Ts>()), &components, sizeof(Ts)), ...);
+				_pending.push_back(std::move(pending));
+				return handle;
+			}
+
+			const uint32_t index = archetype(mask);
+			Archetype& arch = _archetypes[index];
+			const size_t row = arch.push(handle);
+			_locations[handle.index].archetype = index;
+			_locations[handle.index].row = row;
+
+			(std::memcpy(arch.at(arch.column[componentId<Ts>()], row), &components, sizeof(Ts)), ...);
+			return handle;
+		}
+
+		// The last row of the archetype moves into the hole, unless a query
+		// runs, then the entity stays until it is done. False for a stale handle.
+		bool destroy(Handle handle);
+
+		bool alive(Handle handle) const {
+			return handle.index < _locations.size() && _locations[handle.index].generation == handle.generation;
+		}
+
+		// Null without the component, or while its create waits
+		template<typename T> T* get(Handle handle) {
+			if (!alive(handle) || _locations[handle.index].archetype == none) return nullptr;
+
+			const Location& loc = _locations[handle.index];
+			Archetype& arch = _archetypes[loc.archetype];
+			const uint32_t col = arch.column[componentId<T>()];
+			return (col == none) ? nullptr : reinterpret_cast<T*>(arch.at(col, loc.row));
+		}
+
+		template<typename... Ts> size_t count() const {
+			const Mask need = maskOf<Ts...>();
+			size_t total = 0;
+			for (auto& arch : _archetypes) total += ((arch.mask & need) == need) ? arch.count : 0;
+			return total;
+		}
+
+		// fn(std::span<Ts>...) once per chunk of every archetype that has all of
+		// Ts, or fn(std::span<const Handle>, std::span<Ts>...) to also get the handles.
+		// Creates and destroys inside fn wait until the outermost query returns.
+		template<typename... Ts, typename Fn> void each(Fn&& fn) {
+			const Mask need = maskOf<Ts...>();
+
+			_iterating++;
+			for (size_t index = 0; index < _archetypes.size(); index++) {
+				Archetype& arch = _archetypes[index];
+				if ((arch.mask & need) != need) continue;
+
+				for (size_t first = 0; first < arch.count; first += arch.capacity)
+					visit<Ts...>(arch, first, fn, std::index_sequence_for<Ts...>());
+			}
+			if (--_iterating == 0) flush();
+		}
+
+		// Same, chunks spread over the scheduler's threads. fn must not
+		// create or destroy, the pending list is not shared between threads.
+		template<typename... Ts, typename Fn> void each(Jobs::Scheduler& jobs, Fn&& fn) {
+			const Mask need = maskOf<Ts...>();
+
+			std::vector<std::pair<uint32_t, size_t>> chunks;
+			for (uint32_t index = 0; index < _archetypes.size(); index++) {
+				Archetype& arch = _archetypes[index];
+				if ((arch.mask & need) != need) continue;
+
+				for (size_t first = 0; first < arch.count; first += arch.capacity) chunks.push_back({ index, first });
+			}
+
+			_iterating++;
+			jobs.parallelFor(chunks.size(), 1, [&](size_t first, size_t count) {
+				for (size_t chunk = first; chunk < first + count; chunk++)
+					visit<Ts...>(_archetypes[chunks[chunk].first], chunks[chunk].second, fn, std::index_sequence_for<Ts...>());
+			});
+			if (--_iterating == 0) flush();
+		}
+
+		// Applies what queries held back, in the order it was asked for
+		void flush();
+
+	private:
+		Handle allocate();
+		uint32_t archetype(Mask mask);
+		void remove(Handle handle);
+
+		template<typename... Ts, typename Fn, size_t... Is> void visit(Archetype& arch, size_t first, Fn& fn, std::index_sequence<Is...>) {
+			const size_t rows = std::min<size_t>(arch.capacity, arch.count - first);
+			const std::array<uint32_t, sizeof...(Ts)> cols = { arch.column[componentId<Ts>()]... };
+
+			if constexpr (std::is_invocable_v<Fn&, std::span<const Handle>, std::span<Ts>...>)
+				fn(std::span<const Handle>(arch.handles(first), rows), std::span<Ts>(reinterpret_cast<Ts*>(arch.at(cols[Is], first)), rows)...);
+			else
+				fn(std::span<Ts>(reinterpret_cast<Ts*>(arch.at(cols[Is], first)), rows)...);
+		}
+	};
+
+}
@@ -0,0 +1,41 @@
+#include <font.h>
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+size_t Font::glyphCount(const String& str) {
+	size_t count = 0;
+	for (char letter : str.data)
+		count += (letter >= 'A' && letter <= 'Z') ? 1 : 0;
+
+	return count;
+}
+
+size_t Font::layout(const String& str, Glyph* out) {
+	using namespace DirectX;
+	using namespace DirectX::PackedVector;
+
+	const float lWidth = 2002.0f / 26.0f, lHeight = 150.0f;
+	const float lAspect = lWidth / lHeight;
+
+	const float offX = static_cast<float>(str.pxOffset[0]);
+	const float offY = static_cast<float>(str.pxOffset[1]);
+
+	const float lVWidth = str.fontSize * lAspect;
+	const float lVHeight = str.fontSize;
+	const XMHALF2 size(lVWidth, lVHeight);
+
+	size_t glyphCount = 0;
+	for (size_t i = 0; i < str.data.size(); i++) {
+		const int idx = str.data[i] - 'A';
+		if (idx < 0 || idx > 25) continue;
+
+		const float tStartX = static_cast<float>(idx) * 1.0f / 26.0f;
+		const float tEndX = static_cast<float>(idx + 1) * 1.0f / 26.0f;
+		const float iOffX = offX + lVWidth * static_cast<float>(i);
+
+		out[glyphCount++] = Glyph{ XMFLOAT2(iOffX, offY), size, XMUSHORTN2(tStartX, tEndX) };
+	}
+
+	return glyphCount;
+}
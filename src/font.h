@@ -1,12 +1,32 @@
 #pragma once
 
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
 #include <array>
-#include <string>
+#include <string_view>
 
 namespace Font {
+	// The text is not owned, literals or an Arena::Linear copy keep it alive
 	struct String {
-		std::string data;
+		std::string_view data;
 		std::array<int, 2> pxOffset;
 		int fontSize;
 	};
-}
\ No newline at end of file
+
+	// One glyph instance, expanded into a quad by fontVS. The atlas is a
+	// single row of letters, so only the horizontal UV range is stored.
+	struct Glyph {
+		DirectX::XMFLOAT2 pos;                  // bottom-left corner in pixels
+		DirectX::PackedVector::XMHALF2 size;    // quad size in pixels
+		DirectX::PackedVector::XMUSHORTN2 uv;   // atlas u start and end
+	};
+
+	static_assert(sizeof(Glyph) == 16);
+
+	// Letters of `str` the atlas has a glyph for
+	size_t glyphCount(const String& str);
+
+	// Writes one glyph per drawable letter into `out`, returns the glyph count
+	size_t layout(const String& str, Glyph* out);
+}
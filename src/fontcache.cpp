@@ -0,0 +1,150 @@
+#include <fontcache.h>
+
+#include <span>
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+#include <font.h>
+
+size_t Font::LayoutCache::KeyHash::hash(std::string_view data, const std::array<int, 2>& pxOffset, int fontSize) {
+	size_t hash = std::hash<std::string_view>{}(data);
+	for (int value : { pxOffset[0], pxOffset[1], fontSize })
+		hash ^= std::hash<int>{}(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
+	return hash;
+}
+
+const std::vector<Font::LayoutCache::Range>& Font::LayoutCache::update(std::span<const String> strings) {
+	_frame++;
+	_stats = {};
+	_order.clear();
+	_draws.clear();
+
+	// Resolve hits first, so compaction knows what is still alive
+	size_t missGlyphs = 0;
+	for (size_t idx = 0; idx < strings.size(); idx++) {
+		const String& str = strings[idx];
+
+		// Static strings usually sit in the same slot as last frame, skip hashing then
+		Entry* hit = (idx < _lastOrder.size()) ? _lastOrder[idx] : nullptr;
+		if (hit == nullptr || !KeyEqual{}(*hit->key, str)) {
+			auto entry = _entries.find(str);
+			hit = (entry != _entries.end()) ? &entry->second : nullptr;
+		}
+
+		if (hit != nullptr) {
+			hit->lastUse = _frame;
+			_stats.hits++;
+		}
+		else {
+			missGlyphs += glyphCount(str);
+			_stats.misses++;
+		}
+
+		_order.push_back(hit);
+	}
+
+	if (_head + missGlyphs > _glyphs.size())
+		compact(missGlyphs);
+
+	for (size_t idx = 0; idx < strings.size(); idx++) {
+		if (_order[idx] != nullptr) continue;
+
+		// The same string may show up twice in one frame, the text is only copied once
+		const String& str = strings[idx];
+		auto entry = _entries.find(str);
+		if (entry == _entries.end()) {
+			entry = _entries.try_emplace({ std::string(str.data), str.pxOffset, str.fontSize }).first;
+			entry->second.key = &entry->first;
+			entry->second.first = _head;
+			entry->second.count = layout(str, _glyphs.data() + _head);
+			_head += entry->second.count;
+
+			markDirty(entry->second.first, entry->second.count);
+			_stats.laidOutGlyphs += entry->second.count;
+		}
+
+		entry->second.lastUse = _frame;
+		_order[idx] = &entry->second;
+	}
+
+	// Neighbouring ranges go out as a single draw
+	for (Entry* entry : _order) {
+		if (entry->count == 0) continue;
+
+		if (!_draws.empty() && _draws.back().first + _draws.back().count == entry->first)
+			_draws.back().count += entry->count;
+		else
+			_draws.push_back({ entry->first, entry->count });
+	}
+
+	std::swap(_order, _lastOrder);
+	return _draws;
+}
+
+void Font::LayoutCache::reserve(size_t glyphs) {
+	if (glyphs <= _glyphs.size()) return;
+
+	_glyphs.resize(glyphs);
+	_resized = true;
+	markDirty(0, _head);
+}
+
+void Font::LayoutCache::clearDirty() {
+	_dirtyBegin = _dirtyEnd = 0;
+	_resized = false;
+	_previous = {};
+}
+
+void Font::LayoutCache::compact(size_t extraGlyphs) {
+	// Drop everything this frame has not asked for
+	std::erase_if(_entries, [&](const auto& item) { return item.second.lastUse != _frame; });
+
+	// Lay live ranges out in this frame's submission order, so they merge into one draw
+	std::vector<Entry*> live;
+	std::unordered_set<Entry*> seen;
+	live.reserve(_entries.size());
+	for (Entry* entry : _order) {
+		if (entry != nullptr && seen.insert(entry).second)
+			live.push_back(entry);
+	}
+
+	size_t liveGlyphs = 0;
+	for (Entry* entry : live) liveGlyphs += entry->count;
+
+	const size_t capacity = std::max(_glyphs.size(), (liveGlyphs + extraGlyphs) * 2);
+	std::vector<Glyph> glyphs(capacity);
+
+	size_t head = 0;
+	for (Entry* entry : live) {
+		std::copy_n(_glyphs.begin() + entry->first, entry->count, glyphs.begin() + head);
+		entry->first = head;
+		head += entry->count;
+	}
+
+	_resized = _resized || capacity != _glyphs.size();
+	_previous = std::exchange(_glyphs, std::move(glyphs));
+	_head = head;
+	_stats.compactions++;
+
+	markDirty(0, _head);
+}
+
+void Font::LayoutCache::markDirty(size_t first, size_t count) {
+	if (count == 0) return;
+
+	if (_dirtyBegin == _dirtyEnd) {
+		_dirtyBegin = first;
+		_dirtyEnd = first + count;
+		return;
+	}
+
+	_dirtyBegin = std::min(_dirtyBegin, first);
+	_dirtyEnd = std::max(_dirtyEnd, first + count);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <unordered_map>
+
+#include <font.h>
+
+namespace Font {
+
+	// Retained glyph layout for strings that repeat across frames. Each
+	// distinct (data, pxOffset, fontSize) keeps its glyphs in one range of
+	// a CPU mirror of the glyph instance buffer; only new strings are laid
+	// out and only their range is reported dirty for upload.
+	struct LayoutCache {
+		// String with its own copy of the text
+		struct Key {
+			std::string data;
+			std::array<int, 2> pxOffset;
+			int fontSize;
+		};
+
+		struct Entry {
+			const Key* key = nullptr;
+			size_t first = 0;
+			size_t count = 0;
+			uint64_t lastUse = 0;
+		};
+
+		struct Range {
+			size_t first = 0;
+			size_t count = 0;
+		};
+
+		struct Stats {
+			size_t hits = 0;
+			size_t misses = 0;
+			size_t compactions = 0;
+			size_t laidOutGlyphs = 0;
+		};
+
+		// Transparent, lookups by String do not copy the text
+		struct KeyHash {
+			using is_transparent = void;
+
+			size_t operator()(const String& str) const { return hash(str.data, str.pxOffset, str.fontSize); }
+			size_t operator()(const Key& key) const { return hash(key.data, key.pxOffset, key.fontSize); }
+
+			static size_t hash(std::string_view data, const std::array<int, 2>& pxOffset, int fontSize);
+		};
+
+		struct KeyEqual {
+			using is_transparent = void;
+
+			template<typename A, typename B> bool operator()(const A& a, const B& b) const {
+				return a.pxOffset == b.pxOffset && a.fontSize == b.fontSize && std::string_view(a.data) == std::string_view(b.data);
+			}
+		};
+
+		std::unordered_map<Key, Entry, KeyHash, KeyEqual> _entries;
+		std::vector<Glyph> _glyphs;
+		std::vector<Glyph> _previous;   // before the last compaction, kept until clearDirty
+		size_t _head = 0;
+		uint64_t _frame = 0;
+
+		// Glyph range that changed since the last clearDirty
+		size_t _dirtyBegin = 0, _dirtyEnd = 0;
+		bool _resized = false;
+
+		// Per submission slot, this and the previous frame
+		std::vector<Entry*> _order, _lastOrder;
+		std::vector<Range> _draws;
+		Stats _stats;
+
+		// Resolves every string to its cached range, lays out the missing ones
+		// and returns the merged glyph ranges to draw, in submission order
+		const std::vector<Range>& update(std::span<const String> strings);
+
+		void reserve(size_t glyphs);
+		void clearDirty();
+
+	private:
+		void compact(size_t extraGlyphs);
+		void markDirty(size_t first, size_t count);
+	};
+
+}
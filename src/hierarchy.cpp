@@ -0,0 +1,107 @@
+#include <hierarchy.h>
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace {
+
+	DirectX::XMMATRIX localMatrix(const Hierarchy::Transform& local) {
+		using namespace DirectX;
+
+		return XMMatrixMultiply(XMMatrixMultiply(XMMatrixScalingFromVector(XMLoadFloat3(&local.scale)),
+			XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&local.rotation))),
+			XMMatrixTranslationFromVector(XMLoadFloat3(&local.position)));
+	}
+
+	// Parents come first, so a node's parent is done before the node is reached
+	void recompute(Hierarchy::Tree& tree, uint32_t first, uint32_t end) {
+		using namespace DirectX;
+
+		for (uint32_t pos = first; pos < end; pos++) {
+			if (tree._dirty[pos]) {
+				XMStoreFloat4x4(&tree._localMatrix[pos], localMatrix(tree._local[pos]));
+				tree._dirty[pos] = 0;
+			}
+
+			const XMMATRIX local = XMLoadFloat4x4(&tree._localMatrix[pos]);
+			const uint32_t parent = tree._parent[pos];
+			XMStoreFloat4x4(&tree._world[pos], (parent == Hierarchy::none) ? local : XMMatrixMultiply(local, XMLoadFloat4x4(&tree._world[parent])));
+		}
+	}
+
+}
+
+Hierarchy::Node Hierarchy::Tree::add(Node parent, const Transform& local) {
+	const Node node = static_cast<Node>(_position.size());
+	uint32_t parentAt = none;
+	uint32_t at = static_cast<uint32_t>(size());
+	if (parent != none) {
+		parentAt = _position[parent];
+		at = parentAt + _size[parentAt];
+	}
+
+	// Everything from `at` on moves up one place, nothing when built depth first
+	if (at < size()) {
+		for (uint32_t& pos : _position) pos += (pos >= at);
+		for (uint32_t& pos : _parent) pos += (pos != none && pos >= at);
+	}
+	for (uint32_t ancestor = parentAt; ancestor != none; ancestor = _parent[ancestor]) _size[ancestor]++;
+
+	_parent.insert(_parent.begin() + at, parentAt);
+	_size.insert(_size.begin() + at, 1);
+	_local.insert(_local.begin() + at, local);
+	_localMatrix.insert(_localMatrix.begin() + at, DirectX::XMFLOAT4X4());
+	_world.insert(_world.begin() + at, DirectX::XMFLOAT4X4());
+	_dirty.insert(_dirty.begin() + at, 1);
+	_node.insert(_node.begin() + at, node);
+
+	_position.push_back(at);
+	_changed.push_back(node);
+	return node;
+}
+
+void Hierarchy::Tree::setLocal(Node node, const Transform& local) {
+	const uint32_t pos = _position[node];
+	_local[pos] = local;
+
+	if (_dirty[pos]) return;
+
+	_dirty[pos] = 1;
+	_changed.push_back(node);
+}
+
+Hierarchy::Node Hierarchy::Tree::parent(Node node) const {
+	const uint32_t parent = _parent[_position[node]];
+	return (parent == none) ? none : _node[parent];
+}
+
+size_t Hierarchy::Tree::update() {
+	if (_changed.empty()) return 0;
+
+	// Sorted by position, a changed node inside a subtree that was already
+	// recomputed needs nothing more
+	for (Node& node : _changed) node = _position[node];
+	std::sort(_changed.begin(), _changed.end());
+
+	size_t recomputed = 0;
+	uint32_t covered = 0;
+	for (uint32_t first : _changed) {
+		if (first < covered) continue;
+
+		covered = first + _size[first];
+		recompute(*this, first, covered);
+		recomputed += covered - first;
+	}
+
+	_changed.clear();
+	return recomputed;
+}
+
+void Hierarchy::Tree::updateAll() {
+	std::fill(_dirty.begin(), _dirty.end(), 1);
+	recompute(*this, 0, static_cast<uint32_t>(size()));
+	_changed.clear();
+}
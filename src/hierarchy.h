@@ -0,0 +1,63 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace Hierarchy {
+
+	// Stable for the node's lifetime, unlike its place in the arrays
+	using Node = uint32_t;
+	static constexpr Node none = ~0u;
+
+	// Same convention as Cube::Data, scale then roll/pitch/yaw then translate
+	struct Transform {
+		DirectX::XMFLOAT3 position = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 rotation = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 scale = { 1.0f, 1.0f, 1.0f };
+	};
+
+	// Parent/child transforms in depth-first order, so every subtree is one
+	// contiguous run that starts at its root and parents always come before
+	// their children. setLocal only flags the node, update recomputes the
+	// local matrices of flagged nodes and the world matrices under them, and
+	// leaves everything else cached. Matrices are row-vector and not
+	// transposed, world = local * parent world.
+	struct Tree {
+		// By position
+		std::vector<uint32_t> _parent;      // position, none for roots
+		std::vector<uint32_t> _size;        // nodes in the subtree, itself included
+		std::vector<Transform> _local;
+		std::vector<DirectX::XMFLOAT4X4> _localMatrix;
+		std::vector<DirectX::XMFLOAT4X4> _world;
+		std::vector<uint8_t> _dirty;        // _local changed since its matrix was built
+		std::vector<Node> _node;
+
+		std::vector<uint32_t> _position;    // by node
+		std::vector<Node> _changed;         // flagged since the last update, in any order
+
+		size_t size() const { return _parent.size(); }
+
+		// Inserts after the parent's last descendant, which moves every later
+		// node up by one. Meant for building, not for every frame.
+		Node add(Node parent, const Transform& local);
+
+		const Transform& local(Node node) const { return _local[_position[node]]; }
+		void setLocal(Node node, const Transform& local);
+
+		// As of the last update
+		const DirectX::XMFLOAT4X4& world(Node node) const { return _world[_position[node]]; }
+		Node parent(Node node) const;
+
+		// Costs the changed subtrees, not the whole tree. Returns how many
+		// world matrices were recomputed.
+		size_t update();
+
+		// Every world matrix from scratch, what update has to match
+		void updateAll();
+	};
+
+}
@@ -0,0 +1,170 @@
+#include <jobs.h>
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+namespace {
+	// Deque the current thread pushes to and pops from, 0 outside the workers
+	thread_local const Jobs::Scheduler* owner = nullptr;
+	thread_local size_t ownQueue = 0;
+
+	size_t localQueue(const Jobs::Scheduler* scheduler) {
+		return (owner == scheduler) ? ownQueue : 0;
+	}
+}
+
+Jobs::Scheduler::Scheduler(size_t workers) {
+	for (size_t idx = 0; idx <= workers; idx++)
+		_queues.push_back(std::make_unique<Queue>());
+
+	for (size_t idx = 0; idx < workers; idx++)
+		_threads.emplace_back(&Scheduler::work, this, idx + 1);
+}
+
+Jobs::Scheduler::~Scheduler() {
+	{
+		std::lock_guard lock(_sleepMutex);
+		_stop = true;
+	}
+	_wake.notify_all();
+
+	for (auto& thread : _threads) thread.join();
+}
+
+size_t Jobs::Scheduler::defaultWorkers() {
+	return std::max(1u, std::thread::hardware_concurrency()) - 1;
+}
+
+void Jobs::Scheduler::spawn(Job job, Counter* counter) {
+	if (counter != nullptr) counter->_pending++;
+
+	push({ std::move(job), counter });
+}
+
+void Jobs::Scheduler::spawn(Job job, Counter& dependency, Counter* counter) {
+	if (counter != nullptr) counter->_pending++;
+
+	{
+		std::lock_guard lock(dependency._mutex);
+		if (!dependency.done()) {
+			dependency._waiting.push_back({ std::move(job), counter });
+			return;
+		}
+	}
+
+	push({ std::move(job), counter });
+}
+
+void Jobs::Scheduler::wait(Counter& counter) {
+	while (!counter.done()) {
+		if (!runOne()) std::this_thread::yield();
+	}
+
+	// The last job may still be releasing dependents, the counter must outlive that
+	std::lock_guard lock(counter._mutex);
+}
+
+void Jobs::Scheduler::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+	if (count == 0) return;
+
+	Counter counter;
+	split(0, count, std::max<size_t>(grain, 1), fn, counter);
+	wait(counter);
+}
+
+void Jobs::Scheduler::split(size_t first, size_t count, size_t grain,
+		const std::function<void(size_t, size_t)>& fn, Counter& counter) {
+	// The upper half goes up for grabs, this thread keeps halving the lower one
+	while (count > grain) {
+		const size_t half = count / 2;
+		spawn([this, first = first + half, count = count - half, grain, &fn, &counter] {
+			split(first, count, grain, fn, counter);
+		}, &counter);
+
+		count = half;
+	}
+
+	fn(first, count);
+}
+
+void Jobs::Scheduler::work(size_t queue) {
+	owner = this;
+	ownQueue = queue;
+
+	while (true) {
+		if (runOne()) continue;
+
+		std::unique_lock lock(_sleepMutex);
+		_wake.wait(lock, [this] { return _stop || _queued > 0; });
+		if (_stop) return;
+	}
+}
+
+bool Jobs::Scheduler::runOne() {
+	const size_t own = localQueue(this);
+	Task task;
+	bool found = false;
+
+	// Newest own job first, it is the most likely to still be in cache
+	{
+		Queue& queue = *_queues[own];
+		std::lock_guard lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			found = true;
+		}
+	}
+
+	// Otherwise the oldest, and so usually biggest, job of someone else
+	for (size_t idx = 1; !found && idx < _queues.size(); idx++) {
+		Queue& queue = *_queues[(own + idx) % _queues.size()];
+		std::lock_guard lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			found = true;
+		}
+	}
+
+	if (!found) return false;
+
+	_queued--;
+	task.job();
+	finish(task.counter);
+	return true;
+}
+
+void Jobs::Scheduler::push(Task task) {
+	{
+		Queue& queue = *_queues[localQueue(this)];
+		std::lock_guard lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	_queued++;
+
+	// Taking the lock orders this against a worker about to sleep
+	{
+		std::lock_guard lock(_sleepMutex);
+	}
+	_wake.notify_one();
+}
+
+void Jobs::Scheduler::finish(Counter* counter) {
+	if (counter == nullptr) return;
+
+	std::vector<Task> released;
+	{
+		std::lock_guard lock(counter->_mutex);
+		if (counter->_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			released.swap(counter->_waiting);
+	}
+
+	for (auto& task : released) push(std::move(task));
+}
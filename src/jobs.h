@@ -0,0 +1,86 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+namespace Jobs {
+
+	using Job = std::function<void()>;
+
+	struct Counter;
+
+	struct Task {
+		Job job;
+		Counter* counter = nullptr;
+	};
+
+	// Jobs spawned against a counter raise it and lower it when they finish.
+	// Jobs can depend on a counter, they only start once it dropped to zero.
+	struct Counter {
+		std::atomic<size_t> _pending = 0;
+		std::mutex _mutex;
+		std::vector<Task> _waiting;     // dependents, released at zero
+
+		bool done() const { return _pending.load(std::memory_order_acquire) == 0; }
+	};
+
+	// Work-stealing scheduler. Every worker owns a deque, spawns go to the
+	// back of the spawning thread's deque and it pops from there too, idle
+	// threads steal from the front of the others. Threads that are not
+	// workers share deque 0 and help out while they wait on a counter, so
+	// threads that must not run each other's jobs need their own scheduler.
+	struct Scheduler {
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		std::vector<std::thread> _threads;
+		std::vector<std::unique_ptr<Queue>> _queues;    // 0 for outside threads, then one per worker
+
+		std::mutex _sleepMutex;
+		std::condition_variable _wake;
+		std::atomic<size_t> _queued = 0;
+		bool _stop = false;
+
+		// Workers besides the caller, defaults to one per spare core
+		explicit Scheduler(size_t workers = defaultWorkers());
+		~Scheduler();
+
+		Scheduler(const Scheduler&) = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+
+		void spawn(Job job, Counter* counter = nullptr);
+
+		// Queued once `dependency` is done, right away if it already is
+		void spawn(Job job, Counter& dependency, Counter* counter);
+
+		// Runs other jobs until the counter is done
+		void wait(Counter& counter);
+
+		// fn(first, count) over [0, count), halves ranges above `grain` so
+		// idle threads can steal the other half. Returns when all ran.
+		void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+		size_t threads() const { return _threads.size() + 1; }
+
+		static size_t defaultWorkers();
+
+	private:
+		void work(size_t queue);
+		bool runOne();
+
+		void push(Task task);
+		void finish(Counter* counter);
+		void split(size_t first, size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn, Counter& counter);
+	};
+
+}
@@ -7,59 +7,372 @@
 
 #include <iostream>
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <span>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <cmath>
 #include <exception>
 
 #include <window.h>
 #include <d3drenderer.h>
 #include <sprite.h>
 #include <cube.h>
+#include <jobs.h>
+#include <profiler.h>
+#include <snapshot.h>
+#include <mesh.h>
+#include <entity.h>
 #include <DX.h>
 
 const int WIDTH = 800, HEIGHT = 600;
 const float aspect = static_cast<float>(WIDTH) / static_cast<float>(HEIGHT);
 
+// Radians per second around each axis, sprites only turn around z
+struct Spin {
+    DirectX::XMFLOAT3 rate;
+};
+
 struct state {
-    std::vector<Sprite::Data> sprites = {
-        Sprite::Data { { WIDTH * 0.75f, HEIGHT * 0.75f }, 0.0f, { 0.5f,  0.5f} },
-        Sprite::Data { { WIDTH * 0.25f, HEIGHT * 0.75f }, 0.0f, { 0.1f,  0.5f} },
-        Sprite::Data { { WIDTH * 0.25f, HEIGHT * 0.25f }, 0.0f, {0.25f, 0.25f} },
-        Sprite::Data { { WIDTH * 0.75f, HEIGHT * 0.25f }, 0.0f, { 0.5f,  0.5f} },
-    };
-
-    std::vector<Cube::Data> cubes = {
-        Cube::Data { { 0.0f, 0.0f, 6.0f }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } },
-        Cube::Data { { -2.0f, -2.0f, 8.0f }, { 0.0f, 0.0f, 0.0f }, { 0.5f, 1.0f, 1.0f } },
-    };
-
-    std::vector<Font::String> strings = {
-		Font::String { "CHOP A WOOD", { 25, 250 }, 128 },
-		Font::String { "MEW", { 700, 20 }, 16 },
-    };
-
-    void update();
+    Entity::World world;
+
+    state() {
+        const Spin sprite = { { 0.0f, 0.0f, DirectX::XM_PI } };
+        createSprite({ WIDTH * 0.75f, HEIGHT * 0.75f }, { 0.5f,  0.5f}, sprite);
+        createSprite({ WIDTH * 0.25f, HEIGHT * 0.75f }, { 0.1f,  0.5f}, sprite);
+        createSprite({ WIDTH * 0.25f, HEIGHT * 0.25f }, {0.25f, 0.25f}, sprite);
+        createSprite({ WIDTH * 0.75f, HEIGHT * 0.25f }, { 0.5f,  0.5f}, sprite);
+
+        createCube({ 0.0f, 0.0f, 6.0f }, { 1.0f, 1.0f, 1.0f }, cubeSpin(0));
+        createCube({ -2.0f, -2.0f, 8.0f }, { 0.5f, 1.0f, 1.0f }, cubeSpin(1));
+
+		world.create(Font::String { "CHOP A WOOD", { 25, 250 }, 128 });
+		world.create(Font::String { "MEW", { 700, 20 }, 16 });
+    }
+
+    // A component per field, so each query only walks the columns it uses
+    void createSprite(DirectX::XMFLOAT2 position, DirectX::XMFLOAT2 scale, const Spin& spin) {
+        world.create(Sprite::Position{ position }, Sprite::Rotation{}, Sprite::Scale{ scale }, Sprite::Image{}, spin);
+    }
+
+    // Cubes also keep their world matrix. One that does not spin gets no
+    // Spin, so the update never visits it and its matrix stays cached.
+    void createCube(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 scale, const Spin& spin) {
+        const Cube::Instance matrix = { Cube::Data(position, { 0.0f, 0.0f, 0.0f }, scale).getWorldMatrix() };
+
+        if (spin.rate.x == 0.0f && spin.rate.y == 0.0f && spin.rate.z == 0.0f)
+            world.create(Cube::Position{ position }, Cube::Rotation{}, Cube::Scale{ scale }, matrix);
+        else
+            world.create(Cube::Position{ position }, Cube::Rotation{}, Cube::Scale{ scale }, matrix, spin);
+    }
+
+    // Every other cube only spins around y, every fourth stands still
+    static Spin cubeSpin(size_t iter) {
+        if (iter % 4 == 3) return {};
+        return { { ((iter % 2) != 0) ? 0.0f : DirectX::XM_PIDIV4, DirectX::XM_PIDIV4, 0.0f } };
+    }
+
+    void spawnCubes(size_t count);
+    void update(Jobs::Scheduler& jobs);
+    void publish(Snapshot::TripleBuffer& snapshots);
 } state;
 
-void state::update() {
+// Replaces the scene cubes with a count-sized grid in front of the camera
+void state::spawnCubes(size_t count) {
+    const size_t side = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(count)))));
+    const float half = static_cast<float>(side) * 0.5f;
+
+    // Destroys wait until the query is done
+    world.each<const Cube::Position>([&](std::span<const Entity::Handle> handles, std::span<const Cube::Position>) {
+        for (Entity::Handle handle : handles) world.destroy(handle);
+    });
+
+    for (size_t iter = 0; iter < count; iter++) {
+        const float x = static_cast<float>(iter % side) - half;
+        const float y = static_cast<float>((iter / side) % side) - half;
+        const float z = static_cast<float>(iter / (side * side));
+
+        createCube({ x * 3.0f, y * 3.0f, 6.0f + z * 3.0f }, { 0.5f, 0.5f, 0.5f }, cubeSpin(iter));
+    }
+}
+
+void state::update(Jobs::Scheduler& jobs) {
+    PROFILE_ZONE("update");
+
 	static auto start = std::chrono::high_resolution_clock::now();
 	auto current = std::chrono::high_resolution_clock::now();
 	const float delta = std::chrono::duration<float, std::chrono::seconds::period>(current - start).count();
 
-    for (auto& sprite : this->sprites)
-        sprite.setRotation(DirectX::XM_PI * delta);
+    // One job per chunk, each walks only the rotation and spin columns front to back
+    world.each<Sprite::Rotation, const Spin>(jobs, [&](std::span<Sprite::Rotation> rotations, std::span<const Spin> spins) {
+        for (size_t iter = 0; iter < rotations.size(); iter++)
+            rotations[iter].radians = spins[iter].rate.z * delta;
+    });
 
-    bool flag = false;
-    for (auto& cube : this->cubes) {
-        cube.setRotation(DirectX::XMVECTOR{ 
-            DirectX::XM_PIDIV4 * delta * ((flag) ? 0.0f : 1.0f), DirectX::XM_PIDIV4 * delta, 0 
+    // Spinning cubes rebuild their cached world matrices right away, static ones are skipped
+    world.each<const Cube::Position, Cube::Rotation, const Cube::Scale, const Spin, Cube::Instance>(jobs,
+        [&](std::span<const Cube::Position> positions, std::span<Cube::Rotation> rotations, std::span<const Cube::Scale> scales,
+                std::span<const Spin> spins, std::span<Cube::Instance> matrices) {
+            for (size_t iter = 0; iter < rotations.size(); iter++) {
+                const DirectX::XMFLOAT3& rate = spins[iter].rate;
+                rotations[iter] = { { rate.x * delta, rate.y * delta, rate.z * delta } };
+            }
+            Cube::getWorldMatrices({ positions, rotations, scales }, matrices);
         });
+}
+
+// Copies the simulation into the next snapshot for the render thread, a chunk at a time
+void state::publish(Snapshot::TripleBuffer& snapshots) {
+    PROFILE_ZONE("publish");
 
-        flag = !flag;
+    Snapshot::Scene& scene = snapshots.back();
+    scene.clear();
+    world.each<const Sprite::Position, const Sprite::Rotation, const Sprite::Scale, const Sprite::Image>(
+        [&](std::span<const Sprite::Position> position, std::span<const Sprite::Rotation> rotation,
+                std::span<const Sprite::Scale> scale, std::span<const Sprite::Image> image) {
+            scene.add(Sprite::Columns{ position, rotation, scale, image });
+        });
+    world.each<const Cube::Position, const Cube::Rotation, const Cube::Scale, const Cube::Instance>(
+        [&](std::span<const Cube::Position> position, std::span<const Cube::Rotation> rotation,
+                std::span<const Cube::Scale> scale, std::span<const Cube::Instance> matrices) {
+            scene.add(Cube::Columns{ position, rotation, scale, matrices });
+        });
+    world.each<const Font::String>([&](std::span<const Font::String> strings) { scene.add(strings); });
+    snapshots.publish();
+}
+
+// Workers of the update's own scheduler. A thread waiting in parallelFor runs
+// whatever its scheduler has queued, so sharing the renderer's would let the
+// update run record and raster jobs and the render thread run update chunks.
+size_t updateWorkers() {
+    return std::max<size_t>(1, Jobs::Scheduler::defaultWorkers() / 4);
+}
+
+// Sleeps until the next update is due, 0 Hz updates as fast as it can
+void pace(std::chrono::steady_clock::time_point& next, int hz) {
+    if (hz <= 0)
+        return;
+
+    // A late update starts the next period right away instead of catching up
+    next = std::max(next + std::chrono::nanoseconds(1000000000 / hz), std::chrono::steady_clock::now());
+    std::this_thread::sleep_until(next);
+}
+
+// Draws the newest snapshot until `stop` is set or `onFrame(ms)` returns
+// false. Runs on the render thread, the only one touching the renderer.
+void renderLoop(D3DRenderer& renderer, Snapshot::TripleBuffer& snapshots, Snapshot::Stats& stats,
+        const std::atomic<bool>& stop, const std::function<bool(double)>& onFrame) {
+    while (!stop.load(std::memory_order_relaxed)) {
+        auto begin = std::chrono::high_resolution_clock::now();
+
+        {
+            PROFILE_ZONE("frame");
+            const bool acquired = snapshots.acquire();
+            Snapshot::Scene& scene = snapshots.front();
+
+            renderer.beginFrame();
+            renderer.clrScr({ 0.0f, 0.0f, 0.25f, 1.0f });
+            renderer.renderScene(scene.sprites, scene.cubes, scene.strings);
+            renderer.present();
+
+            stats.frame(scene, acquired, Profile::now());
+        }
+        PROFILE_FRAME();
+
+        auto end = std::chrono::high_resolution_clock::now();
+        if (!onFrame(std::chrono::duration<double, std::milli>(end - begin).count()))
+            return;
     }
 }
 
+// Runs the frame loop without a window or device and reports CPU cost,
+// software runs also rasterize every frame and can save the last one.
+// This thread keeps updating while a render thread draws the frames.
+int runHeadless(int frames, int updateHz, bool occlusion, bool software, bool compact, const std::string& frameOut, const std::string& traceOut) {
+    Window window;
+    D3DRenderer renderer(window, WIDTH, HEIGHT);
+    renderer._compactSprites = compact;
+
+    if (software)
+        renderer.initSoftware();
+    else
+        renderer.initHeadless();
+    renderer.populateVRAM(4, 16, 1024);
+    renderer._occlusionCulling = occlusion;
+
+    Backend::FrameStats total;
+    Cull::Stats spriteCull, cubeCull, cubeOcclusion;
+    std::array<size_t, Mesh::maxLods> cubeLods = {};
+    size_t textHits = 0, textMisses = 0, rasterPixels = 0;
+    double totalMs = 0.0, minMs = 1e9, maxMs = 0.0;
+
+    Snapshot::TripleBuffer snapshots;
+    Snapshot::Stats snapshotStats;
+    std::atomic<bool> done = false;
+    int frame = 0;
+
+    // Frame stats are only touched by the render thread until the join
+    state.publish(snapshots);
+    std::thread render([&] {
+        renderLoop(renderer, snapshots, snapshotStats, done, [&](double ms) {
+            totalMs += ms;
+            minMs = std::min(minMs, ms);
+            maxMs = std::max(maxMs, ms);
+            total += renderer._backend->stats;
+            spriteCull += renderer._spriteCull;
+            cubeCull += renderer._cubeCull;
+            cubeOcclusion += renderer._cubeOcclusion;
+            for (size_t level = 0; level < cubeLods.size(); level++) cubeLods[level] += renderer._cubeLodInstances[level];
+            textHits += renderer._fontCache._stats.hits;
+            textMisses += renderer._fontCache._stats.misses;
+            if (software) rasterPixels += renderer._raster->_stats.pixels;
+            return ++frame < frames;
+        });
+        done = true;
+    });
+
+    Jobs::Scheduler updateJobs(updateWorkers());
+    auto next = std::chrono::steady_clock::now();
+    while (!done.load(std::memory_order_relaxed)) {
+        state.update(updateJobs);
+        state.publish(snapshots);
+        pace(next, updateHz);
+    }
+    render.join();
+
+    if (!frameOut.empty() && !renderer.saveFrame(frameOut))
+        std::cerr << "Could not write " << frameOut << std::endl;
+#ifdef PROFILE_ZONES
+    if (!traceOut.empty() && !Profile::profiler().writeTrace(traceOut))
+        std::cerr << "Could not write " << traceOut << std::endl;
+#endif
+
+    renderer.cleanUp();
+
+    if (frames <= 0)
+        return 0;
+
+    const double n = static_cast<double>(frames);
+    const size_t cubes = state.world.count<Cube::Position>();
+    std::cout << "Headless frames: " << frames << ", cubes: " << cubes << " (" << cubes - state.world.count<Cube::Position, Spin>() << " static)"
+        << ", threads: render " << renderer._jobs.threads() << ", update " << updateJobs.threads() << "\n"
+        << "CPU ms/frame: avg " << totalMs / n << ", min " << minMs << ", max " << maxMs << "\n"
+        << "Draws/frame: " << total.drawCalls() / n
+        << " (instances " << total.instances / n << ")\n"
+        << "Triangles/frame: " << total.triangles / n << ", cubes per lod";
+    for (size_t level = 0; level < renderer._cubeLods.size(); level++)
+        std::cout << " " << cubeLods[level] / n;
+    std::cout << "\n"
+        << "Binds/frame: " << total.binds / n << " issued, " << total.bindsSkipped / n << " skipped\n"
+        << "Culled/frame: sprites " << spriteCull.culled() / n << " of " << spriteCull.tested / n
+        << ", cubes " << cubeCull.culled() / n << " of " << cubeCull.tested / n
+        << " (" << (spriteCull.ms + cubeCull.ms) / n << " ms)\n"
+        << "Occluded/frame: cubes " << cubeOcclusion.culled() / n << " of " << cubeOcclusion.tested / n
+        << " (" << cubeOcclusion.ms / n << " ms)\n"
+        << "Maps/frame: " << total.maps / n
+        << ", bytes uploaded/frame: " << total.bytesUploaded / n << "\n"
+        << "Text cache hits/misses: " << textHits << "/" << textMisses << "\n"
+        << "Snapshots: " << snapshots._sequence << " published, " << snapshotStats.dropped << " dropped, "
+        << snapshotStats.duplicated << " frames duplicated, latency avg " << snapshotStats.avgLatencyMs()
+        << ", max " << snapshotStats.maxLatencyMs << " ms\n"
+        << "Arena peak bytes/frame: render " << renderer._frameArena.peak() << ", snapshot text "
+        << std::max({ snapshots._slots[0]._text._peak, snapshots._slots[1]._text._peak, snapshots._slots[2]._text._peak }) << std::endl;
+
+    if (software)
+        std::cout << "Software Mpixels/s: " << static_cast<double>(rasterPixels) / (totalMs * 1000.0) << std::endl;
+
+#ifdef PROFILE_ZONES
+    for (auto& zone : Profile::profiler().summary())
+        std::cout << "Zone " << zone.name << ": min " << zone.minMs << ", avg " << zone.avgMs
+            << ", p99 " << zone.p99Ms << " ms (" << zone.frames << " frames)\n";
+#endif
+    std::cout << std::flush;
+
+    return 0;
+}
+
+// Compiles every shader variant into the pack, no window or device needed
+int buildShaders() {
+    Window window;
+    D3DRenderer renderer(window, WIDTH, HEIGHT);
+
+    try {
+        renderer.buildShaderPack();
+    }
+    catch (DX::com_exception e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+// OBJ to the quantized, cache ordered binary the renderer maps
+int importMesh(const std::string& objPath, const std::string& meshPath) {
+    Mesh::Source mesh;
+    if (!Mesh::importObj(objPath, mesh) || mesh.indices.empty()) {
+        std::cerr << objPath << ": missing or malformed OBJ" << std::endl;
+        return 1;
+    }
+
+    const auto before = Mesh::analyzeVertexCache(mesh.indices, mesh.positions.size());
+    Mesh::buildLods(mesh);
+    Mesh::optimize(mesh);
+    const auto after = Mesh::analyzeVertexCache(std::span(mesh.indices).first(mesh.lods[0].indexCount), mesh.positions.size());
+
+    if (!Mesh::write(meshPath, Mesh::encode(mesh, Mesh::Optimized))) {
+        std::cerr << "Could not write " << meshPath << std::endl;
+        return 1;
+    }
+
+    std::cout << meshPath << ": " << mesh.positions.size() << " vertices, " << mesh.lods[0].indexCount / 3
+        << " triangles, ACMR " << before.acmr << " -> " << after.acmr << ", lods";
+    for (const Mesh::Lod& lod : mesh.lods)
+        std::cout << " " << lod.indexCount / 3;
+    std::cout << std::endl;
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && std::string(argv[1]) == "--build-shaders")
+        return buildShaders();
+    if (argc > 3 && std::string(argv[1]) == "--import-mesh")
+        return importMesh(argv[2], argv[3]);
+
+    int headlessFrames = 0, updateHz = 60;
+    size_t textureBudgetMB = 64;
+    bool occlusion = true, software = false, compact = false;
+    std::string frameOut, traceOut;
+    for (int arg = 1; arg + 1 < argc; arg += 2) {
+        const std::string option = argv[arg];
+
+        if (option == "--headless")
+            headlessFrames = std::stoi(argv[arg + 1]);
+        else if (option == "--cubes")
+            state.spawnCubes(std::stoul(argv[arg + 1]));
+        else if (option == "--texture-budget")
+            textureBudgetMB = std::stoul(argv[arg + 1]);
+        else if (option == "--occlusion")
+            occlusion = std::stoi(argv[arg + 1]) != 0;
+        else if (option == "--software")
+            software = std::stoi(argv[arg + 1]) != 0;
+        else if (option == "--frame-out")
+            frameOut = argv[arg + 1];
+        else if (option == "--trace")
+            traceOut = argv[arg + 1];
+        else if (option == "--update-hz")
+            updateHz = std::stoi(argv[arg + 1]);
+        else if (option == "--compact-sprites")
+            compact = std::stoi(argv[arg + 1]) != 0;
+    }
+
+    if (headlessFrames > 0)
+        return runHeadless(headlessFrames, updateHz, occlusion, software, compact, frameOut, traceOut);
+
 	Window window;
     SDL_Init(SDL_INIT_VIDEO);
 
@@ -78,10 +391,25 @@ int main(int argc, char *argv[])
 	SDL_GetWindowWMInfo(window.SDL, &window.sysWMInfo);
 
 	D3DRenderer renderer(window);
+    renderer._textureBudget = textureBudgetMB << 20;
+    renderer._occlusionCulling = occlusion;
+    renderer._compactSprites = compact;
 
     try {
         renderer.init();
-        renderer.populateVRAM(4, 16);
+        renderer.populateVRAM(4, 16, 1024);
+
+        // Sprites take turns between the atlas images
+        const std::array spriteImages = { "res/wood/Wood066_1K_Color.dds", "res/heart/heart.dds" };
+        auto regions = renderer.loadSpriteAtlas(spriteImages);
+        size_t iter = 0;
+        state.world.each<Sprite::Image>([&](std::span<Sprite::Image> images) {
+            for (auto& image : images) {
+                auto& region = regions[iter % regions.size()];
+                image = { DirectX::XMFLOAT4(region.uvRect.data()), region.page, static_cast<uint16_t>(iter % regions.size()) };
+                iter++;
+            }
+        });
     }
     catch (DX::com_exception e) {
 		window.shout(e.what(), "DirectX 11 error");
@@ -91,21 +419,37 @@ int main(int argc, char *argv[])
         return 1;
     }
     
+    // The render thread owns the renderer from here to the join, this
+    // thread handles the window and the updates and never waits on the GPU
+    Snapshot::TripleBuffer snapshots;
+    Snapshot::Stats snapshotStats;
+    std::atomic<bool> quit = false;
+
+    state.publish(snapshots);
+    std::thread render([&] {
+        renderLoop(renderer, snapshots, snapshotStats, quit, [](double) { return true; });
+    });
+
     SDL_Event windowEvent;
-    while (true) {
-        if (SDL_PollEvent(&windowEvent)) {
+    Jobs::Scheduler updateJobs(updateWorkers());
+    auto next = std::chrono::steady_clock::now();
+    while (!quit.load(std::memory_order_relaxed)) {
+        while (SDL_PollEvent(&windowEvent)) {
             if (SDL_QUIT == windowEvent.type)
-                break;
+                quit = true;
         }
 
-        state.update();
-
-        renderer.clrScr({ 0.0f, 0.0f, 0.25f, 1.0f });
-		renderer.renderSprites(state.sprites);
-        renderer.renderCube(state.cubes);
-        renderer.renderString(state.strings);
-        renderer.present();
+        state.update(updateJobs);
+        state.publish(snapshots);
+        pace(next, updateHz);
     }
+    render.join();
+
+    // The last frames before closing the window
+#ifdef PROFILE_ZONES
+    if (!traceOut.empty() && !Profile::profiler().writeTrace(traceOut))
+        std::cerr << "Could not write " << traceOut << std::endl;
+#endif
     
     renderer.cleanUp();
     SDL_DestroyWindow(window.SDL);
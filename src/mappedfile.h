@@ -0,0 +1,29 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <cstddef>
+
+// Read-only view of a whole file through the OS page cache
+struct MappedFile {
+	const std::byte* _data = nullptr;
+	size_t _size = 0;
+
+#ifdef _WIN32
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+#else
+	int _fd = -1;
+#endif
+
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	// False when the file is missing, empty or cannot be mapped
+	bool open(const std::string& path);
+	void close();
+
+	std::span<const std::byte> bytes() const { return { _data, _size }; }
+};
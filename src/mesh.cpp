@@ -0,0 +1,881 @@
+#include <mesh.h>
+
+#include <span>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <charconv>
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+#include <DirectXMath.h>
+
+#include <mappedfile.h>
+
+namespace {
+
+	// Forsyth's tuning, the simulated cache is bigger than the real one on purpose
+	constexpr uint32_t scoreCacheSize = 32;
+	constexpr uint32_t noTriangle = ~0u;
+
+	float vertexScore(int cachePos, uint32_t valence) {
+		if (valence == 0) return -1.0f;
+
+		float score = 0.0f;
+		if (cachePos >= 0) {
+			// The last triangle's vertices score flat so it does not win again by itself
+			score = (cachePos < 3) ? 0.75f
+				: std::pow(1.0f - static_cast<float>(cachePos - 3) / static_cast<float>(scoreCacheSize - 3), 1.5f);
+		}
+
+		// Vertices with few triangles left go first, or they get stranded
+		return score + 2.0f / std::sqrt(static_cast<float>(valence));
+	}
+
+	void skipSpace(std::string_view& text) {
+		while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+	}
+
+	template<typename T> bool number(std::string_view& text, T& value) {
+		skipSpace(text);
+		auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+		if (error != std::errc()) return false;
+
+		text.remove_prefix(static_cast<size_t>(end - text.data()));
+		return true;
+	}
+
+	// 1-based, negative counts back from the last one so far, -1 for none
+	bool resolve(int64_t index, size_t count, int64_t& out) {
+		out = (index < 0) ? static_cast<int64_t>(count) + index : index - 1;
+		return index != 0 && out >= 0 && out < static_cast<int64_t>(count);
+	}
+
+	struct Point {
+		float x, y, z;
+	};
+
+	float edge(const Point& a, const Point& b, float px, float py) {
+		return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+	}
+
+	// Pixels exactly on an edge shared by two triangles belong to one of them
+	bool owns(const Point& a, const Point& b, float w) {
+		return w > 0.0f || (w == 0.0f && (b.y < a.y || (b.y == a.y && b.x < a.x)));
+	}
+
+	// Sum of squared distances to the planes around a vertex, weighted by triangle area
+	struct Quadric {
+		double xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+		double x = 0, y = 0, z = 0, c = 0;
+		double weight = 0;
+
+		void addPlane(const DirectX::XMFLOAT3& n, float d, float area) {
+			xx += area * n.x * n.x; xy += area * n.x * n.y; xz += area * n.x * n.z;
+			yy += area * n.y * n.y; yz += area * n.y * n.z; zz += area * n.z * n.z;
+			x += area * n.x * d; y += area * n.y * d; z += area * n.z * d;
+			c += area * d * d;
+			weight += area;
+		}
+
+		void add(const Quadric& other) {
+			xx += other.xx; xy += other.xy; xz += other.xz; yy += other.yy; yz += other.yz; zz += other.zz;
+			x += other.x; y += other.y; z += other.z; c += other.c;
+			weight += other.weight;
+		}
+
+		// Mean squared distance of p to the planes
+		double error(const DirectX::XMFLOAT3& p) const {
+			if (weight <= 0) return 0;
+			const double sum = xx * p.x * p.x + 2 * xy * p.x * p.y + 2 * xz * p.x * p.z + yy * p.y * p.y + 2 * yz * p.y * p.z + zz * p.z * p.z
+				+ 2 * (x * p.x + y * p.y + z * p.z) + c;
+			return std::max(sum, 0.0) / weight;
+		}
+	};
+
+	struct Collapse {
+		float cost;
+		uint32_t from, to;
+	};
+
+	// Same bits, same position, whatever the uv says
+	struct PositionHash {
+		size_t operator()(const std::array<uint32_t, 3>& bits) const {
+			return (size_t(bits[0]) * 73856093) ^ (size_t(bits[1]) * 19349663) ^ (size_t(bits[2]) * 83492791);
+		}
+	};
+
+	DirectX::XMVECTOR faceNormal(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, const DirectX::XMFLOAT3& c) {
+		using namespace DirectX;
+		const XMVECTOR pa = XMLoadFloat3(&a);
+		return XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&b), pa), XMVectorSubtract(XMLoadFloat3(&c), pa));
+	}
+
+	// What an empty lods vector stands for
+	std::vector<Mesh::Lod> levels(const Mesh::Source& mesh) {
+		if (!mesh.lods.empty()) return mesh.lods;
+		return { { 0, static_cast<uint32_t>(mesh.indices.size()), 0.0f } };
+	}
+
+	void storeIndices(std::span<const uint32_t> indices, size_t indexSize, std::byte* out) {
+		for (size_t idx = 0; idx < indices.size(); idx++) {
+			if (indexSize == 4) {
+				std::memcpy(out + idx * 4, &indices[idx], 4);
+			}
+			else {
+				const uint16_t narrow = static_cast<uint16_t>(indices[idx]);
+				std::memcpy(out + idx * 2, &narrow, 2);
+			}
+		}
+	}
+
+}
+
+const char* Mesh::describe(Result result) {
+	switch (result) {
+		case Result::Ok: return "ok";
+		case Result::Missing: return "file missing or empty";
+		case Result::TooSmall: return "file smaller than the mesh header";
+		case Result::BadMagic: return "not a mesh file";
+		case Result::BadHeader: return "malformed mesh header";
+		case Result::Truncated: return "vertex or index data is truncated";
+		case Result::BadIndex: return "index past the last vertex";
+	}
+	return "unknown";
+}
+
+bool Mesh::importObj(std::span<const std::byte> text, Source& mesh) {
+	mesh = {};
+
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT2> uvs;
+	std::unordered_map<uint64_t, uint32_t> vertices;
+	std::vector<uint32_t> face;
+
+	std::string_view rest(reinterpret_cast<const char*>(text.data()), text.size());
+	while (!rest.empty()) {
+		const size_t end = std::min(rest.find('\n'), rest.size());
+		std::string_view line = rest.substr(0, end);
+		rest.remove_prefix(std::min(end + 1, rest.size()));
+
+		if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+		skipSpace(line);
+
+		if (line.starts_with("v ")) {
+			line.remove_prefix(2);
+			DirectX::XMFLOAT3 pos;
+			if (!number(line, pos.x) || !number(line, pos.y) || !number(line, pos.z)) return false;
+
+			// OBJ is right-handed, the renderer is not. Mirroring z keeps the
+			// counter-clockwise faces front facing under clockwise culling.
+			pos.z = -pos.z;
+			positions.push_back(pos);
+		}
+		else if (line.starts_with("vt ")) {
+			line.remove_prefix(3);
+			DirectX::XMFLOAT2 uv;
+			if (!number(line, uv.x) || !number(line, uv.y)) return false;
+			uvs.push_back(uv);
+		}
+		else if (line.starts_with("f ")) {
+			line.remove_prefix(2);
+			face.clear();
+
+			// v, v/vt, v//vn or v/vt/vn, normals are not kept
+			for (skipSpace(line); !line.empty(); skipSpace(line)) {
+				int64_t posIdx = 0, uvIdx = 0, pos = 0, uv = -1;
+				if (!number(line, posIdx) || !resolve(posIdx, positions.size(), pos)) return false;
+
+				if (line.starts_with("/")) {
+					line.remove_prefix(1);
+					if (!line.starts_with("/") && (!number(line, uvIdx) || !resolve(uvIdx, uvs.size(), uv))) return false;
+				}
+				while (!line.empty() && line.front() != ' ' && line.front() != '\t') line.remove_prefix(1);
+
+				const uint64_t key = (static_cast<uint64_t>(pos) << 32) | static_cast<uint32_t>(uv + 1);
+				auto [it, added] = vertices.try_emplace(key, static_cast<uint32_t>(mesh.positions.size()));
+				if (added) {
+					mesh.positions.push_back(positions[pos]);
+					mesh.uvs.push_back((uv >= 0) ? uvs[uv] : DirectX::XMFLOAT2(0.0f, 0.0f));
+				}
+				face.push_back(it->second);
+			}
+
+			if (face.size() < 3) return false;
+			for (size_t corner = 2; corner < face.size(); corner++)
+				mesh.indices.insert(mesh.indices.end(), { face[0], face[corner - 1], face[corner] });
+		}
+	}
+
+	return true;
+}
+
+bool Mesh::importObj(const std::string& path, Source& mesh) {
+	MappedFile file;
+	return file.open(path) && importObj(file.bytes(), mesh);
+}
+
+void Mesh::optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount) {
+	const size_t triangles = indices.size() / 3;
+	if (triangles == 0) return;
+
+	// Triangles of every vertex, the live ones first in each range
+	std::vector<uint32_t> valence(vertexCount, 0), offsets(vertexCount + 1, 0);
+	for (uint32_t idx : indices) valence[idx]++;
+	for (size_t vert = 0; vert < vertexCount; vert++) offsets[vert + 1] = offsets[vert] + valence[vert];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t idx = 0; idx < indices.size(); idx++) adjacency[fill[indices[idx]]++] = static_cast<uint32_t>(idx / 3);
+	}
+
+	std::vector<int> cachePos(vertexCount, -1);
+	std::vector<float> vertScore(vertexCount), triScore(triangles);
+	for (size_t vert = 0; vert < vertexCount; vert++) vertScore[vert] = vertexScore(-1, valence[vert]);
+	for (size_t tri = 0; tri < triangles; tri++)
+		triScore[tri] = vertScore[indices[tri * 3]] + vertScore[indices[tri * 3 + 1]] + vertScore[indices[tri * 3 + 2]];
+
+	std::vector<uint8_t> emitted(triangles, 0);
+	std::vector<uint32_t> order;
+	order.reserve(indices.size());
+
+	std::array<uint32_t, scoreCacheSize + 3> cache, next;
+	size_t cached = 0, cursor = 0;
+	uint32_t best = noTriangle;
+
+	while (order.size() < triangles * 3) {
+		if (best == noTriangle) {
+			// Nothing in the cache has triangles left, start over at the next one in input order
+			while (emitted[cursor]) cursor++;
+			best = static_cast<uint32_t>(cursor);
+		}
+
+		const uint32_t* tri = &indices[best * 3];
+		order.insert(order.end(), tri, tri + 3);
+		emitted[best] = 1;
+
+		for (int corner = 0; corner < 3; corner++) {
+			const uint32_t vert = tri[corner];
+			uint32_t* live = &adjacency[offsets[vert]];
+			std::swap(*std::find(live, live + valence[vert], best), live[valence[vert] - 1]);
+			valence[vert]--;
+		}
+
+		// The triangle's vertices move to the front, the rest shift back
+		size_t count = 0;
+		for (int corner = 0; corner < 3; corner++)
+			if (std::find(next.begin(), next.begin() + count, tri[corner]) == next.begin() + count) next[count++] = tri[corner];
+		for (size_t slot = 0; slot < cached; slot++)
+			if (cache[slot] != tri[0] && cache[slot] != tri[1] && cache[slot] != tri[2]) next[count++] = cache[slot];
+
+		for (size_t slot = 0; slot < count; slot++) {
+			const uint32_t vert = next[slot];
+			cachePos[vert] = (slot < scoreCacheSize) ? static_cast<int>(slot) : -1;
+			vertScore[vert] = vertexScore(cachePos[vert], valence[vert]);
+		}
+
+		// Only triangles around the touched vertices changed score, the best of them goes next
+		best = noTriangle;
+		float bestScore = -1.0f;
+		for (size_t slot = 0; slot < count; slot++) {
+			const uint32_t vert = next[slot];
+			for (uint32_t live = 0; live < valence[vert]; live++) {
+				const uint32_t other = adjacency[offsets[vert] + live];
+				const uint32_t* corners = &indices[other * 3];
+				triScore[other] = vertScore[corners[0]] + vertScore[corners[1]] + vertScore[corners[2]];
+
+				if (triScore[other] > bestScore) {
+					bestScore = triScore[other];
+					best = other;
+				}
+			}
+		}
+
+		cached = std::min<size_t>(count, scoreCacheSize);
+		std::copy(next.begin(), next.begin() + cached, cache.begin());
+	}
+
+	std::copy(order.begin(), order.end(), indices.begin());
+}
+
+void Mesh::optimizeOverdraw(std::span<uint32_t> indices, std::span<const DirectX::XMFLOAT3> positions, uint32_t cacheSize, float threshold) {
+	using namespace DirectX;
+
+	const size_t triangles = indices.size() / 3;
+	if (triangles == 0) return;
+
+	// FIFO by timestamps, bumping the clock past every stamp empties the cache
+	std::vector<uint32_t> stamp(positions.size(), 0);
+	uint32_t clock = cacheSize + 1;
+	auto misses = [&](size_t tri) {
+		int missed = 0;
+		for (int corner = 0; corner < 3; corner++) {
+			const uint32_t vert = indices[tri * 3 + corner];
+			if (clock - stamp[vert] <= cacheSize) continue;
+
+			stamp[vert] = clock++;
+			missed++;
+		}
+		return missed;
+	};
+	auto flush = [&] { clock += cacheSize + 1; };
+
+	// A triangle missing with all three vertices is where the cache order started over
+	std::vector<uint32_t> hard;
+	for (size_t tri = 0; tri < triangles; tri++)
+		if (misses(tri) == 3 || tri == 0) hard.push_back(static_cast<uint32_t>(tri));
+	hard.push_back(static_cast<uint32_t>(triangles));
+
+	// Those are few, so each one is cut again wherever the piece so far costs
+	// no more than `threshold` times the whole one with a cold cache
+	std::vector<uint32_t> clusters;
+	for (size_t cluster = 0; cluster + 1 < hard.size(); cluster++) {
+		const size_t first = hard[cluster], last = hard[cluster + 1];
+
+		flush();
+		size_t total = 0;
+		for (size_t tri = first; tri < last; tri++) total += misses(tri);
+		const float limit = threshold * static_cast<float>(total) / static_cast<float>(last - first);
+
+		flush();
+		size_t start = first, missed = 0;
+		for (size_t tri = first; tri < last; tri++) {
+			missed += misses(tri);
+			if (static_cast<float>(missed) / static_cast<float>(tri + 1 - start) > limit && tri + 1 != last) continue;
+
+			clusters.push_back(static_cast<uint32_t>(start));
+			start = tri + 1;
+			missed = 0;
+			flush();
+		}
+	}
+	clusters.push_back(static_cast<uint32_t>(triangles));
+
+	// Area weighted, the cross product is the outward normal for clockwise faces
+	auto weigh = [&](size_t first, size_t last, XMVECTOR& centroid, XMVECTOR& normal) {
+		float area = 0.0f;
+		centroid = XMVectorZero();
+		normal = XMVectorZero();
+
+		for (size_t tri = first; tri < last; tri++) {
+			const XMVECTOR a = XMLoadFloat3(&positions[indices[tri * 3]]);
+			const XMVECTOR b = XMLoadFloat3(&positions[indices[tri * 3 + 1]]);
+			const XMVECTOR c = XMLoadFloat3(&positions[indices[tri * 3 + 2]]);
+
+			const XMVECTOR cross = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+			const float weight = XMVectorGetX(XMVector3Length(cross));
+			centroid = XMVectorAdd(centroid, XMVectorScale(XMVectorAdd(XMVectorAdd(a, b), c), weight / 3.0f));
+			area += weight;
+			normal = XMVectorAdd(normal, cross);
+		}
+
+		centroid = (area > 0.0f) ? XMVectorScale(centroid, 1.0f / area) : XMVectorZero();
+	};
+
+	XMVECTOR center, unused;
+	weigh(0, triangles, center, unused);
+
+	std::vector<float> keys(clusters.size() - 1);
+	for (size_t cluster = 0; cluster + 1 < clusters.size(); cluster++) {
+		XMVECTOR centroid, normal;
+		weigh(clusters[cluster], clusters[cluster + 1], centroid, normal);
+		const float length = XMVectorGetX(XMVector3Length(normal));
+		keys[cluster] = (length > 0.0f) ? XMVectorGetX(XMVector3Dot(XMVectorSubtract(centroid, center), normal)) / length : 0.0f;
+	}
+
+	std::vector<uint32_t> sorted(keys.size());
+	std::iota(sorted.begin(), sorted.end(), 0);
+	std::stable_sort(sorted.begin(), sorted.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+	std::vector<uint32_t> order;
+	order.reserve(indices.size());
+	for (uint32_t cluster : sorted)
+		order.insert(order.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+
+	std::copy(order.begin(), order.end(), indices.begin());
+}
+
+void Mesh::optimizeVertexFetch(Source& mesh) {
+	std::vector<uint32_t> remap(mesh.positions.size(), noTriangle);
+	Source fetched;
+	fetched.indices.reserve(mesh.indices.size());
+	fetched.lods = std::move(mesh.lods);
+
+	// Vertices nothing references are dropped on the way
+	for (uint32_t idx : mesh.indices) {
+		if (remap[idx] == noTriangle) {
+			remap[idx] = static_cast<uint32_t>(fetched.positions.size());
+			fetched.positions.push_back(mesh.positions[idx]);
+			fetched.uvs.push_back(mesh.uvs[idx]);
+		}
+		fetched.indices.push_back(remap[idx]);
+	}
+
+	mesh = std::move(fetched);
+}
+
+void Mesh::optimize(Source& mesh) {
+	for (const Lod& lod : levels(mesh)) {
+		auto range = std::span(mesh.indices).subspan(lod.firstIndex, lod.indexCount);
+		optimizeVertexCache(range, mesh.positions.size());
+		optimizeOverdraw(range, mesh.positions);
+	}
+
+	// Every level uses a subset of the full one's vertices, so its first use decides the order
+	optimizeVertexFetch(mesh);
+}
+
+std::vector<uint32_t> Mesh::simplify(std::span<const DirectX::XMFLOAT3> positions, std::span<const uint32_t> indices, size_t targetIndexCount, float targetError, float* error) {
+	using namespace DirectX;
+
+	std::vector<uint32_t> result(indices.begin(), indices.end());
+	if (error) *error = 0.0f;
+	if (result.size() <= targetIndexCount || positions.empty()) return result;
+
+	const size_t vertexCount = positions.size();
+
+	// In units of the largest extent, so the error means the same for any mesh
+	XMFLOAT3 lo = positions[0], hi = positions[0];
+	for (auto& pos : positions) {
+		lo = { std::min(lo.x, pos.x), std::min(lo.y, pos.y), std::min(lo.z, pos.z) };
+		hi = { std::max(hi.x, pos.x), std::max(hi.y, pos.y), std::max(hi.z, pos.z) };
+	}
+	const float extent = std::max({ hi.x - lo.x, hi.y - lo.y, hi.z - lo.z });
+	const float toUnit = (extent > 0.0f) ? 1.0f / extent : 1.0f;
+
+	std::vector<XMFLOAT3> pos(vertexCount);
+	for (size_t vert = 0; vert < vertexCount; vert++)
+		pos[vert] = { (positions[vert].x - lo.x) * toUnit, (positions[vert].y - lo.y) * toUnit, (positions[vert].z - lo.z) * toUnit };
+
+	// A position split over several vertices is a uv seam, moving one copy would tear it open
+	std::vector<uint8_t> locked(vertexCount, 0);
+	std::unordered_map<std::array<uint32_t, 3>, uint32_t, PositionHash> firstAt;
+	firstAt.reserve(vertexCount);
+	for (uint32_t vert = 0; vert < vertexCount; vert++) {
+		std::array<uint32_t, 3> bits;
+		std::memcpy(bits.data(), &positions[vert], sizeof(bits));
+
+		auto [first, inserted] = firstAt.try_emplace(bits, vert);
+		if (!inserted) locked[vert] = locked[first->second] = 1;
+	}
+
+	// Edges without exactly two triangles are open borders or non-manifold, both stay put
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	edgeUses.reserve(result.size());
+	auto edgeKey = [](uint32_t a, uint32_t b) { return (uint64_t(std::min(a, b)) << 32) | std::max(a, b); };
+	for (size_t tri = 0; tri < result.size(); tri += 3) {
+		for (int corner = 0; corner < 3; corner++) edgeUses[edgeKey(result[tri + corner], result[tri + (corner + 1) % 3])]++;
+	}
+	for (size_t tri = 0; tri < result.size(); tri += 3) {
+		for (int corner = 0; corner < 3; corner++) {
+			const uint32_t a = result[tri + corner], b = result[tri + (corner + 1) % 3];
+			if (edgeUses[edgeKey(a, b)] != 2) locked[a] = locked[b] = 1;
+		}
+	}
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t tri = 0; tri < result.size(); tri += 3) {
+		const uint32_t a = result[tri], b = result[tri + 1], c = result[tri + 2];
+		const XMVECTOR normal = faceNormal(pos[a], pos[b], pos[c]);
+		const float length = XMVectorGetX(XMVector3Length(normal));
+		if (length <= 0.0f) continue;
+
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, XMVectorScale(normal, 1.0f / length));
+		const float d = -(n.x * pos[a].x + n.y * pos[a].y + n.z * pos[a].z);
+		for (uint32_t vert : { a, b, c }) quadrics[vert].addPlane(n, d, length * 0.5f);
+	}
+
+	const float maxCost = targetError * targetError;
+	float worst = 0.0f;
+
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertexCount), firstTriangle(vertexCount + 1), triangles;
+	std::vector<uint8_t> touched(vertexCount);
+
+	// Passes of independent collapses, cheapest first, until nothing under the error is left
+	while (result.size() > targetIndexCount) {
+		const size_t triangleCount = result.size() / 3;
+
+		// Triangles around each vertex
+		std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+		for (uint32_t idx : result) firstTriangle[idx + 1]++;
+		std::partial_sum(firstTriangle.begin(), firstTriangle.end(), firstTriangle.begin());
+		triangles.resize(result.size());
+		{
+			std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+			for (size_t idx = 0; idx < result.size(); idx++) triangles[fill[result[idx]]++] = static_cast<uint32_t>(idx / 3);
+		}
+
+		collapses.clear();
+		for (size_t tri = 0; tri < result.size(); tri += 3) {
+			for (int corner = 0; corner < 3; corner++) {
+				const uint32_t a = result[tri + corner], b = result[tri + (corner + 1) % 3];
+				for (auto [from, to] : { std::pair(a, b), std::pair(b, a) }) {
+					if (locked[from]) continue;
+
+					Quadric merged = quadrics[from];
+					merged.add(quadrics[to]);
+					collapses.push_back({ static_cast<float>(merged.error(pos[to])), from, to });
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		std::iota(remap.begin(), remap.end(), 0);
+		std::fill(touched.begin(), touched.end(), 0);
+		size_t removed = 0;
+
+		for (const Collapse& collapse : collapses) {
+			if (collapse.cost > maxCost) break;
+			if ((triangleCount - removed) * 3 <= targetIndexCount) break;
+			if (touched[collapse.from] || touched[collapse.to]) continue;
+
+			// Triangles on the edge vanish, the others must not turn over
+			size_t dying = 0;
+			bool flips = false;
+			for (uint32_t at = firstTriangle[collapse.from]; at < firstTriangle[collapse.from + 1] && !flips; at++) {
+				const uint32_t* corners = &result[triangles[at] * 3];
+				if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to) {
+					dying++;
+					continue;
+				}
+
+				XMFLOAT3 moved[3];
+				for (int corner = 0; corner < 3; corner++) moved[corner] = pos[(corners[corner] == collapse.from) ? collapse.to : corners[corner]];
+
+				const XMVECTOR before = faceNormal(pos[corners[0]], pos[corners[1]], pos[corners[2]]);
+				const XMVECTOR after = faceNormal(moved[0], moved[1], moved[2]);
+				flips = XMVectorGetX(XMVector3Dot(before, after)) <= 0.0f;
+			}
+			if (flips || dying == 0) continue;
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			worst = std::max(worst, collapse.cost);
+			removed += dying;
+
+			for (uint32_t at = firstTriangle[collapse.from]; at < firstTriangle[collapse.from + 1]; at++) {
+				for (int corner = 0; corner < 3; corner++) touched[result[triangles[at] * 3 + corner]] = 1;
+			}
+		}
+
+		if (removed == 0) break;
+
+		size_t kept = 0;
+		for (size_t tri = 0; tri < result.size(); tri += 3) {
+			const uint32_t a = remap[result[tri]], b = remap[result[tri + 1]], c = remap[result[tri + 2]];
+			if (a == b || b == c || c == a) continue;
+
+			result[kept++] = a;
+			result[kept++] = b;
+			result[kept++] = c;
+		}
+		result.resize(kept);
+	}
+
+	if (error) *error = std::sqrt(worst);
+	return result;
+}
+
+void Mesh::buildLods(Source& mesh, float maxError) {
+	// Every level starts again from the full mesh, so errors do not stack up
+	const std::vector<uint32_t> full = mesh.lods.empty() ? mesh.indices
+		: std::vector<uint32_t>(mesh.indices.begin() + mesh.lods[0].firstIndex, mesh.indices.begin() + mesh.lods[0].firstIndex + mesh.lods[0].indexCount);
+
+	mesh.indices = full;
+	mesh.lods = { { 0, static_cast<uint32_t>(full.size()), 0.0f } };
+
+	while (mesh.lods.size() < maxLods) {
+		const Lod& previous = mesh.lods.back();
+
+		float error = 0.0f;
+		const std::vector<uint32_t> level = simplify(mesh.positions, full, previous.indexCount / 6 * 3, maxError, &error);
+
+		// A level that barely shrinks only costs memory
+		if (level.size() * 10 > size_t(previous.indexCount) * 9) break;
+
+		mesh.lods.push_back({ static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(level.size()), std::max(error, previous.error) });
+		mesh.indices.insert(mesh.indices.end(), level.begin(), level.end());
+	}
+}
+
+uint32_t Mesh::selectLod(std::span<const Lod> lods, float size, uint32_t current, float pixels, float hysteresis) {
+	uint32_t selected = 0;
+	for (uint32_t level = 1; level < lods.size(); level++) {
+		const float limit = (level > current) ? pixels * (1.0f - hysteresis) : pixels;
+		if (lods[level].error * size > limit) break;
+
+		selected = level;
+	}
+
+	return selected;
+}
+
+Mesh::CacheStats Mesh::analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize) {
+	if (indices.size() < 3 || vertexCount == 0) return {};
+
+	// FIFO by timestamps, a vertex is cached while fewer than cacheSize misses came after it
+	std::vector<uint32_t> stamp(vertexCount, 0);
+	uint32_t clock = cacheSize + 1;
+	size_t transformed = 0;
+	for (uint32_t idx : indices) {
+		if (clock - stamp[idx] <= cacheSize) continue;
+
+		stamp[idx] = clock++;
+		transformed++;
+	}
+
+	return {
+		.acmr = static_cast<float>(transformed) / static_cast<float>(indices.size() / 3),
+		.atvr = static_cast<float>(transformed) / static_cast<float>(vertexCount),
+	};
+}
+
+float Mesh::analyzeOverdraw(std::span<const uint32_t> indices, std::span<const DirectX::XMFLOAT3> positions, uint32_t resolution) {
+	if (indices.size() < 3 || positions.empty()) return 0.0f;
+
+	std::array<float, 3> lo = { positions[0].x, positions[0].y, positions[0].z }, hi = lo;
+	for (auto& pos : positions) {
+		const std::array<float, 3> coords = { pos.x, pos.y, pos.z };
+		for (int axis = 0; axis < 3; axis++) {
+			lo[axis] = std::min(lo[axis], coords[axis]);
+			hi[axis] = std::max(hi[axis], coords[axis]);
+		}
+	}
+
+	const float extent = std::max({ hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] });
+	if (extent <= 0.0f) return 0.0f;
+
+	// Right, up and forward axes with their signs, left-handed like the camera
+	struct View {
+		int axis[3];
+		float sign[3];
+	};
+	constexpr std::array<View, 6> views = {
+		View { { 0, 1, 2 }, { 1.0f, 1.0f, 1.0f } },
+		View { { 0, 1, 2 }, { -1.0f, 1.0f, -1.0f } },
+		View { { 2, 1, 0 }, { -1.0f, 1.0f, 1.0f } },
+		View { { 2, 1, 0 }, { 1.0f, 1.0f, -1.0f } },
+		View { { 0, 2, 1 }, { 1.0f, -1.0f, 1.0f } },
+		View { { 0, 2, 1 }, { 1.0f, 1.0f, -1.0f } },
+	};
+
+	const float res = static_cast<float>(resolution);
+	std::vector<float> depth(static_cast<size_t>(resolution) * resolution);
+	size_t shaded = 0, covered = 0;
+
+	for (const View& view : views) {
+		std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+
+		auto project = [&](uint32_t idx) {
+			const std::array<float, 3> coords = { positions[idx].x, positions[idx].y, positions[idx].z };
+			float out[3];
+			for (int dir = 0; dir < 3; dir++) {
+				const int axis = view.axis[dir];
+				out[dir] = view.sign[dir] * (coords[axis] - (lo[axis] + hi[axis]) * 0.5f) / extent;
+			}
+			return Point { (out[0] + 0.5f) * res, (out[1] + 0.5f) * res, out[2] };
+		};
+
+		for (size_t tri = 0; tri + 2 < indices.size(); tri += 3) {
+			Point p0 = project(indices[tri]), p1 = project(indices[tri + 1]), p2 = project(indices[tri + 2]);
+
+			// Clockwise with y up is front facing, flipped to counter-clockwise for the edge tests
+			const float area = edge(p0, p1, p2.x, p2.y);
+			if (area >= 0.0f) continue;
+			std::swap(p1, p2);
+
+			const int minX = std::max(0, static_cast<int>(std::floor(std::min({ p0.x, p1.x, p2.x }))));
+			const int minY = std::max(0, static_cast<int>(std::floor(std::min({ p0.y, p1.y, p2.y }))));
+			const int maxX = std::min(static_cast<int>(resolution) - 1, static_cast<int>(std::ceil(std::max({ p0.x, p1.x, p2.x }))));
+			const int maxY = std::min(static_cast<int>(resolution) - 1, static_cast<int>(std::ceil(std::max({ p0.y, p1.y, p2.y }))));
+
+			for (int py = minY; py <= maxY; py++) {
+				for (int px = minX; px <= maxX; px++) {
+					const float cx = px + 0.5f, cy = py + 0.5f;
+					const float w0 = edge(p1, p2, cx, cy), w1 = edge(p2, p0, cx, cy), w2 = edge(p0, p1, cx, cy);
+					if (!owns(p1, p2, w0) || !owns(p2, p0, w1) || !owns(p0, p1, w2)) continue;
+
+					const float z = (w0 * p0.z + w1 * p1.z + w2 * p2.z) / -area;
+					float& stored = depth[static_cast<size_t>(py) * resolution + px];
+					if (z >= stored) continue;
+
+					stored = z;
+					shaded++;
+				}
+			}
+		}
+
+		covered += std::count_if(depth.begin(), depth.end(), [](float z) { return z != std::numeric_limits<float>::max(); });
+	}
+
+	return covered > 0 ? static_cast<float>(shaded) / static_cast<float>(covered) : 0.0f;
+}
+
+std::vector<std::byte> Mesh::encode(const Source& mesh, uint32_t flags) {
+	Header header = {
+		.magicNumber = Header::magic,
+		.flags = flags & Optimized,
+		.vertexCount = static_cast<uint32_t>(mesh.positions.size()),
+		.indexCount = static_cast<uint32_t>(mesh.indices.size()),
+	};
+	if (mesh.positions.size() > 0x10000) header.flags |= Index32;
+
+	const std::vector<Lod> lods = levels(mesh);
+	header.lodCount = static_cast<uint32_t>(lods.size());
+
+	DirectX::XMFLOAT3 hi = {};
+	if (!mesh.positions.empty()) header.boundsMin = hi = mesh.positions[0];
+	for (auto& pos : mesh.positions) {
+		header.boundsMin = { std::min(header.boundsMin.x, pos.x), std::min(header.boundsMin.y, pos.y), std::min(header.boundsMin.z, pos.z) };
+		hi = { std::max(hi.x, pos.x), std::max(hi.y, pos.y), std::max(hi.z, pos.z) };
+	}
+	header.boundsScale = { hi.x - header.boundsMin.x, hi.y - header.boundsMin.y, hi.z - header.boundsMin.z };
+
+	auto unorm = [](float value, float lo, float scale) {
+		const float norm = (scale > 0.0f) ? (value - lo) / scale : 0.0f;
+		return static_cast<uint16_t>(std::lround(std::clamp(norm, 0.0f, 1.0f) * 65535.0f));
+	};
+
+	const size_t vertexOffset = sizeof(Header) + lods.size() * sizeof(Lod);
+	const size_t vertexBytes = mesh.positions.size() * sizeof(Vertex);
+	const size_t indexOffset = (vertexOffset + vertexBytes + 3) & ~size_t(3);
+	const size_t indexSize = (header.flags & Index32) ? 4 : 2;
+
+	std::vector<std::byte> data(indexOffset + mesh.indices.size() * indexSize);
+	std::memcpy(data.data(), &header, sizeof(Header));
+	std::memcpy(data.data() + sizeof(Header), lods.data(), lods.size() * sizeof(Lod));
+
+	for (size_t vert = 0; vert < mesh.positions.size(); vert++) {
+		const auto& pos = mesh.positions[vert];
+		const auto& uv = mesh.uvs[vert];
+
+		const Vertex packed = {
+			{ unorm(pos.x, header.boundsMin.x, header.boundsScale.x), unorm(pos.y, header.boundsMin.y, header.boundsScale.y),
+				unorm(pos.z, header.boundsMin.z, header.boundsScale.z), 0 },
+			{ unorm(uv.x, 0.0f, 1.0f), unorm(uv.y, 0.0f, 1.0f) },
+		};
+		std::memcpy(data.data() + vertexOffset + vert * sizeof(Vertex), &packed, sizeof(Vertex));
+	}
+
+	storeIndices(mesh.indices, indexSize, data.data() + indexOffset);
+	return data;
+}
+
+bool Mesh::write(const std::string& path, std::span<const std::byte> data) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+	return static_cast<bool>(file);
+}
+
+uint32_t Mesh::View::index(size_t idx) const {
+	if (indexSize() == 4) {
+		uint32_t value;
+		std::memcpy(&value, indices.data() + idx * 4, 4);
+		return value;
+	}
+
+	uint16_t value;
+	std::memcpy(&value, indices.data() + idx * 2, 2);
+	return value;
+}
+
+Mesh::Result Mesh::parse(std::span<const std::byte> data, View& view) {
+	view = {};
+	if (data.empty()) return Result::Missing;
+	if (data.size() < sizeof(Header)) return Result::TooSmall;
+
+	Header header;
+	std::memcpy(&header, data.data(), sizeof(Header));
+	if (header.magicNumber != Header::magic) return Result::BadMagic;
+	if ((header.flags & ~uint32_t(Index32 | Optimized)) != 0 || header.indexCount % 3 != 0) return Result::BadHeader;
+	if (header.lodCount == 0 || header.lodCount > maxLods) return Result::BadHeader;
+
+	// 64-bit so a damaged count cannot wrap around
+	const uint64_t indexSize = (header.flags & Index32) ? 4 : 2;
+	const uint64_t vertexOffset = sizeof(Header) + uint64_t(header.lodCount) * sizeof(Lod);
+	const uint64_t indexOffset = (vertexOffset + uint64_t(header.vertexCount) * sizeof(Vertex) + 3) & ~uint64_t(3);
+	if (indexOffset + uint64_t(header.indexCount) * indexSize > data.size()) return Result::Truncated;
+
+	const std::span<const Lod> lods = { reinterpret_cast<const Lod*>(data.data() + sizeof(Header)), header.lodCount };
+	for (const Lod& lod : lods) {
+		if (lod.indexCount % 3 != 0 || lod.firstIndex % 3 != 0 || uint64_t(lod.firstIndex) + lod.indexCount > header.indexCount) return Result::BadHeader;
+	}
+
+	view.header = header;
+	view.lods = lods;
+	view.vertices = { reinterpret_cast<const Vertex*>(data.data() + vertexOffset), header.vertexCount };
+	view.indices = data.subspan(static_cast<size_t>(indexOffset), static_cast<size_t>(header.indexCount * indexSize));
+
+	// The GPU would clamp a stray index, the software rasterizer would not
+	for (size_t idx = 0; idx < header.indexCount; idx++) {
+		if (view.index(idx) < header.vertexCount) continue;
+
+		view = {};
+		return Result::BadIndex;
+	}
+
+	return Result::Ok;
+}
+
+void Mesh::decode(const View& view, Source& mesh) {
+	const auto& lo = view.header.boundsMin;
+	const auto& scale = view.header.boundsScale;
+	constexpr float unorm = 1.0f / 65535.0f;
+
+	mesh.positions.resize(view.vertices.size());
+	mesh.uvs.resize(view.vertices.size());
+	for (size_t vert = 0; vert < view.vertices.size(); vert++) {
+		const Vertex& packed = view.vertices[vert];
+		mesh.positions[vert] = { lo.x + packed.pos[0] * unorm * scale.x, lo.y + packed.pos[1] * unorm * scale.y, lo.z + packed.pos[2] * unorm * scale.z };
+		mesh.uvs[vert] = { packed.tex[0] * unorm, packed.tex[1] * unorm };
+	}
+
+	mesh.indices.resize(view.header.indexCount);
+	for (size_t idx = 0; idx < mesh.indices.size(); idx++) mesh.indices[idx] = view.index(idx);
+
+	mesh.lods.assign(view.lods.begin(), view.lods.end());
+}
+
+Mesh::Result Mesh::File::open(const std::string& path) {
+	close();
+
+	if (!_file.open(path)) return Result::Missing;
+
+	const Result result = parse(_file.bytes(), view);
+	if (result != Result::Ok) {
+		close();
+		return result;
+	}
+
+	if (view.header.flags & Optimized) return result;
+
+	// Not reordered offline, do the cache pass now. Overdraw ordering needs
+	// the positions decoded and is left to the importer.
+	std::vector<uint32_t> indices(view.header.indexCount);
+	for (size_t idx = 0; idx < indices.size(); idx++) indices[idx] = view.index(idx);
+	for (const Lod& lod : view.lods)
+		optimizeVertexCache(std::span(indices).subspan(lod.firstIndex, lod.indexCount), view.vertices.size());
+
+	_reordered.resize(view.indices.size());
+	storeIndices(indices, view.indexSize(), _reordered.data());
+
+	view.indices = _reordered;
+	view.header.flags |= Optimized;
+	return result;
+}
+
+void Mesh::File::close() {
+	view = {};
+	_reordered.clear();
+	_file.close();
+}
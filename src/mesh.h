@@ -0,0 +1,151 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include <DirectXMath.h>
+
+#include <mappedfile.h>
+
+// Static meshes: OBJ import, index and vertex reordering for the post-transform
+// cache and overdraw, a simplified LOD chain, and a quantized binary format that
+// is mapped and handed to CreateBuffer as is. No D3D headers, so the importer and
+// the checks run anywhere.
+namespace Mesh {
+
+	static constexpr uint32_t maxLods = 4;
+
+	// One level of detail, a range of the shared index buffer over the shared vertices
+	struct Lod {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error;        // furthest the surface moved, relative to the largest bounds extent
+	};
+
+	// Float mesh as the importer and the optimizers see it, indexed triangle list
+	struct Source {
+		std::vector<DirectX::XMFLOAT3> positions;
+		std::vector<DirectX::XMFLOAT2> uvs;
+		std::vector<uint32_t> indices;
+		std::vector<Lod> lods;      // empty is a single level over all indices
+	};
+
+	// 12 bytes, R16G16B16A16_UNORM position over the mesh bounds and R16G16_UNORM uv
+	struct Vertex {
+		uint16_t pos[4];    // w unused
+		uint16_t tex[2];    // uvs outside [0, 1] are clamped
+	};
+
+	enum Flags : uint32_t {
+		Index32 = 1,        // 32-bit indices, 16-bit otherwise
+		Optimized = 2,      // indices already in cache order, loads skip the reorder
+	};
+
+	// Layout: Header, Lod[lodCount], Vertex[vertexCount], indices of every level padded to 4 bytes
+	struct Header {
+		static constexpr uint32_t magic = 0x3248534D; // "MSH2"
+
+		uint32_t magicNumber;
+		uint32_t flags;
+		uint32_t vertexCount;
+		uint32_t indexCount;            // all levels
+		uint32_t lodCount;
+		DirectX::XMFLOAT3 boundsMin;    // position = boundsMin + unorm * boundsScale
+		DirectX::XMFLOAT3 boundsScale;
+	};
+
+	enum class Result {
+		Ok,
+		Missing,
+		TooSmall,
+		BadMagic,
+		BadHeader,
+		Truncated,
+		BadIndex,
+	};
+
+	const char* describe(Result result);
+
+	// Positions, texture coordinates and faces of any size, fanned into triangles.
+	// Every distinct v/vt pair becomes one vertex, false on a malformed face.
+	bool importObj(std::span<const std::byte> text, Source& mesh);
+	bool importObj(const std::string& path, Source& mesh);
+
+	// Tom Forsyth's linear-speed ordering for a small LRU post-transform cache
+	void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount);
+
+	// Splits the cache order into clusters that each cost at most `threshold`
+	// times the ACMR they had in place, then draws the ones facing outwards
+	// first so they occlude the rest. Run after optimizeVertexCache.
+	void optimizeOverdraw(std::span<uint32_t> indices, std::span<const DirectX::XMFLOAT3> positions, uint32_t cacheSize = 16, float threshold = 1.05f);
+
+	// Renumbers vertices in first-use order so fetches walk the buffer forwards
+	void optimizeVertexFetch(Source& mesh);
+
+	// Cache and overdraw order per level, then the vertex fetch order, what the importer runs
+	void optimize(Source& mesh);
+
+	// Quadric error edge collapses onto existing vertices, so every level shares
+	// one vertex buffer. Vertices sharing a position with another one (uv seams)
+	// and open borders never move. Stops at `targetIndexCount` or before a collapse
+	// would move the surface further than `targetError` of the largest bounds
+	// extent, `error` gets the furthest.
+	std::vector<uint32_t> simplify(std::span<const DirectX::XMFLOAT3> positions, std::span<const uint32_t> indices,
+		size_t targetIndexCount, float targetError, float* error = nullptr);
+
+	// Halves the triangle count per level from the full mesh, until maxLods,
+	// `maxError` or a level that barely shrinks. Replaces mesh.lods.
+	void buildLods(Source& mesh, float maxError = 0.05f);
+
+	// Coarsest level whose error stays under `pixels` for an object whose largest
+	// extent covers `size` pixels. Going coarser than `current` needs a margin of
+	// `hysteresis`, so objects near a boundary do not flip every frame.
+	uint32_t selectLod(std::span<const Lod> lods, float size, uint32_t current, float pixels = 1.0f, float hysteresis = 0.25f);
+
+	struct CacheStats {
+		float acmr = 0.0f;  // transformed vertices per triangle, 0.5 is the limit for a big grid
+		float atvr = 0.0f;  // transformed per vertex, 1 is ideal
+	};
+
+	// FIFO cache of `cacheSize` entries, like most hardware behaves
+	CacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+	// Pixels shaded per pixel covered, rasterized with depth test and back face
+	// culling from the six axis directions onto a `resolution` square
+	float analyzeOverdraw(std::span<const uint32_t> indices, std::span<const DirectX::XMFLOAT3> positions, uint32_t resolution = 256);
+
+	// Quantizes into the file layout, 16-bit indices whenever they fit
+	std::vector<std::byte> encode(const Source& mesh, uint32_t flags);
+	bool write(const std::string& path, std::span<const std::byte> data);
+
+	// Points into the parsed memory
+	struct View {
+		Header header = {};
+		std::span<const Lod> lods;
+		std::span<const Vertex> vertices;
+		std::span<const std::byte> indices;
+
+		uint32_t indexSize() const { return (header.flags & Index32) ? 4 : 2; }
+		uint32_t index(size_t idx) const;
+	};
+
+	Result parse(std::span<const std::byte> data, View& view);
+
+	// Dequantized copy, for the software rasterizer and the checks
+	void decode(const View& view, Source& mesh);
+
+	// Keeps the file mapped for as long as the view is in use. Files written
+	// without the Optimized flag have each level reordered on load into _reordered.
+	struct File {
+		MappedFile _file;
+		std::vector<std::byte> _reordered;
+		View view;
+
+		Result open(const std::string& path);
+		void close();
+	};
+
+}
@@ -0,0 +1,260 @@
+#include <occlusion.h>
+
+#include <DirectXMath.h>
+
+#include <span>
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <algorithm>
+
+namespace {
+	constexpr uint32_t lanes = 4;
+
+	// Corners of the unit cube by bit, x in bit 0, y in bit 1, z in bit 2
+	constexpr std::array<std::array<uint8_t, 4>, 6> boxFaces = { {
+		{ 0, 2, 6, 4 }, { 1, 3, 7, 5 },
+		{ 0, 1, 5, 4 }, { 2, 3, 7, 6 },
+		{ 0, 1, 3, 2 }, { 4, 5, 7, 6 },
+	} };
+}
+
+void Occlusion::Buffer::resize(uint32_t width, uint32_t height, DirectX::FXMMATRIX proj) {
+	_width = std::max(width, 1u);
+	_height = std::max(height, 1u);
+	DirectX::XMStoreFloat4x4(&_proj, proj);
+
+	// Depth is 0 where z * _33 + _43 is
+	_near = -_proj._43 / _proj._33;
+
+	_levels.clear();
+	uint32_t levelWidth = _width, levelHeight = _height;
+	uint32_t pitch = (_width + lanes - 1) / lanes * lanes;
+
+	while (true) {
+		_levels.push_back({ levelWidth, levelHeight, pitch, std::vector<float>(size_t(pitch) * levelHeight, 1.0f) });
+		if (levelWidth == 1 && levelHeight == 1) break;
+
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+		pitch = levelWidth;
+	}
+}
+
+void Occlusion::Buffer::clear() {
+	std::fill(_levels[0].depth.begin(), _levels[0].depth.end(), 1.0f);
+}
+
+void Occlusion::Buffer::renderBox(DirectX::FXMMATRIX world) {
+	using namespace DirectX;
+
+	const XMMATRIX worldProj = XMMatrixMultiply(world, XMLoadFloat4x4(&_proj));
+	const float width = static_cast<float>(_width), height = static_cast<float>(_height);
+
+	std::array<XMVECTOR, 8> view;
+	std::array<XMFLOAT3, 8> screen;
+	for (uint32_t corner = 0; corner < screen.size(); corner++) {
+		XMVECTOR local = XMVectorSet((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f, 1.0f);
+
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(local, worldProj));
+		if (clip.z < 0.0f || clip.w <= 0.0f) return;
+
+		view[corner] = XMVector3TransformCoord(local, world);
+		screen[corner] = {
+			(clip.x / clip.w * 0.5f + 0.5f) * width,
+			(0.5f - clip.y / clip.w * 0.5f) * height,
+			clip.z / clip.w,
+		};
+	}
+
+	// A ray enters a convex box through the last face turned towards the eye
+	// it crosses, so the box's depth is the farthest of those faces' planes
+	std::array<XMFLOAT3, 6> planes;
+	size_t planeCount = 0;
+	for (auto& face : boxFaces) {
+		const XMVECTOR faceCenter = XMVectorScale(XMVectorAdd(XMVectorAdd(view[face[0]], view[face[1]]), XMVectorAdd(view[face[2]], view[face[3]])), 0.25f);
+		XMVECTOR normal = XMVector3Cross(XMVectorSubtract(view[face[1]], view[face[0]]), XMVectorSubtract(view[face[3]], view[face[0]]));
+		if (XMVectorGetX(XMVector3Dot(normal, XMVectorSubtract(faceCenter, world.r[3]))) < 0.0f) normal = XMVectorNegate(normal);
+
+		// The eye is at the origin of view space
+		if (XMVectorGetX(XMVector3Dot(normal, faceCenter)) >= 0.0f) continue;
+
+		const XMFLOAT3& a = screen[face[0]];
+		const XMFLOAT3& b = screen[face[1]];
+		const XMFLOAT3& c = screen[face[3]];
+		const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if (area == 0.0f) continue;
+
+		const float zA = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+		const float zB = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+		planes[planeCount++] = { zA, zB, a.z - zA * a.x - zB * a.y };
+	}
+	if (planeCount == 0) return;
+
+	// Outline of the box by monotone chain, wound so that `turn` is positive along it
+	std::array<XMFLOAT3, 8> sorted = screen;
+	std::sort(sorted.begin(), sorted.end(), [](const XMFLOAT3& l, const XMFLOAT3& r) { return (l.x < r.x) || (l.x == r.x && l.y < r.y); });
+
+	auto turn = [](const XMFLOAT3& o, const XMFLOAT3& a, const XMFLOAT3& b) {
+		return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+	};
+
+	std::array<XMFLOAT3, 2 * 8> hull;
+	size_t hullCount = 0;
+	for (const XMFLOAT3& point : sorted) {
+		while (hullCount >= 2 && turn(hull[hullCount - 2], hull[hullCount - 1], point) <= 0.0f) hullCount--;
+		hull[hullCount++] = point;
+	}
+	for (size_t idx = sorted.size() - 1, lower = hullCount + 1; idx-- > 0;) {
+		while (hullCount >= lower && turn(hull[hullCount - 2], hull[hullCount - 1], sorted[idx]) <= 0.0f) hullCount--;
+		hull[hullCount++] = sorted[idx];
+	}
+	hullCount--;
+	if (hullCount < 3) return;
+
+	// E(x, y) = A * x + B * y + C, positive inside all of them
+	std::array<XMFLOAT3, 2 * 8> edges;
+	for (size_t idx = 0; idx < hullCount; idx++) {
+		const XMFLOAT3& from = hull[idx];
+		const XMFLOAT3& to = hull[(idx + 1) % hullCount];
+		edges[idx] = { from.y - to.y, to.x - from.x, from.x * to.y - from.y * to.x };
+	}
+
+	Rect bounds = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (const XMFLOAT3& point : screen) {
+		bounds.left = std::min(bounds.left, point.x), bounds.right = std::max(bounds.right, point.x);
+		bounds.top = std::min(bounds.top, point.y), bounds.bottom = std::max(bounds.bottom, point.y);
+	}
+
+	rasterize({ edges.data(), hullCount }, { planes.data(), planeCount }, bounds);
+}
+
+void Occlusion::Buffer::rasterize(std::span<const DirectX::XMFLOAT3> edges, std::span<const DirectX::XMFLOAT3> planes, const Rect& bounds) {
+	using namespace DirectX;
+
+	// Texels the outline can cover entirely
+	const float width = static_cast<float>(_width), height = static_cast<float>(_height);
+	const int minX = static_cast<int>(std::ceil(std::clamp(bounds.left, 0.0f, width)));
+	const int maxX = static_cast<int>(std::floor(std::clamp(bounds.right, 0.0f, width))) - 1;
+	const int minY = static_cast<int>(std::ceil(std::clamp(bounds.top, 0.0f, height)));
+	const int maxY = static_cast<int>(std::floor(std::clamp(bounds.bottom, 0.0f, height))) - 1;
+	if (minX > maxX || minY > maxY) return;
+
+	// Tested at texel centers, each edge moved inward by half a texel's extent
+	// only passes texels it covers entirely, and each plane moved back by as
+	// much gives the farthest depth it reaches in them. An occluder then never
+	// hides more than it does at any resolution.
+	std::array<XMVECTOR, 2 * 8> edgeX, edgeRow;
+	std::array<XMVECTOR, 6> planeX, planeRow;
+	for (size_t idx = 0; idx < edges.size(); idx++)
+		edgeX[idx] = XMVectorReplicate(edges[idx].x);
+	for (size_t idx = 0; idx < planes.size(); idx++)
+		planeX[idx] = XMVectorReplicate(planes[idx].x);
+
+	const XMVECTOR offsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	const XMVECTOR zero = XMVectorZero();
+
+	Level& level = _levels[0];
+	const int firstX = minX / lanes * lanes;
+
+	for (int y = minY; y <= maxY; y++) {
+		const float py = static_cast<float>(y) + 0.5f;
+		for (size_t idx = 0; idx < edges.size(); idx++) {
+			const XMFLOAT3& e = edges[idx];
+			edgeRow[idx] = XMVectorReplicate(e.y * py + e.z - 0.5f * (std::abs(e.x) + std::abs(e.y)));
+		}
+		for (size_t idx = 0; idx < planes.size(); idx++) {
+			const XMFLOAT3& p = planes[idx];
+			planeRow[idx] = XMVectorReplicate(p.y * py + p.z + 0.5f * (std::abs(p.x) + std::abs(p.y)));
+		}
+
+		float* depth = &level.depth[size_t(y) * level.pitch];
+
+		// Lanes past the bounds fail an edge test, the padded pitch keeps them in the row
+		for (int x = firstX; x <= maxX; x += lanes) {
+			const XMVECTOR px = XMVectorAdd(XMVectorReplicate(static_cast<float>(x)), offsets);
+
+			XMVECTOR inside = XMVectorTrueInt();
+			for (size_t idx = 0; idx < edges.size(); idx++)
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(px, edgeX[idx], edgeRow[idx]), zero));
+
+			XMVECTOR z = XMVectorMultiplyAdd(px, planeX[0], planeRow[0]);
+			for (size_t idx = 1; idx < planes.size(); idx++)
+				z = XMVectorMax(z, XMVectorMultiplyAdd(px, planeX[idx], planeRow[idx]));
+
+			XMFLOAT4* texels = reinterpret_cast<XMFLOAT4*>(depth + x);
+			const XMVECTOR old = XMLoadFloat4(texels);
+			XMStoreFloat4(texels, XMVectorSelect(old, XMVectorMin(old, z), inside));
+		}
+	}
+}
+
+void Occlusion::Buffer::buildHiZ() {
+	// Every texel keeps the farthest occluder depth of the four below it
+	for (size_t idx = 1; idx < _levels.size(); idx++) {
+		const Level& src = _levels[idx - 1];
+		Level& dst = _levels[idx];
+
+		for (uint32_t y = 0; y < dst.height; y++) {
+			const float* row0 = &src.depth[size_t(2 * y) * src.pitch];
+			const float* row1 = &src.depth[size_t(std::min(2 * y + 1, src.height - 1)) * src.pitch];
+
+			for (uint32_t x = 0; x < dst.width; x++) {
+				const uint32_t x0 = 2 * x, x1 = std::min(2 * x + 1, src.width - 1);
+				dst.depth[size_t(y) * dst.pitch + x] = std::max({ row0[x0], row0[x1], row1[x0], row1[x1] });
+			}
+		}
+	}
+}
+
+bool Occlusion::Buffer::visible(const Rect& bounds, float nearest) const {
+	if (nearest <= 0.0f) return true;
+
+	// Clamped as floats first, bounds of spheres close to the near plane get huge
+	const float width = static_cast<float>(_width), height = static_cast<float>(_height);
+	const int minX = static_cast<int>(std::floor(std::clamp(bounds.left, 0.0f, width)));
+	const int maxX = static_cast<int>(std::floor(std::clamp(bounds.right, -1.0f, width - 1.0f)));
+	const int minY = static_cast<int>(std::floor(std::clamp(bounds.top, 0.0f, height)));
+	const int maxY = static_cast<int>(std::floor(std::clamp(bounds.bottom, -1.0f, height - 1.0f)));
+
+	// Off screen entirely, nothing to see
+	if (minX > maxX || minY > maxY) return false;
+
+	// Coarsest level where the bounds touch at most 2x2 texels
+	size_t idx = 0;
+	while (((maxX >> idx) - (minX >> idx)) > 1 || ((maxY >> idx) - (minY >> idx)) > 1) idx++;
+
+	const Level& level = _levels[idx];
+	for (int y = minY >> idx; y <= (maxY >> idx); y++)
+		for (int x = minX >> idx; x <= (maxX >> idx); x++)
+			if (level.depth[size_t(y) * level.pitch + x] >= nearest) return true;
+
+	return false;
+}
+
+bool Occlusion::Buffer::project(DirectX::XMFLOAT3 center, float radius, Rect& bounds, float& nearest) const {
+	const float zNear = center.z - radius, zFar = center.z + radius;
+	if (zNear <= _near) return false;
+
+	// x / z over the sphere's box peaks at one of its corners
+	const float invNear = 1.0f / zNear, invFar = 1.0f / zFar;
+	const float left = std::min((center.x - radius) * invNear, (center.x - radius) * invFar);
+	const float right = std::max((center.x + radius) * invNear, (center.x + radius) * invFar);
+	const float bottom = std::min((center.y - radius) * invNear, (center.y - radius) * invFar);
+	const float top = std::max((center.y + radius) * invNear, (center.y + radius) * invFar);
+
+	const float projX = _proj._11 * 0.5f * static_cast<float>(_width), centerX = 0.5f * static_cast<float>(_width);
+	const float projY = _proj._22 * 0.5f * static_cast<float>(_height), centerY = 0.5f * static_cast<float>(_height);
+	bounds = {
+		projX * left + centerX,
+		centerY - projY * top,
+		projX * right + centerX,
+		centerY - projY * bottom,
+	};
+	nearest = _proj._43 * invNear + _proj._33;
+
+	return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace Occlusion {
+
+	// Screen-space bounds in depth buffer pixels, y down
+	struct Rect {
+		float left, top, right, bottom;
+	};
+
+	// Low resolution depth buffer for software occlusion culling. Occluders
+	// are rasterized four pixels per SIMD iteration, then a max-depth pyramid
+	// is built on top. An occludee is hidden when every texel its bounds
+	// cover holds an occluder closer than its own nearest point. Depth is
+	// z / w of a D3D projection, 0 at the near plane and 1 at the far one.
+	struct Buffer {
+		uint32_t _width = 0, _height = 0;
+		DirectX::XMFLOAT4X4 _proj = {};
+		float _near = 0.0f;                     // view-space distance of the near plane
+
+		// Level 0 is the rasterized depth, each next one halves both edges
+		struct Level {
+			uint32_t width, height;
+			uint32_t pitch;                     // level 0 rows are padded to the SIMD lanes
+			std::vector<float> depth;
+		};
+
+		std::vector<Level> _levels;
+
+		void resize(uint32_t width, uint32_t height, DirectX::FXMMATRIX proj);
+
+		// Everything back to the far plane
+		void clear();
+
+		// Unit cube [-1, 1] moved by `world` (row vectors, like the shaders).
+		// Only texels the box covers entirely are written, with the farthest
+		// depth it has in them. Boxes crossing the near plane are skipped,
+		// which only hides less.
+		void renderBox(DirectX::FXMMATRIX world);
+
+		// Call after the last occluder and before the first test
+		void buildHiZ();
+
+		// `nearest` is the occludee's smallest depth, true unless it is hidden
+		bool visible(const Rect& bounds, float nearest) const;
+
+		// Conservative depth buffer bounds of a view-space sphere, false when
+		// it crosses the near plane and so cannot be tested. Assumes a centered
+		// perspective projection like XMMatrixPerspectiveFovLH.
+		bool project(DirectX::XMFLOAT3 center, float radius, Rect& bounds, float& nearest) const;
+
+	private:
+		// Convex outline as edge functions positive inside, depth as the
+		// farthest of the planes z = A * x + B * y + C
+		void rasterize(std::span<const DirectX::XMFLOAT3> edges, std::span<const DirectX::XMFLOAT3> planes, const Rect& bounds);
+	};
+
+}
@@ -0,0 +1,126 @@
+#include <profiler.h>
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+int64_t Profile::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Profile::Ring& Profile::local() {
+	thread_local Ring* ring = &profiler().add();
+	return *ring;
+}
+
+Profile::Profiler& Profile::profiler() {
+	static Profiler instance;
+	return instance;
+}
+
+Profile::Ring& Profile::Profiler::add() {
+	std::lock_guard lock(_mutex);
+
+	auto& ring = _rings.emplace_back(std::make_unique<Ring>());
+	ring->_thread = static_cast<uint32_t>(_rings.size() - 1);
+	return *ring;
+}
+
+void Profile::Profiler::endFrame() {
+	std::lock_guard lock(_mutex);
+
+	if (_trace.size() == traceFrames) {
+		// Reuse the oldest frame's memory
+		_trace.push_back(std::move(_trace.front()));
+		_trace.pop_front();
+		_trace.back().clear();
+	}
+	else {
+		_trace.emplace_back();
+	}
+
+	auto& events = _trace.back();
+	_frameTotals.clear();
+
+	for (auto& ring : _rings) {
+		const uint64_t head = ring->_head.load(std::memory_order_acquire);
+
+		// A thread that outran the ring loses its oldest events
+		ring->_tail = std::max(ring->_tail, head - std::min<uint64_t>(head, Ring::capacity));
+
+		for (; ring->_tail < head; ring->_tail++) {
+			const Event& event = ring->_events[ring->_tail % Ring::capacity];
+
+			events.push_back({ event.name, event.begin, event.end, ring->_thread });
+			_frameTotals[event.name] += static_cast<double>(event.end - event.begin) / 1e6;
+		}
+	}
+
+	// The same name can come from literals at different addresses
+	std::unordered_map<std::string, double> totals;
+	for (auto& [name, ms] : _frameTotals) totals[name] += ms;
+
+	for (auto& [name, ms] : totals) {
+		History& history = _zones[name];
+		history.ms[history.next] = ms;
+		history.next = (history.next + 1) % window;
+		history.count = std::min(history.count + 1, window);
+	}
+
+	_frames++;
+}
+
+std::vector<Profile::Summary> Profile::Profiler::summary() const {
+	std::vector<Summary> ret;
+	std::vector<double> sorted;
+
+	for (auto& [name, history] : _zones) {
+		sorted.assign(history.ms.begin(), history.ms.begin() + history.count);
+		std::sort(sorted.begin(), sorted.end());
+
+		double total = 0.0;
+		for (double ms : sorted) total += ms;
+
+		// Nearest rank
+		const size_t rank = (sorted.size() * 99 + 99) / 100;
+		ret.push_back({ name, sorted.size(), sorted.front(), total / static_cast<double>(sorted.size()), sorted[rank - 1] });
+	}
+
+	std::sort(ret.begin(), ret.end(), [](const Summary& a, const Summary& b) { return a.avgMs > b.avgMs; });
+	return ret;
+}
+
+bool Profile::Profiler::writeTrace(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file) return false;
+
+	// Complete events in microseconds, one track per recording thread
+	file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool first = true;
+	for (auto& frame : _trace) {
+		for (auto& event : frame) {
+			std::string name;
+			for (const char* c = event.name; *c != '\0'; c++) {
+				if (*c == '"' || *c == '\\') name += '\\';
+				name += *c;
+			}
+
+			file << (first ? "\n" : ",\n")
+				<< "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+				<< ",\"ts\":" << static_cast<double>(event.begin - _origin) / 1e3
+				<< ",\"dur\":" << static_cast<double>(event.end - event.begin) / 1e3 << "}";
+			first = false;
+		}
+	}
+
+	file << "\n]}\n";
+	return static_cast<bool>(file);
+}
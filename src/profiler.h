@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+// PROFILE_ZONE("name") times the rest of the enclosing scope, PROFILE_FRAME()
+// drains the zones once a frame. Builds without PROFILE_ZONES compile both
+// out entirely.
+#ifdef PROFILE_ZONES
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) Profile::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FRAME() Profile::profiler().endFrame()
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
+
+namespace Profile {
+
+	// Nanoseconds on the steady clock
+	int64_t now();
+
+	struct Event {
+		const char* name;       // string literal, compared by content
+		int64_t begin, end;
+	};
+
+	// Written only by its thread, no locks. endFrame reads everything up to
+	// `_head`, safe while the thread records less than a ring during the drain.
+	struct Ring {
+		static constexpr size_t capacity = size_t(1) << 14;
+
+		std::array<Event, capacity> _events;
+		std::atomic<uint64_t> _head = 0;        // events ever written
+		uint64_t _tail = 0;                     // events collected, endFrame only
+		uint32_t _thread = 0;
+
+		void push(const Event& event) {
+			const uint64_t head = _head.load(std::memory_order_relaxed);
+			_events[head % capacity] = event;
+			_head.store(head + 1, std::memory_order_release);
+		}
+	};
+
+	// The calling thread's ring, registered on first use
+	Ring& local();
+
+	struct Zone {
+		const char* _name;
+		int64_t _begin;
+
+		explicit Zone(const char* name) : _name(name), _begin(now()) {}
+		~Zone() { local().push({ _name, _begin, now() }); }
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+	};
+
+	// Per-frame time of one zone, summed over threads and calls
+	struct Summary {
+		std::string name;
+		size_t frames = 0;      // in the window that had the zone at all
+		double minMs = 0.0, avgMs = 0.0, p99Ms = 0.0;
+	};
+
+	// Drains the rings once a frame. Keeps a rolling window of per-zone
+	// totals for the summary and the last frames' events for the trace.
+	struct Profiler {
+		static constexpr size_t window = 240;
+		static constexpr size_t traceFrames = 60;
+
+		struct TraceEvent {
+			const char* name;
+			int64_t begin, end;
+			uint32_t thread;
+		};
+
+		struct History {
+			std::array<double, window> ms = {};
+			size_t count = 0;       // valid entries, at most window
+			size_t next = 0;
+		};
+
+		std::mutex _mutex;                          // registration and endFrame
+		std::vector<std::unique_ptr<Ring>> _rings;  // outlive their threads
+		std::deque<std::vector<TraceEvent>> _trace;
+		std::unordered_map<std::string, History> _zones;
+		std::unordered_map<const char*, double> _frameTotals;    // by literal, merged by name after
+		size_t _frames = 0;
+		int64_t _origin = now();
+
+		Ring& add();
+
+		// Zones still open on other threads land in a later frame
+		void endFrame();
+
+		// Zones by average time, slowest first
+		std::vector<Summary> summary() const;
+
+		// Chrome / Perfetto trace event JSON of the kept frames
+		bool writeTrace(const std::string& path) const;
+	};
+
+	Profiler& profiler();
+
+}
@@ -0,0 +1,468 @@
+#include <raster.h>
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include <span>
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include <cube.h>
+#include <sprite.h>
+#include <font.h>
+
+namespace {
+	using namespace DirectX;
+
+	constexpr float depthMax = 16777215.0f;     // D24
+	constexpr uint32_t clearDepthValue = 0xffffff;
+
+	XMVECTOR unpack(uint32_t texel) {
+		return XMVectorMultiply(XMVectorSet(
+			static_cast<float>(texel & 0xff), static_cast<float>((texel >> 8) & 0xff),
+			static_cast<float>((texel >> 16) & 0xff), static_cast<float>(texel >> 24)
+		), XMVectorReplicate(1.0f / 255.0f));
+	}
+
+	uint32_t pack(XMVECTOR color) {
+		XMFLOAT4 c;
+		XMStoreFloat4(&c, XMVectorMultiplyAdd(XMVectorSaturate(color), XMVectorReplicate(255.0f), XMVectorReplicate(0.5f)));
+
+		return static_cast<uint32_t>(c.x) | static_cast<uint32_t>(c.y) << 8
+			| static_cast<uint32_t>(c.z) << 16 | static_cast<uint32_t>(c.w) << 24;
+	}
+
+	// Clip space position plus texture coordinates, page in z
+	struct ClipVertex {
+		XMFLOAT4 pos;
+		XMFLOAT3 tex;
+	};
+
+	ClipVertex lerp(const ClipVertex& a, const ClipVertex& b, float t) {
+		ClipVertex ret;
+		XMStoreFloat4(&ret.pos, XMVectorLerp(XMLoadFloat4(&a.pos), XMLoadFloat4(&b.pos), t));
+		XMStoreFloat3(&ret.tex, XMVectorLerp(XMLoadFloat3(&a.tex), XMLoadFloat3(&b.tex), t));
+		return ret;
+	}
+
+	// The fill rule keeps pixels on a shared edge to one of its triangles
+	bool isTopLeft(const XMFLOAT2& from, const XMFLOAT2& to) {
+		return (from.y == to.y && to.x > from.x) || to.y < from.y;
+	}
+}
+
+void Raster::Device::resize(uint32_t width, uint32_t height) {
+	_target.width = width;
+	_target.height = height;
+	_target.color.assign(size_t(width) * height, 0);
+	_target.depth.assign(size_t(width) * height, clearDepthValue);
+
+	_tilesX = (width + tileSize - 1) / tileSize;
+	_tilesY = (height + tileSize - 1) / tileSize;
+	_tilePixels.assign(size_t(_tilesX) * _tilesY, 0);
+}
+
+void Raster::Device::setProjection(DirectX::FXMMATRIX pers, DirectX::CXMMATRIX ortho) {
+	XMStoreFloat4x4(&_pers, pers);
+	XMStoreFloat4x4(&_ortho, ortho);
+}
+
+void Raster::Device::clear(const std::array<float, 4>& color) {
+	std::fill(_target.color.begin(), _target.color.end(), pack(XMVectorSet(color[0], color[1], color[2], color[3])));
+}
+
+void Raster::Device::clearDepth() {
+	std::fill(_target.depth.begin(), _target.depth.end(), clearDepthValue);
+}
+
+void Raster::Device::submit(const Draw& draw) {
+	if (draw.instanceCount == 0 || draw.count == 0) return;
+
+	_draws.push_back(draw);
+
+	const size_t chunks = (draw.instanceCount + instanceGrain - 1) / instanceGrain;
+	const size_t firstBatch = _batchCount;
+	_batchCount += chunks;
+	if (_batches.size() < _batchCount) _batches.resize(_batchCount);
+
+	for (size_t idx = firstBatch; idx < _batchCount; idx++) {
+		Batch& batch = _batches[idx];
+		batch.draw = _draws.size() - 1;
+		batch.triangles.clear();
+		batch.bins.resize(size_t(_tilesX) * _tilesY);
+		for (auto& bin : batch.bins) bin.clear();
+	}
+
+	_jobs.parallelFor(chunks, 1, [&](size_t first, size_t count) {
+		for (size_t chunk = first; chunk < first + count; chunk++) {
+			const uint32_t firstInstance = static_cast<uint32_t>(chunk * instanceGrain);
+			shade(_batches[firstBatch + chunk], firstInstance, std::min(instanceGrain, draw.instanceCount - firstInstance));
+		}
+	});
+}
+
+void Raster::Device::shade(Batch& batch, uint32_t firstInstance, uint32_t count) {
+	const Draw& draw = _draws[batch.draw];
+	std::array<XMFLOAT4, 3> clip;
+	std::array<XMFLOAT3, 3> tex;
+
+	switch (draw.program) {
+	case Program::Cube: {
+		// cubeVS, instance matrices are stored transposed
+		auto* vertices = static_cast<const Cube::Vertex*>(draw.vertices);
+		auto* instances = static_cast<const Cube::Instance*>(draw.instances) + firstInstance;
+		const XMMATRIX pers = XMLoadFloat4x4(&_pers);
+
+		for (uint32_t inst = 0; inst < count; inst++) {
+			const XMMATRIX worldProj = XMMatrixMultiply(XMMatrixTranspose(XMLoadFloat4x4(&instances[inst].model)), pers);
+
+			for (uint32_t idx = 0; idx + 2 < draw.count; idx += 3) {
+				for (uint32_t corner = 0; corner < 3; corner++) {
+					const Cube::Vertex& vert = vertices[draw.indices[idx + corner]];
+					XMStoreFloat4(&clip[corner], XMVector4Transform(XMVectorSet(vert.pos.x, vert.pos.y, vert.pos.z, 1.0f), worldProj));
+					tex[corner] = { vert.tex.x, 1.0f - vert.tex.y, 0.0f };
+				}
+				setup(batch, clip, tex);
+			}
+		}
+		break;
+	}
+
+	case Program::Sprite: {
+		// spriteVS, the 3x3 model is stored transposed too
+		auto* vertices = static_cast<const Sprite::Vertex*>(draw.vertices);
+		auto* instances = static_cast<const Sprite::Instance*>(draw.instances) + firstInstance;
+		const XMMATRIX ortho = XMLoadFloat4x4(&_ortho);
+
+		for (uint32_t inst = 0; inst < count; inst++) {
+			const Sprite::Instance& sprite = instances[inst];
+			const XMFLOAT3X3& m = sprite.model;
+
+			for (uint32_t idx = 0; idx + 2 < draw.count; idx += 3) {
+				for (uint32_t corner = 0; corner < 3; corner++) {
+					const Sprite::Vertex& vert = vertices[idx + corner];
+					XMVECTOR pos = XMVectorSet(
+						m._11 * vert.pos.x + m._12 * vert.pos.y + m._13,
+						m._21 * vert.pos.x + m._22 * vert.pos.y + m._23,
+						m._31 * vert.pos.x + m._32 * vert.pos.y + m._33,
+						1.0f);
+					XMStoreFloat4(&clip[corner], XMVector4Transform(pos, ortho));
+
+					tex[corner] = {
+						sprite.uvRect.x + vert.tex.x * sprite.uvRect.z,
+						sprite.uvRect.y + (1.0f - vert.tex.y) * sprite.uvRect.w,
+						static_cast<float>(sprite.page),
+					};
+				}
+				setup(batch, clip, tex);
+			}
+		}
+		break;
+	}
+
+	case Program::SpriteCompact: {
+		// spriteCompactVS, scale then rotate then move
+		auto* vertices = static_cast<const Sprite::Vertex*>(draw.vertices);
+		auto* instances = static_cast<const Sprite::CompactInstance*>(draw.instances) + firstInstance;
+		const XMMATRIX ortho = XMLoadFloat4x4(&_ortho);
+
+		for (uint32_t inst = 0; inst < count; inst++) {
+			const Sprite::CompactInstance& sprite = instances[inst];
+			const Sprite::Region& region = draw.regions[sprite.region % Sprite::maxRegions];
+			const float sclX = PackedVector::XMConvertHalfToFloat(sprite.scale.x);
+			const float sclY = PackedVector::XMConvertHalfToFloat(sprite.scale.y);
+
+			float sinRot, cosRot;
+			XMScalarSinCos(&sinRot, &cosRot, PackedVector::XMConvertHalfToFloat(sprite.rotation));
+
+			for (uint32_t idx = 0; idx + 2 < draw.count; idx += 3) {
+				for (uint32_t corner = 0; corner < 3; corner++) {
+					const Sprite::Vertex& vert = vertices[idx + corner];
+					const float x = vert.pos.x * sclX, y = vert.pos.y * sclY;
+
+					XMVECTOR pos = XMVectorSet(x * cosRot - y * sinRot + sprite.position.x, x * sinRot + y * cosRot + sprite.position.y, 1.0f, 1.0f);
+					XMStoreFloat4(&clip[corner], XMVector4Transform(pos, ortho));
+
+					tex[corner] = {
+						region.uvRect.x + vert.tex.x * region.uvRect.z,
+						region.uvRect.y + (1.0f - vert.tex.y) * region.uvRect.w,
+						static_cast<float>(region.page),
+					};
+				}
+				setup(batch, clip, tex);
+			}
+		}
+		break;
+	}
+
+	case Program::Font: {
+		// fontVS, same corner order as the shader
+		constexpr std::array<XMFLOAT2, 6> corners = { {
+			{ 1.0f, 1.0f }, { 1.0f, 0.0f }, { 0.0f, 0.0f },
+			{ 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f },
+		} };
+
+		auto* glyphs = static_cast<const Font::Glyph*>(draw.instances) + firstInstance;
+		const XMMATRIX ortho = XMLoadFloat4x4(&_ortho);
+
+		for (uint32_t inst = 0; inst < count; inst++) {
+			const Font::Glyph& glyph = glyphs[inst];
+			const float width = PackedVector::XMConvertHalfToFloat(glyph.size.x);
+			const float height = PackedVector::XMConvertHalfToFloat(glyph.size.y);
+			const float u0 = static_cast<float>(glyph.uv.x) / 65535.0f, u1 = static_cast<float>(glyph.uv.y) / 65535.0f;
+
+			for (uint32_t idx = 0; idx + 2 < corners.size(); idx += 3) {
+				for (uint32_t corner = 0; corner < 3; corner++) {
+					const XMFLOAT2& c = corners[idx + corner];
+					XMVECTOR pos = XMVectorSet(glyph.pos.x + c.x * width, glyph.pos.y + c.y * height, 1.0f, 1.0f);
+					XMStoreFloat4(&clip[corner], XMVector4Transform(pos, ortho));
+
+					tex[corner] = { u0 + (u1 - u0) * c.x, 1.0f - c.y, 0.0f };
+				}
+				setup(batch, clip, tex);
+			}
+		}
+		break;
+	}
+	}
+}
+
+void Raster::Device::setup(Batch& batch, const std::array<XMFLOAT4, 3>& clip, const std::array<XMFLOAT3, 3>& tex) {
+	// Near plane clipping, z >= 0 in D3D clip space
+	std::array<ClipVertex, 4> poly;
+	size_t corners = 0;
+
+	if (clip[0].z >= 0.0f && clip[1].z >= 0.0f && clip[2].z >= 0.0f) {
+		for (size_t idx = 0; idx < 3; idx++) poly[idx] = { clip[idx], tex[idx] };
+		corners = 3;
+	}
+	else {
+		for (size_t idx = 0; idx < 3; idx++) {
+			const ClipVertex a = { clip[idx], tex[idx] };
+			const ClipVertex b = { clip[(idx + 1) % 3], tex[(idx + 1) % 3] };
+
+			if (a.pos.z >= 0.0f) poly[corners++] = a;
+			if ((a.pos.z >= 0.0f) != (b.pos.z >= 0.0f))
+				poly[corners++] = lerp(a, b, a.pos.z / (a.pos.z - b.pos.z));
+		}
+	}
+
+	const float width = static_cast<float>(_target.width), height = static_cast<float>(_target.height);
+
+	// Fan out what is left, a clipped triangle has at most four corners
+	for (size_t fan = 1; fan + 1 < corners; fan++) {
+		const std::array<const ClipVertex*, 3> verts = { &poly[0], &poly[fan], &poly[fan + 1] };
+
+		std::array<XMFLOAT2, 3> screen;
+		std::array<float, 3> depth, invW;
+		for (size_t idx = 0; idx < 3; idx++) {
+			invW[idx] = 1.0f / verts[idx]->pos.w;
+			screen[idx] = {
+				(verts[idx]->pos.x * invW[idx] * 0.5f + 0.5f) * width,
+				(0.5f - verts[idx]->pos.y * invW[idx] * 0.5f) * height,
+			};
+			depth[idx] = verts[idx]->pos.z * invW[idx];
+		}
+
+		// Clockwise is front facing, back faces are culled like the default rasterizer state
+		const float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y)
+			- (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+		if (!(area > 0.0f)) continue;
+
+		// Pixels whose center can be covered
+		Triangle tri;
+		tri.minX = static_cast<int>(std::ceil(std::clamp(std::min({ screen[0].x, screen[1].x, screen[2].x }) - 0.5f, 0.0f, width)));
+		tri.maxX = static_cast<int>(std::floor(std::clamp(std::max({ screen[0].x, screen[1].x, screen[2].x }) - 0.5f, -1.0f, width - 1.0f)));
+		tri.minY = static_cast<int>(std::ceil(std::clamp(std::min({ screen[0].y, screen[1].y, screen[2].y }) - 0.5f, 0.0f, height)));
+		tri.maxY = static_cast<int>(std::floor(std::clamp(std::max({ screen[0].y, screen[1].y, screen[2].y }) - 0.5f, -1.0f, height - 1.0f)));
+		if (tri.minX > tri.maxX || tri.minY > tri.maxY) continue;
+
+		// Edge opposite each vertex is that vertex's barycentric times the area.
+		// Anchored at the same end whichever way it runs, a neighbour sharing the
+		// edge gets the exact negation, so no pixel on it is lost or drawn twice.
+		for (size_t idx = 0; idx < 3; idx++) {
+			const XMFLOAT2& from = screen[(idx + 1) % 3];
+			const XMFLOAT2& to = screen[(idx + 2) % 3];
+			const XMFLOAT2& anchor = (from.x < to.x || (from.x == to.x && from.y < to.y)) ? from : to;
+
+			const float dx = from.y - to.y, dy = to.x - from.x;
+			tri.edges[idx] = { dx, dy, -(dx * anchor.x + dy * anchor.y) };
+			tri.topLeft[idx] = isTopLeft(from, to);
+		}
+
+		const float invArea = 1.0f / area;
+		auto plane = [&](float q0, float q1, float q2) {
+			return Plane{
+				(tri.edges[0].dx * q0 + tri.edges[1].dx * q1 + tri.edges[2].dx * q2) * invArea,
+				(tri.edges[0].dy * q0 + tri.edges[1].dy * q1 + tri.edges[2].dy * q2) * invArea,
+				(tri.edges[0].c * q0 + tri.edges[1].c * q1 + tri.edges[2].c * q2) * invArea,
+			};
+		};
+
+		tri.depth = plane(depth[0], depth[1], depth[2]);
+		tri.invW = plane(invW[0], invW[1], invW[2]);
+		tri.u = plane(verts[0]->tex.x * invW[0], verts[1]->tex.x * invW[1], verts[2]->tex.x * invW[2]);
+		tri.v = plane(verts[0]->tex.y * invW[0], verts[1]->tex.y * invW[1], verts[2]->tex.y * invW[2]);
+		tri.page = verts[0]->tex.z;
+
+		const uint32_t index = static_cast<uint32_t>(batch.triangles.size());
+		batch.triangles.push_back(tri);
+
+		for (int ty = tri.minY / static_cast<int>(tileSize); ty <= tri.maxY / static_cast<int>(tileSize); ty++)
+			for (int tx = tri.minX / static_cast<int>(tileSize); tx <= tri.maxX / static_cast<int>(tileSize); tx++)
+				batch.bins[size_t(ty) * _tilesX + tx].push_back(index);
+	}
+}
+
+void Raster::Device::flush() {
+	_jobs.parallelFor(size_t(_tilesX) * _tilesY, 1, [&](size_t first, size_t count) {
+		for (size_t tile = first; tile < first + count; tile++)
+			rasterize(static_cast<uint32_t>(tile % _tilesX), static_cast<uint32_t>(tile / _tilesX));
+	});
+
+	_stats = {};
+	for (size_t idx = 0; idx < _batchCount; idx++) _stats.triangles += _batches[idx].triangles.size();
+	for (size_t pixels : _tilePixels) _stats.pixels += pixels;
+
+	_draws.clear();
+	_batchCount = 0;
+}
+
+void Raster::Device::rasterize(uint32_t tileX, uint32_t tileY) {
+	const size_t tile = size_t(tileY) * _tilesX + tileX;
+	const int left = static_cast<int>(tileX * tileSize), top = static_cast<int>(tileY * tileSize);
+	const int right = std::min(left + static_cast<int>(tileSize), static_cast<int>(_target.width)) - 1;
+	const int bottom = std::min(top + static_cast<int>(tileSize), static_cast<int>(_target.height)) - 1;
+
+	size_t pixels = 0;
+
+	// Batches and their bins are in submission order, the blending relies on it
+	for (size_t idx = 0; idx < _batchCount; idx++) {
+		const Batch& batch = _batches[idx];
+		const Draw& draw = _draws[batch.draw];
+
+		for (uint32_t index : batch.bins[tile]) {
+			const Triangle& tri = batch.triangles[index];
+			drawTriangle(draw, tri, std::max(tri.minX, left), std::max(tri.minY, top),
+				std::min(tri.maxX, right), std::min(tri.maxY, bottom), pixels);
+		}
+	}
+
+	_tilePixels[tile] = pixels;
+}
+
+void Raster::Device::drawTriangle(const Draw& draw, const Triangle& tri, int minX, int minY, int maxX, int maxY, size_t& pixels) {
+	const XMVECTOR offsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	const XMVECTOR zero = XMVectorZero();
+
+	// Edges on the top or left keep the pixels centered exactly on them
+	std::array<XMVECTOR, 3> inclusive;
+	for (size_t idx = 0; idx < 3; idx++)
+		inclusive[idx] = tri.topLeft[idx] ? XMVectorTrueInt() : XMVectorZero();
+
+	auto eval = [](const Plane& plane, XMVECTOR px, float py) {
+		return XMVectorMultiplyAdd(px, XMVectorReplicate(plane.dx), XMVectorReplicate(plane.dy * py + plane.c));
+	};
+
+	const bool depthTest = draw.program == Program::Cube;
+	const bool blend = draw.program == Program::Font;
+	const Texture empty;
+	const Texture& tex0 = draw.textures[0] ? *draw.textures[0] : empty;
+	const Texture& tex1 = draw.textures[1] ? *draw.textures[1] : empty;
+
+	const XMVECTOR lastX = XMVectorReplicate(static_cast<float>(maxX) + 0.5f);
+	const XMVECTOR firstX = XMVectorReplicate(static_cast<float>(minX) + 0.5f);
+
+	for (int y = minY; y <= maxY; y++) {
+		const float py = static_cast<float>(y) + 0.5f;
+		uint32_t* color = &_target.color[size_t(y) * _target.width];
+		uint32_t* depthRow = &_target.depth[size_t(y) * _target.width];
+
+		for (int x = minX & ~3; x <= maxX; x += 4) {
+			const XMVECTOR px = XMVectorAdd(XMVectorReplicate(static_cast<float>(x)), offsets);
+
+			// Coverage, four pixels at a time
+			XMVECTOR inside = XMVectorAndInt(XMVectorGreaterOrEqual(px, firstX), XMVectorLessOrEqual(px, lastX));
+			for (size_t idx = 0; idx < 3; idx++) {
+				const XMVECTOR bary = eval(tri.edges[idx], px, py);
+				const XMVECTOR covered = XMVectorSelect(XMVectorGreater(bary, zero), XMVectorGreaterOrEqual(bary, zero), inclusive[idx]);
+				inside = XMVectorAndInt(inside, covered);
+			}
+
+			alignas(16) uint32_t mask[4];
+			XMStoreInt4A(mask, inside);
+			if ((mask[0] | mask[1] | mask[2] | mask[3]) == 0) continue;
+
+			// Perspective correct texture coordinates
+			const XMVECTOR w = XMVectorReciprocal(eval(tri.invW, px, py));
+			alignas(16) float u[4], v[4], z[4];
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(u), XMVectorMultiply(eval(tri.u, px, py), w));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(v), XMVectorMultiply(eval(tri.v, px, py), w));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(z), XMVectorMultiplyAdd(
+				XMVectorSaturate(eval(tri.depth, px, py)), XMVectorReplicate(depthMax), XMVectorReplicate(0.5f)));
+
+			for (int lane = 0; lane < 4; lane++) {
+				if (mask[lane] == 0) continue;
+				const int at = x + lane;
+
+				// Less, like the default depth stencil state
+				if (depthTest) {
+					const uint32_t depth = static_cast<uint32_t>(z[lane]);
+					if (depth >= depthRow[at]) continue;
+					depthRow[at] = depth;
+				}
+
+				XMVECTOR out;
+				switch (draw.program) {
+				case Program::Cube: {
+					// combiPS
+					const XMVECTOR wood = sample(tex0, u[lane], v[lane], 0.0f);
+					const XMVECTOR heart = sample(tex1, u[lane], v[lane], 0.0f);
+					out = XMVectorLerpV(wood, XMVectorMultiply(heart, wood), XMVectorSplatW(heart));
+					break;
+				}
+				case Program::Sprite:
+				case Program::SpriteCompact:
+					out = sample(tex0, u[lane], v[lane], tri.page);
+					break;
+				case Program::Font:
+					out = sample(tex0, u[lane], v[lane], 0.0f);
+					break;
+				}
+
+				// _blendState, source alpha over, destination alpha ends up zero
+				if (blend) {
+					const XMVECTOR alpha = XMVectorSplatW(out);
+					out = XMVectorMultiplyAdd(out, alpha, XMVectorNegativeMultiplySubtract(unpack(color[at]), alpha, unpack(color[at])));
+					out = XMVectorSetW(out, 0.0f);
+				}
+
+				color[at] = pack(out);
+				pixels++;
+			}
+		}
+	}
+}
+
+DirectX::XMVECTOR Raster::sample(const Texture& texture, float u, float v, float page) {
+	if (texture.texels.empty()) return XMVectorZero();
+
+	const int width = static_cast<int>(texture.width), height = static_cast<int>(texture.height);
+	const float x = (u - std::floor(u)) * static_cast<float>(width) - 0.5f;
+	const float y = (v - std::floor(v)) * static_cast<float>(height) - 0.5f;
+	const float fx = std::floor(x), fy = std::floor(y);
+
+	// Wrap addressing, x and y start at -0.5 at worst
+	const int x0 = (static_cast<int>(fx) + width) % width, x1 = (x0 + 1) % width;
+	const int y0 = (static_cast<int>(fy) + height) % height, y1 = (y0 + 1) % height;
+	const int layer = std::clamp(static_cast<int>(std::lround(page)), 0, static_cast<int>(texture.layers) - 1);
+
+	const uint32_t* texels = texture.texels.data() + size_t(layer) * width * height;
+	const XMVECTOR top = XMVectorLerp(unpack(texels[y0 * width + x0]), unpack(texels[y0 * width + x1]), x - fx);
+	const XMVECTOR bottom = XMVectorLerp(unpack(texels[y1 * width + x0]), unpack(texels[y1 * width + x1]), x - fx);
+
+	return XMVectorLerp(top, bottom, y - fy);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <span>
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <jobs.h>
+#include <sprite.h>
+
+// CPU implementation of the sampleShader.hlsl pipeline, for machines
+// without a GPU. Draws are vertex shaded and binned into screen tiles on
+// submit, tiles are rasterized in parallel on flush. Within a tile the
+// triangles keep submission order, so the image does not depend on the
+// thread count.
+namespace Raster {
+
+	// RGBA8, mip 0 of every layer back to back. Empty ones sample as zero,
+	// like an unbound shader resource.
+	struct Texture {
+		uint32_t width = 0, height = 0, layers = 1;
+		std::vector<uint32_t> texels;
+	};
+
+	// Color is RGBA8 like the swap chain, depth keeps 24-bit unorm values
+	struct Target {
+		uint32_t width = 0, height = 0;
+		std::vector<uint32_t> color;
+		std::vector<uint32_t> depth;
+	};
+
+	// Vertex and pixel shader pairs the renderer uses
+	enum class Program { Cube, Sprite, SpriteCompact, Font };
+
+	// One instanced draw. Vertex layouts are Cube::Vertex, Sprite::Vertex and
+	// Font::Glyph instances, the pointers must live until flush. Compact
+	// sprites read Sprite::CompactInstance and look their rects up in `regions`.
+	struct Draw {
+		Program program = Program::Cube;
+		const void* vertices = nullptr;         // cubes and sprites, fontVS builds its own quads
+		const uint16_t* indices = nullptr;      // cubes only
+		uint32_t count = 0;                     // indices or vertices per instance
+		const void* instances = nullptr;
+		uint32_t instanceCount = 0;
+		std::array<const Texture*, 2> textures = {};
+		const Sprite::Region* regions = nullptr;    // Sprite::maxRegions of them
+	};
+
+	struct Stats {
+		size_t triangles = 0;       // after culling and clipping
+		size_t pixels = 0;          // written to the target
+	};
+
+	struct Device {
+		static constexpr uint32_t tileSize = 64;
+		static constexpr uint32_t instanceGrain = 256;
+
+		// Attribute q at pixel (x, y) is dx * x + dy * y + c
+		struct Plane {
+			float dx, dy, c;
+		};
+
+		// Screen space, ready to rasterize
+		struct Triangle {
+			std::array<Plane, 3> edges;         // barycentrics of vertex 0, 1 and 2 times the area
+			std::array<bool, 3> topLeft;        // edges that own the pixels centered on them
+			Plane depth, invW, u, v;            // u and v are divided by w
+			float page;
+			int minX, minY, maxX, maxY;
+		};
+
+		// Triangles of one chunk of instances, and the ones touching each tile
+		struct Batch {
+			size_t draw;
+			std::vector<Triangle> triangles;
+			std::vector<std::vector<uint32_t>> bins;
+		};
+
+		Target _target;
+		Jobs::Scheduler& _jobs;
+
+		// Row vector matrices, the transposes of what projBuffer holds
+		DirectX::XMFLOAT4X4 _pers = {}, _ortho = {};
+
+		std::vector<Draw> _draws;
+		std::vector<Batch> _batches;
+		size_t _batchCount = 0;             // in use this frame, the rest keep their memory
+		uint32_t _tilesX = 0, _tilesY = 0;
+		std::vector<size_t> _tilePixels;
+		Stats _stats;
+
+		explicit Device(Jobs::Scheduler& jobs) : _jobs(jobs) {}
+
+		void resize(uint32_t width, uint32_t height);
+		void setProjection(DirectX::FXMMATRIX pers, DirectX::CXMMATRIX ortho);
+
+		void clear(const std::array<float, 4>& color);
+		void clearDepth();
+
+		// Shades and bins the draw's vertices right away, in parallel
+		void submit(const Draw& draw);
+
+		// Rasterizes everything submitted since the last flush
+		void flush();
+
+	private:
+		void shade(Batch& batch, uint32_t firstInstance, uint32_t count);
+		void setup(Batch& batch, const std::array<DirectX::XMFLOAT4, 3>& clip, const std::array<DirectX::XMFLOAT3, 3>& tex);
+		void rasterize(uint32_t tileX, uint32_t tileY);
+		void drawTriangle(const Draw& draw, const Triangle& tri, int minX, int minY, int maxX, int maxY, size_t& pixels);
+	};
+
+	// Bilinear filter with wrap addressing on mip 0, texel centers at .5
+	DirectX::XMVECTOR sample(const Texture& texture, float u, float v, float page);
+
+}
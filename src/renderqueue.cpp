@@ -0,0 +1,44 @@
+#include <renderqueue.h>
+
+#include <span>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+uint64_t Render::makeKey(Layer layer, Pass pass, uint16_t shader, uint16_t texture, float depth) {
+	constexpr uint64_t depthMax = (1u << 24) - 1;
+
+	uint64_t z = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * static_cast<float>(depthMax));
+	const uint64_t state = (static_cast<uint64_t>(shader & 0xfff) << 16) | texture;
+
+	uint64_t key = (static_cast<uint64_t>(layer) << 56) | (static_cast<uint64_t>(pass) << 52);
+	if (pass == Pass::Transparent)
+		return key | ((depthMax - z) << 28) | state;
+
+	return key | (state << 24) | z;
+}
+
+std::span<const Render::Queue::Item> Render::Queue::sort() {
+	_scratch.resize(_items.size());
+
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		std::array<size_t, 256> counts = {};
+		for (auto& item : _items) counts[(item.key >> shift) & 0xff]++;
+
+		// Every key shares this byte, nothing would move
+		if (counts[(_items.empty() ? 0 : _items[0].key >> shift) & 0xff] == _items.size()) continue;
+
+		size_t offset = 0;
+		for (auto& count : counts) {
+			const size_t bucket = count;
+			count = offset;
+			offset += bucket;
+		}
+
+		for (auto& item : _items) _scratch[counts[(item.key >> shift) & 0xff]++] = item;
+		_items.swap(_scratch);
+	}
+
+	return _items;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+
+namespace Render {
+
+	// Layers draw in order, whatever order their render* calls came in
+	enum class Layer : uint8_t { Background, World, Overlay };
+
+	// Opaque draws go front to back, transparent ones back to front
+	enum class Pass : uint8_t { Opaque, Transparent };
+
+	// From the top bit down: layer 8 | pass 4 | shader 12 | texture 16 | depth 24.
+	// Transparent draws move depth above shader and texture so blending stays
+	// correct. Depth is clamped to [0, 1].
+	uint64_t makeKey(Layer layer, Pass pass, uint16_t shader, uint16_t texture, float depth);
+
+	// Draw items collected over a frame and replayed in key order. Knows
+	// nothing about D3D, `draw` indexes whatever the caller keeps its packets in.
+	struct Queue {
+		struct Item {
+			uint64_t key;
+			uint32_t draw;
+		};
+
+		std::vector<Item> _items, _scratch;
+
+		void submit(uint64_t key, uint32_t draw) { _items.push_back({ key, draw }); }
+		void clear() { _items.clear(); }
+
+		// Stable LSD radix sort by key, equal keys keep their submission order
+		std::span<const Item> sort();
+	};
+
+}
@@ -0,0 +1,125 @@
+#include <shaderpack.h>
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#include <mappedfile.h>
+
+uint64_t Shader::hash(std::span<const std::byte> data, uint64_t seed) {
+	uint64_t value = seed;
+	for (std::byte chr : data) {
+		value ^= static_cast<uint64_t>(chr);
+		value *= 1099511628211ull;
+	}
+
+	return value;
+}
+
+uint64_t Shader::hash(const std::string& text, uint64_t seed) {
+	// Hash the terminator too, so "ab" + "c" and "a" + "bc" differ
+	return hash(std::as_bytes(std::span(text.c_str(), text.size() + 1)), seed);
+}
+
+uint64_t Shader::Key::hash() const {
+	std::vector<const Define*> sorted;
+	for (auto& define : defines) sorted.push_back(&define);
+
+	std::sort(sorted.begin(), sorted.end(), [](const Define* a, const Define* b) { return a->name < b->name; });
+
+	uint64_t value = Shader::hash(entry);
+	value = Shader::hash(profile, value);
+	for (const Define* define : sorted) {
+		value = Shader::hash(define->name, value);
+		value = Shader::hash(define->value, value);
+	}
+
+	return value;
+}
+
+bool Shader::Pack::open(const std::string& path) {
+	close();
+
+	if (!_file.open(path)) return false;
+	if (load(_file.bytes())) return true;
+
+	close();
+	return false;
+}
+
+bool Shader::Pack::load(std::span<const std::byte> data) {
+	if (data.size() < sizeof(Header)) return false;
+
+	Header header;
+	std::memcpy(&header, data.data(), sizeof(Header));
+	if (header.magic != magic) return false;
+
+	const size_t tableBytes = static_cast<size_t>(header.count) * sizeof(Entry);
+	if (data.size() - sizeof(Header) < tableBytes) return false;
+
+	auto entries = std::span(reinterpret_cast<const Entry*>(data.data() + sizeof(Header)), header.count);
+
+	for (size_t idx = 0; idx < entries.size(); idx++) {
+		const Entry& entry = entries[idx];
+
+		if (entry.offset > data.size() || entry.size > data.size() - entry.offset) return false;
+		if (idx > 0 && entries[idx - 1].key >= entry.key) return false;
+	}
+
+	_sourceHash = header.sourceHash;
+	_entries = entries;
+	_data = data;
+	return true;
+}
+
+void Shader::Pack::close() {
+	_file.close();
+	_sourceHash = 0;
+	_entries = {};
+	_data = {};
+}
+
+std::span<const std::byte> Shader::Pack::find(uint64_t key) const {
+	auto entry = std::lower_bound(_entries.begin(), _entries.end(), key,
+		[](const Entry& item, uint64_t value) { return item.key < value; });
+
+	if (entry == _entries.end() || entry->key != key) return {};
+
+	return _data.subspan(entry->offset, entry->size);
+}
+
+std::vector<std::byte> Shader::Pack::build(uint64_t sourceHash, std::vector<Blob> blobs) {
+	std::sort(blobs.begin(), blobs.end(), [](const Blob& a, const Blob& b) { return a.key < b.key; });
+	blobs.erase(std::unique(blobs.begin(), blobs.end(),
+		[](const Blob& a, const Blob& b) { return a.key == b.key; }), blobs.end());
+
+	const Header header = { magic, static_cast<uint32_t>(blobs.size()), sourceHash };
+
+	// Blobs start 16-byte aligned after the table
+	size_t offset = (sizeof(Header) + blobs.size() * sizeof(Entry) + 15) & ~size_t(15);
+
+	std::vector<Entry> entries;
+	for (auto& blob : blobs) {
+		entries.push_back({ blob.key, offset, blob.code.size() });
+		offset = (offset + blob.code.size() + 15) & ~size_t(15);
+	}
+
+	std::vector<std::byte> data(offset);
+	std::memcpy(data.data(), &header, sizeof(Header));
+	std::memcpy(data.data() + sizeof(Header), entries.data(), entries.size() * sizeof(Entry));
+
+	for (size_t idx = 0; idx < blobs.size(); idx++)
+		std::memcpy(data.data() + entries[idx].offset, blobs[idx].code.data(), blobs[idx].code.size());
+
+	return data;
+}
+
+bool Shader::Pack::write(const std::string& path, std::span<const std::byte> data) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+	return static_cast<bool>(file);
+}
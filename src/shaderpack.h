@@ -0,0 +1,74 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <mappedfile.h>
+
+namespace Shader {
+
+	// 64-bit FNV-1a, chain calls through `seed`
+	uint64_t hash(std::span<const std::byte> data, uint64_t seed = 14695981039346656037ull);
+	uint64_t hash(const std::string& text, uint64_t seed = 14695981039346656037ull);
+
+	struct Define {
+		std::string name;
+		std::string value;
+	};
+
+	// One compiled variant of an entry point
+	struct Key {
+		std::string entry;
+		std::string profile;
+		std::vector<Define> defines;
+
+		// Order of the defines does not matter
+		uint64_t hash() const;
+	};
+
+	// Precompiled bytecode for every variant of one shader source, keyed by
+	// Key::hash. Layout: Header, Entry[count] sorted by key, then the blobs.
+	struct Pack {
+		static constexpr uint32_t magic = 0x314B5053; // "SPK1"
+
+		struct Header {
+			uint32_t magic;
+			uint32_t count;
+			uint64_t sourceHash;
+		};
+
+		struct Entry {
+			uint64_t key;
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		struct Blob {
+			uint64_t key;
+			std::span<const std::byte> code;
+		};
+
+		MappedFile _file;
+		uint64_t _sourceHash = 0;
+		std::span<const Entry> _entries;
+		std::span<const std::byte> _data;
+
+		// Maps and validates a pack file, false if missing or malformed
+		bool open(const std::string& path);
+
+		// Validates an in-memory pack, the memory has to outlive the lookups
+		bool load(std::span<const std::byte> data);
+
+		void close();
+
+		// Empty span when the key is not in the pack
+		std::span<const std::byte> find(uint64_t key) const;
+
+		static std::vector<std::byte> build(uint64_t sourceHash, std::vector<Blob> blobs);
+		static bool write(const std::string& path, std::span<const std::byte> data);
+	};
+
+}
@@ -0,0 +1,68 @@
+#include <snapshot.h>
+
+#include <span>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+#include <profiler.h>
+
+void Snapshot::Scene::assign(Sprite::Columns sprites, Cube::Columns cubes, std::span<const Font::String> strings) {
+	clear();
+	add(sprites);
+	add(cubes);
+	add(strings);
+}
+
+void Snapshot::Scene::clear() {
+	sprites.clear();
+	cubes.clear();
+	strings.clear();
+	_text.reset();
+}
+
+void Snapshot::Scene::add(Sprite::Columns more) {
+	sprites.add(more);
+}
+
+void Snapshot::Scene::add(Cube::Columns more) {
+	cubes.add(more);
+}
+
+void Snapshot::Scene::add(std::span<const Font::String> more) {
+	for (const auto& str : more) strings.push_back({ _text.string(str.data), str.pxOffset, str.fontSize });
+}
+
+void Snapshot::TripleBuffer::publish() {
+	Scene& scene = back();
+	scene.sequence = ++_sequence;
+	scene.published = Profile::now();
+
+	// Release hands the filled slot over, acquire takes back whatever the reader left
+	_back = _middle.exchange(_back | fresh, std::memory_order_acq_rel) & ~fresh;
+}
+
+bool Snapshot::TripleBuffer::acquire() {
+	if ((_middle.load(std::memory_order_relaxed) & fresh) == 0)
+		return false;
+
+	// Only the writer sets the flag, so it is still there for the exchange
+	_front = _middle.exchange(_front, std::memory_order_acq_rel) & ~fresh;
+	return true;
+}
+
+void Snapshot::Stats::frame(const Scene& scene, bool acquired, int64_t presented) {
+	frames++;
+
+	if (!acquired || scene.sequence == _last) {
+		duplicated++;
+		return;
+	}
+
+	dropped += static_cast<size_t>(scene.sequence - _last - 1);
+	_last = scene.sequence;
+
+	const double ms = static_cast<double>(presented - scene.published) / 1e6;
+	latencyMs += ms;
+	maxLatencyMs = std::max(maxLatencyMs, ms);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <sprite.h>
+#include <cube.h>
+#include <font.h>
+#include <arena.h>
+
+namespace Snapshot {
+
+	// Everything a frame draws, a copy of the simulation at one update
+	struct Scene {
+		Sprite::Arrays sprites;
+		Cube::Arrays cubes;
+		std::vector<Font::String> strings;
+		uint64_t sequence = 0;      // 1 for the first publish, 0 never published
+		int64_t published = 0;      // Profile::now() at publish
+		Arena::Linear _text;        // what the strings point at, until the next assign
+
+		// Copies into the columns and the arena, all keep their capacity between updates
+		void assign(Sprite::Columns, Cube::Columns, std::span<const Font::String>);
+
+		// Same in pieces, for a scene kept in several arrays. clear, then add each.
+		void clear();
+		void add(Sprite::Columns);
+		void add(Cube::Columns);
+		void add(std::span<const Font::String>);
+	};
+
+	// Lock-free triple buffer between one writer and one reader thread. The
+	// writer fills back() and swaps it with the middle slot, the reader
+	// swaps the middle slot in when it is newer than the one it holds.
+	// Neither side ever waits, the writer overwrites what the reader missed.
+	struct TripleBuffer {
+		static constexpr uint32_t fresh = 4;    // set on the middle index by publish
+
+		std::array<Scene, 3> _slots;
+		std::atomic<uint32_t> _middle = 1;
+		uint32_t _back = 0;                     // writer only
+		uint32_t _front = 2;                    // reader only
+		uint64_t _sequence = 0;                 // writer only
+
+		// Writer side, fill then publish
+		Scene& back() { return _slots[_back]; }
+		void publish();
+
+		// Reader side, true if front() changed
+		bool acquire();
+		Scene& front() { return _slots[_front]; }
+	};
+
+	// Reader side bookkeeping, one call per rendered frame
+	struct Stats {
+		size_t frames = 0;
+		size_t dropped = 0;         // published, overwritten before any frame took them
+		size_t duplicated = 0;      // frames that had nothing newer than the last one
+		double latencyMs = 0.0;     // publish to presented, summed over new snapshots
+		double maxLatencyMs = 0.0;
+		uint64_t _last = 0;
+
+		size_t fresh() const { return frames - duplicated; }
+		double avgLatencyMs() const { return fresh() > 0 ? latencyMs / static_cast<double>(fresh()) : 0.0; }
+
+		// `presented` on the Profile::now() clock
+		void frame(const Scene&, bool acquired, int64_t presented);
+	};
+
+}
@@ -2,6 +2,11 @@
 
 #include <DirectXMath.h>
 
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
 DirectX::XMFLOAT3X3 Sprite::Data::getWorldMatrix() {
 	DirectX::XMVECTOR zeroes = { 0.0f, 0.0f };
 	DirectX::XMVECTOR simdScale = DirectX::XMLoadFloat2(&_scale);
@@ -22,6 +27,165 @@ DirectX::XMFLOAT3X3 Sprite::Data::getWorldMatrix() {
 	return ret;
 }
 
+namespace {
+
+	// Kernel behind both getWorldMatrices, `indices` may be null
+	void buildInstances(Sprite::Columns sprites, const uint32_t* indices, size_t count, Sprite::Instance* out) {
+		using namespace DirectX;
+
+		if (count == 0) return;
+
+		// Short batches repeat their last sprite in the unused lanes
+		auto lane = [&](size_t idx) -> size_t {
+			idx = std::min(idx, count - 1);
+			return (indices != nullptr) ? indices[idx] : idx;
+		};
+
+		const Sprite::Rotation* rot = sprites.rotation.data();
+		const Sprite::Scale* scl = sprites.scale.data();
+
+		for (size_t first = 0; first < count; first += 4) {
+			const size_t s0 = lane(first), s1 = lane(first + 1), s2 = lane(first + 2), s3 = lane(first + 3);
+
+			XMVECTOR sinRot, cosRot;
+			XMVectorSinCos(&sinRot, &cosRot, XMVectorSet(rot[s0].radians, rot[s1].radians, rot[s2].radians, rot[s3].radians));
+
+			XMVECTOR sclX = XMVectorSet(scl[s0].x, scl[s1].x, scl[s2].x, scl[s3].x);
+			XMVECTOR sclY = XMVectorSet(scl[s0].y, scl[s1].y, scl[s2].y, scl[s3].y);
+
+			alignas(16) float m11[4], m12[4], m21[4], m22[4];
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m11), XMVectorMultiply(sclX, cosRot));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m12), XMVectorNegate(XMVectorMultiply(sclY, sinRot)));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m21), XMVectorMultiply(sclX, sinRot));
+			XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(m22), XMVectorMultiply(sclY, cosRot));
+
+			const size_t lanes = std::min<size_t>(4, count - first);
+			for (size_t idx = 0; idx < lanes; idx++) {
+				const size_t sprite = lane(first + idx);
+				const Sprite::Position& pos = sprites.position[sprite];
+
+				out[first + idx].model = XMFLOAT3X3(
+					m11[idx], m12[idx], pos.x,
+					m21[idx], m22[idx], pos.y,
+					0.0f, 0.0f, 1.0f
+				);
+				out[first + idx].uvRect = sprites.image[sprite].uvRect;
+				out[first + idx].page = sprites.image[sprite].page;
+			}
+		}
+	}
+
+	// Same for getCompactInstances
+	void packInstances(Sprite::Columns sprites, const uint32_t* indices, size_t count, Sprite::CompactInstance* out) {
+		using namespace DirectX;
+		using namespace DirectX::PackedVector;
+
+		for (size_t idx = 0; idx < count; idx++) {
+			const size_t sprite = (indices != nullptr) ? indices[idx] : idx;
+			const Sprite::Scale& scale = sprites.scale[sprite];
+
+			// Halves lose precision away from zero, the angle keeps growing otherwise
+			out[idx] = {
+				sprites.position[sprite],
+				XMHALF2(scale.x, scale.y),
+				XMConvertFloatToHalf(XMScalarModAngle(sprites.rotation[sprite].radians)),
+				sprites.image[sprite].region,
+			};
+		}
+	}
+
+}
+
+void Sprite::getWorldMatrices(Columns sprites, std::span<Instance> out) {
+	buildInstances(sprites, nullptr, std::min(sprites.size(), out.size()), out.data());
+}
+
+void Sprite::getWorldMatrices(Columns sprites, std::span<const uint32_t> indices, std::span<Instance> out) {
+	buildInstances(sprites, indices.data(), std::min(indices.size(), out.size()), out.data());
+}
+
+void Sprite::getCompactInstances(Columns sprites, std::span<CompactInstance> out) {
+	packInstances(sprites, nullptr, std::min(sprites.size(), out.size()), out.data());
+}
+
+void Sprite::getCompactInstances(Columns sprites, std::span<const uint32_t> indices, std::span<CompactInstance> out) {
+	packInstances(sprites, indices.data(), std::min(indices.size(), out.size()), out.data());
+}
+
+size_t Sprite::cull(const Cull::Rect& view, float halfSize, Columns sprites, std::vector<uint32_t>& visible) {
+	using namespace DirectX;
+
+	const size_t count = sprites.size();
+	visible.resize(count);
+	if (count == 0) return 0;
+
+	auto lane = [&](size_t idx) -> size_t { return std::min(idx, count - 1); };
+	const Position* pos = sprites.position.data();
+	const Scale* scl = sprites.scale.data();
+
+	const XMVECTOR half = XMVectorReplicate(halfSize);
+	const XMVECTOR left = XMVectorReplicate(view.left), right = XMVectorReplicate(view.right);
+	const XMVECTOR bottom = XMVectorReplicate(view.bottom), top = XMVectorReplicate(view.top);
+
+	size_t survivors = 0;
+	for (size_t first = 0; first < count; first += 4) {
+		const size_t s0 = lane(first), s1 = lane(first + 1), s2 = lane(first + 2), s3 = lane(first + 3);
+
+		XMVECTOR x = XMVectorSet(pos[s0].x, pos[s1].x, pos[s2].x, pos[s3].x);
+		XMVECTOR y = XMVectorSet(pos[s0].y, pos[s1].y, pos[s2].y, pos[s3].y);
+		XMVECTOR sclX = XMVectorSet(scl[s0].x, scl[s1].x, scl[s2].x, scl[s3].x);
+		XMVECTOR sclY = XMVectorSet(scl[s0].y, scl[s1].y, scl[s2].y, scl[s3].y);
+
+		// The circle around the quad covers it at any rotation
+		XMVECTOR radius = XMVectorMultiply(half, XMVectorSqrt(XMVectorMultiplyAdd(sclX, sclX, XMVectorMultiply(sclY, sclY))));
+
+		XMVECTOR inX = XMVectorAndInt(
+			XMVectorGreaterOrEqual(XMVectorAdd(x, radius), left),
+			XMVectorLessOrEqual(XMVectorSubtract(x, radius), right));
+		XMVECTOR inY = XMVectorAndInt(
+			XMVectorGreaterOrEqual(XMVectorAdd(y, radius), bottom),
+			XMVectorLessOrEqual(XMVectorSubtract(y, radius), top));
+
+		alignas(16) uint32_t mask[4];
+		XMStoreInt4A(mask, XMVectorAndInt(inX, inY));
+
+		// Always written, only kept when visible
+		const size_t lanes = std::min<size_t>(4, count - first);
+		for (size_t idx = 0; idx < lanes; idx++) {
+			visible[survivors] = static_cast<uint32_t>(first + idx);
+			survivors += mask[idx] & 1;
+		}
+	}
+
+	visible.resize(survivors);
+	return survivors;
+}
+
+Sprite::Arrays::Arrays(std::span<const Data> sprites) {
+	for (const Data& sprite : sprites) add(sprite);
+}
+
+void Sprite::Arrays::clear() {
+	position.clear();
+	rotation.clear();
+	scale.clear();
+	image.clear();
+}
+
+void Sprite::Arrays::add(Columns more) {
+	position.insert(position.end(), more.position.begin(), more.position.end());
+	rotation.insert(rotation.end(), more.rotation.begin(), more.rotation.end());
+	scale.insert(scale.end(), more.scale.begin(), more.scale.end());
+	image.insert(image.end(), more.image.begin(), more.image.end());
+}
+
+void Sprite::Arrays::add(const Data& sprite) {
+	position.push_back({ sprite._position });
+	rotation.push_back({ sprite._rotation });
+	scale.push_back({ sprite._scale });
+	image.push_back({ sprite._uvRect, sprite._page, sprite._region });
+}
+
 DirectX::XMVECTOR Sprite::Data::getPosition() {
 	return DirectX::XMLoadFloat2(&_position);
 }
@@ -58,3 +222,14 @@ Sprite::Data& Sprite::Data::setScale(DirectX::XMVECTOR other) {
 	DirectX::XMStoreFloat2(&_scale, other);
 	return *this;
 }
+
+Sprite::Data& Sprite::Data::setUV(DirectX::XMFLOAT4 rect, uint32_t page) {
+	_uvRect = rect;
+	_page = page;
+	return *this;
+}
+
+Sprite::Data& Sprite::Data::setRegion(uint16_t region) {
+	_region = region;
+	return *this;
+}
@@ -1,6 +1,13 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include <span>
+#include <vector>
+#include <cstdint>
+
+#include <culling.h>
 
 namespace Sprite {
 
@@ -11,12 +18,108 @@ namespace Sprite {
 
 	struct Instance {
 		DirectX::XMFLOAT3X3 model;
+		DirectX::XMFLOAT4 uvRect;   // atlas u, v, width, height
+		uint32_t page;
+	};
+
+	// Same sprite in 16 bytes, spriteCompactVS builds the matrix and looks
+	// the atlas rect up by region
+	struct CompactInstance {
+		DirectX::XMFLOAT2 position;
+		DirectX::PackedVector::XMHALF2 scale;
+		DirectX::PackedVector::HALF rotation;   // radians in [-pi, pi]
+		uint16_t region;
+	};
+
+	static_assert(sizeof(CompactInstance) == 16);
+
+	// Entry of the region table compact sprites index, laid out like the HLSL one
+	struct Region {
+		DirectX::XMFLOAT4 uvRect;   // atlas u, v, width, height
+		uint32_t page;
+		uint32_t pad[3];
+	};
+
+	static_assert(sizeof(Region) == 32);
+
+	constexpr size_t maxRegions = 1024;
+
+	// A sprite's fields, each its own component in the entity store so a
+	// query only streams over the columns it touches
+	struct Position : DirectX::XMFLOAT2 {};
+	struct Scale : DirectX::XMFLOAT2 {};
+
+	struct Rotation {
+		float radians = 0.0f;
 	};
 
+	// Region of the sprite atlas a sprite shows
+	struct Image {
+		DirectX::XMFLOAT4 uvRect = { 0.0f, 0.0f, 1.0f, 1.0f };
+		uint32_t page = 0;
+		uint16_t region = 0;    // the same region as an index into the region table
+	};
+
+	class Data;
+
+	// Sprites as parallel columns, element i of each belongs to sprite i
+	struct Columns {
+		std::span<const Position> position;
+		std::span<const Rotation> rotation;
+		std::span<const Scale> scale;
+		std::span<const Image> image;
+
+		size_t size() const { return position.size(); }
+		bool empty() const { return position.empty(); }
+
+		Columns subspan(size_t first, size_t count) const {
+			return { position.subspan(first, count), rotation.subspan(first, count), scale.subspan(first, count), image.subspan(first, count) };
+		}
+	};
+
+	// Owning columns, keep their capacity through clear
+	struct Arrays {
+		std::vector<Position> position;
+		std::vector<Rotation> rotation;
+		std::vector<Scale> scale;
+		std::vector<Image> image;
+
+		Arrays() = default;
+		explicit Arrays(std::span<const Data> sprites);
+
+		size_t size() const { return position.size(); }
+		operator Columns() const { return { position, rotation, scale, image }; }
+
+		void clear();
+		void add(Columns more);
+		void add(const Data& sprite);
+	};
+
+	// Same result as Data::getWorldMatrix, four sprites per SIMD iteration
+	void getWorldMatrices(Columns sprites, std::span<Instance> out);
+
+	// Same, for the sprites at `indices` only, written back to back
+	void getWorldMatrices(Columns sprites, std::span<const uint32_t> indices, std::span<Instance> out);
+
+	// Compact instances instead, no matrix is built on the CPU
+	void getCompactInstances(Columns sprites, std::span<CompactInstance> out);
+	void getCompactInstances(Columns sprites, std::span<const uint32_t> indices, std::span<CompactInstance> out);
+
+	// Indices of the sprites whose bounding circle touches `view`, four per
+	// SIMD iteration. `halfSize` is half the quad's edge at scale 1. Reads
+	// positions and scales only.
+	size_t cull(const Cull::Rect& view, float halfSize, Columns sprites, std::vector<uint32_t>& visible);
+
+	// One sprite on its own, the per-object reference for the kernels
 	class Data {
 		DirectX::XMFLOAT2 _position = { 0.0f, 0.0f };
 		float			  _rotation = 0.0f;
 		DirectX::XMFLOAT2 _scale = { 1.0f, 1.0f };
+		DirectX::XMFLOAT4 _uvRect = { 0.0f, 0.0f, 1.0f, 1.0f };
+		uint32_t          _page = 0;
+		uint16_t          _region = 0;
+
+		friend struct Arrays;
 
 	public:
 		Data(const DirectX::XMFLOAT2& _pos, float _rot, const DirectX::XMFLOAT2& _scl)
@@ -34,6 +137,12 @@ namespace Sprite {
 		DirectX::XMVECTOR getScale();
 		Data& setScale(DirectX::XMFLOAT2 other);
 		Data& setScale(DirectX::XMVECTOR other);
+
+		// Region of the sprite atlas this sprite shows
+		Data& setUV(DirectX::XMFLOAT4 rect, uint32_t page);
+
+		// The same region as an index into the region table, for compact instances
+		Data& setRegion(uint16_t region);
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include <texturestream.h>
+
+#include <span>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+// Residency
+
+Texture::Handle Texture::Residency::add(Desc desc) {
+	const uint32_t mipLevels = static_cast<uint32_t>(desc.mipBytes.size());
+
+	uint32_t tail = 0;
+	while (tail + 1 < mipLevels && std::max(desc.width >> tail, desc.height >> tail) > tailSize)
+		tail++;
+
+	_entries.push_back({ std::move(desc), tail, tail, tail, tail, 0 });
+
+	const Handle texture = static_cast<Handle>(_entries.size() - 1);
+	_committed += bytes(texture, tail);
+
+	return texture;
+}
+
+void Texture::Residency::request(Handle texture, float pixels) {
+	Entry& entry = _entries[texture];
+	const uint32_t longest = std::max(entry.desc.width, entry.desc.height);
+
+	// Smallest mip that still has a texel per pixel
+	uint32_t mip = 0;
+	while (mip < entry.tailMip && static_cast<float>(longest >> (mip + 1)) >= pixels)
+		mip++;
+
+	entry.wantedMip = (entry.lastUse == _frame) ? std::min(entry.wantedMip, mip) : mip;
+	entry.lastUse = _frame;
+}
+
+const std::vector<Texture::Job>& Texture::Residency::schedule(size_t maxInFlight) {
+	_jobs.clear();
+
+	std::vector<Handle> wanting, victims;
+	for (Handle texture = 0; texture < _entries.size(); texture++) {
+		const Entry& entry = _entries[texture];
+		if (entry.pendingMip != entry.residentMip) continue;
+
+		// Unused textures fall back to their tail, used ones to what they asked for
+		const uint32_t keep = (entry.lastUse == _frame) ? entry.wantedMip : entry.tailMip;
+
+		if (entry.lastUse == _frame && entry.wantedMip < entry.residentMip)
+			wanting.push_back(texture);
+		else if (entry.residentMip < keep)
+			victims.push_back(texture);
+	}
+
+	// Furthest from what they asked for first
+	std::sort(wanting.begin(), wanting.end(), [&](Handle a, Handle b) {
+		const Entry& ea = _entries[a];
+		const Entry& eb = _entries[b];
+		return (ea.residentMip - ea.wantedMip) > (eb.residentMip - eb.wantedMip);
+	});
+
+	// Least recently used first
+	std::sort(victims.begin(), victims.end(), [&](Handle a, Handle b) {
+		return _entries[a].lastUse < _entries[b].lastUse;
+	});
+
+	// Bytes that evictions still in flight are about to give back
+	size_t freeing = 0;
+	for (Handle texture = 0; texture < _entries.size(); texture++) {
+		const Entry& entry = _entries[texture];
+		if (entry.pendingMip > entry.residentMip)
+			freeing += bytes(texture, entry.residentMip) - bytes(texture, entry.pendingMip);
+	}
+
+	auto victim = victims.begin();
+	for (Handle texture : wanting) {
+		if (_inFlight >= maxInFlight) break;
+
+		Entry& entry = _entries[texture];
+		const uint32_t target = entry.residentMip - 1;
+		const size_t extra = bytes(texture, target) - bytes(texture, entry.residentMip);
+
+		if (_committed + extra > _budget) {
+			// Memory only comes back once an eviction job is done, so the load waits a frame
+			while (_committed + extra > _budget + freeing && victim != victims.end()) {
+				Entry& evicted = _entries[*victim];
+				const uint32_t keep = (evicted.lastUse == _frame) ? evicted.wantedMip : evicted.tailMip;
+
+				freeing += bytes(*victim, evicted.residentMip) - bytes(*victim, keep);
+				evicted.pendingMip = keep;
+				_jobs.push_back({ *victim, keep });
+				_inFlight++;
+				_stats.evictions++;
+				++victim;
+			}
+
+			_stats.deferred++;
+			continue;
+		}
+
+		entry.pendingMip = target;
+		_committed += extra;
+		_jobs.push_back({ texture, target });
+		_inFlight++;
+		_stats.loads++;
+	}
+
+	return _jobs;
+}
+
+void Texture::Residency::complete(const Job& job) {
+	Entry& entry = _entries[job.texture];
+
+	_committed -= footprint(entry);
+	entry.residentMip = job.firstMip;
+	entry.pendingMip = job.firstMip;
+	_committed += footprint(entry);
+
+	_inFlight--;
+}
+
+size_t Texture::Residency::bytes(Handle texture, uint32_t firstMip) const {
+	size_t total = 0;
+	for (size_t bytes : std::span(_entries[texture].desc.mipBytes).subspan(firstMip))
+		total += bytes;
+
+	return total;
+}
+
+size_t Texture::Residency::footprint(const Entry& entry) const {
+	const Handle texture = static_cast<Handle>(&entry - _entries.data());
+	return bytes(texture, std::min(entry.residentMip, entry.pendingMip));
+}
+
+// Streamer
+
+void Texture::Streamer::start(std::function<void(const Job&)> load) {
+	stop();
+
+	_load = std::move(load);
+	_quit = false;
+	_worker = std::thread(&Streamer::work, this);
+}
+
+void Texture::Streamer::stop() {
+	if (!_worker.joinable()) return;
+
+	{
+		std::lock_guard lock(_mutex);
+		_quit = true;
+	}
+	_wake.notify_one();
+	_worker.join();
+
+	_queue.clear();
+}
+
+const std::vector<Texture::Job>& Texture::Streamer::update() {
+	{
+		std::lock_guard lock(_mutex);
+		std::swap(_finished, _done);
+		_done.clear();
+	}
+
+	for (auto& job : _finished)
+		residency.complete(job);
+
+	auto& jobs = residency.schedule(_maxInFlight);
+
+	// Without a worker thread the jobs run inline and finish next frame
+	if (!_worker.joinable()) {
+		for (auto& job : jobs) {
+			if (_load) _load(job);
+			_done.push_back(job);
+		}
+	}
+	else if (!jobs.empty()) {
+		{
+			std::lock_guard lock(_mutex);
+			_queue.insert(_queue.end(), jobs.begin(), jobs.end());
+		}
+		_wake.notify_one();
+	}
+
+	residency.beginFrame();
+	return _finished;
+}
+
+void Texture::Streamer::work() {
+	while (true) {
+		Job job;
+		{
+			std::unique_lock lock(_mutex);
+			_wake.wait(lock, [&] { return _quit || !_queue.empty(); });
+			if (_quit) return;
+
+			job = _queue.front();
+			_queue.pop_front();
+		}
+
+		_load(job);
+
+		std::lock_guard lock(_mutex);
+		_done.push_back(job);
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+
+namespace Texture {
+
+	using Handle = uint32_t;
+
+	// What the scheduler needs to know about one texture
+	struct Desc {
+		uint32_t width;
+		uint32_t height;
+		std::vector<size_t> mipBytes;   // mip 0 is the largest, all array slices included
+	};
+
+	// The texture should end up holding mips [firstMip, mipBytes.size())
+	struct Job {
+		Handle texture;
+		uint32_t firstMip;
+	};
+
+	// Decides which mips are resident under a byte budget. Knows nothing
+	// about threads or D3D, so it runs against fake textures just as well.
+	struct Residency {
+		struct Entry {
+			Desc desc;
+			uint32_t tailMip;       // smallest mips, resident from add() on and never evicted
+			uint32_t residentMip;   // first resident mip
+			uint32_t pendingMip;    // first mip of the job in flight, residentMip when idle
+			uint32_t wantedMip;     // most detailed mip requested this frame
+			uint64_t lastUse;
+		};
+
+		struct Stats {
+			size_t loads = 0;
+			size_t evictions = 0;
+			size_t deferred = 0;    // loads that did not fit the budget
+		};
+
+		// Mips with both edges at or below this are part of the tail
+		static constexpr uint32_t tailSize = 64;
+
+		size_t _budget = 0;
+		size_t _committed = 0;      // resident bytes, counting a job in flight at its larger size
+		size_t _inFlight = 0;
+		uint64_t _frame = 1;
+		std::vector<Entry> _entries;
+		std::vector<Job> _jobs;
+		Stats _stats;
+
+		explicit Residency(size_t budget = 0) : _budget(budget) {}
+
+		// Registers a texture with only its tail resident
+		Handle add(Desc desc);
+
+		// `pixels` is the longest edge the texture covers on screen
+		void request(Handle texture, float pixels);
+
+		// Moves at most `maxInFlight` textures one mip closer to what was requested,
+		// evicting the least recently used mips when the budget is full
+		const std::vector<Job>& schedule(size_t maxInFlight);
+
+		void complete(const Job& job);
+
+		void beginFrame() { _frame++; }
+
+		size_t bytes(Handle texture, uint32_t firstMip) const;
+		size_t footprint(const Entry& entry) const;
+	};
+
+	// Runs residency jobs on a background thread. `load` is called on that
+	// thread, update() hands the finished jobs back on the calling thread.
+	struct Streamer {
+		Residency residency;
+		size_t _maxInFlight = 4;
+
+		std::function<void(const Job&)> _load;
+		std::thread _worker;
+		std::mutex _mutex;
+		std::condition_variable _wake;
+		std::deque<Job> _queue;
+		std::vector<Job> _done;
+		std::vector<Job> _finished;
+		bool _quit = false;
+
+		Streamer() = default;
+		Streamer(const Streamer&) = delete;
+		Streamer& operator=(const Streamer&) = delete;
+		~Streamer() { stop(); }
+
+		void start(std::function<void(const Job&)> load);
+		void stop();
+
+		// Once per frame: applies finished jobs, queues new ones and returns
+		// the finished jobs so the caller can swap in the new textures
+		const std::vector<Job>& update();
+
+		void work();
+	};
+
+}
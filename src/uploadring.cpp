@@ -0,0 +1,115 @@
+#include <uploadring.h>
+
+#include <d3d11.h>
+#include <DX.h>
+
+#include <utility>
+#include <iterator>
+#include <algorithm>
+
+#include <backend.h>
+
+#define HR(fn) DX::ThrowIfFailed(fn, __FILE__, __LINE__, __func__)
+
+void UploadRing::create(ID3D11Device* device, size_t bytes) {
+	if (_buffer != nullptr) _buffer->Release();
+	_buffer = nullptr;
+
+	_capacity = bytes;
+	// First map always discards
+	_head = bytes;
+
+	// Headless runs keep the bytes in system memory
+	if (device == nullptr) {
+		_shadow.resize(bytes);
+		return;
+	}
+
+	D3D11_BUFFER_DESC ringDesc = {
+		.ByteWidth = static_cast<unsigned int>(bytes),
+		.Usage = D3D11_USAGE_DYNAMIC,
+		.BindFlags = D3D11_BIND_VERTEX_BUFFER,
+		.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE,
+	};
+
+	HR(device->CreateBuffer(&ringDesc, nullptr, &_buffer));
+}
+
+bool UploadRing::fits(size_t bytes, size_t align) const {
+	return bytes <= _capacity && (_head + align - 1) / align * align + bytes <= _capacity;
+}
+
+UploadRing::Allocation UploadRing::map(Backend::Context& ctx, ID3D11Device* device, size_t bytes, size_t align) {
+	if (_queued && !fits(bytes, align))
+		setAside(device, bytes);
+	else if (bytes > _capacity)
+		create(device, std::max(bytes, _capacity * 2));
+
+	size_t offset = (_head + align - 1) / align * align;
+	Backend::MapType type = Backend::MapType::WriteNoOverwrite;
+
+	if (offset + bytes > _capacity) {
+		offset = 0;
+		type = Backend::MapType::WriteDiscard;
+	}
+
+	_head = offset + bytes;
+	_queued = true;
+
+	auto* base = static_cast<unsigned char*>(ctx.map(Backend::handle(_buffer), type, bytes, offset));
+	if (_buffer == nullptr) base = _shadow.data();
+
+	return { base + offset, static_cast<unsigned int>(offset) };
+}
+
+void UploadRing::unmap(Backend::Context& ctx) {
+	ctx.unmap(Backend::handle(_buffer));
+}
+
+void UploadRing::setAside(ID3D11Device* device, size_t bytes) {
+	_retired.push_back({ std::exchange(_buffer, nullptr), _capacity, std::exchange(_shadow, {}) });
+
+	const size_t capacity = (bytes > _capacity) ? std::max(bytes, _capacity * 2) : _capacity;
+	auto spare = std::find_if(_spare.begin(), _spare.end(), [&](const Spare& s) { return s.capacity == capacity; });
+	if (spare == _spare.end()) {
+		create(device, capacity);
+		return;
+	}
+
+	// Maybe still read by the last frame, so the first map discards
+	_buffer = spare->buffer;
+	_shadow = std::move(spare->shadow);
+	_capacity = capacity;
+	_head = capacity;
+	_spare.erase(spare);
+}
+
+void UploadRing::recycle() {
+	std::move(_retired.begin(), _retired.end(), std::back_inserter(_spare));
+	_retired.clear();
+	_queued = false;
+
+	// The ring only grows, smaller spares are no use any more
+	std::erase_if(_spare, [&](Spare& spare) {
+		if (spare.capacity == _capacity) return false;
+		if (spare.buffer != nullptr) spare.buffer->Release();
+		return true;
+	});
+}
+
+void UploadRing::release() {
+	if (_buffer != nullptr) {
+		_buffer->Release();
+		_buffer = nullptr;
+	}
+
+	for (auto* list : { &_retired, &_spare }) {
+		for (Spare& spare : *list)
+			if (spare.buffer != nullptr) spare.buffer->Release();
+		list->clear();
+	}
+
+	_capacity = 0;
+	_head = 0;
+	_queued = false;
+}
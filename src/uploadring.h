@@ -0,0 +1,56 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <vector>
+
+#include <backend.h>
+
+// Dynamic vertex buffer handed out front to back with NO_OVERWRITE maps.
+// Only DISCARDs when an allocation wraps around, and is recreated bigger
+// when an allocation does not fit at all. Once draws may be queued on the
+// contents neither happens: the buffer is set aside until recycle and the
+// ring carries on in a spare one.
+struct UploadRing {
+	ID3D11Buffer* _buffer = nullptr;
+	size_t _capacity = 0;
+	size_t _head = 0;
+
+	// Headless rings write here instead, the software rasterizer reads it back
+	// when the draws are flushed
+	std::vector<unsigned char> _shadow;
+
+	// Mapped since the last recycle
+	bool _queued = false;
+
+	struct Spare {
+		ID3D11Buffer* buffer = nullptr;
+		size_t capacity = 0;
+		std::vector<unsigned char> shadow;
+	};
+
+	// Set aside since the last recycle, and free ones of the current size
+	std::vector<Spare> _retired, _spare;
+
+	struct Allocation {
+		void* data = nullptr;
+		unsigned int offset = 0;
+	};
+
+	void create(ID3D11Device* device, size_t bytes);
+
+	// False when mapping `bytes` would recreate or DISCARD the buffer
+	bool fits(size_t bytes, size_t align) const;
+
+	// Maps `bytes` aligned to `align`, the buffer stays mapped until unmap
+	Allocation map(Backend::Context& ctx, ID3D11Device* device, size_t bytes, size_t align);
+	void unmap(Backend::Context& ctx);
+
+	// Call once the queued draws were replayed, buffers set aside become spares
+	void recycle();
+
+	void release();
+
+private:
+	void setAside(ID3D11Device* device, size_t bytes);
+};